@@ -0,0 +1,3939 @@
+// O_DIRECT and statx are GNU extensions.
+#define _GNU_SOURCE
+
+#include "BF.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include <time.h>
+
+// Asynchronous reads use io_uring where the kernel headers define it, and a pool of threads otherwise.
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define BF_HAS_IO_URING 1
+#else
+#define BF_HAS_IO_URING 0
+#endif
+
+// The code of the last error that occured in the block level. Every thread has it's own.
+_Thread_local int BF_Errno = BFE_OK;
+
+// The magic number stored at the beginning of every block level file ("BF01").
+#define BF_MAGIC 0x31304642
+
+// The buffer pool is split in shards. Every shard owns a part of the frames and a page table for the blocks that hash
+// to it, so threads that access different blocks rarely wait for each other. The shard count is the largest power of two
+// up to BF_MAX_SHARD_COUNT that leaves every shard at least BF_MIN_FRAMES_PER_SHARD frames.
+#define BF_MAX_SHARD_COUNT 64
+#define BF_MIN_FRAMES_PER_SHARD 32
+
+// The size of the huge pages that back the frames when the configuration asks for them.
+#define BF_HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+// The queues of the frames, for the policies that keep more than one. RECENT is the 2Q A1in and the ARC T1 queue and
+// FREQUENT is the 2Q Am and the ARC T2 queue.
+#define BF_QUEUE_NONE 0
+#define BF_QUEUE_RECENT 1
+#define BF_QUEUE_FREQUENT 2
+#define BF_QUEUE_COUNT 3
+
+// The number of blocks returned by BF_ReadBlock that stay pinned for every thread. A block read with BF_ReadBlock is
+// unpinned once the thread has read this many newer blocks, so other threads can't evict the blocks it's still using.
+#define BF_IMPLICIT_PIN_COUNT 8
+
+// The maximum number of consecutive blocks a flush writes, or BF_ReadBlocks reads, with one pwritev or preadv call.
+#define BF_FLUSH_BATCH_SIZE 64
+
+// The maximum number of consecutive blocks an asynchronous read loads, and the maximum number of asynchronous reads in
+// flight. Prefetches past that are dropped, since they are only hints.
+#define BF_PREFETCH_RUN_SIZE 16
+#define BF_PREFETCH_QUEUE_SIZE 64
+
+// The number of threads that perform the asynchronous reads when io_uring is not available.
+#define BF_PREFETCH_THREAD_COUNT 4
+
+// How the asynchronous reads are performed. Chosen at the first prefetch.
+#define BF_PREFETCH_ENGINE_NONE 0
+#define BF_PREFETCH_ENGINE_IO_URING 1
+#define BF_PREFETCH_ENGINE_THREADS 2
+
+// The types of the log records. An update sets Length bytes at Offset of a block, an allocation appends a zeroed block
+// and a commit ends an operation. Redo applies only the records that are followed by a commit.
+#define BF_LOG_UPDATE 1
+#define BF_LOG_ALLOCATE 2
+#define BF_LOG_COMMIT 3
+
+// The changed byte ranges of a block that are closer than this many bytes are logged as one record.
+#define BF_LOG_RANGE_GAP 16
+
+// A commit checkpoints the file once it's log grows past this many bytes.
+#define BF_LOG_CHECKPOINT_SIZE ((uint64_t)16 * 1024 * 1024)
+
+// An invalid index in any of the internal tables.
+#define BF_INVALID_INDEX -1
+
+// Memory mapped files grow their mapping by this many bytes at a time.
+#define BF_MMAP_EXTENT_SIZE (16 * 1024 * 1024)
+
+// The address space reserved for every memory mapped file. Extents are mapped inside it so that pointers returned
+// by BF_ReadBlock stay valid while the file grows.
+#define BF_MMAP_RESERVE_SIZE ((size_t)64 * 1024 * 1024 * 1024)
+
+// The memory layout of the block level file header. It's stored at the beginning of the file, which is padded to
+// a whole block so that block N lives at byte offset (N + 1) * BlockSize.
+typedef struct BF_FileHeader
+{
+	// Used to recognize block level files.
+	uint32_t Magic;
+
+	// The size of every block in the file.
+	uint32_t BlockSize;
+} BF_FileHeader;
+
+// The header of a log record. Update records are followed by Length bytes.
+typedef struct BF_LogRecord
+{
+	uint32_t Type;
+	uint32_t BlockNumber;
+	uint32_t Offset;
+	uint32_t Length;
+
+	// A checksum of the record, so that a record torn by a crash ends the log.
+	uint32_t Checksum;
+} BF_LogRecord;
+
+// The write ahead log of a file. Changes are appended to the log buffer and the committer writes and syncs it. A block
+// is written to the file only after the log records of it's changes are committed and durable, so a crash never leaves
+// half of an operation in the file.
+typedef struct BF_Log
+{
+	// Whether the file is logged.
+	int IsEnabled;
+
+	// The OS file descriptor and the name of the log file.
+	int Descriptor;
+	char* FileName;
+
+	// Guards the rest of the fields.
+	pthread_mutex_t Lock;
+
+	// Signaled when the log has been written.
+	pthread_cond_t Written;
+
+	// The records that have not been written yet, and a spare buffer to append to while they are.
+	uint8_t* Buffer;
+	size_t BufferLength;
+	size_t BufferCapacity;
+	uint8_t* SpareBuffer;
+	size_t SpareBufferCapacity;
+
+	// The log positions count the bytes appended since the file was opened. Base is the position of the start of the
+	// log file, which moves forward when a checkpoint empties it.
+	uint64_t Base;
+	uint64_t Position;
+	uint64_t WrittenPosition;
+
+	// The position after the last commit record, and after the last one that is durable. DurablePosition is read without
+	// the lock by the eviction checks.
+	uint64_t CommitPosition;
+	uint64_t DurablePosition;
+
+	// The sequence numbers of the last commit and the last durable commit.
+	uint64_t CommitSequence;
+	uint64_t DurableSequence;
+
+	// Whether the log is being written, by the committer or a checkpoint.
+	int IsWriting;
+
+	// Whether writing the log has failed. The changes that follow can't be made durable.
+	int HasFailed;
+} BF_Log;
+
+// An OS level file. Opening the same file more than once shares this entry, so the buffer pool never holds two
+// copies of the same block.
+typedef struct BF_File
+{
+	// The OS file descriptor.
+	int Descriptor;
+
+	// Used to recognize the same file opened through a different path.
+	dev_t Device;
+	ino_t Inode;
+
+	// The size of every block in the file.
+	int BlockSize;
+
+	// The number of blocks in the file, excluding the file header.
+	int BlockCount;
+
+	// The number of blocks the disk space reserved for the file can hold, past the end of the file too.
+	int ReservedBlockCount;
+
+	// The number of open block level descriptors that refer to this file. Zero means that this entry is free.
+	int OpenCount;
+
+	// How the blocks of the file are accessed.
+	BF_Backend Backend;
+
+	// The reserved address space of a memory mapped file and the number of bytes of the file mapped into it.
+	uint8_t* Mapping;
+	size_t MappedSize;
+
+	// Serializes the allocation of new blocks.
+	pthread_mutex_t Lock;
+
+	// The write ahead log of a file opened with BF_OpenFileWithLog.
+	BF_Log Log;
+} BF_File;
+
+// A frame of the buffer pool.
+typedef struct BF_Frame
+{
+	// The file and block stored in the frame. File is BF_INVALID_INDEX if the frame is free.
+	int File;
+	int BlockNumber;
+
+	// The value of the access counter of the shard the last time the frame was used and the time before that. Used by the
+	// LRU-K policy, and to keep the order of the frames when the policy changes.
+	uint64_t LastUsed;
+	uint64_t PreviousUsed;
+
+	// Set on every access and cleared by the CLOCK hand.
+	int ReferenceBit;
+
+	// The queue of the frame for the 2Q and ARC policies.
+	int Queue;
+
+	// The neighbours of the frame in the free list of it's shard, or in the list of it's queue.
+	int Newer;
+	int Older;
+
+	// The position of the frame in the LRU-K heap of it's shard, or BF_INVALID_INDEX.
+	int HeapPosition;
+
+	// The next frame in the same page table slot.
+	int Next;
+
+	// The number of pins on the frame. Pinned frames are never evicted.
+	int PinCount;
+
+	// Incremented every time the frame is evicted, so that stale implicit pins can be recognized.
+	uint64_t Generation;
+
+	// Whether the block is being read from the disk, by a reader or a prefetch. Other threads wait on the shard's Loaded
+	// condition until it's done.
+	int IsLoading;
+
+	// Whether the block has changed since it was last written to it's file. Only set in write back mode.
+	int IsDirty;
+
+	// Whether a flush is writing the block. Threads that pin the block wait on the shard's Loaded condition until it's
+	// done, so that they don't change it halfway through the write.
+	int IsWriting;
+
+	// The log position after the last logged change of the block. A block of a logged file can be written to the file
+	// once the log is durable up to it.
+	uint64_t LogPosition;
+
+	// The shared/exclusive latch that BF_PinBlock acquires.
+	pthread_rwlock_t Latch;
+
+	// The shard that owns the frame.
+	int Shard;
+
+	// The memory of the frame.
+	uint8_t* Memory;
+
+	// The contents of the block. Points to Memory, or into the mapping of a memory mapped file.
+	uint8_t* Data;
+} BF_Frame;
+
+// A list of frames, linked through their Newer and Older fields from the most recently added one to the oldest.
+typedef struct BF_FrameList
+{
+	int Newest;
+	int Oldest;
+	int Count;
+} BF_FrameList;
+
+// A block recently evicted from a queue. Only it's identity is kept.
+typedef struct BF_Ghost
+{
+	int File;
+	int BlockNumber;
+
+	// The neighbours of the ghost in the eviction order.
+	int Newer;
+	int Older;
+
+	// The next ghost in the same hash slot, or in the free list.
+	int Next;
+} BF_Ghost;
+
+// The blocks recently evicted from a queue, in eviction order and indexed by a hash table, so that a block is found and
+// forgotten in constant time.
+typedef struct BF_GhostList
+{
+	// Room for as many ghosts as the frames of the shard.
+	BF_Ghost* Ghosts;
+	int FreeGhost;
+
+	// The newest and the oldest ghost, and the number of ghosts.
+	int Newest;
+	int Oldest;
+	int Count;
+
+	// The heads of the ghost lists for every hash slot. The slot count is a power of two.
+	int* Slots;
+	int SlotCount;
+} BF_GhostList;
+
+// A shard of the buffer pool.
+typedef struct BF_Shard
+{
+	// Guards the page table and the frames of the shard, except for their contents.
+	pthread_mutex_t Lock;
+
+	// Signaled when a frame of the shard finishes loading.
+	pthread_cond_t Loaded;
+
+	// The frames of the shard are the FrameCount frames starting from FirstFrame.
+	int FirstFrame;
+	int FrameCount;
+
+	// The heads of the frame lists for every page table slot. The slot count is a power of two.
+	int* PageTable;
+	int PageTableSize;
+
+	// Incremented on every block access in the shard.
+	uint64_t AccessCounter;
+
+	// The next frame the CLOCK hand looks at, relative to the first frame of the shard.
+	int ClockHand;
+
+	// The free frames, and the frames of every queue from the most to the least recently used. The policies without queues
+	// keep every frame in the BF_QUEUE_NONE list. The RECENT queue of 2Q is kept in load order, since it's evicted in FIFO order.
+	BF_FrameList FreeFrames;
+	BF_FrameList Queues[BF_QUEUE_COUNT];
+
+	// The frames for the LRU-K policy, as a binary heap whose top is the frame with the oldest second to last access. The
+	// frames that can't be evicted are taken off the top into SkippedFrames while a victim is selected.
+	int* Heap;
+	int HeapCount;
+	int* SkippedFrames;
+
+	// The blocks evicted from the RECENT and the FREQUENT queues.
+	BF_GhostList RecentGhosts;
+	BF_GhostList FrequentGhosts;
+
+	// The number of frames the ARC policy aims to keep in the RECENT queue.
+	int RecentTarget;
+
+	// The number of frames that prefetches are loading. Kept to a quarter of the frames, so that prefetches don't take
+	// over the frames that readers need.
+	int PrefetchingCount;
+
+	// The number of frames that a flush is writing back, which are pinned until it's done.
+	int WritingCount;
+
+	// The statistics of the shard.
+	uint64_t HitCount;
+	uint64_t MissCount;
+	uint64_t EvictionCount;
+	uint64_t PrefetchCount;
+} BF_Shard;
+
+// The operations of a replacement policy. They are called with the shard locked.
+typedef struct BF_PolicyOps
+{
+	// Called when a block is not in the buffer pool, before a frame is selected for it. Returns the ghost queue that
+	// remembered the block, or BF_QUEUE_NONE.
+	int (*OnMiss)(BF_Shard* shard, int file, int blockNumber);
+
+	// Returns the unpinned frame to evict for a block, or BF_INVALID_INDEX if every frame of the shard is pinned.
+	int (*SelectVictim)(BF_Shard* shard, int ghostQueue);
+
+	// Called before a frame is evicted to make room for another block.
+	void (*OnEvict)(BF_Shard* shard, BF_Frame* frame);
+
+	// Called when a frame is assigned to a block.
+	void (*OnLoad)(BF_Shard* shard, BF_Frame* frame, int ghostQueue);
+
+	// Called when a block is found in the buffer pool.
+	void (*OnHit)(BF_Shard* shard, BF_Frame* frame);
+} BF_PolicyOps;
+
+// A block that stays pinned after BF_ReadBlock.
+typedef struct BF_ImplicitPin
+{
+	// The frame of the block, or BF_INVALID_INDEX.
+	int Frame;
+
+	// The generation of the frame when it was pinned.
+	uint64_t Generation;
+} BF_ImplicitPin;
+
+// The blocks that a thread read with BF_ReadBlock and still has pinned.
+typedef struct BF_ThreadPins
+{
+	// A ring of the most recently read blocks.
+	BF_ImplicitPin Pins[BF_IMPLICIT_PIN_COUNT];
+
+	// The next slot of the ring to reuse.
+	int Next;
+
+	// Whether the pins are registered for release at thread exit.
+	int IsRegistered;
+} BF_ThreadPins;
+
+// A dirty block collected by a flush.
+typedef struct BF_DirtyBlock
+{
+	// The frame of the block, which the flush keeps pinned.
+	int Frame;
+
+	// The file and the number of the block, which the blocks are sorted by.
+	int File;
+	int BlockNumber;
+} BF_DirtyBlock;
+
+// A block requested from BF_ReadBlocks.
+typedef struct BF_BlockRequest
+{
+	// The number of the block and it's position in the arrays of the caller, since the requests are sorted.
+	int BlockNumber;
+	int Position;
+
+	// The frame the block is pinned in, or BF_INVALID_INDEX, and it's generation.
+	int Frame;
+	uint64_t Generation;
+
+	// Whether this call reads the block into it's frame, since it was not in the buffer pool.
+	int IsRead;
+} BF_BlockRequest;
+
+// An asynchronous read of consecutive blocks of a file into frames that are marked as loading.
+typedef struct BF_ReadRequest
+{
+	// The file, the first block and the number of blocks.
+	int File;
+	int BlockNumber;
+	int BlockCount;
+
+	// The frame of every block and the vector that reads into it.
+	int Frames[BF_PREFETCH_RUN_SIZE];
+	struct iovec Vectors[BF_PREFETCH_RUN_SIZE];
+
+	// The next request in the free list or in the queue of the thread pool.
+	int Next;
+} BF_ReadRequest;
+
+#if BF_HAS_IO_URING
+// The submission and completion queues of an io_uring instance, shared with the kernel.
+typedef struct BF_IoRing
+{
+	int Descriptor;
+
+	unsigned* SubmissionTail;
+	unsigned SubmissionMask;
+	unsigned* SubmissionArray;
+	struct io_uring_sqe* SubmissionEntries;
+
+	unsigned* CompletionHead;
+	unsigned* CompletionTail;
+	unsigned CompletionMask;
+	struct io_uring_cqe* CompletionEntries;
+} BF_IoRing;
+#endif
+
+// Whether BF_Init has been called.
+static int s_Initialized = 0;
+
+// Guards the file and descriptor tables.
+static pthread_mutex_t s_FileTableLock = PTHREAD_MUTEX_INITIALIZER;
+
+// The maximum number of simultaneously open block level files. Set by BF_InitWithConfig.
+static int s_MaxOpenFiles = BF_DEFAULT_MAX_OPEN_FILES;
+
+// The OS level files.
+static BF_File* s_Files = NULL;
+
+// Maps block level file descriptors to OS level files.
+static int* s_Descriptors = NULL;
+
+// The buffer pool, along with the memory of it's frames. Every frame is s_FrameSize bytes, the largest block size the
+// configuration allows.
+static int s_FrameCount = 0;
+static int s_FrameSize = BF_MAX_BLOCK_SIZE;
+static BF_Frame* s_Frames = NULL;
+static uint8_t* s_FrameMemory = NULL;
+
+// The shards of the buffer pool. The count is a power of two.
+static int s_ShardCount = 0;
+static BF_Shard* s_Shards = NULL;
+
+// The implicit pins of every thread, and the key that releases them when the thread exits.
+static _Thread_local BF_ThreadPins t_ThreadPins;
+static pthread_key_t s_ThreadPinsKey;
+
+// The backend of the files opened from now on.
+static BF_Backend s_Backend = BF_BACKEND_BUFFERED;
+
+// The replacement policy of the buffer pool. Changed only with every shard locked.
+static BF_ReplacementPolicy s_Policy = BF_POLICY_LRU;
+
+// How BF_WriteBlock writes the blocks, and how often the flusher runs in write back mode. Set by BF_InitWithConfig.
+static BF_WriteMode s_WriteMode = BF_WRITE_THROUGH;
+static int s_FlushInterval = BF_DEFAULT_FLUSH_INTERVAL;
+
+// Whether the buffered files bypass the page cache with direct I/O. Set by BF_InitWithConfig.
+static int s_UseDirectIO = 0;
+
+// The number of blocks the disk space of a file is reserved in. Set by BF_InitWithConfig.
+static int s_ExtentBlockCount = BF_DEFAULT_EXTENT_BLOCK_COUNT;
+
+// The number of dirty frames. The flusher is woken up early once a quarter of the frames is dirty.
+static int s_DirtyFrameCount = 0;
+
+// Serializes the flushes, so that a flush returns only after the blocks another flush was writing have been written.
+// Also guards s_DirtyBlocks, which holds the blocks collected by the current flush.
+static pthread_mutex_t s_FlushLock = PTHREAD_MUTEX_INITIALIZER;
+static BF_DirtyBlock* s_DirtyBlocks = NULL;
+
+// The background flusher sleeps on this condition between flushes.
+static pthread_mutex_t s_FlusherLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_FlusherWake = PTHREAD_COND_INITIALIZER;
+
+// The contents of the frames of logged files as they were last logged, so that BF_WriteBlock logs only the bytes that
+// changed. Allocated when the first logged file is opened, and as large as the frame memory.
+static uint8_t* s_ShadowMemory = NULL;
+
+// The sequence number of the last commit of any file.
+static uint64_t s_CommitSequence = 0;
+
+// The committer writes the logs with commits waiting. It sleeps on this condition until BF_Commit counts a request.
+static int s_IsCommitterRunning = 0;
+static int s_CommitRequestCount = 0;
+static pthread_mutex_t s_CommitterLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_CommitterWake = PTHREAD_COND_INITIALIZER;
+
+// The asynchronous reads. Free requests are linked from s_FreeReadRequest and the requests that wait for the thread pool
+// from s_FirstQueuedRead to s_LastQueuedRead. Guarded by s_PrefetchLock.
+static pthread_mutex_t s_PrefetchLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_PrefetchWake = PTHREAD_COND_INITIALIZER;
+static BF_ReadRequest s_ReadRequests[BF_PREFETCH_QUEUE_SIZE];
+static int s_FreeReadRequest = BF_INVALID_INDEX;
+static int s_FirstQueuedRead = BF_INVALID_INDEX;
+static int s_LastQueuedRead = BF_INVALID_INDEX;
+static int s_PrefetchEngine = BF_PREFETCH_ENGINE_NONE;
+
+#if BF_HAS_IO_URING
+static BF_IoRing s_IoRing;
+#endif
+
+// The descriptions of the error codes. Indexed by the negated error code.
+static const char* s_ErrorMessages[] =
+{
+	"No error",
+	"Out of memory",
+	"Cannot open file",
+	"Cannot close file",
+	"Cannot create file",
+	"Incomplete read of block",
+	"Incomplete write of block",
+	"File already exists",
+	"No free buffer frame",
+	"List error",
+	"File is already open",
+	"Invalid file descriptor",
+	"File does not exist",
+	"Open file table is full",
+	"Header overflow",
+	"Block is already fixed",
+	"Block is not fixed",
+	"End of file",
+	"File has fixed blocks",
+	"Block is free",
+	"Block is already in the buffer",
+	"Block is not in the buffer",
+	"Invalid block number",
+	"Cannot destroy file",
+	"Invalid block size",
+	"Invalid configuration",
+	"The backend does not support logging"
+};
+
+// Hashes a block. The low bits select the shard and the rest select the page table slot.
+static uint32_t HashBlock(int file, int blockNumber)
+{
+	uint32_t hash = (uint32_t)file * 0x9E3779B1u ^ (uint32_t)blockNumber * 0x85EBCA77u;
+	hash ^= hash >> 15;
+
+	return hash;
+}
+
+// Returns the shard of a block.
+static BF_Shard* GetShard(int file, int blockNumber)
+{
+	return &s_Shards[HashBlock(file, blockNumber) & (s_ShardCount - 1)];
+}
+
+// Returns the shard that owns a frame.
+static BF_Shard* GetFrameShard(int frameIndex)
+{
+	return &s_Shards[s_Frames[frameIndex].Shard];
+}
+
+// Returns the page table slot of a block in it's shard.
+static int* GetPageTableSlot(BF_Shard* shard, int file, int blockNumber)
+{
+	return &shard->PageTable[(HashBlock(file, blockNumber) / s_ShardCount) & (shard->PageTableSize - 1)];
+}
+
+// Returns the frame that holds a block, or BF_INVALID_INDEX if the block is not in the buffer pool. The shard must be locked.
+static int FindFrame(BF_Shard* shard, int file, int blockNumber)
+{
+	int frameIndex = *GetPageTableSlot(shard, file, blockNumber);
+	while (frameIndex != BF_INVALID_INDEX)
+	{
+		if (s_Frames[frameIndex].File == file && s_Frames[frameIndex].BlockNumber == blockNumber)
+			return frameIndex;
+
+		frameIndex = s_Frames[frameIndex].Next;
+	}
+
+	return BF_INVALID_INDEX;
+}
+
+// Returns the byte offset of a block in it's file.
+static off_t BlockOffset(const BF_File* file, int blockNumber)
+{
+	return (off_t)(blockNumber + 1) * file->BlockSize;
+}
+
+// Returns the contents of a frame of a logged file as they were last logged.
+static uint8_t* GetShadow(int frameIndex)
+{
+	return s_ShadowMemory + (size_t)frameIndex * s_FrameSize;
+}
+
+// Returns whether a frame can be written to it's file. The changes to a block of a logged file must be committed and
+// durable in the log first.
+static int IsWritable(const BF_Frame* frame)
+{
+	if (frame->File == BF_INVALID_INDEX)
+		return 1;
+
+	return frame->LogPosition <= __atomic_load_n(&s_Files[frame->File].Log.DurablePosition, __ATOMIC_ACQUIRE);
+}
+
+// Marks a frame dirty. The shard must be locked.
+static void MarkFrameDirty(BF_Frame* frame)
+{
+	if (frame->IsDirty)
+		return;
+
+	frame->IsDirty = 1;
+
+	// Wake the flusher up early when many frames are dirty, so that evictions rarely have to write.
+	if (__atomic_add_fetch(&s_DirtyFrameCount, 1, __ATOMIC_RELAXED) > s_FrameCount / 4)
+		pthread_cond_signal(&s_FlusherWake);
+}
+
+// Marks a frame clean. The shard must be locked.
+static void MarkFrameClean(BF_Frame* frame)
+{
+	if (!frame->IsDirty)
+		return;
+
+	frame->IsDirty = 0;
+	__atomic_sub_fetch(&s_DirtyFrameCount, 1, __ATOMIC_RELAXED);
+}
+
+// Writes the block of a dirty frame to it's file and marks the frame clean. Returns 0 on success and -1 on failure, in
+// which case the frame stays dirty. The shard must be locked.
+static int WriteFrame(BF_Frame* frame)
+{
+	BF_File* file = &s_Files[frame->File];
+	if (pwrite(file->Descriptor, frame->Data, file->BlockSize, BlockOffset(file, frame->BlockNumber)) != file->BlockSize)
+		return -1;
+
+	MarkFrameClean(frame);
+	return 0;
+}
+
+// Returns the index of a frame.
+static int GetFrameIndex(const BF_Frame* frame)
+{
+	return (int)(frame - s_Frames);
+}
+
+// Inserts a frame at the newest end of a frame list.
+static void LinkFrame(BF_FrameList* list, int frameIndex)
+{
+	BF_Frame* frame = &s_Frames[frameIndex];
+	frame->Newer = BF_INVALID_INDEX;
+	frame->Older = list->Newest;
+
+	if (list->Newest != BF_INVALID_INDEX)
+		s_Frames[list->Newest].Newer = frameIndex;
+	else
+		list->Oldest = frameIndex;
+
+	list->Newest = frameIndex;
+	list->Count++;
+}
+
+// Removes a frame from a frame list.
+static void UnlinkFrame(BF_FrameList* list, int frameIndex)
+{
+	BF_Frame* frame = &s_Frames[frameIndex];
+
+	if (frame->Newer != BF_INVALID_INDEX)
+		s_Frames[frame->Newer].Older = frame->Older;
+	else
+		list->Newest = frame->Older;
+
+	if (frame->Older != BF_INVALID_INDEX)
+		s_Frames[frame->Older].Newer = frame->Newer;
+	else
+		list->Oldest = frame->Newer;
+
+	frame->Newer = BF_INVALID_INDEX;
+	frame->Older = BF_INVALID_INDEX;
+	list->Count--;
+}
+
+// Empties a frame list.
+static void ResetFrameList(BF_FrameList* list)
+{
+	list->Newest = BF_INVALID_INDEX;
+	list->Oldest = BF_INVALID_INDEX;
+	list->Count = 0;
+}
+
+// Returns whether a frame comes before another in the LRU-K heap. Frames accessed only once have no second to last
+// access, so they come first, and ties are broken by the last access.
+static int IsHeapOlder(int frameIndex, int otherFrameIndex)
+{
+	const BF_Frame* frame = &s_Frames[frameIndex];
+	const BF_Frame* other = &s_Frames[otherFrameIndex];
+
+	return frame->PreviousUsed < other->PreviousUsed || (frame->PreviousUsed == other->PreviousUsed && frame->LastUsed < other->LastUsed);
+}
+
+// Places a frame at a position of the LRU-K heap.
+static void SetHeapPosition(BF_Shard* shard, int position, int frameIndex)
+{
+	shard->Heap[position] = frameIndex;
+	s_Frames[frameIndex].HeapPosition = position;
+}
+
+// Moves the frame at a position of the LRU-K heap up or down until the heap is ordered again.
+static void RestoreHeap(BF_Shard* shard, int position)
+{
+	int frameIndex = shard->Heap[position];
+
+	while (position > 0 && IsHeapOlder(frameIndex, shard->Heap[(position - 1) / 2]))
+	{
+		SetHeapPosition(shard, position, shard->Heap[(position - 1) / 2]);
+		position = (position - 1) / 2;
+	}
+
+	while (2 * position + 1 < shard->HeapCount)
+	{
+		int childPosition = 2 * position + 1;
+		if (childPosition + 1 < shard->HeapCount && IsHeapOlder(shard->Heap[childPosition + 1], shard->Heap[childPosition]))
+			childPosition++;
+
+		if (!IsHeapOlder(shard->Heap[childPosition], frameIndex))
+			break;
+
+		SetHeapPosition(shard, position, shard->Heap[childPosition]);
+		position = childPosition;
+	}
+
+	SetHeapPosition(shard, position, frameIndex);
+}
+
+// Inserts a frame in the LRU-K heap.
+static void PushHeap(BF_Shard* shard, int frameIndex)
+{
+	SetHeapPosition(shard, shard->HeapCount++, frameIndex);
+	RestoreHeap(shard, shard->HeapCount - 1);
+}
+
+// Removes a frame from the LRU-K heap.
+static void RemoveFromHeap(BF_Shard* shard, int frameIndex)
+{
+	int position = s_Frames[frameIndex].HeapPosition;
+	s_Frames[frameIndex].HeapPosition = BF_INVALID_INDEX;
+
+	int lastFrameIndex = shard->Heap[--shard->HeapCount];
+	if (position == shard->HeapCount)
+		return;
+
+	SetHeapPosition(shard, position, lastFrameIndex);
+	RestoreHeap(shard, position);
+}
+
+// Removes a frame from the page table of it's shard and the lists of the replacement policy, and marks it as free. The
+// shard must be locked.
+static void EvictFrame(int frameIndex)
+{
+	BF_Frame* frame = &s_Frames[frameIndex];
+	if (frame->File == BF_INVALID_INDEX)
+		return;
+
+	BF_Shard* shard = GetFrameShard(frameIndex);
+	UnlinkFrame(&shard->Queues[frame->Queue], frameIndex);
+	if (frame->HeapPosition != BF_INVALID_INDEX)
+		RemoveFromHeap(shard, frameIndex);
+
+	LinkFrame(&shard->FreeFrames, frameIndex);
+
+	MarkFrameClean(frame);
+
+	int* link = GetPageTableSlot(shard, frame->File, frame->BlockNumber);
+	while (*link != frameIndex)
+		link = &s_Frames[*link].Next;
+
+	*link = frame->Next;
+
+	frame->File = BF_INVALID_INDEX;
+	frame->BlockNumber = BF_INVALID_INDEX;
+	frame->Next = BF_INVALID_INDEX;
+	frame->LastUsed = 0;
+	frame->Generation++;
+}
+
+// Returns whether a frame can be evicted.
+static int IsEvictable(const BF_Frame* frame)
+{
+	return frame->PinCount == 0 && !frame->IsLoading && (!frame->IsDirty || IsWritable(frame));
+}
+
+// Returns the file of an unpinned frame of the shard that can't be evicted only because it's changes are committed but
+// not durable in the log yet, or BF_INVALID_INDEX if there is none. Frames with changes that are not committed stay until
+// the operation that made them commits. The shard must be locked.
+static int FindCommittedFile(const BF_Shard* shard)
+{
+	for (int frameIndex = shard->FirstFrame; frameIndex < shard->FirstFrame + shard->FrameCount; frameIndex++)
+	{
+		const BF_Frame* frame = &s_Frames[frameIndex];
+		if (frame->PinCount > 0 || frame->IsLoading || !frame->IsDirty || IsWritable(frame))
+			continue;
+
+		BF_Log* log = &s_Files[frame->File].Log;
+		pthread_mutex_lock(&log->Lock);
+		int isCommitted = (frame->LogPosition <= log->CommitPosition);
+		pthread_mutex_unlock(&log->Lock);
+
+		if (isCommitted)
+			return frame->File;
+	}
+
+	return BF_INVALID_INDEX;
+}
+
+// Returns the hash slot of a block in a ghost list of the shard.
+static int* GetGhostSlot(BF_GhostList* ghosts, int file, int blockNumber)
+{
+	return &ghosts->Slots[(HashBlock(file, blockNumber) / s_ShardCount) & (ghosts->SlotCount - 1)];
+}
+
+// Forgets every block of a ghost list.
+static void ResetGhosts(BF_GhostList* ghosts, int capacity)
+{
+	for (int index = 0; index < capacity; index++)
+		ghosts->Ghosts[index].Next = (index + 1 < capacity) ? index + 1 : BF_INVALID_INDEX;
+
+	for (int index = 0; index < ghosts->SlotCount; index++)
+		ghosts->Slots[index] = BF_INVALID_INDEX;
+
+	ghosts->FreeGhost = (capacity > 0) ? 0 : BF_INVALID_INDEX;
+	ghosts->Newest = BF_INVALID_INDEX;
+	ghosts->Oldest = BF_INVALID_INDEX;
+	ghosts->Count = 0;
+}
+
+// Returns the ghost of a block in a ghost list, or BF_INVALID_INDEX.
+static int FindGhost(BF_GhostList* ghosts, int file, int blockNumber)
+{
+	int ghostIndex = *GetGhostSlot(ghosts, file, blockNumber);
+	while (ghostIndex != BF_INVALID_INDEX && (ghosts->Ghosts[ghostIndex].File != file || ghosts->Ghosts[ghostIndex].BlockNumber != blockNumber))
+		ghostIndex = ghosts->Ghosts[ghostIndex].Next;
+
+	return ghostIndex;
+}
+
+// Removes a ghost from a ghost list.
+static void RemoveGhost(BF_GhostList* ghosts, int ghostIndex)
+{
+	BF_Ghost* ghost = &ghosts->Ghosts[ghostIndex];
+
+	int* link = GetGhostSlot(ghosts, ghost->File, ghost->BlockNumber);
+	while (*link != ghostIndex)
+		link = &ghosts->Ghosts[*link].Next;
+
+	*link = ghost->Next;
+
+	if (ghost->Newer != BF_INVALID_INDEX)
+		ghosts->Ghosts[ghost->Newer].Older = ghost->Older;
+	else
+		ghosts->Newest = ghost->Older;
+
+	if (ghost->Older != BF_INVALID_INDEX)
+		ghosts->Ghosts[ghost->Older].Newer = ghost->Newer;
+	else
+		ghosts->Oldest = ghost->Newer;
+
+	ghost->Next = ghosts->FreeGhost;
+	ghosts->FreeGhost = ghostIndex;
+	ghosts->Count--;
+}
+
+// Adds a block to a ghost list, forgetting the oldest one if the list already holds capacity blocks.
+static void PushGhost(BF_GhostList* ghosts, int capacity, int file, int blockNumber)
+{
+	if (capacity <= 0)
+		return;
+
+	if (ghosts->Count >= capacity)
+		RemoveGhost(ghosts, ghosts->Oldest);
+
+	int ghostIndex = ghosts->FreeGhost;
+	BF_Ghost* ghost = &ghosts->Ghosts[ghostIndex];
+	ghosts->FreeGhost = ghost->Next;
+
+	ghost->File = file;
+	ghost->BlockNumber = blockNumber;
+	ghost->Newer = BF_INVALID_INDEX;
+	ghost->Older = ghosts->Newest;
+
+	if (ghosts->Newest != BF_INVALID_INDEX)
+		ghosts->Ghosts[ghosts->Newest].Newer = ghostIndex;
+	else
+		ghosts->Oldest = ghostIndex;
+
+	ghosts->Newest = ghostIndex;
+	ghosts->Count++;
+
+	int* slot = GetGhostSlot(ghosts, file, blockNumber);
+	ghost->Next = *slot;
+	*slot = ghostIndex;
+}
+
+// Returns the evictable frame of a queue that was least recently used, or BF_INVALID_INDEX if there is none. The frames
+// that can't be evicted are pinned or were changed, so they were mostly used recently and the walk rarely passes many.
+static int FindOldestFrame(const BF_Shard* shard, int queue)
+{
+	for (int frameIndex = shard->Queues[queue].Oldest; frameIndex != BF_INVALID_INDEX; frameIndex = s_Frames[frameIndex].Newer)
+	{
+		if (IsEvictable(&s_Frames[frameIndex]))
+			return frameIndex;
+	}
+
+	return BF_INVALID_INDEX;
+}
+
+// Moves a frame to the most recently used end of the list of it's queue.
+static void MoveToNewest(BF_Shard* shard, BF_Frame* frame)
+{
+	int frameIndex = GetFrameIndex(frame);
+
+	UnlinkFrame(&shard->Queues[frame->Queue], frameIndex);
+	LinkFrame(&shard->Queues[frame->Queue], frameIndex);
+}
+
+// Policy operations that do nothing.
+static int NoGhostOnMiss(BF_Shard* shard, int file, int blockNumber)
+{
+	(void)shard;
+	(void)file;
+	(void)blockNumber;
+
+	return BF_QUEUE_NONE;
+}
+
+static void NoOpOnEvict(BF_Shard* shard, BF_Frame* frame)
+{
+	(void)shard;
+	(void)frame;
+}
+
+static void NoOpOnLoad(BF_Shard* shard, BF_Frame* frame, int ghostQueue)
+{
+	(void)shard;
+	(void)frame;
+	(void)ghostQueue;
+}
+
+// LRU evicts the least recently used frame.
+static int LRUSelectVictim(BF_Shard* shard, int ghostQueue)
+{
+	(void)ghostQueue;
+
+	return FindOldestFrame(shard, BF_QUEUE_NONE);
+}
+
+static void LRUOnHit(BF_Shard* shard, BF_Frame* frame)
+{
+	MoveToNewest(shard, frame);
+}
+
+// CLOCK sweeps the frames in a circle, giving every frame that was accessed since the last sweep a second chance.
+static int ClockSelectVictim(BF_Shard* shard, int ghostQueue)
+{
+	(void)ghostQueue;
+
+	// Two turns clear every reference bit, so if there's no victim by then every frame is pinned.
+	for (int step = 0; step < 2 * shard->FrameCount; step++)
+	{
+		int frameIndex = shard->FirstFrame + shard->ClockHand;
+		shard->ClockHand = (shard->ClockHand + 1) % shard->FrameCount;
+
+		BF_Frame* frame = &s_Frames[frameIndex];
+		if (!IsEvictable(frame))
+			continue;
+
+		if (frame->ReferenceBit)
+		{
+			frame->ReferenceBit = 0;
+			continue;
+		}
+
+		return frameIndex;
+	}
+
+	return BF_INVALID_INDEX;
+}
+
+static void ClockOnLoad(BF_Shard* shard, BF_Frame* frame, int ghostQueue)
+{
+	(void)shard;
+	(void)ghostQueue;
+
+	frame->ReferenceBit = 1;
+}
+
+static void ClockOnHit(BF_Shard* shard, BF_Frame* frame)
+{
+	(void)shard;
+
+	frame->ReferenceBit = 1;
+}
+
+// LRU-2 evicts the frame whose second to last access is the oldest. Frames accessed only once count as the oldest, so a
+// scan can only evict blocks of the scan.
+// The frames are kept in a heap, since an access moves a frame by it's previous access rather than to one end.
+static int LRUKSelectVictim(BF_Shard* shard, int ghostQueue)
+{
+	(void)ghostQueue;
+
+	// Take the frames that can't be evicted off the top until the top can be, and then put them back.
+	int skippedCount = 0;
+	while (shard->HeapCount > 0 && !IsEvictable(&s_Frames[shard->Heap[0]]))
+	{
+		shard->SkippedFrames[skippedCount++] = shard->Heap[0];
+		RemoveFromHeap(shard, shard->Heap[0]);
+	}
+
+	int victimIndex = (shard->HeapCount > 0) ? shard->Heap[0] : BF_INVALID_INDEX;
+
+	for (int index = 0; index < skippedCount; index++)
+		PushHeap(shard, shard->SkippedFrames[index]);
+
+	return victimIndex;
+}
+
+static void LRUKOnLoad(BF_Shard* shard, BF_Frame* frame, int ghostQueue)
+{
+	(void)ghostQueue;
+
+	PushHeap(shard, GetFrameIndex(frame));
+}
+
+static void LRUKOnHit(BF_Shard* shard, BF_Frame* frame)
+{
+	RestoreHeap(shard, frame->HeapPosition);
+}
+
+// 2Q loads blocks in the RECENT queue, which is evicted in FIFO order once it grows past it's share of the frames. Blocks
+// that are loaded again while they are remembered as evicted from it go to the FREQUENT queue, which is evicted in LRU order.
+static int TwoQueueOnMiss(BF_Shard* shard, int file, int blockNumber)
+{
+	int ghostIndex = FindGhost(&shard->RecentGhosts, file, blockNumber);
+	if (ghostIndex == BF_INVALID_INDEX)
+		return BF_QUEUE_NONE;
+
+	RemoveGhost(&shard->RecentGhosts, ghostIndex);
+	return BF_QUEUE_RECENT;
+}
+
+static int TwoQueueSelectVictim(BF_Shard* shard, int ghostQueue)
+{
+	(void)ghostQueue;
+
+	// A quarter of the frames is kept for the blocks accessed only once.
+	int queue = (shard->Queues[BF_QUEUE_RECENT].Count > shard->FrameCount / 4) ? BF_QUEUE_RECENT : BF_QUEUE_FREQUENT;
+	int victimIndex = FindOldestFrame(shard, queue);
+
+	// If the preferred queue is pinned, fall back to the other one.
+	if (victimIndex == BF_INVALID_INDEX)
+		victimIndex = FindOldestFrame(shard, (queue == BF_QUEUE_RECENT) ? BF_QUEUE_FREQUENT : BF_QUEUE_RECENT);
+
+	return victimIndex;
+}
+
+static void TwoQueueOnEvict(BF_Shard* shard, BF_Frame* frame)
+{
+	if (frame->Queue == BF_QUEUE_RECENT)
+		PushGhost(&shard->RecentGhosts, shard->FrameCount / 2, frame->File, frame->BlockNumber);
+}
+
+static void TwoQueueOnLoad(BF_Shard* shard, BF_Frame* frame, int ghostQueue)
+{
+	(void)shard;
+
+	frame->Queue = (ghostQueue == BF_QUEUE_NONE) ? BF_QUEUE_RECENT : BF_QUEUE_FREQUENT;
+}
+
+static void TwoQueueOnHit(BF_Shard* shard, BF_Frame* frame)
+{
+	// The RECENT queue stays in load order.
+	if (frame->Queue == BF_QUEUE_FREQUENT)
+		MoveToNewest(shard, frame);
+}
+
+// ARC splits the frames between the RECENT queue, for blocks accessed once, and the FREQUENT queue, for blocks accessed
+// more than once. It remembers the blocks evicted from both, and adapts the share of the RECENT queue towards the queue
+// whose evicted blocks are loaded again.
+static int ARCOnMiss(BF_Shard* shard, int file, int blockNumber)
+{
+	int recentGhostCount = shard->RecentGhosts.Count;
+	int frequentGhostCount = shard->FrequentGhosts.Count;
+
+	int ghostIndex = FindGhost(&shard->RecentGhosts, file, blockNumber);
+	if (ghostIndex != BF_INVALID_INDEX)
+	{
+		int delta = (frequentGhostCount > recentGhostCount) ? frequentGhostCount / recentGhostCount : 1;
+		shard->RecentTarget = (shard->RecentTarget + delta < shard->FrameCount) ? shard->RecentTarget + delta : shard->FrameCount;
+
+		RemoveGhost(&shard->RecentGhosts, ghostIndex);
+		return BF_QUEUE_RECENT;
+	}
+
+	ghostIndex = FindGhost(&shard->FrequentGhosts, file, blockNumber);
+	if (ghostIndex != BF_INVALID_INDEX)
+	{
+		int delta = (recentGhostCount > frequentGhostCount) ? recentGhostCount / frequentGhostCount : 1;
+		shard->RecentTarget = (shard->RecentTarget > delta) ? shard->RecentTarget - delta : 0;
+
+		RemoveGhost(&shard->FrequentGhosts, ghostIndex);
+		return BF_QUEUE_FREQUENT;
+	}
+
+	return BF_QUEUE_NONE;
+}
+
+static int ARCSelectVictim(BF_Shard* shard, int ghostQueue)
+{
+	int recentCount = shard->Queues[BF_QUEUE_RECENT].Count;
+
+	int queue = BF_QUEUE_FREQUENT;
+	if (recentCount > 0 && (recentCount > shard->RecentTarget || (ghostQueue == BF_QUEUE_FREQUENT && recentCount == shard->RecentTarget)))
+		queue = BF_QUEUE_RECENT;
+
+	int victimIndex = FindOldestFrame(shard, queue);
+
+	// If the preferred queue is pinned, fall back to the other one.
+	if (victimIndex == BF_INVALID_INDEX)
+		victimIndex = FindOldestFrame(shard, (queue == BF_QUEUE_RECENT) ? BF_QUEUE_FREQUENT : BF_QUEUE_RECENT);
+
+	return victimIndex;
+}
+
+static void ARCOnEvict(BF_Shard* shard, BF_Frame* frame)
+{
+	if (frame->Queue == BF_QUEUE_RECENT)
+		PushGhost(&shard->RecentGhosts, shard->FrameCount, frame->File, frame->BlockNumber);
+	else
+		PushGhost(&shard->FrequentGhosts, shard->FrameCount, frame->File, frame->BlockNumber);
+}
+
+static void ARCOnLoad(BF_Shard* shard, BF_Frame* frame, int ghostQueue)
+{
+	(void)shard;
+
+	frame->Queue = (ghostQueue == BF_QUEUE_NONE) ? BF_QUEUE_RECENT : BF_QUEUE_FREQUENT;
+}
+
+static void ARCOnHit(BF_Shard* shard, BF_Frame* frame)
+{
+	int frameIndex = GetFrameIndex(frame);
+
+	UnlinkFrame(&shard->Queues[frame->Queue], frameIndex);
+	frame->Queue = BF_QUEUE_FREQUENT;
+	LinkFrame(&shard->Queues[frame->Queue], frameIndex);
+}
+
+// The operations of every replacement policy, indexed by BF_ReplacementPolicy.
+static const BF_PolicyOps s_PolicyOps[] =
+{
+	{ NoGhostOnMiss, LRUSelectVictim, NoOpOnEvict, NoOpOnLoad, LRUOnHit },
+	{ NoGhostOnMiss, ClockSelectVictim, NoOpOnEvict, ClockOnLoad, ClockOnHit },
+	{ TwoQueueOnMiss, TwoQueueSelectVictim, TwoQueueOnEvict, TwoQueueOnLoad, TwoQueueOnHit },
+	{ ARCOnMiss, ARCSelectVictim, ARCOnEvict, ARCOnLoad, ARCOnHit },
+	{ NoGhostOnMiss, LRUKSelectVictim, NoOpOnEvict, LRUKOnLoad, LRUKOnHit }
+};
+
+// Records an access to a frame that holds a block. The shard must be locked.
+static void TouchFrame(BF_Shard* shard, BF_Frame* frame)
+{
+	frame->PreviousUsed = frame->LastUsed;
+	frame->LastUsed = ++shard->AccessCounter;
+	shard->HitCount++;
+
+	s_PolicyOps[s_Policy].OnHit(shard, frame);
+}
+
+// Assigns a frame of the shard to a block and inserts it in the page table. Uses a free frame if there is one, otherwise
+// the replacement policy selects an unpinned frame to evict. Returns BF_INVALID_INDEX if every frame of the shard is
+// pinned. The shard must be locked.
+static int AcquireFrame(BF_Shard* shard, int file, int blockNumber)
+{
+	const BF_PolicyOps* policy = &s_PolicyOps[s_Policy];
+	int ghostQueue = policy->OnMiss(shard, file, blockNumber);
+
+	// A free frame may still be pinned by the threads that waited for a block that failed to load, until they notice.
+	int victimIndex = shard->FreeFrames.Newest;
+	while (victimIndex != BF_INVALID_INDEX && !IsEvictable(&s_Frames[victimIndex]))
+		victimIndex = s_Frames[victimIndex].Older;
+
+	if (victimIndex == BF_INVALID_INDEX)
+	{
+		victimIndex = policy->SelectVictim(shard, ghostQueue);
+		if (victimIndex == BF_INVALID_INDEX)
+			return BF_INVALID_INDEX;
+
+		// A dirty block is written back before it's frame is reused. If that fails, the block stays in the frame.
+		if (s_Frames[victimIndex].IsDirty && WriteFrame(&s_Frames[victimIndex]) < 0)
+			return BF_INVALID_INDEX;
+
+		policy->OnEvict(shard, &s_Frames[victimIndex]);
+		shard->EvictionCount++;
+	}
+
+	EvictFrame(victimIndex);
+	UnlinkFrame(&shard->FreeFrames, victimIndex);
+
+	BF_Frame* frame = &s_Frames[victimIndex];
+	frame->File = file;
+	frame->BlockNumber = blockNumber;
+	frame->LastUsed = ++shard->AccessCounter;
+	frame->PreviousUsed = 0;
+	frame->ReferenceBit = 0;
+	frame->Queue = BF_QUEUE_NONE;
+	frame->LogPosition = 0;
+
+	policy->OnLoad(shard, frame, ghostQueue);
+	LinkFrame(&shard->Queues[frame->Queue], victimIndex);
+
+	int* slot = GetPageTableSlot(shard, file, blockNumber);
+	frame->Next = *slot;
+	*slot = victimIndex;
+
+	return victimIndex;
+}
+
+// Maps the file into it's reserved address space so that at least byteCount bytes are mapped. Returns 0 on success.
+static int GrowMapping(BF_File* file, size_t byteCount)
+{
+	if (byteCount <= file->MappedSize)
+		return 0;
+
+	size_t newMappedSize = ((byteCount + BF_MMAP_EXTENT_SIZE - 1) / BF_MMAP_EXTENT_SIZE) * BF_MMAP_EXTENT_SIZE;
+	if (newMappedSize > BF_MMAP_RESERVE_SIZE)
+		return -1;
+
+	// Map only the new extents, at their fixed place after the ones already mapped.
+	void* extents = mmap(file->Mapping + file->MappedSize, newMappedSize - file->MappedSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_FIXED, file->Descriptor, file->MappedSize);
+	if (extents == MAP_FAILED)
+		return -1;
+
+	file->MappedSize = newMappedSize;
+	return 0;
+}
+
+// Schedules the write back of the pages that hold the byte range of a memory mapped file.
+static int SyncMapping(BF_File* file, off_t offset, size_t byteCount, int flags)
+{
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t start = ((size_t)offset / pageSize) * pageSize;
+
+	return msync(file->Mapping + start, (size_t)offset + byteCount - start, flags);
+}
+
+// Validates a block level file descriptor and returns the OS level file it refers to, or NULL on failure.
+static BF_File* GetFile(int fileDesc)
+{
+	if (fileDesc < 0 || fileDesc >= s_MaxOpenFiles || s_Descriptors == NULL || s_Descriptors[fileDesc] == BF_INVALID_INDEX)
+	{
+		BF_Errno = BFE_FD;
+		return NULL;
+	}
+
+	return &s_Files[s_Descriptors[fileDesc]];
+}
+
+// Returns the number of blocks of a file. It's read without the file lock, since BF_AllocateBlock only increments it after
+// the new block is written.
+static int GetBlockCount(BF_File* file)
+{
+	return __atomic_load_n(&file->BlockCount, __ATOMIC_ACQUIRE);
+}
+
+// Reserves disk space for the first blockCount blocks of a file, a whole extent of blocks at a time, so that the blocks
+// are contiguous on the disk. The size of the file doesn't change. The reservation is only a hint, so failures, such as
+// file systems without fallocate, are ignored.
+static void ReserveBlocks(BF_File* file, int blockCount)
+{
+	if (s_ExtentBlockCount == 0 || blockCount <= file->ReservedBlockCount)
+		return;
+
+	int reservedBlockCount = ((blockCount + s_ExtentBlockCount - 1) / s_ExtentBlockCount) * s_ExtentBlockCount;
+	fallocate(file->Descriptor, FALLOC_FL_KEEP_SIZE, BlockOffset(file, file->ReservedBlockCount),
+		(off_t)(reservedBlockCount - file->ReservedBlockCount) * file->BlockSize);
+
+	file->ReservedBlockCount = reservedBlockCount;
+}
+
+// Frees the disk space reserved past the end of a file. Truncating a file to it's own size frees the blocks past it's end.
+static void ReleaseReservedBlocks(BF_File* file)
+{
+	struct stat fileStatus;
+	if (file->ReservedBlockCount <= GetBlockCount(file) || fstat(file->Descriptor, &fileStatus) < 0)
+		return;
+
+	if (ftruncate(file->Descriptor, fileStatus.st_size) == 0)
+		file->ReservedBlockCount = GetBlockCount(file);
+}
+
+// Returns the FNV-1a checksum of a log record and the bytes that follow it.
+static uint32_t ChecksumLogRecord(const BF_LogRecord* record, const uint8_t* data)
+{
+	BF_LogRecord header = *record;
+	header.Checksum = 0;
+
+	uint32_t checksum = 2166136261u;
+	for (size_t index = 0; index < sizeof(BF_LogRecord); index++)
+		checksum = (checksum ^ ((const uint8_t*)&header)[index]) * 16777619u;
+
+	for (uint32_t index = 0; index < record->Length; index++)
+		checksum = (checksum ^ data[index]) * 16777619u;
+
+	return checksum;
+}
+
+// Appends a record to the log buffer. Returns the log position after the record, or 0 if the buffer could not grow.
+// The log must be locked.
+static uint64_t AppendLogRecord(BF_Log* log, uint32_t type, int blockNumber, uint32_t offset, const uint8_t* data, uint32_t length)
+{
+	size_t recordSize = sizeof(BF_LogRecord) + length;
+	if (log->BufferLength + recordSize > log->BufferCapacity)
+	{
+		size_t newCapacity = (log->BufferCapacity > 0) ? log->BufferCapacity : BF_MAX_BLOCK_SIZE * 4;
+		while (newCapacity < log->BufferLength + recordSize)
+			newCapacity *= 2;
+
+		uint8_t* newBuffer = (uint8_t*)realloc(log->Buffer, newCapacity);
+		if (newBuffer == NULL)
+			return 0;
+
+		log->Buffer = newBuffer;
+		log->BufferCapacity = newCapacity;
+	}
+
+	BF_LogRecord record = { };
+	record.Type = type;
+	record.BlockNumber = (uint32_t)blockNumber;
+	record.Offset = offset;
+	record.Length = length;
+	record.Checksum = ChecksumLogRecord(&record, data);
+
+	memcpy(log->Buffer + log->BufferLength, &record, sizeof(BF_LogRecord));
+	if (length > 0)
+		memcpy(log->Buffer + log->BufferLength + sizeof(BF_LogRecord), data, length);
+
+	log->BufferLength += recordSize;
+	log->Position += recordSize;
+
+	return log->Position;
+}
+
+// Appends a commit record if records were appended since the last one. The log must be locked.
+static int AppendLogCommit(BF_Log* log)
+{
+	if (log->Position == log->CommitPosition)
+		return 0;
+
+	if (AppendLogRecord(log, BF_LOG_COMMIT, 0, 0, NULL, 0) == 0)
+		return -1;
+
+	log->CommitPosition = log->Position;
+	log->CommitSequence = __atomic_add_fetch(&s_CommitSequence, 1, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+// Logs the bytes of a frame that changed since they were last logged, as one record for every changed range. Returns 0
+// on success and -1 if the log buffer could not grow. The shard must be locked.
+static int LogFrameChanges(BF_File* file, int frameIndex)
+{
+	BF_Frame* frame = &s_Frames[frameIndex];
+	uint8_t* shadow = GetShadow(frameIndex);
+
+	pthread_mutex_lock(&file->Log.Lock);
+
+	int offset = 0;
+	while (offset < file->BlockSize)
+	{
+		if (frame->Data[offset] == shadow[offset])
+		{
+			offset++;
+			continue;
+		}
+
+		// Extend the range until BF_LOG_RANGE_GAP bytes in a row are unchanged.
+		int end = offset + 1;
+		for (int index = end; index < file->BlockSize && index < end + BF_LOG_RANGE_GAP; index++)
+			if (frame->Data[index] != shadow[index])
+				end = index + 1;
+
+		uint64_t position = AppendLogRecord(&file->Log, BF_LOG_UPDATE, frame->BlockNumber, offset, frame->Data + offset, end - offset);
+		if (position == 0)
+		{
+			pthread_mutex_unlock(&file->Log.Lock);
+			return -1;
+		}
+
+		memcpy(shadow + offset, frame->Data + offset, end - offset);
+		frame->LogPosition = position;
+
+		offset = end;
+	}
+
+	pthread_mutex_unlock(&file->Log.Lock);
+
+	return 0;
+}
+
+// Logs the allocation of the block in a frame. Returns 0 on success and -1 if the log buffer could not grow. The shard
+// must be locked.
+static int LogAllocation(BF_File* file, int frameIndex)
+{
+	BF_Frame* frame = &s_Frames[frameIndex];
+
+	pthread_mutex_lock(&file->Log.Lock);
+	uint64_t position = AppendLogRecord(&file->Log, BF_LOG_ALLOCATE, frame->BlockNumber, 0, NULL, 0);
+	pthread_mutex_unlock(&file->Log.Lock);
+
+	if (position == 0)
+		return -1;
+
+	frame->LogPosition = position;
+	return 0;
+}
+
+// Writes the log buffer to the log file and syncs it, which makes the commits in it durable. Records appended meanwhile
+// go to the spare buffer. Returns 0 on success and -1 on failure.
+static int WriteLog(BF_Log* log)
+{
+	pthread_mutex_lock(&log->Lock);
+
+	// Only one thread writes the log at a time.
+	while (log->IsWriting)
+		pthread_cond_wait(&log->Written, &log->Lock);
+
+	if (!log->IsEnabled || log->HasFailed || log->BufferLength == 0)
+	{
+		int result = (log->IsEnabled && log->HasFailed) ? -1 : 0;
+		pthread_mutex_unlock(&log->Lock);
+
+		return result;
+	}
+
+	// Swap the buffers and remember what the written one holds.
+	uint8_t* buffer = log->Buffer;
+	size_t length = log->BufferLength;
+	size_t capacity = log->BufferCapacity;
+
+	log->Buffer = log->SpareBuffer;
+	log->BufferCapacity = log->SpareBufferCapacity;
+	log->BufferLength = 0;
+	log->SpareBuffer = NULL;
+	log->SpareBufferCapacity = 0;
+
+	off_t offset = (off_t)(log->WrittenPosition - log->Base);
+	uint64_t writtenPosition = log->WrittenPosition + length;
+	uint64_t commitPosition = log->CommitPosition;
+	uint64_t commitSequence = log->CommitSequence;
+
+	log->IsWriting = 1;
+	pthread_mutex_unlock(&log->Lock);
+
+	int result = (pwrite(log->Descriptor, buffer, length, offset) == (ssize_t)length && fdatasync(log->Descriptor) == 0) ? 0 : -1;
+
+	pthread_mutex_lock(&log->Lock);
+	log->IsWriting = 0;
+
+	// Keep the written buffer as the spare one.
+	if (log->SpareBuffer == NULL)
+	{
+		log->SpareBuffer = buffer;
+		log->SpareBufferCapacity = capacity;
+	}
+	else
+		free(buffer);
+
+	if (result == 0)
+	{
+		log->WrittenPosition = writtenPosition;
+		log->DurableSequence = commitSequence;
+		__atomic_store_n(&log->DurablePosition, commitPosition, __ATOMIC_RELEASE);
+	}
+	else
+		log->HasFailed = 1;
+
+	pthread_cond_broadcast(&log->Written);
+	pthread_mutex_unlock(&log->Lock);
+
+	return result;
+}
+
+// Pins the frame of a block, loading the block in the buffer pool if it's not there. New blocks are zero filled instead
+// of read. Memory mapped blocks are not copied, their frame points into the mapping. Returns the frame index and stores
+// it's generation, or returns BF_INVALID_INDEX and sets BF_Errno on failure.
+static int PinFrame(BF_File* file, int fileIndex, int blockNumber, int isNewBlock, uint64_t* generation)
+{
+	BF_Shard* shard = GetShard(fileIndex, blockNumber);
+	pthread_mutex_lock(&shard->Lock);
+
+	// Serve the block from the buffer pool if it's there.
+	int frameIndex = FindFrame(shard, fileIndex, blockNumber);
+	if (frameIndex != BF_INVALID_INDEX)
+	{
+		BF_Frame* frame = &s_Frames[frameIndex];
+		frame->PinCount++;
+		TouchFrame(shard, frame);
+
+		// Another thread may still be reading the block from the disk, or a flush writing it.
+		while (frame->IsLoading || frame->IsWriting)
+			pthread_cond_wait(&shard->Loaded, &shard->Lock);
+
+		// If loading it failed, the frame no longer holds the block. Load it again, since the failed read may have been
+		// a prefetch.
+		if (frame->File != fileIndex || frame->BlockNumber != blockNumber)
+		{
+			frame->PinCount--;
+			pthread_mutex_unlock(&shard->Lock);
+
+			return PinFrame(file, fileIndex, blockNumber, isNewBlock, generation);
+		}
+
+		*generation = frame->Generation;
+		pthread_mutex_unlock(&shard->Lock);
+
+		return frameIndex;
+	}
+
+	// Otherwise assign a frame to it.
+	frameIndex = AcquireFrame(shard, fileIndex, blockNumber);
+
+	// If the only frames that could be evicted are being prefetched or written back, wait for them and start over.
+	if (frameIndex == BF_INVALID_INDEX && (shard->PrefetchingCount > 0 || shard->WritingCount > 0))
+	{
+		pthread_cond_wait(&shard->Loaded, &shard->Lock);
+		pthread_mutex_unlock(&shard->Lock);
+
+		return PinFrame(file, fileIndex, blockNumber, isNewBlock, generation);
+	}
+
+	if (frameIndex == BF_INVALID_INDEX)
+	{
+		int committedFileIndex = FindCommittedFile(shard);
+		pthread_mutex_unlock(&shard->Lock);
+
+		// If the only frames that could be evicted hold committed changes that are not durable in the log yet, write the log
+		// instead of waiting for the committer and start over.
+		if (committedFileIndex != BF_INVALID_INDEX)
+		{
+			if (WriteLog(&s_Files[committedFileIndex].Log) == 0)
+				return PinFrame(file, fileIndex, blockNumber, isNewBlock, generation);
+
+			BF_Errno = BFE_INCOMPLETEWRITE;
+			return BF_INVALID_INDEX;
+		}
+
+		BF_Errno = BFE_NOBUF;
+		return BF_INVALID_INDEX;
+	}
+
+	BF_Frame* frame = &s_Frames[frameIndex];
+	frame->PinCount = 1;
+	*generation = frame->Generation;
+
+	// New blocks are not misses, since they are never read.
+	if (!isNewBlock)
+		shard->MissCount++;
+
+	if (file->Backend == BF_BACKEND_MMAP)
+	{
+		frame->Data = file->Mapping + BlockOffset(file, blockNumber);
+		pthread_mutex_unlock(&shard->Lock);
+
+		return frameIndex;
+	}
+
+	frame->Data = frame->Memory;
+
+	if (isNewBlock)
+	{
+		memset(frame->Data, 0, file->BlockSize);
+		if (file->Log.IsEnabled)
+			memset(GetShadow(frameIndex), 0, file->BlockSize);
+
+		pthread_mutex_unlock(&shard->Lock);
+
+		return frameIndex;
+	}
+
+	// Read the block without holding the shard lock. Threads that want the same block wait until it's loaded.
+	frame->IsLoading = 1;
+	pthread_mutex_unlock(&shard->Lock);
+
+	ssize_t readByteCount = pread(file->Descriptor, frame->Data, file->BlockSize, BlockOffset(file, blockNumber));
+	if (readByteCount == file->BlockSize && file->Log.IsEnabled)
+		memcpy(GetShadow(frameIndex), frame->Data, file->BlockSize);
+
+	pthread_mutex_lock(&shard->Lock);
+	frame->IsLoading = 0;
+
+	if (readByteCount != file->BlockSize)
+	{
+		EvictFrame(frameIndex);
+		frame->PinCount--;
+		pthread_cond_broadcast(&shard->Loaded);
+		pthread_mutex_unlock(&shard->Lock);
+
+		BF_Errno = BFE_INCOMPLETEREAD;
+		return BF_INVALID_INDEX;
+	}
+
+	pthread_cond_broadcast(&shard->Loaded);
+	pthread_mutex_unlock(&shard->Lock);
+
+	return frameIndex;
+}
+
+// Removes a pin from a frame, unless the frame has been evicted since it was pinned.
+static void UnpinFrame(int frameIndex, uint64_t generation)
+{
+	BF_Shard* shard = GetFrameShard(frameIndex);
+	pthread_mutex_lock(&shard->Lock);
+
+	BF_Frame* frame = &s_Frames[frameIndex];
+	if (frame->Generation == generation && frame->PinCount > 0)
+		frame->PinCount--;
+
+	pthread_mutex_unlock(&shard->Lock);
+}
+
+// Releases the implicit pins of a thread. Called when the thread exits.
+static void ReleaseThreadPins(void* threadPins)
+{
+	BF_ThreadPins* pins = (BF_ThreadPins*)threadPins;
+	for (int index = 0; index < BF_IMPLICIT_PIN_COUNT; index++)
+	{
+		if (pins->Pins[index].Frame != BF_INVALID_INDEX)
+			UnpinFrame(pins->Pins[index].Frame, pins->Pins[index].Generation);
+
+		pins->Pins[index].Frame = BF_INVALID_INDEX;
+	}
+}
+
+// Keeps a frame pinned for the calling thread until it has read BF_IMPLICIT_PIN_COUNT newer blocks.
+static void AddImplicitPin(int frameIndex, uint64_t generation)
+{
+	BF_ThreadPins* pins = &t_ThreadPins;
+	if (!pins->IsRegistered)
+	{
+		for (int index = 0; index < BF_IMPLICIT_PIN_COUNT; index++)
+			pins->Pins[index].Frame = BF_INVALID_INDEX;
+
+		pthread_setspecific(s_ThreadPinsKey, pins);
+		pins->IsRegistered = 1;
+	}
+
+	BF_ImplicitPin* pin = &pins->Pins[pins->Next];
+	if (pin->Frame != BF_INVALID_INDEX)
+		UnpinFrame(pin->Frame, pin->Generation);
+
+	pin->Frame = frameIndex;
+	pin->Generation = generation;
+
+	pins->Next = (pins->Next + 1) % BF_IMPLICIT_PIN_COUNT;
+}
+
+// Pins the frames of blocks sorted by block number, loading the ones that are not in the buffer pool with one preadv call
+// for every run of consecutive blocks. Every request is pinned once, even if it repeats a block. On failure no block stays
+// pinned. Returns a BF error code.
+static int PinFrames(BF_File* file, int fileIndex, BF_BlockRequest* requests, int requestCount)
+{
+	int result = BFE_OK;
+
+	// Pin the blocks that are in the buffer pool and assign frames to the rest, without reading them yet. Holding frames
+	// that are loading is safe, since nothing here waits for another thread until they are loaded.
+	int pinnedCount = 0;
+	while (pinnedCount < requestCount)
+	{
+		BF_BlockRequest* request = &requests[pinnedCount];
+		BF_Shard* shard = GetShard(fileIndex, request->BlockNumber);
+		pthread_mutex_lock(&shard->Lock);
+
+		request->IsRead = 0;
+
+		int frameIndex = FindFrame(shard, fileIndex, request->BlockNumber);
+		if (frameIndex != BF_INVALID_INDEX)
+		{
+			s_Frames[frameIndex].PinCount++;
+			TouchFrame(shard, &s_Frames[frameIndex]);
+		}
+		else
+		{
+			frameIndex = AcquireFrame(shard, fileIndex, request->BlockNumber);
+
+			// If the only frames that could be evicted are being prefetched or written back, wait for them and try the block again.
+			if (frameIndex == BF_INVALID_INDEX && (shard->PrefetchingCount > 0 || shard->WritingCount > 0))
+			{
+				pthread_cond_wait(&shard->Loaded, &shard->Lock);
+				pthread_mutex_unlock(&shard->Lock);
+
+				continue;
+			}
+
+			if (frameIndex == BF_INVALID_INDEX)
+			{
+				int committedFileIndex = FindCommittedFile(shard);
+				pthread_mutex_unlock(&shard->Lock);
+
+				// If the only frames that could be evicted hold committed changes that are not durable in the log yet, write
+				// the log instead of waiting for the committer and try the block again.
+				if (committedFileIndex != BF_INVALID_INDEX && WriteLog(&s_Files[committedFileIndex].Log) == 0)
+					continue;
+
+				result = (committedFileIndex != BF_INVALID_INDEX) ? BFE_INCOMPLETEWRITE : BFE_NOBUF;
+				break;
+			}
+
+			BF_Frame* frame = &s_Frames[frameIndex];
+			frame->PinCount = 1;
+			shard->MissCount++;
+
+			if (file->Backend == BF_BACKEND_MMAP)
+				frame->Data = file->Mapping + BlockOffset(file, request->BlockNumber);
+			else
+			{
+				frame->Data = frame->Memory;
+				frame->IsLoading = 1;
+				request->IsRead = 1;
+			}
+		}
+
+		request->Frame = frameIndex;
+		request->Generation = s_Frames[frameIndex].Generation;
+
+		pthread_mutex_unlock(&shard->Lock);
+		pinnedCount++;
+	}
+
+	// Read the runs of consecutive blocks that were assigned frames. If pinning failed, they are released unread.
+	struct iovec vectors[BF_FLUSH_BATCH_SIZE];
+	int index = 0;
+	while (index < pinnedCount)
+	{
+		if (!requests[index].IsRead)
+		{
+			index++;
+			continue;
+		}
+
+		int runLength = 0;
+		while (index + runLength < pinnedCount && runLength < BF_FLUSH_BATCH_SIZE && requests[index + runLength].IsRead &&
+			requests[index + runLength].BlockNumber == requests[index].BlockNumber + runLength)
+		{
+			vectors[runLength].iov_base = s_Frames[requests[index + runLength].Frame].Data;
+			vectors[runLength].iov_len = file->BlockSize;
+			runLength++;
+		}
+
+		ssize_t byteCount = -1;
+		if (result == BFE_OK)
+			byteCount = preadv(file->Descriptor, vectors, runLength, BlockOffset(file, requests[index].BlockNumber));
+
+		for (int runIndex = 0; runIndex < runLength; runIndex++)
+		{
+			BF_BlockRequest* request = &requests[index + runIndex];
+			BF_Frame* frame = &s_Frames[request->Frame];
+
+			int isRead = byteCount >= (ssize_t)(runIndex + 1) * file->BlockSize;
+			if (isRead && file->Log.IsEnabled)
+				memcpy(GetShadow(request->Frame), frame->Data, file->BlockSize);
+
+			BF_Shard* shard = GetFrameShard(request->Frame);
+			pthread_mutex_lock(&shard->Lock);
+
+			frame->IsLoading = 0;
+			if (!isRead)
+			{
+				EvictFrame(request->Frame);
+				frame->PinCount--;
+				request->Frame = BF_INVALID_INDEX;
+
+				if (result == BFE_OK)
+					result = BFE_INCOMPLETEREAD;
+			}
+
+			pthread_cond_broadcast(&shard->Loaded);
+			pthread_mutex_unlock(&shard->Lock);
+		}
+
+		index += runLength;
+	}
+
+	// Wait for the blocks that other threads are still loading or writing.
+	for (index = 0; index < pinnedCount && result == BFE_OK; index++)
+	{
+		BF_BlockRequest* request = &requests[index];
+		if (request->IsRead)
+			continue;
+
+		BF_Shard* shard = GetFrameShard(request->Frame);
+		pthread_mutex_lock(&shard->Lock);
+
+		BF_Frame* frame = &s_Frames[request->Frame];
+		while (frame->IsLoading || frame->IsWriting)
+			pthread_cond_wait(&shard->Loaded, &shard->Lock);
+
+		// If loading it failed, or a batch that could not pin all it's blocks released it unread, the frame no longer holds
+		// the block. Load it again.
+		if (frame->File != fileIndex || frame->BlockNumber != request->BlockNumber)
+		{
+			frame->PinCount--;
+			pthread_mutex_unlock(&shard->Lock);
+
+			request->Frame = PinFrame(file, fileIndex, request->BlockNumber, 0, &request->Generation);
+			if (request->Frame == BF_INVALID_INDEX)
+				result = BF_Errno;
+
+			continue;
+		}
+
+		pthread_mutex_unlock(&shard->Lock);
+	}
+
+	if (result != BFE_OK)
+	{
+		for (index = 0; index < pinnedCount; index++)
+		{
+			if (requests[index].Frame != BF_INVALID_INDEX)
+				UnpinFrame(requests[index].Frame, requests[index].Generation);
+		}
+	}
+
+	return result;
+}
+
+// Orders block numbers.
+static int CompareBlockNumbers(const void* first, const void* second)
+{
+	int firstBlockNumber = *(const int*)first;
+	int secondBlockNumber = *(const int*)second;
+
+	return (firstBlockNumber > secondBlockNumber) - (firstBlockNumber < secondBlockNumber);
+}
+
+// Orders block requests by block number.
+static int CompareBlockRequests(const void* first, const void* second)
+{
+	const BF_BlockRequest* firstRequest = (const BF_BlockRequest*)first;
+	const BF_BlockRequest* secondRequest = (const BF_BlockRequest*)second;
+
+	return (firstRequest->BlockNumber > secondRequest->BlockNumber) - (firstRequest->BlockNumber < secondRequest->BlockNumber);
+}
+
+// Orders dirty blocks by file and block number.
+static int CompareDirtyBlocks(const void* first, const void* second)
+{
+	const BF_DirtyBlock* firstBlock = (const BF_DirtyBlock*)first;
+	const BF_DirtyBlock* secondBlock = (const BF_DirtyBlock*)second;
+
+	if (firstBlock->File != secondBlock->File)
+		return (firstBlock->File < secondBlock->File) ? -1 : 1;
+
+	return (firstBlock->BlockNumber > secondBlock->BlockNumber) - (firstBlock->BlockNumber < secondBlock->BlockNumber);
+}
+
+// Writes the dirty frames of a file, or of every file if fileIndex is BF_INVALID_INDEX. The blocks are sorted, and the
+// consecutive blocks of a file are written with one pwritev call. Pinned frames may be changing, so they are skipped
+// unless includePinned is set. So are frames with changes that are not durable in the log yet. Returns 0 on success
+// and -1 if any block could not be written, in which case it stays dirty.
+static int FlushFrames(int fileIndex, int includePinned)
+{
+	pthread_mutex_lock(&s_FlushLock);
+
+	// Collect the dirty frames and pin them, so that they are not evicted while they are written, and keep new pins
+	// waiting until they are written.
+	int blockCount = 0;
+	for (int shardIndex = 0; shardIndex < s_ShardCount; shardIndex++)
+	{
+		BF_Shard* shard = &s_Shards[shardIndex];
+		pthread_mutex_lock(&shard->Lock);
+
+		for (int frameIndex = shard->FirstFrame; frameIndex < shard->FirstFrame + shard->FrameCount; frameIndex++)
+		{
+			BF_Frame* frame = &s_Frames[frameIndex];
+			if (!frame->IsDirty || (fileIndex != BF_INVALID_INDEX && frame->File != fileIndex) || (!includePinned && frame->PinCount > 0) ||
+				!IsWritable(frame))
+				continue;
+
+			MarkFrameClean(frame);
+			frame->PinCount++;
+			frame->IsWriting = 1;
+			shard->WritingCount++;
+
+			BF_DirtyBlock* block = &s_DirtyBlocks[blockCount++];
+			block->Frame = frameIndex;
+			block->File = frame->File;
+			block->BlockNumber = frame->BlockNumber;
+		}
+
+		pthread_mutex_unlock(&shard->Lock);
+	}
+
+	qsort(s_DirtyBlocks, blockCount, sizeof(BF_DirtyBlock), CompareDirtyBlocks);
+
+	int result = 0;
+	struct iovec vectors[BF_FLUSH_BATCH_SIZE];
+
+	int firstIndex = 0;
+	while (firstIndex < blockCount)
+	{
+		// Extend the batch while the blocks are consecutive blocks of the same file.
+		int lastIndex = firstIndex + 1;
+		while (lastIndex < blockCount && lastIndex - firstIndex < BF_FLUSH_BATCH_SIZE &&
+			s_DirtyBlocks[lastIndex].File == s_DirtyBlocks[firstIndex].File &&
+			s_DirtyBlocks[lastIndex].BlockNumber == s_DirtyBlocks[lastIndex - 1].BlockNumber + 1)
+			lastIndex++;
+
+		BF_File* file = &s_Files[s_DirtyBlocks[firstIndex].File];
+		for (int index = firstIndex; index < lastIndex; index++)
+		{
+			vectors[index - firstIndex].iov_base = s_Frames[s_DirtyBlocks[index].Frame].Data;
+			vectors[index - firstIndex].iov_len = file->BlockSize;
+		}
+
+		ssize_t byteCount = (ssize_t)(lastIndex - firstIndex) * file->BlockSize;
+		if (pwritev(file->Descriptor, vectors, lastIndex - firstIndex, BlockOffset(file, s_DirtyBlocks[firstIndex].BlockNumber)) != byteCount)
+		{
+			// Mark the blocks dirty again, so that a later flush retries them.
+			for (int index = firstIndex; index < lastIndex; index++)
+			{
+				BF_Frame* frame = &s_Frames[s_DirtyBlocks[index].Frame];
+				BF_Shard* shard = GetFrameShard(s_DirtyBlocks[index].Frame);
+
+				pthread_mutex_lock(&shard->Lock);
+				MarkFrameDirty(frame);
+				pthread_mutex_unlock(&shard->Lock);
+			}
+
+			result = -1;
+		}
+
+		firstIndex = lastIndex;
+	}
+
+	// Let the threads waiting for the blocks pin them.
+	for (int index = 0; index < blockCount; index++)
+	{
+		BF_Frame* frame = &s_Frames[s_DirtyBlocks[index].Frame];
+		BF_Shard* shard = GetFrameShard(s_DirtyBlocks[index].Frame);
+
+		pthread_mutex_lock(&shard->Lock);
+		frame->IsWriting = 0;
+		frame->PinCount--;
+		shard->WritingCount--;
+		pthread_cond_broadcast(&shard->Loaded);
+		pthread_mutex_unlock(&shard->Lock);
+	}
+
+	pthread_mutex_unlock(&s_FlushLock);
+
+	return result;
+}
+
+// The committer. Writes the logs of the files every time commits are requested. The commits requested while it writes
+// make up the next batch, so concurrent writers share one sync.
+static void* RunCommitter(void* argument)
+{
+	(void)argument;
+
+	pthread_mutex_lock(&s_CommitterLock);
+
+	while (1)
+	{
+		while (s_CommitRequestCount == 0)
+			pthread_cond_wait(&s_CommitterWake, &s_CommitterLock);
+
+		s_CommitRequestCount = 0;
+		pthread_mutex_unlock(&s_CommitterLock);
+
+		for (int fileIndex = 0; fileIndex < s_MaxOpenFiles; fileIndex++)
+			WriteLog(&s_Files[fileIndex].Log);
+
+		pthread_mutex_lock(&s_CommitterLock);
+	}
+
+	return NULL;
+}
+
+// Makes a logged file durable and empties it's log. Commits the records of the current operation, writes the log, then
+// writes every dirty block of the file and syncs it. Returns a BF error code.
+static int CheckpointFile(BF_File* file, int fileIndex)
+{
+	BF_Log* log = &file->Log;
+
+	pthread_mutex_lock(&log->Lock);
+	int commitResult = AppendLogCommit(log);
+	pthread_mutex_unlock(&log->Lock);
+
+	if (commitResult < 0)
+		return BFE_NOMEM;
+
+	if (WriteLog(log) < 0)
+		return BFE_INCOMPLETEWRITE;
+
+	if (FlushFrames(fileIndex, 1) < 0 || fdatasync(file->Descriptor) < 0)
+		return BFE_INCOMPLETEWRITE;
+
+	// Empty the log, unless more records were appended meanwhile.
+	int result = BFE_OK;
+
+	pthread_mutex_lock(&log->Lock);
+	while (log->IsWriting)
+		pthread_cond_wait(&log->Written, &log->Lock);
+
+	if (log->Position == log->WrittenPosition)
+	{
+		if (ftruncate(log->Descriptor, 0) < 0)
+			result = BFE_INCOMPLETEWRITE;
+		else
+			log->Base = log->Position;
+	}
+
+	pthread_mutex_unlock(&log->Lock);
+
+	return result;
+}
+
+// Returns the name of the log file of a file, or NULL if there is no memory for it. The caller frees it.
+static char* GetLogFileName(const char* filename)
+{
+	char* logFileName = (char*)malloc(strlen(filename) + sizeof(".wal"));
+	if (logFileName != NULL)
+		sprintf(logFileName, "%s.wal", filename);
+
+	return logFileName;
+}
+
+// Applies the committed records of a log to it's file, in case the last run crashed before the file was checkpointed.
+// The records set bytes to the values they had after the change, so applying them again is harmless. Returns 0 on
+// success and -1 on failure.
+static int RedoLog(int descriptor, int blockSize, const char* logFileName)
+{
+	// Without a log there is nothing to redo.
+	int logDescriptor = open(logFileName, O_RDONLY);
+	if (logDescriptor < 0)
+		return 0;
+
+	struct stat logStatus;
+	if (fstat(logDescriptor, &logStatus) < 0)
+	{
+		close(logDescriptor);
+		return -1;
+	}
+
+	size_t logSize = (size_t)logStatus.st_size;
+	uint8_t* contents = (uint8_t*)malloc(logSize + blockSize);
+	if (contents == NULL)
+	{
+		close(logDescriptor);
+		return -1;
+	}
+
+	ssize_t readByteCount = pread(logDescriptor, contents, logSize, 0);
+	close(logDescriptor);
+
+	if (readByteCount != (ssize_t)logSize)
+	{
+		free(contents);
+		return -1;
+	}
+
+	// Find the end of the last commit. The log ends at the first record that is torn or invalid.
+	size_t position = 0;
+	size_t commitEnd = 0;
+	while (position + sizeof(BF_LogRecord) <= logSize)
+	{
+		BF_LogRecord record;
+		memcpy(&record, contents + position, sizeof(BF_LogRecord));
+
+		if (record.Length > logSize - position - sizeof(BF_LogRecord) ||
+			ChecksumLogRecord(&record, contents + position + sizeof(BF_LogRecord)) != record.Checksum)
+			break;
+
+		position += sizeof(BF_LogRecord) + record.Length;
+
+		if (record.Type == BF_LOG_COMMIT)
+			commitEnd = position;
+	}
+
+	// Apply the committed records in order. Allocations write a zeroed block, which the end of the buffer provides.
+	uint8_t* zeroBlock = contents + logSize;
+	memset(zeroBlock, 0, blockSize);
+
+	int result = 0;
+	position = 0;
+	while (position < commitEnd && result == 0)
+	{
+		BF_LogRecord record;
+		memcpy(&record, contents + position, sizeof(BF_LogRecord));
+
+		off_t blockOffset = (off_t)(record.BlockNumber + 1) * blockSize;
+		if (record.Type == BF_LOG_UPDATE)
+		{
+			if (record.Offset + record.Length > (uint32_t)blockSize ||
+				pwrite(descriptor, contents + position + sizeof(BF_LogRecord), record.Length, blockOffset + record.Offset) != (ssize_t)record.Length)
+				result = -1;
+		}
+		else if (record.Type == BF_LOG_ALLOCATE)
+		{
+			if (pwrite(descriptor, zeroBlock, blockSize, blockOffset) != blockSize)
+				result = -1;
+		}
+
+		position += sizeof(BF_LogRecord) + record.Length;
+	}
+
+	free(contents);
+
+	if (result == 0 && commitEnd > 0 && fdatasync(descriptor) < 0)
+		result = -1;
+
+	return result;
+}
+
+// Turns on the write ahead log of a file that is being opened. Takes ownership of the log file name. Returns a BF
+// error code. The file table must be locked.
+static int EnableLog(BF_File* file, char* logFileName)
+{
+	// The frames of logged files keep the contents they had when they were last logged.
+	if (s_ShadowMemory == NULL)
+	{
+		s_ShadowMemory = (uint8_t*)calloc(s_FrameCount, s_FrameSize);
+		if (s_ShadowMemory == NULL)
+		{
+			free(logFileName);
+			return BFE_NOMEM;
+		}
+	}
+
+	if (!s_IsCommitterRunning)
+	{
+		pthread_t committer;
+		if (pthread_create(&committer, NULL, RunCommitter, NULL) != 0)
+		{
+			free(logFileName);
+			return BFE_NOMEM;
+		}
+
+		pthread_detach(committer);
+		s_IsCommitterRunning = 1;
+	}
+
+	int descriptor = open(logFileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (descriptor < 0)
+	{
+		free(logFileName);
+		return BFE_CANNOTCREATEFILE;
+	}
+
+	BF_Log* log = &file->Log;
+	pthread_mutex_lock(&log->Lock);
+
+	log->Descriptor = descriptor;
+	log->FileName = logFileName;
+	log->BufferLength = 0;
+	log->Base = 0;
+	log->Position = 0;
+	log->WrittenPosition = 0;
+	log->CommitPosition = 0;
+	log->CommitSequence = __atomic_load_n(&s_CommitSequence, __ATOMIC_RELAXED);
+	log->DurableSequence = log->CommitSequence;
+	log->HasFailed = 0;
+	log->IsEnabled = 1;
+	__atomic_store_n(&log->DurablePosition, 0, __ATOMIC_RELEASE);
+
+	pthread_mutex_unlock(&log->Lock);
+
+	return BFE_OK;
+}
+
+// Turns off the write ahead log of a file that is being closed. The log file is removed if the file has been
+// checkpointed, otherwise it's kept for redo. The file table must be locked.
+static void DisableLog(BF_File* file, int isCheckpointed)
+{
+	BF_Log* log = &file->Log;
+	pthread_mutex_lock(&log->Lock);
+
+	while (log->IsWriting)
+		pthread_cond_wait(&log->Written, &log->Lock);
+
+	close(log->Descriptor);
+	if (isCheckpointed)
+		unlink(log->FileName);
+
+	free(log->FileName);
+	free(log->Buffer);
+	free(log->SpareBuffer);
+
+	log->FileName = NULL;
+	log->Buffer = NULL;
+	log->BufferCapacity = 0;
+	log->SpareBuffer = NULL;
+	log->SpareBufferCapacity = 0;
+	log->IsEnabled = 0;
+
+	// Wake the threads waiting for commits, which the checkpoint has made durable.
+	pthread_cond_broadcast(&log->Written);
+	pthread_mutex_unlock(&log->Lock);
+}
+
+// Writes the dirty blocks of a file and waits until they, along with every block written before, are on the disk.
+// Returns a BF error code.
+static int FlushFile(BF_File* file, int fileIndex)
+{
+	// Logged files are checkpointed, so that their log can be emptied.
+	if (file->Log.IsEnabled)
+		return CheckpointFile(file, fileIndex);
+
+	// Memory mapped blocks are never dirty in the buffer pool, their changes are in the page cache.
+	if (file->Backend == BF_BACKEND_MMAP)
+		return (file->MappedSize > 0 && msync(file->Mapping, file->MappedSize, MS_SYNC) < 0) ? BFE_INCOMPLETEWRITE : BFE_OK;
+
+	// The caller has finished changing the file, so it's pinned blocks are written too.
+	if (FlushFrames(fileIndex, 1) < 0 || fdatasync(file->Descriptor) < 0)
+		return BFE_INCOMPLETEWRITE;
+
+	return BFE_OK;
+}
+
+// The background flusher of write back mode. Writes the dirty frames every flush interval, or earlier when many frames
+// are dirty.
+static void* RunFlusher(void* argument)
+{
+	(void)argument;
+
+	pthread_mutex_lock(&s_FlusherLock);
+
+	while (1)
+	{
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += s_FlushInterval / 1000;
+		deadline.tv_nsec += (long)(s_FlushInterval % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+
+		pthread_cond_timedwait(&s_FlusherWake, &s_FlusherLock, &deadline);
+		pthread_mutex_unlock(&s_FlusherLock);
+
+		FlushFrames(BF_INVALID_INDEX, 0);
+
+		pthread_mutex_lock(&s_FlusherLock);
+	}
+
+	return NULL;
+}
+
+// Finishes an asynchronous read that read byteCount bytes, or failed if it's negative. The blocks that were read stop
+// loading and the rest are dropped from the buffer pool.
+static void CompleteRead(BF_ReadRequest* request, ssize_t byteCount)
+{
+	BF_File* file = &s_Files[request->File];
+
+	for (int index = 0; index < request->BlockCount; index++)
+	{
+		int isRead = byteCount >= (ssize_t)(index + 1) * file->BlockSize;
+		if (isRead && file->Log.IsEnabled)
+			memcpy(GetShadow(request->Frames[index]), request->Vectors[index].iov_base, file->BlockSize);
+
+		BF_Shard* shard = GetFrameShard(request->Frames[index]);
+		pthread_mutex_lock(&shard->Lock);
+
+		s_Frames[request->Frames[index]].IsLoading = 0;
+		shard->PrefetchingCount--;
+		if (!isRead)
+			EvictFrame(request->Frames[index]);
+
+		pthread_cond_broadcast(&shard->Loaded);
+		pthread_mutex_unlock(&shard->Lock);
+	}
+
+	pthread_mutex_lock(&s_PrefetchLock);
+	request->Next = s_FreeReadRequest;
+	s_FreeReadRequest = (int)(request - s_ReadRequests);
+	pthread_mutex_unlock(&s_PrefetchLock);
+}
+
+// A thread of the pool that performs the asynchronous reads when io_uring is not available.
+static void* RunPrefetchThread(void* argument)
+{
+	(void)argument;
+
+	pthread_mutex_lock(&s_PrefetchLock);
+
+	while (1)
+	{
+		while (s_FirstQueuedRead == BF_INVALID_INDEX)
+			pthread_cond_wait(&s_PrefetchWake, &s_PrefetchLock);
+
+		BF_ReadRequest* request = &s_ReadRequests[s_FirstQueuedRead];
+		s_FirstQueuedRead = request->Next;
+		if (s_FirstQueuedRead == BF_INVALID_INDEX)
+			s_LastQueuedRead = BF_INVALID_INDEX;
+
+		pthread_mutex_unlock(&s_PrefetchLock);
+
+		BF_File* file = &s_Files[request->File];
+		CompleteRead(request, preadv(file->Descriptor, request->Vectors, request->BlockCount, BlockOffset(file, request->BlockNumber)));
+
+		pthread_mutex_lock(&s_PrefetchLock);
+	}
+
+	return NULL;
+}
+
+#if BF_HAS_IO_URING
+// Reaps the completions of the io_uring instance as they arrive.
+static void* RunCompletionThread(void* argument)
+{
+	(void)argument;
+
+	while (1)
+	{
+		if (syscall(__NR_io_uring_enter, s_IoRing.Descriptor, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0)
+			continue;
+
+		// Synchronize with the threads that submitted the reads, which fill the requests in while holding s_PrefetchLock.
+		pthread_mutex_lock(&s_PrefetchLock);
+		pthread_mutex_unlock(&s_PrefetchLock);
+
+		unsigned head = *s_IoRing.CompletionHead;
+		while (head != __atomic_load_n(s_IoRing.CompletionTail, __ATOMIC_ACQUIRE))
+		{
+			struct io_uring_cqe* completion = &s_IoRing.CompletionEntries[head & s_IoRing.CompletionMask];
+			BF_ReadRequest* request = &s_ReadRequests[completion->user_data];
+			ssize_t byteCount = completion->res;
+
+			__atomic_store_n(s_IoRing.CompletionHead, ++head, __ATOMIC_RELEASE);
+			CompleteRead(request, byteCount);
+		}
+	}
+
+	return NULL;
+}
+
+// Creates the io_uring instance and maps it's queues. Returns 0 on success and -1 if io_uring is not available.
+static int SetupIoRing()
+{
+	struct io_uring_params parameters = { 0 };
+	int descriptor = (int)syscall(__NR_io_uring_setup, BF_PREFETCH_QUEUE_SIZE, &parameters);
+	if (descriptor < 0)
+		return -1;
+
+	size_t submissionSize = parameters.sq_off.array + parameters.sq_entries * sizeof(unsigned);
+	size_t completionSize = parameters.cq_off.cqes + parameters.cq_entries * sizeof(struct io_uring_cqe);
+	size_t entriesSize = parameters.sq_entries * sizeof(struct io_uring_sqe);
+
+	uint8_t* submissionQueue = (uint8_t*)mmap(NULL, submissionSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, descriptor, IORING_OFF_SQ_RING);
+	uint8_t* completionQueue = (uint8_t*)mmap(NULL, completionSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, descriptor, IORING_OFF_CQ_RING);
+	void* entries = mmap(NULL, entriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, descriptor, IORING_OFF_SQES);
+	if (submissionQueue == MAP_FAILED || completionQueue == MAP_FAILED || entries == MAP_FAILED)
+	{
+		if (submissionQueue != MAP_FAILED)
+			munmap(submissionQueue, submissionSize);
+		if (completionQueue != MAP_FAILED)
+			munmap(completionQueue, completionSize);
+		if (entries != MAP_FAILED)
+			munmap(entries, entriesSize);
+
+		close(descriptor);
+		return -1;
+	}
+
+	s_IoRing.Descriptor = descriptor;
+	s_IoRing.SubmissionTail = (unsigned*)(submissionQueue + parameters.sq_off.tail);
+	s_IoRing.SubmissionMask = *(unsigned*)(submissionQueue + parameters.sq_off.ring_mask);
+	s_IoRing.SubmissionArray = (unsigned*)(submissionQueue + parameters.sq_off.array);
+	s_IoRing.SubmissionEntries = (struct io_uring_sqe*)entries;
+	s_IoRing.CompletionHead = (unsigned*)(completionQueue + parameters.cq_off.head);
+	s_IoRing.CompletionTail = (unsigned*)(completionQueue + parameters.cq_off.tail);
+	s_IoRing.CompletionMask = *(unsigned*)(completionQueue + parameters.cq_off.ring_mask);
+	s_IoRing.CompletionEntries = (struct io_uring_cqe*)(completionQueue + parameters.cq_off.cqes);
+
+	return 0;
+}
+#endif
+
+// Starts the engine of the asynchronous reads, io_uring if the kernel supports it or the thread pool otherwise. Returns
+// a BF error code. s_PrefetchLock must be locked.
+static int StartPrefetchEngine()
+{
+	if (s_PrefetchEngine != BF_PREFETCH_ENGINE_NONE)
+		return BFE_OK;
+
+	for (int index = 0; index < BF_PREFETCH_QUEUE_SIZE; index++)
+		s_ReadRequests[index].Next = index + 1 < BF_PREFETCH_QUEUE_SIZE ? index + 1 : BF_INVALID_INDEX;
+
+	s_FreeReadRequest = 0;
+
+#if BF_HAS_IO_URING
+	pthread_t completionThread;
+	if (SetupIoRing() == 0)
+	{
+		if (pthread_create(&completionThread, NULL, RunCompletionThread, NULL) != 0)
+			return BFE_NOMEM;
+
+		pthread_detach(completionThread);
+		s_PrefetchEngine = BF_PREFETCH_ENGINE_IO_URING;
+
+		return BFE_OK;
+	}
+#endif
+
+	for (int index = 0; index < BF_PREFETCH_THREAD_COUNT; index++)
+	{
+		pthread_t prefetchThread;
+		if (pthread_create(&prefetchThread, NULL, RunPrefetchThread, NULL) != 0)
+			return index > 0 ? BFE_OK : BFE_NOMEM;
+
+		pthread_detach(prefetchThread);
+		s_PrefetchEngine = BF_PREFETCH_ENGINE_THREADS;
+	}
+
+	return BFE_OK;
+}
+
+// Hands a read request over to the engine. s_PrefetchLock must be locked. Returns 0 on success and -1 on failure.
+static int SubmitRead(BF_ReadRequest* request)
+{
+	int requestIndex = (int)(request - s_ReadRequests);
+	request->Next = BF_INVALID_INDEX;
+
+#if BF_HAS_IO_URING
+	if (s_PrefetchEngine == BF_PREFETCH_ENGINE_IO_URING)
+	{
+		// At most BF_PREFETCH_QUEUE_SIZE reads are in flight, so there is always a free submission entry.
+		BF_File* file = &s_Files[request->File];
+		unsigned tail = *s_IoRing.SubmissionTail;
+		unsigned entryIndex = tail & s_IoRing.SubmissionMask;
+
+		struct io_uring_sqe* entry = &s_IoRing.SubmissionEntries[entryIndex];
+		memset(entry, 0, sizeof(*entry));
+		entry->opcode = IORING_OP_READV;
+		entry->fd = file->Descriptor;
+		entry->addr = (uint64_t)(uintptr_t)request->Vectors;
+		entry->len = request->BlockCount;
+		entry->off = BlockOffset(file, request->BlockNumber);
+		entry->user_data = requestIndex;
+
+		s_IoRing.SubmissionArray[entryIndex] = entryIndex;
+		__atomic_store_n(s_IoRing.SubmissionTail, tail + 1, __ATOMIC_RELEASE);
+
+		if (syscall(__NR_io_uring_enter, s_IoRing.Descriptor, 1, 0, 0, NULL, 0) != 1)
+		{
+			__atomic_store_n(s_IoRing.SubmissionTail, tail, __ATOMIC_RELEASE);
+			return -1;
+		}
+
+		return 0;
+	}
+#endif
+
+	if (s_LastQueuedRead == BF_INVALID_INDEX)
+		s_FirstQueuedRead = requestIndex;
+	else
+		s_ReadRequests[s_LastQueuedRead].Next = requestIndex;
+
+	s_LastQueuedRead = requestIndex;
+	pthread_cond_signal(&s_PrefetchWake);
+
+	return 0;
+}
+
+// Starts asynchronous reads of up to blockCount consecutive blocks of a file, starting from blockNumber. Blocks that are
+// in the buffer pool are skipped. Returns 0 if the reads were started and -1 if the engine is busy, in which case the
+// remaining blocks are not read.
+static int PrefetchRange(BF_File* file, int fileIndex, int blockNumber, int blockCount)
+{
+	// Memory mapped files only ask the kernel to read the pages ahead.
+	if (file->Backend == BF_BACKEND_MMAP)
+	{
+		size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+		size_t start = ((size_t)BlockOffset(file, blockNumber) / pageSize) * pageSize;
+		size_t end = (size_t)BlockOffset(file, blockNumber + blockCount);
+
+		madvise(file->Mapping + start, end - start, MADV_WILLNEED);
+		return 0;
+	}
+
+	int endBlockNumber = blockNumber + blockCount;
+	while (blockNumber < endBlockNumber)
+	{
+		pthread_mutex_lock(&s_PrefetchLock);
+
+		int requestIndex = StartPrefetchEngine() == BFE_OK ? s_FreeReadRequest : BF_INVALID_INDEX;
+		if (requestIndex == BF_INVALID_INDEX)
+		{
+			pthread_mutex_unlock(&s_PrefetchLock);
+			return -1;
+		}
+
+		s_FreeReadRequest = s_ReadRequests[requestIndex].Next;
+		pthread_mutex_unlock(&s_PrefetchLock);
+
+		BF_ReadRequest* request = &s_ReadRequests[requestIndex];
+		request->File = fileIndex;
+		request->BlockCount = 0;
+
+		// Assign frames to the consecutive blocks that are not in the buffer pool. A block that is, or one that finds no
+		// free frame, ends the run.
+		while (blockNumber < endBlockNumber && request->BlockCount < BF_PREFETCH_RUN_SIZE)
+		{
+			BF_Shard* shard = GetShard(fileIndex, blockNumber);
+			pthread_mutex_lock(&shard->Lock);
+
+			int frameIndex = BF_INVALID_INDEX;
+			if (shard->PrefetchingCount < shard->FrameCount / 4 && FindFrame(shard, fileIndex, blockNumber) == BF_INVALID_INDEX)
+				frameIndex = AcquireFrame(shard, fileIndex, blockNumber);
+
+			if (frameIndex != BF_INVALID_INDEX)
+			{
+				BF_Frame* frame = &s_Frames[frameIndex];
+				frame->Data = frame->Memory;
+				frame->IsLoading = 1;
+				shard->PrefetchingCount++;
+				shard->PrefetchCount++;
+			}
+
+			pthread_mutex_unlock(&shard->Lock);
+
+			if (frameIndex == BF_INVALID_INDEX)
+			{
+				if (request->BlockCount > 0)
+					break;
+
+				blockNumber++;
+				continue;
+			}
+
+			if (request->BlockCount == 0)
+				request->BlockNumber = blockNumber;
+
+			request->Frames[request->BlockCount] = frameIndex;
+			request->Vectors[request->BlockCount].iov_base = s_Frames[frameIndex].Data;
+			request->Vectors[request->BlockCount].iov_len = file->BlockSize;
+			request->BlockCount++;
+			blockNumber++;
+		}
+
+		pthread_mutex_lock(&s_PrefetchLock);
+
+		if (request->BlockCount == 0)
+		{
+			request->Next = s_FreeReadRequest;
+			s_FreeReadRequest = requestIndex;
+			pthread_mutex_unlock(&s_PrefetchLock);
+
+			continue;
+		}
+
+		int result = SubmitRead(request);
+		pthread_mutex_unlock(&s_PrefetchLock);
+
+		// A read that could not be submitted releases it's frames.
+		if (result < 0)
+		{
+			CompleteRead(request, -1);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void BF_SetBackend(const BF_Backend backend)
+{
+	s_Backend = backend;
+}
+
+// Orders frames, given by their index, by their last use.
+static int CompareFrameUse(const void* first, const void* second)
+{
+	const BF_Frame* firstFrame = &s_Frames[*(const int*)first];
+	const BF_Frame* secondFrame = &s_Frames[*(const int*)second];
+
+	return (firstFrame->LastUsed > secondFrame->LastUsed) - (firstFrame->LastUsed < secondFrame->LastUsed);
+}
+
+void BF_SetReplacementPolicy(const BF_ReplacementPolicy policy)
+{
+	if (policy < BF_POLICY_LRU || policy > BF_POLICY_LRU_K)
+		return;
+
+	// Before BF_Init there is no state to reset.
+	pthread_mutex_lock(&s_FileTableLock);
+	if (!s_Initialized)
+	{
+		s_Policy = policy;
+		pthread_mutex_unlock(&s_FileTableLock);
+		return;
+	}
+
+	// Otherwise lock every shard, so that no frame is selected while the policy changes.
+	for (int shardIndex = 0; shardIndex < s_ShardCount; shardIndex++)
+		pthread_mutex_lock(&s_Shards[shardIndex].Lock);
+
+	s_Policy = policy;
+
+	// The blocks in the buffer pool stay there, but the new policy starts with no history. They are loaded in it again in
+	// the order they were last used.
+	for (int shardIndex = s_ShardCount - 1; shardIndex >= 0; shardIndex--)
+	{
+		BF_Shard* shard = &s_Shards[shardIndex];
+		shard->ClockHand = 0;
+		shard->RecentTarget = 0;
+		shard->HeapCount = 0;
+		ResetGhosts(&shard->RecentGhosts, shard->FrameCount);
+		ResetGhosts(&shard->FrequentGhosts, shard->FrameCount);
+
+		for (int queue = 0; queue < BF_QUEUE_COUNT; queue++)
+			ResetFrameList(&shard->Queues[queue]);
+
+		int loadedCount = 0;
+		for (int frameIndex = shard->FirstFrame; frameIndex < shard->FirstFrame + shard->FrameCount; frameIndex++)
+		{
+			if (s_Frames[frameIndex].File != BF_INVALID_INDEX)
+				shard->SkippedFrames[loadedCount++] = frameIndex;
+		}
+
+		qsort(shard->SkippedFrames, loadedCount, sizeof(int), CompareFrameUse);
+
+		for (int index = 0; index < loadedCount; index++)
+		{
+			BF_Frame* frame = &s_Frames[shard->SkippedFrames[index]];
+			frame->PreviousUsed = 0;
+			frame->Queue = BF_QUEUE_NONE;
+			frame->HeapPosition = BF_INVALID_INDEX;
+
+			s_PolicyOps[s_Policy].OnLoad(shard, frame, BF_QUEUE_NONE);
+			frame->ReferenceBit = 0;
+			LinkFrame(&shard->Queues[frame->Queue], shard->SkippedFrames[index]);
+		}
+
+		pthread_mutex_unlock(&shard->Lock);
+	}
+
+	pthread_mutex_unlock(&s_FileTableLock);
+}
+
+void BF_GetStatistics(BF_Statistics* statistics)
+{
+	statistics->HitCount = 0;
+	statistics->MissCount = 0;
+	statistics->EvictionCount = 0;
+	statistics->PrefetchCount = 0;
+
+	if (!s_Initialized)
+		return;
+
+	for (int shardIndex = 0; shardIndex < s_ShardCount; shardIndex++)
+	{
+		BF_Shard* shard = &s_Shards[shardIndex];
+		pthread_mutex_lock(&shard->Lock);
+
+		statistics->HitCount += shard->HitCount;
+		statistics->MissCount += shard->MissCount;
+		statistics->EvictionCount += shard->EvictionCount;
+		statistics->PrefetchCount += shard->PrefetchCount;
+
+		pthread_mutex_unlock(&shard->Lock);
+	}
+}
+
+void BF_ResetStatistics()
+{
+	if (!s_Initialized)
+		return;
+
+	for (int shardIndex = 0; shardIndex < s_ShardCount; shardIndex++)
+	{
+		BF_Shard* shard = &s_Shards[shardIndex];
+		pthread_mutex_lock(&shard->Lock);
+
+		shard->HitCount = 0;
+		shard->MissCount = 0;
+		shard->EvictionCount = 0;
+		shard->PrefetchCount = 0;
+
+		pthread_mutex_unlock(&shard->Lock);
+	}
+}
+
+// Allocates the memory of the frames, backed by huge pages if asked to. Falls back to regular pages, with a transparent
+// huge page hint, if no huge pages are reserved. Returns NULL on failure.
+static uint8_t* AllocateFrameMemory(size_t byteCount, int useHugePages)
+{
+	if (useHugePages)
+	{
+		size_t hugeByteCount = ((byteCount + BF_HUGE_PAGE_SIZE - 1) / BF_HUGE_PAGE_SIZE) * BF_HUGE_PAGE_SIZE;
+		void* memory = mmap(NULL, hugeByteCount, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (memory != MAP_FAILED)
+			return (uint8_t*)memory;
+	}
+
+	void* memory = mmap(NULL, byteCount, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+		return NULL;
+
+	if (useHugePages)
+		madvise(memory, byteCount, MADV_HUGEPAGE);
+
+	return (uint8_t*)memory;
+}
+
+// Switches a descriptor to direct I/O, if the file system supports it for blocks of the given size. The frames are page
+// aligned and every block starts at a multiple of the block size, so it's enough that the alignments of the device
+// divide the page size and the block size. Returns 0 on success and -1 if the descriptor keeps using the page cache.
+static int EnableDirectIO(int descriptor, int blockSize)
+{
+	unsigned int memoryAlignment = 0;
+	unsigned int offsetAlignment = 0;
+
+#ifdef STATX_DIOALIGN
+	struct statx status;
+	if (statx(descriptor, "", AT_EMPTY_PATH, STATX_DIOALIGN, &status) == 0 && (status.stx_mask & STATX_DIOALIGN) != 0)
+	{
+		// A zero alignment means that the file system doesn't support direct I/O.
+		if (status.stx_dio_offset_align == 0 || status.stx_dio_mem_align == 0)
+			return -1;
+
+		memoryAlignment = status.stx_dio_mem_align;
+		offsetAlignment = status.stx_dio_offset_align;
+	}
+#endif
+
+	// Without the alignments of the device, assume the preferred I/O size of the file, which is at least as strict.
+	if (offsetAlignment == 0)
+	{
+		struct stat fileStatus;
+		if (fstat(descriptor, &fileStatus) < 0 || fileStatus.st_blksize <= 0)
+			return -1;
+
+		memoryAlignment = (unsigned int)fileStatus.st_blksize;
+		offsetAlignment = (unsigned int)fileStatus.st_blksize;
+	}
+
+	long pageSize = sysconf(_SC_PAGESIZE);
+	if (pageSize <= 0 || pageSize % memoryAlignment != 0 || blockSize % offsetAlignment != 0)
+		return -1;
+
+	int flags = fcntl(descriptor, F_GETFL);
+	if (flags < 0 || fcntl(descriptor, F_SETFL, flags | O_DIRECT) < 0)
+		return -1;
+
+	return 0;
+}
+
+// Frees the tables allocated by BF_InitWithConfig. The frame memory is freed by the caller, since it's size depends on
+// the pages that back it.
+static void FreeTables()
+{
+	for (int shardIndex = 0; s_Shards != NULL && shardIndex < s_ShardCount; shardIndex++)
+	{
+		free(s_Shards[shardIndex].PageTable);
+		free(s_Shards[shardIndex].RecentGhosts.Ghosts);
+		free(s_Shards[shardIndex].RecentGhosts.Slots);
+		free(s_Shards[shardIndex].FrequentGhosts.Ghosts);
+		free(s_Shards[shardIndex].FrequentGhosts.Slots);
+		free(s_Shards[shardIndex].Heap);
+		free(s_Shards[shardIndex].SkippedFrames);
+	}
+
+	free(s_DirtyBlocks);
+	free(s_Shards);
+	free(s_Frames);
+	free(s_Descriptors);
+	free(s_Files);
+
+	s_DirtyBlocks = NULL;
+	s_Shards = NULL;
+	s_Frames = NULL;
+	s_Descriptors = NULL;
+	s_Files = NULL;
+}
+
+void BF_GetDefaultConfig(BF_Config* config)
+{
+	config->FrameCount = BF_DEFAULT_FRAME_COUNT;
+	config->MemoryBudget = 0;
+	config->MaxBlockSize = BF_MAX_BLOCK_SIZE;
+	config->MaxOpenFiles = BF_DEFAULT_MAX_OPEN_FILES;
+	config->UseHugePages = 0;
+	config->ReplacementPolicy = BF_POLICY_LRU;
+	config->WriteMode = BF_WRITE_THROUGH;
+	config->FlushInterval = BF_DEFAULT_FLUSH_INTERVAL;
+	config->UseDirectIO = 0;
+	config->ExtentBlockCount = BF_DEFAULT_EXTENT_BLOCK_COUNT;
+}
+
+int BF_GetMaxOpenFiles()
+{
+	return s_MaxOpenFiles;
+}
+
+int BF_GetFrameCount()
+{
+	return s_FrameCount;
+}
+
+void BF_Init()
+{
+	// Keep the replacement policy if it was set before the initialization.
+	BF_Config config = { };
+	BF_GetDefaultConfig(&config);
+	config.ReplacementPolicy = s_Policy;
+
+	BF_InitWithConfig(&config);
+}
+
+int BF_InitWithConfig(const BF_Config* config)
+{
+	pthread_mutex_lock(&s_FileTableLock);
+
+	// Files may already be open if the application initializes the block level more than once.
+	if (s_Initialized)
+	{
+		pthread_mutex_unlock(&s_FileTableLock);
+
+		BF_Errno = BFE_OK;
+		return BFE_OK;
+	}
+
+	// Every frame holds a block of the largest size the application opens, so the memory budget is split in such blocks. The
+	// budget covers the copies of the frames that logged files keep too, so every frame takes up two blocks of it.
+	int maxBlockSize = config->MaxBlockSize;
+	int frameCount = config->FrameCount;
+	if (frameCount <= 0 && config->MemoryBudget > 0 && maxBlockSize > 0)
+		frameCount = (int)(config->MemoryBudget / (2 * (unsigned long long)maxBlockSize));
+
+	if (frameCount <= 0 || maxBlockSize < BF_MIN_BLOCK_SIZE || maxBlockSize > BF_MAX_BLOCK_SIZE || (maxBlockSize & (maxBlockSize - 1)) != 0 ||
+		config->MaxOpenFiles <= 0 || config->ExtentBlockCount < 0 || config->ReplacementPolicy < BF_POLICY_LRU || config->ReplacementPolicy > BF_POLICY_LRU_K ||
+		(config->WriteMode != BF_WRITE_THROUGH && config->WriteMode != BF_WRITE_BACK) ||
+		(config->WriteMode == BF_WRITE_BACK && config->FlushInterval <= 0))
+	{
+		pthread_mutex_unlock(&s_FileTableLock);
+
+		BF_Errno = BFE_INVALIDCONFIG;
+		return BF_Errno;
+	}
+
+	int shardCount = 1;
+	while (shardCount * 2 <= BF_MAX_SHARD_COUNT && frameCount / (shardCount * 2) >= BF_MIN_FRAMES_PER_SHARD)
+		shardCount *= 2;
+
+	s_MaxOpenFiles = config->MaxOpenFiles;
+	s_FrameCount = frameCount;
+	s_FrameSize = maxBlockSize;
+	s_ShardCount = shardCount;
+	s_Policy = config->ReplacementPolicy;
+	s_WriteMode = config->WriteMode;
+	s_FlushInterval = config->FlushInterval;
+	s_UseDirectIO = config->UseDirectIO;
+	s_ExtentBlockCount = config->ExtentBlockCount;
+
+	// The frame memory is mapped, so it's page aligned, as direct I/O needs.
+	size_t frameMemorySize = (size_t)frameCount * s_FrameSize;
+	s_FrameMemory = AllocateFrameMemory(frameMemorySize, config->UseHugePages);
+	s_Files = (BF_File*)calloc(s_MaxOpenFiles, sizeof(BF_File));
+	s_Descriptors = (int*)calloc(s_MaxOpenFiles, sizeof(int));
+	s_Frames = (BF_Frame*)calloc(s_FrameCount, sizeof(BF_Frame));
+	s_Shards = (BF_Shard*)calloc(s_ShardCount, sizeof(BF_Shard));
+	s_DirtyBlocks = (BF_DirtyBlock*)malloc(s_FrameCount * sizeof(BF_DirtyBlock));
+
+	int isAllocated = (s_FrameMemory != NULL && s_Files != NULL && s_Descriptors != NULL && s_Frames != NULL && s_Shards != NULL &&
+		s_DirtyBlocks != NULL);
+
+	for (int shardIndex = 0; isAllocated && shardIndex < s_ShardCount; shardIndex++)
+	{
+		BF_Shard* shard = &s_Shards[shardIndex];
+
+		// The frames are split as evenly as possible between the shards.
+		shard->FirstFrame = (int)((int64_t)s_FrameCount * shardIndex / s_ShardCount);
+		shard->FrameCount = (int)((int64_t)s_FrameCount * (shardIndex + 1) / s_ShardCount) - shard->FirstFrame;
+
+		shard->PageTableSize = 1;
+		while (shard->PageTableSize < shard->FrameCount * 2)
+			shard->PageTableSize *= 2;
+
+		shard->PageTable = (int*)malloc(shard->PageTableSize * sizeof(int));
+		shard->RecentGhosts.Ghosts = (BF_Ghost*)malloc(shard->FrameCount * sizeof(BF_Ghost));
+		shard->RecentGhosts.Slots = (int*)malloc(shard->PageTableSize * sizeof(int));
+		shard->RecentGhosts.SlotCount = shard->PageTableSize;
+		shard->FrequentGhosts.Ghosts = (BF_Ghost*)malloc(shard->FrameCount * sizeof(BF_Ghost));
+		shard->FrequentGhosts.Slots = (int*)malloc(shard->PageTableSize * sizeof(int));
+		shard->FrequentGhosts.SlotCount = shard->PageTableSize;
+		shard->Heap = (int*)malloc(shard->FrameCount * sizeof(int));
+		shard->SkippedFrames = (int*)malloc(shard->FrameCount * sizeof(int));
+
+		isAllocated = (shard->PageTable != NULL && shard->RecentGhosts.Ghosts != NULL && shard->RecentGhosts.Slots != NULL &&
+			shard->FrequentGhosts.Ghosts != NULL && shard->FrequentGhosts.Slots != NULL && shard->Heap != NULL && shard->SkippedFrames != NULL);
+	}
+
+	if (!isAllocated)
+	{
+		if (s_FrameMemory != NULL)
+			munmap(s_FrameMemory, config->UseHugePages ? ((frameMemorySize + BF_HUGE_PAGE_SIZE - 1) / BF_HUGE_PAGE_SIZE) * BF_HUGE_PAGE_SIZE : frameMemorySize);
+
+		s_FrameMemory = NULL;
+		FreeTables();
+
+		pthread_mutex_unlock(&s_FileTableLock);
+
+		BF_Errno = BFE_NOMEM;
+		return BF_Errno;
+	}
+
+	for (int index = 0; index < s_MaxOpenFiles; index++)
+	{
+		s_Files[index].OpenCount = 0;
+		pthread_mutex_init(&s_Files[index].Lock, NULL);
+		pthread_mutex_init(&s_Files[index].Log.Lock, NULL);
+		pthread_cond_init(&s_Files[index].Log.Written, NULL);
+		s_Descriptors[index] = BF_INVALID_INDEX;
+	}
+
+	for (int shardIndex = 0; shardIndex < s_ShardCount; shardIndex++)
+	{
+		BF_Shard* shard = &s_Shards[shardIndex];
+		pthread_mutex_init(&shard->Lock, NULL);
+		pthread_cond_init(&shard->Loaded, NULL);
+
+		for (int index = 0; index < shard->PageTableSize; index++)
+			shard->PageTable[index] = BF_INVALID_INDEX;
+
+		ResetGhosts(&shard->RecentGhosts, shard->FrameCount);
+		ResetGhosts(&shard->FrequentGhosts, shard->FrameCount);
+		ResetFrameList(&shard->FreeFrames);
+
+		for (int queue = 0; queue < BF_QUEUE_COUNT; queue++)
+			ResetFrameList(&shard->Queues[queue]);
+
+		for (int frameIndex = shard->FirstFrame; frameIndex < shard->FirstFrame + shard->FrameCount; frameIndex++)
+		{
+			BF_Frame* frame = &s_Frames[frameIndex];
+			frame->File = BF_INVALID_INDEX;
+			frame->BlockNumber = BF_INVALID_INDEX;
+			frame->Queue = BF_QUEUE_NONE;
+			frame->HeapPosition = BF_INVALID_INDEX;
+			frame->Next = BF_INVALID_INDEX;
+			LinkFrame(&shard->FreeFrames, frameIndex);
+			pthread_rwlock_init(&frame->Latch, NULL);
+			frame->Shard = shardIndex;
+			frame->Memory = s_FrameMemory + (size_t)frameIndex * s_FrameSize;
+			frame->Data = frame->Memory;
+		}
+	}
+
+	pthread_key_create(&s_ThreadPinsKey, ReleaseThreadPins);
+
+	// Start the flusher. Without it the blocks are written through.
+	if (s_WriteMode == BF_WRITE_BACK)
+	{
+		pthread_t flusher;
+		if (pthread_create(&flusher, NULL, RunFlusher, NULL) == 0)
+			pthread_detach(flusher);
+		else
+			s_WriteMode = BF_WRITE_THROUGH;
+	}
+
+	s_Initialized = 1;
+
+	pthread_mutex_unlock(&s_FileTableLock);
+
+	BF_Errno = BFE_OK;
+	return BFE_OK;
+}
+
+int BF_CreateFile(const char* filename)
+{
+	return BF_CreateFileWithBlockSize(filename, BF_DEFAULT_BLOCK_SIZE);
+}
+
+int BF_CreateFileWithBlockSize(const char* filename, const int blockSize)
+{
+	// The block size must be a power of two inside the supported range, and fit in the frames so that the file can be opened.
+	if (blockSize < BF_MIN_BLOCK_SIZE || blockSize > s_FrameSize || (blockSize & (blockSize - 1)) != 0)
+	{
+		BF_Errno = BFE_INVALIDBLOCKSIZE;
+		return BF_Errno;
+	}
+
+	int descriptor = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (descriptor < 0)
+	{
+		BF_Errno = BFE_CANNOTCREATEFILE;
+		return BF_Errno;
+	}
+
+	// The header occupies a whole block.
+	uint8_t* headerBlock = (uint8_t*)calloc(1, blockSize);
+	if (headerBlock == NULL)
+	{
+		close(descriptor);
+
+		BF_Errno = BFE_NOMEM;
+		return BF_Errno;
+	}
+
+	BF_FileHeader header = { };
+	header.Magic = BF_MAGIC;
+	header.BlockSize = blockSize;
+	memcpy(headerBlock, &header, sizeof(BF_FileHeader));
+
+	ssize_t written = pwrite(descriptor, headerBlock, blockSize, 0);
+	free(headerBlock);
+
+	if (close(descriptor) < 0)
+	{
+		BF_Errno = BFE_CANNOTCLOSEFILE;
+		return BF_Errno;
+	}
+
+	if (written != blockSize)
+	{
+		BF_Errno = BFE_INCOMPLETEWRITE;
+		return BF_Errno;
+	}
+
+	// Remove the log left by an earlier file with the same name, so that it's never applied to the new one.
+	char* logFileName = GetLogFileName(filename);
+	if (logFileName != NULL)
+		unlink(logFileName);
+
+	free(logFileName);
+
+	BF_Errno = BFE_OK;
+	return BFE_OK;
+}
+
+// Opens a block level file, with a write ahead log if isLogged is set. The file table must be locked.
+static int OpenFile(const char* filename, int isLogged)
+{
+	// The kernel writes the pages of a memory mapped file back whenever it likes, so the changes can't be logged before
+	// they reach the file.
+	if (isLogged && s_Backend == BF_BACKEND_MMAP)
+	{
+		BF_Errno = BFE_LOGUNSUPPORTED;
+		return BF_Errno;
+	}
+
+	// Find a free block level descriptor.
+	int fileDesc = BF_INVALID_INDEX;
+	for (int index = 0; index < s_MaxOpenFiles; index++)
+	{
+		if (s_Descriptors[index] == BF_INVALID_INDEX)
+		{
+			fileDesc = index;
+			break;
+		}
+	}
+
+	if (fileDesc == BF_INVALID_INDEX)
+	{
+		BF_Errno = BFE_FTABFULL;
+		return BF_Errno;
+	}
+
+	struct stat fileStatus;
+	if (stat(filename, &fileStatus) < 0)
+	{
+		BF_Errno = BFE_FILENOTEXISTS;
+		return BF_Errno;
+	}
+
+	// If the file is already open, share the OS level file.
+	for (int index = 0; index < s_MaxOpenFiles; index++)
+	{
+		BF_File* file = &s_Files[index];
+		if (file->OpenCount > 0 && file->Device == fileStatus.st_dev && file->Inode == fileStatus.st_ino)
+		{
+			// The blocks of a file that is open without a log may already be changed without logging.
+			if (isLogged && !file->Log.IsEnabled)
+			{
+				BF_Errno = BFE_FILEOPEN;
+				return BF_Errno;
+			}
+
+			file->OpenCount++;
+			s_Descriptors[fileDesc] = index;
+
+			BF_Errno = BFE_OK;
+			return fileDesc;
+		}
+	}
+
+	// Otherwise find a free OS level file entry.
+	int fileIndex = BF_INVALID_INDEX;
+	for (int index = 0; index < s_MaxOpenFiles; index++)
+	{
+		if (s_Files[index].OpenCount == 0)
+		{
+			fileIndex = index;
+			break;
+		}
+	}
+
+	int descriptor = open(filename, O_RDWR);
+	if (descriptor < 0)
+	{
+		BF_Errno = BFE_CANNOTOPENFILE;
+		return BF_Errno;
+	}
+
+	// Read and validate the block level file header.
+	BF_FileHeader header = { };
+	if (pread(descriptor, &header, sizeof(BF_FileHeader), 0) != sizeof(BF_FileHeader))
+	{
+		close(descriptor);
+
+		BF_Errno = BFE_INCOMPLETEREAD;
+		return BF_Errno;
+	}
+
+	// The blocks must fit in the frames, whose size the configuration sets.
+	if (header.Magic != BF_MAGIC || header.BlockSize < BF_MIN_BLOCK_SIZE || header.BlockSize > (uint32_t)s_FrameSize)
+	{
+		close(descriptor);
+
+		BF_Errno = BFE_INVALIDBLOCKSIZE;
+		return BF_Errno;
+	}
+
+	// Replay the log left by a run that crashed before any of the blocks is read, even if the file is opened without a
+	// log, so that the log is never applied over newer changes. The size of the file may change.
+	char* logFileName = GetLogFileName(filename);
+	if (logFileName == NULL || RedoLog(descriptor, header.BlockSize, logFileName) < 0 || fstat(descriptor, &fileStatus) < 0)
+	{
+		free(logFileName);
+		close(descriptor);
+
+		BF_Errno = BFE_INCOMPLETEWRITE;
+		return BF_Errno;
+	}
+
+	// Logged files keep the log file for the changes to come, the rest don't need it anymore.
+	if (isLogged)
+	{
+		int result = EnableLog(&s_Files[fileIndex], logFileName);
+		if (result != BFE_OK)
+		{
+			close(descriptor);
+
+			BF_Errno = result;
+			return BF_Errno;
+		}
+	}
+	else
+	{
+		unlink(logFileName);
+		free(logFileName);
+	}
+
+	BF_File* file = &s_Files[fileIndex];
+	file->Descriptor = descriptor;
+	file->Device = fileStatus.st_dev;
+	file->Inode = fileStatus.st_ino;
+	file->BlockSize = header.BlockSize;
+	file->BlockCount = (int)(fileStatus.st_size / header.BlockSize) - 1;
+	file->ReservedBlockCount = file->BlockCount;
+	file->Backend = s_Backend;
+	file->Mapping = NULL;
+	file->MappedSize = 0;
+
+	// Bypass the page cache if asked to, so that the blocks are cached only once, in the buffer pool. The header and the
+	// log were read above with buffered I/O, since they are not aligned. Memory mapped files always use the page cache.
+	if (file->Backend == BF_BACKEND_BUFFERED && s_UseDirectIO)
+		EnableDirectIO(descriptor, header.BlockSize);
+
+	if (file->Backend == BF_BACKEND_MMAP)
+	{
+		// Reserve the address space without backing it, then map the current contents of the file into it.
+		void* reservation = mmap(NULL, BF_MMAP_RESERVE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (reservation == MAP_FAILED)
+		{
+			close(descriptor);
+
+			BF_Errno = BFE_NOMEM;
+			return BF_Errno;
+		}
+
+		file->Mapping = (uint8_t*)reservation;
+		if (GrowMapping(file, (size_t)fileStatus.st_size) < 0)
+		{
+			munmap(file->Mapping, BF_MMAP_RESERVE_SIZE);
+			close(descriptor);
+
+			BF_Errno = BFE_NOMEM;
+			return BF_Errno;
+		}
+	}
+
+	file->OpenCount = 1;
+
+	s_Descriptors[fileDesc] = fileIndex;
+
+	BF_Errno = BFE_OK;
+	return fileDesc;
+}
+
+int BF_OpenFile(const char* filename)
+{
+	pthread_mutex_lock(&s_FileTableLock);
+
+	int fileDesc = OpenFile(filename, 0);
+
+	pthread_mutex_unlock(&s_FileTableLock);
+
+	return fileDesc;
+}
+
+int BF_OpenFileWithLog(const char* filename)
+{
+	pthread_mutex_lock(&s_FileTableLock);
+
+	int fileDesc = OpenFile(filename, 1);
+
+	pthread_mutex_unlock(&s_FileTableLock);
+
+	return fileDesc;
+}
+
+int BF_CloseFile(const int fileDesc)
+{
+	pthread_mutex_lock(&s_FileTableLock);
+
+	BF_File* file = GetFile(fileDesc);
+	if (file == NULL)
+	{
+		pthread_mutex_unlock(&s_FileTableLock);
+		return BF_Errno;
+	}
+
+	int fileIndex = s_Descriptors[fileDesc];
+	s_Descriptors[fileDesc] = BF_INVALID_INDEX;
+
+	// Make the changes durable, even if other descriptors keep the file open.
+	int result = FlushFile(file, fileIndex);
+
+	// The OS level file stays open while other descriptors refer to it.
+	if (--file->OpenCount > 0)
+	{
+		pthread_mutex_unlock(&s_FileTableLock);
+
+		BF_Errno = result;
+		return result;
+	}
+
+	// Drop all the blocks of the file from the buffer pool, even the pinned ones. They have been flushed above.
+	for (int frameIndex = 0; frameIndex < s_FrameCount; frameIndex++)
+	{
+		BF_Shard* shard = GetFrameShard(frameIndex);
+		pthread_mutex_lock(&shard->Lock);
+
+		// Wait for the reads that are still loading blocks of the file, such as prefetches.
+		while (s_Frames[frameIndex].File == fileIndex && s_Frames[frameIndex].IsLoading)
+			pthread_cond_wait(&shard->Loaded, &shard->Lock);
+
+		if (s_Frames[frameIndex].File == fileIndex)
+		{
+			EvictFrame(frameIndex);
+			s_Frames[frameIndex].PinCount = 0;
+		}
+
+		pthread_mutex_unlock(&shard->Lock);
+	}
+
+	// The log is removed along with the file, unless it's still needed for redo.
+	if (file->Log.IsEnabled)
+		DisableLog(file, result == BFE_OK);
+
+	// Give back the disk space reserved past the end of the file.
+	ReleaseReservedBlocks(file);
+
+	// Memory mapped files are unmapped.
+	if (file->Backend == BF_BACKEND_MMAP)
+	{
+		munmap(file->Mapping, BF_MMAP_RESERVE_SIZE);
+
+		file->Mapping = NULL;
+		file->MappedSize = 0;
+	}
+
+	if (close(file->Descriptor) < 0 && result == BFE_OK)
+		result = BFE_CANNOTCLOSEFILE;
+
+	pthread_mutex_unlock(&s_FileTableLock);
+
+	BF_Errno = result;
+	return result;
+}
+
+int BF_GetBlockCounter(const int fileDesc)
+{
+	BF_File* file = GetFile(fileDesc);
+	if (file == NULL)
+		return BF_Errno;
+
+	BF_Errno = BFE_OK;
+	return GetBlockCount(file);
+}
+
+int BF_GetBlockSize(const int fileDesc)
+{
+	BF_File* file = GetFile(fileDesc);
+	if (file == NULL)
+		return BF_Errno;
+
+	BF_Errno = BFE_OK;
+	return file->BlockSize;
+}
+
+// Allocates a new zeroed block at the end of a file. The caller holds the file lock. Returns a BF error code.
+static int AllocateBlock(BF_File* file, int fileIndex)
+{
+	int blockNumber = file->BlockCount;
+
+	// Reserve the disk space of the block along with the rest of it's extent.
+	ReserveBlocks(file, blockNumber + 1);
+
+	if (file->Backend == BF_BACKEND_MMAP)
+	{
+		// Extend the file by one zeroed block and make sure the mapping covers it.
+		off_t newFileSize = BlockOffset(file, blockNumber + 1);
+		if (ftruncate(file->Descriptor, newFileSize) < 0 || GrowMapping(file, (size_t)newFileSize) < 0)
+			return BFE_INCOMPLETEWRITE;
+
+		__atomic_store_n(&file->BlockCount, blockNumber + 1, __ATOMIC_RELEASE);
+		return BFE_OK;
+	}
+
+	// The new block goes straight into the buffer pool since the caller is about to read it.
+	uint64_t generation = 0;
+	int frameIndex = PinFrame(file, fileIndex, blockNumber, 1, &generation);
+	if (frameIndex == BF_INVALID_INDEX)
+		return BF_Errno;
+
+	// The new block of a logged file is logged, and it's written to the file like any other change. In write back mode
+	// it's written by the next flush. Otherwise extend the file by one zeroed block.
+	int isAllocated = 1;
+	if (file->Log.IsEnabled || s_WriteMode == BF_WRITE_BACK)
+	{
+		BF_Shard* shard = GetFrameShard(frameIndex);
+		pthread_mutex_lock(&shard->Lock);
+
+		isAllocated = !file->Log.IsEnabled || LogAllocation(file, frameIndex) == 0;
+		if (isAllocated)
+			MarkFrameDirty(&s_Frames[frameIndex]);
+
+		pthread_mutex_unlock(&shard->Lock);
+	}
+	else
+		isAllocated = (pwrite(file->Descriptor, s_Frames[frameIndex].Data, file->BlockSize, BlockOffset(file, blockNumber)) == file->BlockSize);
+
+	if (!isAllocated)
+	{
+		BF_Shard* shard = GetFrameShard(frameIndex);
+		pthread_mutex_lock(&shard->Lock);
+		EvictFrame(frameIndex);
+		s_Frames[frameIndex].PinCount = 0;
+		pthread_mutex_unlock(&shard->Lock);
+
+		return BFE_INCOMPLETEWRITE;
+	}
+
+	__atomic_store_n(&file->BlockCount, blockNumber + 1, __ATOMIC_RELEASE);
+	UnpinFrame(frameIndex, generation);
+
+	return BFE_OK;
+}
+
+int BF_AllocateBlock(const int fileDesc)
+{
+	BF_File* file = GetFile(fileDesc);
+	if (file == NULL)
+		return BF_Errno;
+
+	// Threads that allocate blocks in the same file get consecutive block numbers.
+	pthread_mutex_lock(&file->Lock);
+	int result = AllocateBlock(file, s_Descriptors[fileDesc]);
+	pthread_mutex_unlock(&file->Lock);
+
+	BF_Errno = result;
+	return result;
+}
+
+int BF_AllocateBlocks(const int fileDesc, const int blockCount)
+{
+	BF_File* file = GetFile(fileDesc);
+	if (file == NULL)
+		return BF_Errno;
+
+	if (blockCount <= 0)
+	{
+		BF_Errno = BFE_INVALIDBLOCK;
+		return BF_Errno;
+	}
+
+	// Hold the file lock for all the blocks, so that no other thread allocates blocks between them.
+	pthread_mutex_lock(&file->Lock);
+
+	int firstBlockNumber = file->BlockCount;
+	ReserveBlocks(file, firstBlockNumber + blockCount);
+
+	int result = BFE_OK;
+	for (int index = 0; index < blockCount && result == BFE_OK; index++)
+		result = AllocateBlock(file, s_Descriptors[fileDesc]);
+
+	pthread_mutex_unlock(&file->Lock);
+
+	BF_Errno = result;
+	return (result == BFE_OK) ? firstBlockNumber : result;
+}
+
+int BF_TruncateFile(const int fileDesc, const int blockCount)
+{
+	BF_File* file = GetFile(fileDesc);
+	if (file == NULL)
+		return BF_Errno;
+
+	int fileIndex = s_Descriptors[fileDesc];
+
+	pthread_mutex_lock(&file->Lock);
+
+	if (blockCount < 0 || blockCount > file->BlockCount)
+	{
+		pthread_mutex_unlock(&file->Lock);
+
+		BF_Errno = BFE_INVALIDBLOCK;
+		return BF_Errno;
+	}
+
+	// Write the changes first, so that neither the flusher nor the redo of the log writes a removed block again.
+	int result = FlushFile(file, fileIndex);
+	if (result != BFE_OK)
+	{
+		pthread_mutex_unlock(&file->Lock);
+
+		BF_Errno = result;
+		return result;
+	}
+
+	// Drop the removed blocks from the buffer pool, even the pinned ones.
+	for (int frameIndex = 0; frameIndex < s_FrameCount; frameIndex++)
+	{
+		BF_Shard* shard = GetFrameShard(frameIndex);
+		pthread_mutex_lock(&shard->Lock);
+
+		BF_Frame* frame = &s_Frames[frameIndex];
+		while (frame->File == fileIndex && frame->BlockNumber >= blockCount && (frame->IsLoading || frame->IsWriting))
+			pthread_cond_wait(&shard->Loaded, &shard->Lock);
+
+		if (frame->File == fileIndex && frame->BlockNumber >= blockCount)
+		{
+			EvictFrame(frameIndex);
+			frame->PinCount = 0;
+		}
+
+		pthread_mutex_unlock(&shard->Lock);
+	}
+
+	// Shrinking the file also frees the disk space reserved past it's end.
+	if (ftruncate(file->Descriptor, BlockOffset(file, blockCount)) < 0)
+		result = BFE_INCOMPLETEWRITE;
+	else
+	{
+		__atomic_store_n(&file->BlockCount, blockCount, __ATOMIC_RELEASE);
+		file->ReservedBlockCount = blockCount;
+	}
+
+	pthread_mutex_unlock(&file->Lock);
+
+	BF_Errno = result;
+	return result;
+}
+
+int BF_ReadBlock(const int fileDesc, const int blockNumber, void** block)
+{
+	BF_File* file = GetFile(fileDesc);
+	if (file == NULL)
+		return BF_Errno;
+
+	if (blockNumber < 0 || blockNumber >= GetBlockCount(file))
+	{
+		BF_Errno = BFE_INVALIDBLOCK;
+		return BF_Errno;
+	}
+
+	// Memory mapped blocks are accessed in place.
+	if (file->Backend == BF_BACKEND_MMAP)
+	{
+		*block = file->Mapping + BlockOffset(file, blockNumber);
+
+		BF_Errno = BFE_OK;
+		return BFE_OK;
+	}
+
+	// Pin the block so that other threads can't evict it while this thread is still using it.
+	uint64_t generation = 0;
+	int frameIndex = PinFrame(file, s_Descriptors[fileDesc], blockNumber, 0, &generation);
+	if (frameIndex == BF_INVALID_INDEX)
+		return BF_Errno;
+
+	AddImplicitPin(frameIndex, generation);
+
+	*block = s_Frames[frameIndex].Data;
+
+	BF_Errno = BFE_OK;
+	return BFE_OK;
+}
+
+int BF_Prefetch(const int fileDesc, const int blockNumber, const int blockCount)
+{
+	BF_File* file = GetFile(fileDesc);
+	if (file == NULL)
+		return BF_Errno;
+
+	if (blockNumber < 0 || blockCount < 0)
+	{
+		BF_Errno = BFE_INVALIDBLOCK;
+		return BF_Errno;
+	}
+
+	// The blocks past the end of the file are ignored.
+	int fileBlockCount = GetBlockCount(file);
+	if (blockNumber < fileBlockCount)
+		PrefetchRange(file, s_Descriptors[fileDesc], blockNumber, blockCount < fileBlockCount - blockNumber ? blockCount : fileBlockCount - blockNumber);
+
+	BF_Errno = BFE_OK;
+	return BFE_OK;
+}
+
+int BF_PrefetchBlocks(const int fileDesc, const int* blockNumbers, const int blockCount)
+{
+	BF_File* file = GetFile(fileDesc);
+	if (file == NULL)
+		return BF_Errno;
+
+	if (blockCount < 0 || (blockNumbers == NULL && blockCount > 0))
+	{
+		BF_Errno = BFE_INVALIDBLOCK;
+		return BF_Errno;
+	}
+
+	// Sort the valid block numbers, so that consecutive blocks are read together.
+	int* sortedBlockNumbers = (int*)malloc((blockCount > 0 ? blockCount : 1) * sizeof(int));
+	if (sortedBlockNumbers == NULL)
+	{
+		BF_Errno = BFE_NOMEM;
+		return BF_Errno;
+	}
+
+	int fileBlockCount = GetBlockCount(file);
+	int sortedBlockCount = 0;
+	for (int index = 0; index < blockCount; index++)
+	{
+		if (blockNumbers[index] >= 0 && blockNumbers[index] < fileBlockCount)
+			sortedBlockNumbers[sortedBlockCount++] = blockNumbers[index];
+	}
+
+	qsort(sortedBlockNumbers, sortedBlockCount, sizeof(int), CompareBlockNumbers);
+
+	// Prefetch every run of consecutive blocks, skipping the duplicates.
+	int index = 0;
+	while (index < sortedBlockCount)
+	{
+		int firstBlockNumber = sortedBlockNumbers[index];
+		int endBlockNumber = firstBlockNumber + 1;
+		for (index++; index < sortedBlockCount && sortedBlockNumbers[index] <= endBlockNumber; index++)
+			endBlockNumber = sortedBlockNumbers[index] + 1;
+
+		if (PrefetchRange(file, s_Descriptors[fileDesc], firstBlockNumber, endBlockNumber - firstBlockNumber) < 0)
+			break;
+	}
+
+	free(sortedBlockNumbers);
+
+	BF_Errno = BFE_OK;
+	return BFE_OK;
+}
+
+int BF_PinBlock(const int fileDesc, const int blockNumber, const BF_LatchMode mode, void** block)
+{
+	BF_File* file = GetFile(fileDesc);
+	if (file == NULL)
+		return BF_Errno;
+
+	if (blockNumber < 0 || blockNumber >= GetBlockCount(file))
+	{
+		BF_Errno = BFE_INVALIDBLOCK;
+		return BF_Errno;
+	}
+
+	// Memory mapped blocks get a frame too, for the pin count and the latch. It points into the mapping.
+	uint64_t generation = 0;
+	int frameIndex = PinFrame(file, s_Descriptors[fileDesc], blockNumber, 0, &generation);
+	if (frameIndex == BF_INVALID_INDEX)
+		return BF_Errno;
+
+	// Acquire the latch after the pin, so that the frame can't be reassigned while we wait for it.
+	if (mode == BF_LATCH_EXCLUSIVE)
+		pthread_rwlock_wrlock(&s_Frames[frameIndex].Latch);
+	else
+		pthread_rwlock_rdlock(&s_Frames[frameIndex].Latch);
+
+	*block = s_Frames[frameIndex].Data;
+
+	BF_Errno = BFE_OK;
+	return BFE_OK;
+}
+
+int BF_UnpinBlock(const int fileDesc, const int blockNumber)
+{
+	BF_File* file = GetFile(fileDesc);
+	if (file == NULL)
+		return BF_Errno;
+
+	int fileIndex = s_Descriptors[fileDesc];
+	BF_Shard* shard = GetShard(fileIndex, blockNumber);
+
+	pthread_mutex_lock(&shard->Lock);
+
+	int frameIndex = FindFrame(shard, fileIndex, blockNumber);
+	if (frameIndex == BF_INVALID_INDEX || s_Frames[frameIndex].PinCount == 0)
+	{
+		pthread_mutex_unlock(&shard->Lock);
+
+		BF_Errno = BFE_BLOCKUNFIXED;
+		return BF_Errno;
+	}
+
+	pthread_mutex_unlock(&shard->Lock);
+
+	// Release the latch before the pin, so that the frame is never reassigned while it's latched.
+	pthread_rwlock_unlock(&s_Frames[frameIndex].Latch);
+
+	pthread_mutex_lock(&shard->Lock);
+	s_Frames[frameIndex].PinCount--;
+	pthread_mutex_unlock(&shard->Lock);
+
+	BF_Errno = BFE_OK;
+	return BFE_OK;
+}
+
+int BF_ReadBlocks(const int fileDesc, const int* blockNumbers, const int blockCount, void** blocks)
+{
+	BF_File* file = GetFile(fileDesc);
+	if (file == NULL)
+		return BF_Errno;
+
+	if (blockCount < 0 || (blockCount > 0 && (blockNumbers == NULL || blocks == NULL)))
+	{
+		BF_Errno = BFE_INVALIDBLOCK;
+		return BF_Errno;
+	}
+
+	int fileBlockCount = GetBlockCount(file);
+	for (int index = 0; index < blockCount; index++)
+	{
+		if (blockNumbers[index] < 0 || blockNumbers[index] >= fileBlockCount)
+		{
+			BF_Errno = BFE_INVALIDBLOCK;
+			return BF_Errno;
+		}
+	}
+
+	// Sort the blocks, remembering where every one was requested, so that consecutive blocks are read together.
+	BF_BlockRequest* requests = (BF_BlockRequest*)malloc((blockCount > 0 ? blockCount : 1) * sizeof(BF_BlockRequest));
+	if (requests == NULL)
+	{
+		BF_Errno = BFE_NOMEM;
+		return BF_Errno;
+	}
+
+	for (int index = 0; index < blockCount; index++)
+	{
+		requests[index].BlockNumber = blockNumbers[index];
+		requests[index].Position = index;
+	}
+
+	qsort(requests, blockCount, sizeof(BF_BlockRequest), CompareBlockRequests);
+
+	int result = PinFrames(file, s_Descriptors[fileDesc], requests, blockCount);
+	if (result == BFE_OK)
+	{
+		// Acquire the latches after all the pins. They are shared, and shared latches don't wait for each other, so the
+		// order of the frames doesn't matter.
+		for (int index = 0; index < blockCount; index++)
+		{
+			pthread_rwlock_rdlock(&s_Frames[requests[index].Frame].Latch);
+			blocks[requests[index].Position] = s_Frames[requests[index].Frame].Data;
+		}
+	}
+
+	free(requests);
+
+	BF_Errno = result;
+	return result;
+}
+
+int BF_UnpinBlocks(const int fileDesc, const int* blockNumbers, const int blockCount)
+{
+	int result = BFE_OK;
+	for (int index = 0; index < blockCount; index++)
+	{
+		if (BF_UnpinBlock(fileDesc, blockNumbers[index]) != BFE_OK && result == BFE_OK)
+			result = BF_Errno;
+	}
+
+	BF_Errno = result;
+	return result;
+}
+
+int BF_WriteBlock(const int fileDesc, const int blockNumber)
+{
+	BF_File* file = GetFile(fileDesc);
+	if (file == NULL)
+		return BF_Errno;
+
+	// The changes to a memory mapped block are already in the page cache, so only schedule their write back.
+	if (file->Backend == BF_BACKEND_MMAP)
+	{
+		if (blockNumber < 0 || blockNumber >= GetBlockCount(file))
+		{
+			BF_Errno = BFE_INVALIDBLOCK;
+			return BF_Errno;
+		}
+
+		// In write back mode the kernel writes the page cache back on it's own.
+		if (s_WriteMode == BF_WRITE_THROUGH && SyncMapping(file, BlockOffset(file, blockNumber), file->BlockSize, MS_ASYNC) < 0)
+		{
+			BF_Errno = BFE_INCOMPLETEWRITE;
+			return BF_Errno;
+		}
+
+		BF_Errno = BFE_OK;
+		return BFE_OK;
+	}
+
+	// Pin the frame of the block while it's written, so that it's not reassigned halfway through.
+	int fileIndex = s_Descriptors[fileDesc];
+	BF_Shard* shard = GetShard(fileIndex, blockNumber);
+
+	pthread_mutex_lock(&shard->Lock);
+
+	int frameIndex = FindFrame(shard, fileIndex, blockNumber);
+	if (frameIndex == BF_INVALID_INDEX)
+	{
+		pthread_mutex_unlock(&shard->Lock);
+
+		BF_Errno = BFE_BLOCKNOTINBUF;
+		return BF_Errno;
+	}
+
+	// Log the changes to a block of a logged file. The block is written once the log is durable.
+	if (file->Log.IsEnabled)
+	{
+		int isLogged = (LogFrameChanges(file, frameIndex) == 0);
+		if (isLogged)
+			MarkFrameDirty(&s_Frames[frameIndex]);
+
+		pthread_mutex_unlock(&shard->Lock);
+
+		BF_Errno = isLogged ? BFE_OK : BFE_NOMEM;
+		return BF_Errno;
+	}
+
+	// In write back mode only mark the frame dirty. The flusher writes it later.
+	if (s_WriteMode == BF_WRITE_BACK)
+	{
+		MarkFrameDirty(&s_Frames[frameIndex]);
+		pthread_mutex_unlock(&shard->Lock);
+
+		BF_Errno = BFE_OK;
+		return BFE_OK;
+	}
+
+	s_Frames[frameIndex].PinCount++;
+	uint64_t generation = s_Frames[frameIndex].Generation;
+
+	pthread_mutex_unlock(&shard->Lock);
+
+	ssize_t writtenByteCount = pwrite(file->Descriptor, s_Frames[frameIndex].Data, file->BlockSize, BlockOffset(file, blockNumber));
+
+	UnpinFrame(frameIndex, generation);
+
+	if (writtenByteCount != file->BlockSize)
+	{
+		BF_Errno = BFE_INCOMPLETEWRITE;
+		return BF_Errno;
+	}
+
+	BF_Errno = BFE_OK;
+	return BFE_OK;
+}
+
+int BF_Flush(const int fileDesc)
+{
+	BF_File* file = GetFile(fileDesc);
+	if (file == NULL)
+		return BF_Errno;
+
+	BF_Errno = FlushFile(file, s_Descriptors[fileDesc]);
+	return BF_Errno;
+}
+
+long long BF_Commit(const int fileDesc)
+{
+	BF_File* file = GetFile(fileDesc);
+	if (file == NULL)
+		return BF_Errno;
+
+	BF_Log* log = &file->Log;
+	pthread_mutex_lock(&log->Lock);
+
+	// Files without a log have nothing to commit.
+	if (!log->IsEnabled)
+	{
+		pthread_mutex_unlock(&log->Lock);
+
+		BF_Errno = BFE_OK;
+		return 0;
+	}
+
+	if (log->HasFailed || AppendLogCommit(log) < 0)
+	{
+		pthread_mutex_unlock(&log->Lock);
+
+		BF_Errno = log->HasFailed ? BFE_INCOMPLETEWRITE : BFE_NOMEM;
+		return BF_Errno;
+	}
+
+	long long ticket = (long long)log->CommitSequence;
+	int isDurable = (log->DurableSequence >= log->CommitSequence);
+	int isCheckpointDue = (log->Position - log->Base > BF_LOG_CHECKPOINT_SIZE);
+
+	pthread_mutex_unlock(&log->Lock);
+
+	// Ask the committer to write the log.
+	if (!isDurable)
+	{
+		pthread_mutex_lock(&s_CommitterLock);
+		s_CommitRequestCount++;
+		pthread_cond_signal(&s_CommitterWake);
+		pthread_mutex_unlock(&s_CommitterLock);
+	}
+
+	// Keep the log short, so that redo is quick.
+	if (isCheckpointDue)
+	{
+		int result = CheckpointFile(file, s_Descriptors[fileDesc]);
+		if (result != BFE_OK)
+		{
+			BF_Errno = result;
+			return BF_Errno;
+		}
+	}
+
+	BF_Errno = BFE_OK;
+	return ticket;
+}
+
+int BF_WaitForCommit(const int fileDesc, const long long ticket)
+{
+	// A file closed meanwhile has been checkpointed, so it's commits are durable.
+	BF_File* file = GetFile(fileDesc);
+	if (ticket <= 0 || file == NULL)
+	{
+		BF_Errno = BFE_OK;
+		return BFE_OK;
+	}
+
+	BF_Log* log = &file->Log;
+	pthread_mutex_lock(&log->Lock);
+
+	while (log->IsEnabled && !log->HasFailed && log->DurableSequence < (uint64_t)ticket)
+		pthread_cond_wait(&log->Written, &log->Lock);
+
+	int result = (log->IsEnabled && log->HasFailed) ? BFE_INCOMPLETEWRITE : BFE_OK;
+
+	pthread_mutex_unlock(&log->Lock);
+
+	BF_Errno = result;
+	return result;
+}
+
+void BF_PrintError(const char* message)
+{
+	const char* description = "Unknown error";
+	if (BF_Errno <= 0 && -BF_Errno < (int)(sizeof(s_ErrorMessages) / sizeof(s_ErrorMessages[0])))
+		description = s_ErrorMessages[-BF_Errno];
+
+	fprintf(stderr, "%s%s\n", message, description);
+}
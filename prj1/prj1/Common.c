@@ -0,0 +1,591 @@
+#include "Common.h"
+
+#include "BF/BF.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+// The index of the header block, the first block of every heap and hash file.
+#define HEADER_BLOCK_INDEX 0
+
+// An invalid block index.
+#define INVALID_BLOCK_INDEX -1
+
+int32_t OpenLoggedFile(const char* fileName)
+{
+	// The memory mapped backend can't log the changes, so if the application selected it, it gets the mapping without the log.
+	int32_t fileHandle = BF_OpenFileWithLog(fileName);
+	if (fileHandle == BFE_LOGUNSUPPORTED)
+		fileHandle = BF_OpenFile(fileName);
+
+	return fileHandle;
+}
+
+OpenFile* AddOpenFile(OpenFileTable* table, int32_t fileHandle)
+{
+	pthread_mutex_lock(&table->Lock);
+
+	// Allocate the entries the first time the table is used, once the block level knows how many files it can open.
+	if (!table->IsInitialized)
+	{
+		table->Files = (OpenFile*)calloc(BF_GetMaxOpenFiles(), sizeof(OpenFile));
+		if (table->Files == nullptr)
+		{
+			pthread_mutex_unlock(&table->Lock);
+			return nullptr;
+		}
+
+		table->FileCount = BF_GetMaxOpenFiles();
+		for (uint32_t fileIndex = 0; fileIndex < table->FileCount; fileIndex++)
+			pthread_rwlock_init(&table->Files[fileIndex].Lock, nullptr);
+
+		table->IsInitialized = true;
+	}
+
+	// Find a free entry.
+	OpenFile* file = nullptr;
+	for (uint32_t fileIndex = 0; fileIndex < table->FileCount && file == nullptr; fileIndex++)
+		if (!table->Files[fileIndex].IsOpen)
+			file = &table->Files[fileIndex];
+
+	// Store the handle in the entry.
+	if (file != nullptr)
+	{
+		file->IsOpen = true;
+		file->Handle = fileHandle;
+	}
+
+	pthread_mutex_unlock(&table->Lock);
+
+	return file;
+}
+
+OpenFile* AcquireOpenFile(OpenFileTable* table, int32_t fileHandle, bool isExclusive)
+{
+	// Find the entry of the file.
+	pthread_mutex_lock(&table->Lock);
+
+	OpenFile* file = nullptr;
+	for (uint32_t fileIndex = 0; fileIndex < table->FileCount && file == nullptr; fileIndex++)
+		if (table->Files[fileIndex].IsOpen && table->Files[fileIndex].Handle == fileHandle)
+			file = &table->Files[fileIndex];
+
+	pthread_mutex_unlock(&table->Lock);
+
+	if (file == nullptr)
+		return nullptr;
+
+	// Lock the entry outside of the table lock, so that a long operation on one file doesn't block the lookups of the others.
+	if (isExclusive)
+		pthread_rwlock_wrlock(&file->Lock);
+	else
+		pthread_rwlock_rdlock(&file->Lock);
+
+	// The file may have been closed while we were waiting for the lock.
+	if (!file->IsOpen || file->Handle != fileHandle)
+	{
+		pthread_rwlock_unlock(&file->Lock);
+		return nullptr;
+	}
+
+	return file;
+}
+
+void ReleaseOpenFile(OpenFile* file)
+{
+	pthread_rwlock_unlock(&file->Lock);
+}
+
+int32_t CommitOpenFile(OpenFile* file)
+{
+	// Commit the logged changes while the file is locked, so that they don't mix with the changes of the next operation.
+	int32_t handle = file->Handle;
+	long long ticket = BF_Commit(handle);
+	ReleaseOpenFile(file);
+
+	if (ticket < 0)
+	{
+		printf("Could not commit the changes to the file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Wait for the commit without the lock.
+	if (BF_WaitForCommit(handle, ticket) < 0)
+	{
+		printf("Could not write the changes of the file to the log! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	return 0;
+}
+
+void RemoveOpenFile(OpenFileTable* table, OpenFile* file)
+{
+	// Mark the entry as free.
+	pthread_mutex_lock(&table->Lock);
+	file->IsOpen = false;
+	file->Handle = -1;
+	pthread_mutex_unlock(&table->Lock);
+
+	pthread_rwlock_unlock(&file->Lock);
+}
+
+// Copies the free block list stored listOffset bytes into the header block of a file. Returns 0 on success and -1 on failure.
+static int32_t LoadFreeBlockList(int32_t fileHandle, size_t listOffset, FreeBlockList* list)
+{
+	// Retrieve a pointer to the header block.
+	uint8_t* headerBlockPtr = nullptr;
+	if (BF_ReadBlock(fileHandle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to header block! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	memcpy(list, headerBlockPtr + listOffset, sizeof(FreeBlockList));
+
+	return 0;
+}
+
+// Writes the free block list stored listOffset bytes into the header block of a file to the disk. Returns 0 on success and -1 on failure.
+static int32_t StoreFreeBlockList(int32_t fileHandle, size_t listOffset, const FreeBlockList* list)
+{
+	// Retrieve a pointer to the header block.
+	uint8_t* headerBlockPtr = nullptr;
+	if (BF_ReadBlock(fileHandle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to header block! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	memcpy(headerBlockPtr + listOffset, list, sizeof(FreeBlockList));
+
+	// Write the header block to the disk.
+	if (BF_WriteBlock(fileHandle, HEADER_BLOCK_INDEX) < 0)
+	{
+		printf("Could not write header block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	return 0;
+}
+
+int32_t AllocateChainBlocks(int32_t fileHandle, size_t listOffset, uint32_t blockCount, uint32_t* allocatedBlockCount)
+{
+	FreeBlockList list = { };
+	if (LoadFreeBlockList(fileHandle, listOffset, &list) == -1)
+		return -1;
+
+	// Reuse a free block before growing the file.
+	if (list.BlockCount > 0)
+	{
+		int32_t blockIndex = list.FirstBlockIndex;
+
+		// Retrieve a pointer to the first free block.
+		uint8_t* blockPtr = nullptr;
+		if (BF_ReadBlock(fileHandle, blockIndex, (void**)&blockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to free block! FileHandle: %d, BlockIndex: %d\n", fileHandle, blockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// Pop it from the free block list and clear the index of the next one.
+		list.FirstBlockIndex = *(int32_t*)blockPtr;
+		list.BlockCount--;
+		memset(blockPtr, 0, sizeof(int32_t));
+
+		if (StoreFreeBlockList(fileHandle, listOffset, &list) == -1)
+			return -1;
+
+		*allocatedBlockCount = 1;
+		return blockIndex;
+	}
+
+	// Allocate the new blocks.
+	int32_t blockIndex = BF_AllocateBlocks(fileHandle, blockCount);
+	if (blockIndex < 0)
+	{
+		printf("Could not allocate block! FileHandle: %d\n", fileHandle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	*allocatedBlockCount = blockCount;
+	return blockIndex;
+}
+
+int32_t FreeBlocks(int32_t fileHandle, size_t listOffset, int32_t firstBlockIndex, uint32_t blockCount)
+{
+	FreeBlockList list = { };
+	if (LoadFreeBlockList(fileHandle, listOffset, &list) == -1)
+		return -1;
+
+	int32_t blockSize = BF_GetBlockSize(fileHandle);
+
+	// Push the blocks from the last one, so that the list starts with them in ascending order.
+	for (uint32_t blockNumber = blockCount; blockNumber > 0; blockNumber--)
+	{
+		int32_t blockIndex = firstBlockIndex + blockNumber - 1;
+
+		// Retrieve a pointer to the block.
+		uint8_t* blockPtr = nullptr;
+		if (BF_ReadBlock(fileHandle, blockIndex, (void**)&blockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to free block! FileHandle: %d, BlockIndex: %d\n", fileHandle, blockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// Clear the block and link it to the next free block.
+		memset(blockPtr, 0, blockSize);
+		*(int32_t*)blockPtr = (list.BlockCount > 0) ? list.FirstBlockIndex : INVALID_BLOCK_INDEX;
+
+		// Write the free block to the disk.
+		if (BF_WriteBlock(fileHandle, blockIndex) < 0)
+		{
+			printf("Could not write free block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, blockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		list.FirstBlockIndex = blockIndex;
+		list.BlockCount++;
+	}
+
+	return StoreFreeBlockList(fileHandle, listOffset, &list);
+}
+
+// Orders block indices.
+static int CompareBlockIndices(const void* left, const void* right)
+{
+	int32_t leftBlockIndex = *(const int32_t*)left;
+	int32_t rightBlockIndex = *(const int32_t*)right;
+
+	return (leftBlockIndex > rightBlockIndex) - (leftBlockIndex < rightBlockIndex);
+}
+
+int32_t TruncateFreeBlocks(int32_t fileHandle, size_t listOffset)
+{
+	FreeBlockList list = { };
+	if (LoadFreeBlockList(fileHandle, listOffset, &list) == -1)
+		return -1;
+
+	if (list.BlockCount == 0)
+		return 0;
+
+	// Allocate room for the indices of the free blocks.
+	int32_t* freeBlockIndices = (int32_t*)malloc(list.BlockCount * sizeof(int32_t));
+	if (freeBlockIndices == nullptr)
+	{
+		printf("Could not allocate memory for the free block list! FileHandle: %d, FreeBlockCount: %d\n", fileHandle, list.BlockCount);
+		return -1;
+	}
+
+	// Walk the free block list and collect it's blocks.
+	int32_t currentBlockIndex = list.FirstBlockIndex;
+	for (uint32_t index = 0; index < list.BlockCount; index++)
+	{
+		// Retrieve a pointer to the current free block.
+		uint8_t* currentBlockPtr = nullptr;
+		if (BF_ReadBlock(fileHandle, currentBlockIndex, (void**)&currentBlockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to free block! FileHandle: %d, BlockIndex: %d\n", fileHandle, currentBlockIndex);
+			BF_PrintError("");
+			free(freeBlockIndices);
+
+			return -1;
+		}
+
+		freeBlockIndices[index] = currentBlockIndex;
+		currentBlockIndex = *(int32_t*)currentBlockPtr;
+	}
+
+	qsort(freeBlockIndices, list.BlockCount, sizeof(int32_t), CompareBlockIndices);
+
+	// Count the free blocks that end the file.
+	int32_t blockCount = BF_GetBlockCounter(fileHandle);
+	uint32_t freeBlockCount = list.BlockCount;
+	while (freeBlockCount > 0 && freeBlockIndices[freeBlockCount - 1] == blockCount - 1)
+	{
+		freeBlockCount--;
+		blockCount--;
+	}
+
+	// There's nothing to give back if the last block of the file is in use.
+	if (freeBlockCount == list.BlockCount)
+	{
+		free(freeBlockIndices);
+		return 0;
+	}
+
+	// Relink the free blocks that stay, so that the list no longer reaches the blocks that are removed.
+	list.FirstBlockIndex = INVALID_BLOCK_INDEX;
+	list.BlockCount = 0;
+
+	int32_t result = StoreFreeBlockList(fileHandle, listOffset, &list);
+	for (uint32_t index = freeBlockCount; index > 0 && result == 0; index--)
+		result = FreeBlocks(fileHandle, listOffset, freeBlockIndices[index - 1], 1);
+
+	free(freeBlockIndices);
+
+	// Remove the blocks. The changes above are written first, so the list never refers to blocks past the end of the file.
+	if (result == 0 && BF_TruncateFile(fileHandle, blockCount) < 0)
+	{
+		printf("Could not truncate the file! FileHandle: %d, BlockCount: %d\n", fileHandle, blockCount);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	return result;
+}
+
+Record* AddRecordSlot(uint8_t* blockPtr, int32_t blockSize, size_t headerSize, uint8_t* recordCount, uint8_t* slotCount)
+{
+	Record* records = (Record*)(blockPtr + headerSize);
+
+	// Extend the used slots if none of them is deleted.
+	uint32_t slotIndex = *slotCount;
+	if (*recordCount == *slotCount)
+		(*slotCount)++;
+	else
+	{
+		// Otherwise find the first deleted slot and clear it's tombstone.
+		for (slotIndex = 0; !IS_SLOT_DELETED(blockPtr, blockSize, slotIndex); slotIndex++)
+			;
+
+		UNMARK_SLOT_DELETED(blockPtr, blockSize, slotIndex);
+	}
+
+	(*recordCount)++;
+
+	return &records[slotIndex];
+}
+
+void DeleteRecordSlot(uint8_t* blockPtr, int32_t blockSize, size_t headerSize, uint8_t* recordCount, uint8_t* slotCount, uint32_t slotIndex)
+{
+	Record* records = (Record*)(blockPtr + headerSize);
+
+	// Clear the record and mark it's slot as deleted.
+	memset(&records[slotIndex], 0, sizeof(Record));
+	MARK_SLOT_DELETED(blockPtr, blockSize, slotIndex);
+	(*recordCount)--;
+
+	// Free the deleted slots at the end of the block, so that they are not scanned.
+	while (*slotCount > 0 && IS_SLOT_DELETED(blockPtr, blockSize, *slotCount - 1))
+	{
+		(*slotCount)--;
+		UNMARK_SLOT_DELETED(blockPtr, blockSize, *slotCount);
+	}
+}
+
+uint32_t CollectRecordSlots(const uint8_t* blockPtr, int32_t blockSize, size_t headerSize, uint32_t endSlotIndex, uint32_t* slotIndex,
+	const int32_t* key, const Record** records, uint32_t maxRecordCount)
+{
+	const Record* slots = (const Record*)(blockPtr + headerSize);
+
+	// Collect the records of the slots that are not deleted, and that have the key if there is one.
+	uint32_t recordCount = 0;
+	while (*slotIndex < endSlotIndex && recordCount < maxRecordCount)
+	{
+		uint32_t currentSlotIndex = (*slotIndex)++;
+		if (!IS_SLOT_DELETED(blockPtr, blockSize, currentSlotIndex) && (key == nullptr || slots[currentSlotIndex].ID == *key))
+			records[recordCount++] = &slots[currentSlotIndex];
+	}
+
+	return recordCount;
+}
+
+// Mixes the bits of a record ID, so that consecutive IDs spread over the entries of a RecordIndex.
+static uint32_t HashRecordID(int32_t id)
+{
+	uint32_t key = (uint32_t)id;
+	key ^= key >> 16;
+	key *= 0x85ebca6b;
+	key ^= key >> 13;
+	key *= 0xc2b2ae35;
+	key ^= key >> 16;
+
+	return key;
+}
+
+// Stores an entry in the first empty entry of it's probe sequence. There must be an empty entry.
+static void PlaceRecordIndexEntry(RecordIndexEntry* entries, uint32_t capacity, RecordIndexEntry entry)
+{
+	uint32_t position = HashRecordID(entry.ID) & (capacity - 1);
+	while (entries[position].BlockIndex != INVALID_BLOCK_INDEX)
+		position = (position + 1) & (capacity - 1);
+
+	entries[position] = entry;
+}
+
+RecordIndexEntry* FindRecordIndexEntry(const RecordIndex* index, int32_t id)
+{
+	if (index->Capacity == 0)
+		return nullptr;
+
+	// Probe from the home entry of the ID, until we find it or an empty entry ends the probe sequence.
+	uint32_t position = HashRecordID(id) & (index->Capacity - 1);
+	while (index->Entries[position].BlockIndex != INVALID_BLOCK_INDEX)
+	{
+		if (index->Entries[position].ID == id)
+			return &index->Entries[position];
+
+		position = (position + 1) & (index->Capacity - 1);
+	}
+
+	return nullptr;
+}
+
+int32_t ReserveRecordIndexEntries(RecordIndex* index, uint32_t recordCount)
+{
+	// Find the capacity that keeps at most half of the entries used.
+	uint32_t newCapacity = (index->Capacity > 0) ? index->Capacity : 1024;
+	while ((uint64_t)(index->Count + recordCount) * 2 > newCapacity)
+		newCapacity *= 2;
+
+	if (newCapacity == index->Capacity)
+		return 0;
+
+	RecordIndexEntry* newEntries = (RecordIndexEntry*)malloc(newCapacity * sizeof(RecordIndexEntry));
+	if (newEntries == nullptr)
+	{
+		printf("Could not allocate memory for the record index! EntryCount: %u\n", newCapacity);
+		return -1;
+	}
+
+	// Mark the new entries as empty, then move the used ones over.
+	for (uint32_t position = 0; position < newCapacity; position++)
+		newEntries[position].BlockIndex = INVALID_BLOCK_INDEX;
+
+	for (uint32_t position = 0; position < index->Capacity; position++)
+		if (index->Entries[position].BlockIndex != INVALID_BLOCK_INDEX)
+			PlaceRecordIndexEntry(newEntries, newCapacity, index->Entries[position]);
+
+	free(index->Entries);
+	index->Entries = newEntries;
+	index->Capacity = newCapacity;
+
+	return 0;
+}
+
+int32_t AddRecordIndexEntry(RecordIndex* index, int32_t id, int32_t blockIndex, uint32_t slotIndex)
+{
+	if (ReserveRecordIndexEntries(index, 1) == -1)
+		return -1;
+
+	RecordIndexEntry entry = { };
+	entry.ID = id;
+	entry.BlockIndex = blockIndex;
+	entry.SlotIndex = slotIndex;
+
+	PlaceRecordIndexEntry(index->Entries, index->Capacity, entry);
+	index->Count++;
+
+	return 0;
+}
+
+void RemoveRecordIndexEntry(RecordIndex* index, int32_t id)
+{
+	RecordIndexEntry* entry = FindRecordIndexEntry(index, id);
+	if (entry == nullptr)
+		return;
+
+	// Move back the later entries of the probe sequence whose home is not after the hole, so that they can still be found. This
+	// leaves no tombstones behind, so the probes don't get longer as records are deleted.
+	uint32_t mask = index->Capacity - 1;
+	uint32_t hole = (uint32_t)(entry - index->Entries);
+	for (uint32_t position = (hole + 1) & mask; index->Entries[position].BlockIndex != INVALID_BLOCK_INDEX; position = (position + 1) & mask)
+	{
+		uint32_t home = HashRecordID(index->Entries[position].ID) & mask;
+		if (((position - home) & mask) >= ((position - hole) & mask))
+		{
+			index->Entries[hole] = index->Entries[position];
+			hole = position;
+		}
+	}
+
+	index->Entries[hole].BlockIndex = INVALID_BLOCK_INDEX;
+	index->Count--;
+}
+
+void DestroyRecordIndex(RecordIndex* index)
+{
+	free(index->Entries);
+	index->Entries = nullptr;
+	index->Capacity = 0;
+	index->Count = 0;
+}
+
+int32_t SaveRecordIndex(const RecordIndex* index, const char* fileName)
+{
+	FILE* file = fopen(fileName, "wb");
+	if (file == nullptr)
+	{
+		printf("Could not create the record index file! FileName: %s\n", fileName);
+		return -1;
+	}
+
+	// Write the number of entries, then the used entries.
+	bool isWritten = fwrite(&index->Count, sizeof(uint32_t), 1, file) == 1;
+	for (uint32_t position = 0; position < index->Capacity && isWritten; position++)
+		if (index->Entries[position].BlockIndex != INVALID_BLOCK_INDEX)
+			isWritten = fwrite(&index->Entries[position], sizeof(RecordIndexEntry), 1, file) == 1;
+
+	// Make sure the entries are on the disk before the caller marks them as valid.
+	isWritten = isWritten && fflush(file) == 0 && fsync(fileno(file)) == 0;
+	if (fclose(file) != 0 || !isWritten)
+	{
+		printf("Could not write the record index file! FileName: %s\n", fileName);
+		return -1;
+	}
+
+	return 0;
+}
+
+int32_t LoadRecordIndex(RecordIndex* index, const char* fileName)
+{
+	FILE* file = fopen(fileName, "rb");
+	if (file == nullptr)
+		return -1;
+
+	// Read the number of entries and make room for them, then add them one by one.
+	uint32_t count = 0;
+	bool isRead = fread(&count, sizeof(uint32_t), 1, file) == 1 && ReserveRecordIndexEntries(index, count) == 0;
+	for (uint32_t entryIndex = 0; entryIndex < count && isRead; entryIndex++)
+	{
+		RecordIndexEntry entry = { };
+		isRead = fread(&entry, sizeof(RecordIndexEntry), 1, file) == 1 && entry.BlockIndex != INVALID_BLOCK_INDEX;
+		if (isRead)
+		{
+			PlaceRecordIndexEntry(index->Entries, index->Capacity, entry);
+			index->Count++;
+		}
+	}
+
+	fclose(file);
+
+	if (!isRead)
+	{
+		DestroyRecordIndex(index);
+		return -1;
+	}
+
+	return 0;
+}
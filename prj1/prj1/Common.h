@@ -1,10 +1,17 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
 
 // A NULL type for pointers.
 #define nullptr 0
 
+// Boolean definition.
+typedef uint8_t bool;
+#define true  1
+#define false 0
+
 // The type of files created by the application.
 typedef enum FileType
 {
@@ -40,3 +47,163 @@ typedef struct Record
 	// The address.
 	char Address[50];
 } Record;
+
+// An entry of a RecordIndex, the location of the record with an ID.
+typedef struct RecordIndexEntry
+{
+	// The ID of the record.
+	int32_t ID;
+
+	// The index of the block the record is in, or -1 if the entry is empty.
+	int32_t BlockIndex;
+
+	// The slot of the record in it's block.
+	uint32_t SlotIndex;
+} RecordIndexEntry;
+
+// An in memory hash map from the IDs of the records of a file to their locations. It uses open addressing with linear probing, so
+// that a lookup usually reads a single cache line and no memory is allocated per record.
+typedef struct RecordIndex
+{
+	// The entries of the map. Their count is a power of two, and at most half of them are used so that the probes stay short.
+	RecordIndexEntry* Entries;
+	uint32_t Capacity;
+
+	// The number of used entries.
+	uint32_t Count;
+} RecordIndex;
+
+// The state of an open file. The open functions return a pointer to it's handle.
+typedef struct OpenFile
+{
+	// Whether the entry holds an open file.
+	bool IsOpen;
+
+	// The block level handle of the file.
+	int32_t Handle;
+
+	// Held shared by the lookups and exclusively by the operations that modify the file, so lookups run concurrently.
+	pthread_rwlock_t Lock;
+
+	// The locations of the records of an open heap file by their IDs, built or loaded when it's opened. Hash files don't use it.
+	RecordIndex Records;
+
+	// The file the record index is saved to when the heap file is closed, or nullptr if it's not saved.
+	char* RecordIndexFileName;
+} OpenFile;
+
+// A table of the open files of a file type.
+typedef struct OpenFileTable
+{
+	// The entries of the table. There is one for every file the block level can open, so the table fills up along with
+	// the block level file table.
+	OpenFile* Files;
+	uint32_t FileCount;
+
+	// Whether the entries have been allocated.
+	bool IsInitialized;
+
+	// Guards the IsOpen and Handle fields of the entries.
+	pthread_mutex_t Lock;
+} OpenFileTable;
+
+// Initializes an OpenFileTable with static storage duration.
+#define OPEN_FILE_TABLE_INITIALIZER { .Files = nullptr, .FileCount = 0, .IsInitialized = false, .Lock = PTHREAD_MUTEX_INITIALIZER }
+
+// Opens a block level file with a write ahead log, or without one if the selected backend doesn't support logging. Returns the
+// file handle on success and a negative BF error code on failure.
+int32_t OpenLoggedFile(const char* fileName);
+
+// Adds an open block level file to the table. Returns the new entry, or nullptr if the table is full.
+OpenFile* AddOpenFile(OpenFileTable* table, int32_t fileHandle);
+
+// Finds and locks the entry of an open file, shared or exclusively. Returns nullptr if the file is not in the table.
+OpenFile* AcquireOpenFile(OpenFileTable* table, int32_t fileHandle, bool isExclusive);
+
+// Unlocks an entry returned by AcquireOpenFile.
+void ReleaseOpenFile(OpenFile* file);
+
+// Commits the changes an operation made to an exclusively locked file and unlocks it, then waits until they are durable.
+// Waiting without the lock lets the commits of concurrent writers share one log write. Returns 0 on success and -1 on failure.
+int32_t CommitOpenFile(OpenFile* file);
+
+// Removes a locked entry from the table and unlocks it.
+void RemoveOpenFile(OpenFileTable* table, OpenFile* file);
+
+// The list of the free blocks of a heap or hash file, stored in it's header block. Blocks emptied by deletes are unlinked from their
+// chains and pushed on it, so that later inserts reuse them before the file grows. A free block is zeroed, apart from the index of the
+// next free block in it's first bytes.
+typedef struct FreeBlockList
+{
+	// The first free block.
+	int32_t FirstBlockIndex;
+
+	// The number of free blocks.
+	uint32_t BlockCount;
+} FreeBlockList;
+
+// Allocates zeroed blocks for a chain of a heap or hash file, whose free block list is stored listOffset bytes into it's header block.
+// The first free block is reused if there is one, otherwise blockCount consecutive blocks are appended to the file. The number of
+// blocks allocated is stored in allocatedBlockCount. The caller writes the blocks. Returns the index of the first block on success
+// and -1 on failure.
+int32_t AllocateChainBlocks(int32_t fileHandle, size_t listOffset, uint32_t blockCount, uint32_t* allocatedBlockCount);
+
+// Pushes blockCount consecutive blocks, starting from firstBlockIndex, on the free block list stored listOffset bytes into the header
+// block of the file. The blocks must already be unlinked from their chains. Returns 0 on success and -1 on failure.
+int32_t FreeBlocks(int32_t fileHandle, size_t listOffset, int32_t firstBlockIndex, uint32_t blockCount);
+
+// Gives the free blocks at the end of the file back to the file system, and relinks the rest of the free block list stored listOffset
+// bytes into the header block in ascending order, so that they are reused front to back. Returns 0 on success and -1 on failure.
+int32_t TruncateFreeBlocks(int32_t fileHandle, size_t listOffset);
+
+// Whether a record slot of a heap or hash data block holds a deleted record. The tombstone bitmap starts from the last byte of the block
+// and grows backwards, so the bit of a slot doesn't depend on the number of slots of the block.
+#define IS_SLOT_DELETED(blockPtr, blockSize, slotIndex) \
+	((((const uint8_t*)(blockPtr))[(blockSize) - 1 - (slotIndex) / 8] >> ((slotIndex) % 8)) & 1)
+
+// Mark a record slot of a heap or hash data block as deleted.
+#define MARK_SLOT_DELETED(blockPtr, blockSize, slotIndex) \
+	(((uint8_t*)(blockPtr))[(blockSize) - 1 - (slotIndex) / 8] |= (uint8_t)(1 << ((slotIndex) % 8)))
+
+// Mark a record slot of a heap or hash data block as used or free.
+#define UNMARK_SLOT_DELETED(blockPtr, blockSize, slotIndex) \
+	(((uint8_t*)(blockPtr))[(blockSize) - 1 - (slotIndex) / 8] &= (uint8_t)~(1 << ((slotIndex) % 8)))
+
+// Takes a free record slot of a heap or hash data block that is not full and counts the record that will be stored in it. The records
+// start headerSize bytes into the block, and recordCount and slotCount point to the counts of it's header. The first deleted slot is
+// reused before the used slots are extended. Returns a pointer to the slot.
+Record* AddRecordSlot(uint8_t* blockPtr, int32_t blockSize, size_t headerSize, uint8_t* recordCount, uint8_t* slotCount);
+
+// Deletes the record in a slot of a heap or hash data block. The slot gets a tombstone instead of the later records moving into it,
+// so the slots of the other records stay the same. The deleted slots at the end of the block are freed.
+void DeleteRecordSlot(uint8_t* blockPtr, int32_t blockSize, size_t headerSize, uint8_t* recordCount, uint8_t* slotCount, uint32_t slotIndex);
+
+// Collects pointers to the records of a heap or hash data block that is pinned for a scan, reading it's slots from the one slotIndex
+// points to up to endSlotIndex. Deleted slots are skipped, and so are records whose ID is not *key, unless key is nullptr. At most
+// maxRecordCount records are collected, and slotIndex is advanced past the last slot read. Returns the number of records collected.
+uint32_t CollectRecordSlots(const uint8_t* blockPtr, int32_t blockSize, size_t headerSize, uint32_t endSlotIndex, uint32_t* slotIndex,
+	const int32_t* key, const Record** records, uint32_t maxRecordCount);
+
+// Finds the location of the record with an ID in the index. Returns nullptr if the ID is not in it.
+RecordIndexEntry* FindRecordIndexEntry(const RecordIndex* index, int32_t id);
+
+// Grows the index, if needed, so that recordCount more IDs can be added to it without allocating memory. Returns 0 on success and -1
+// on failure.
+int32_t ReserveRecordIndexEntries(RecordIndex* index, uint32_t recordCount);
+
+// Adds the location of a record to the index, growing it if needed. The ID must not be in the index already. Returns 0 on success and
+// -1 on failure.
+int32_t AddRecordIndexEntry(RecordIndex* index, int32_t id, int32_t blockIndex, uint32_t slotIndex);
+
+// Removes the location of the record with an ID from the index, if it's in it.
+void RemoveRecordIndexEntry(RecordIndex* index, int32_t id);
+
+// Frees the memory of the index and empties it.
+void DestroyRecordIndex(RecordIndex* index);
+
+// Writes the locations in the index to a file, and waits until they are on the disk. Returns 0 on success and -1 on failure.
+int32_t SaveRecordIndex(const RecordIndex* index, const char* fileName);
+
+// Loads the locations a file written by SaveRecordIndex holds into an empty index. Returns 0 on success and -1 on failure, leaving the
+// index empty.
+int32_t LoadRecordIndex(RecordIndex* index, const char* fileName);
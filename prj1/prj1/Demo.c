@@ -2,6 +2,7 @@
 #include "HP.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 // Entry Point
 int main()
@@ -108,6 +109,62 @@ int main()
 		return -1;
 	}
 
+	printf("All elements restored! Press enter to append 20000 more elements at once...\n");
+	getchar();
+
+	// Append more elements than the buffer pool holds blocks for.
+	uint32_t appendCount = 20000;
+	Record* records = (Record*)malloc(appendCount * sizeof(Record));
+	if (records == nullptr)
+	{
+		printf("Could not allocate the appended records!\n");
+		return -1;
+	}
+
+	for (uint32_t recordIndex = 0; recordIndex < appendCount; recordIndex++)
+	{
+		Record record = { };
+		record.ID = recordCount + recordIndex + 1;
+		sprintf(record.Name, "Name %d", record.ID);
+		sprintf(record.Surname, "Surname %d", record.ID);
+		sprintf(record.Address, "Address %d", record.ID);
+
+		records[recordIndex] = record;
+	}
+
+	int32_t appendedCount = HP_AppendEntries(*heapFileHandle, records, appendCount);
+	free(records);
+
+	if (appendedCount != (int32_t)appendCount)
+	{
+		printf("Could not append the elements! Appended: %d\n", appendedCount);
+		return -1;
+	}
+
+	// Count all the elements.
+	HP_Cursor* cursor = HP_ScanOpen(*heapFileHandle, nullptr);
+	if (cursor == nullptr)
+	{
+		printf("Could not open a cursor over the heap file!\n");
+		return -1;
+	}
+
+	uint32_t scannedCount = 0;
+	const Record* record = nullptr;
+	while (HP_ScanNext(cursor, &record) == 1)
+		scannedCount++;
+
+	HP_ScanClose(cursor);
+
+	if (scannedCount != recordCount + appendCount)
+	{
+		printf("The heap file has %u elements instead of %u!\n", scannedCount, recordCount + appendCount);
+		return -1;
+	}
+
+	printf("Appended %u elements! Press enter to close the heap file...\n", appendCount);
+	getchar();
+
 	// Close the test heap file.
 	if (HP_CloseFile(heapFileHandle) == -1)
 	{
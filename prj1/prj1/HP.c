@@ -1,6 +1,7 @@
 #include "HP.h"
 
 #include <string.h>
+#include <stdlib.h>
 #include <stdio.h>
 
 #include "BF/BF.h"
@@ -19,31 +20,92 @@ typedef struct FileHeader
 
 	// The index of the next block in the heap file.
 	int32_t NextBlockIndex;
+
+	// The blocks emptied by deletes, which inserts reuse before the file grows.
+	FreeBlockList FreeBlocks;
+
+	// The index of the last block in the heap file, which new blocks are linked after.
+	int32_t LastBlockIndex;
+
+	// The first block of the list of blocks with a free record slot. Inserts fill the blocks of the list before adding new ones.
+	int32_t FirstBlockWithSpaceIndex;
+
+	// Whether the record index file next to the heap file matches it. It's set when a file opened with HP_OpenFileWithSavedIndex is
+	// closed, and cleared whenever the file is opened, so that a file that was not closed cleanly rebuilds it's record index.
+	bool HasSavedRecordIndex;
 } FileHeader;
 
+// The offset of the free block list in the heap file header block.
+#define FREE_BLOCK_LIST_OFFSET offsetof(FileHeader, FreeBlocks)
+
 // The memory layout of a heap file block. This structure is stored in all heap file blocks except of the first one.
 typedef struct BlockHeader
 {
 	// The number of records in the current block.
 	uint8_t RecordCount;
 
+	// The number of record slots in use, deleted ones included. A deleted record keeps it's slot, marked in the tombstone bitmap at the
+	// end of the block, so that the other records of the block never move.
+	uint8_t SlotCount;
+
 	// The index of the next block in the heap file.
 	int32_t NextBlockIndex;
+
+	// The index of the previous block in the heap file, or of the header block for the first one.
+	int32_t PreviousBlockIndex;
+
+	// The previous and next blocks in the list of blocks with a free record slot. A block is in the list exactly when it's not full.
+	int32_t PreviousBlockWithSpaceIndex;
+	int32_t NextBlockWithSpaceIndex;
 } BlockHeader;
 
-// Calculate at compile time the maximum number of records in a heap block.
-#define MAX_RECORD_COUNT_PER_BLOCK ((BLOCK_SIZE - sizeof(BlockHeader)) / sizeof(Record))
+// Calculate the maximum number of records in a heap block for a given block size. Every record slot also needs a bit of the tombstone
+// bitmap at the end of the block.
+#define MAX_RECORD_COUNT_PER_BLOCK(blockSize) ((((blockSize) - sizeof(BlockHeader)) * 8) / (sizeof(Record) * 8 + 1))
+
+// The number of blocks a scan of a heap file reads ahead. Heap blocks are allocated in order, so the blocks that follow
+// the current one are the next ones in the chain.
+#define READAHEAD_BLOCK_COUNT 64
+
+// The state of a scan of a heap file, opened by HP_ScanOpen.
+struct HP_Cursor
+{
+	// The open heap file, whose lock the cursor holds shared until it's closed.
+	OpenFile* File;
+
+	// The block size of the heap file, which locates the tombstones of the blocks.
+	int32_t BlockSize;
+
+	// The block whose records are returned, pinned until the cursor moves past it, or INVALID_BLOCK_INDEX if the scan is over.
+	int32_t BlockIndex;
+	uint8_t* BlockPtr;
+
+	// The next slot of the block to read, and the slot after the last one to read.
+	uint32_t SlotIndex;
+	uint32_t EndSlotIndex;
+
+	// Whether the cursor returns a single record found in the record index, so it doesn't move to the next block.
+	bool IsKeyLookup;
+
+	// The first block that has not been read ahead yet.
+	int32_t ReadaheadBlockIndex;
+};
 
-// Storage for the currently open heap file handle.
-static HP_info s_HandleStorage = -1;
+// The open heap files.
+static OpenFileTable s_OpenFiles = OPEN_FILE_TABLE_INITIALIZER;
 
 int32_t HP_CreateFile(char* fileName, char attributeType, char* attributeName, int32_t attributeLength)
+{
+	return HP_CreateFileWithBlockSize(fileName, attributeType, attributeName, attributeLength, BF_DEFAULT_BLOCK_SIZE);
+}
+
+int32_t HP_CreateFileWithBlockSize(char* fileName, char attributeType, char* attributeName, int32_t attributeLength, int32_t blockSize)
 {
 	// Initialize the block level.
 	BF_Init();
 
 	// Create the block level file.
-	if (BF_CreateFile(fileName) < 0)
+	if (BF_CreateFileWithBlockSize(fileName, blockSize) < 0)
 	{
 		printf("Could not create block level file for the heap file! FileName: %s\n", fileName);
 		BF_PrintError("");
@@ -84,6 +146,9 @@ int32_t HP_CreateFile(char* fileName, char attributeType, char* attributeName, i
 	FileHeader header = { };
 	header.CommonHeader.Type = HeapFile;
 	header.NextBlockIndex = INVALID_BLOCK_INDEX;
+	header.FreeBlocks.FirstBlockIndex = INVALID_BLOCK_INDEX;
+	header.LastBlockIndex = INVALID_BLOCK_INDEX;
+	header.FirstBlockWithSpaceIndex = INVALID_BLOCK_INDEX;
 
 	// Copy the file header into the heap file header block.
 	memcpy(headerBlockPtr, &header, sizeof(FileHeader));
@@ -109,77 +174,19 @@ int32_t HP_CreateFile(char* fileName, char attributeType, char* attributeName, i
 	return 0;
 }
 
-HP_info* HP_OpenFile(char* fileName)
-{
-	// Ensure that there are no files currently open.
-	if (s_HandleStorage != -1)
-	{
-		printf("Cannot open heap file since there's another file open!\n");
-		return nullptr;
-	}
-
-	// Open the block level file.
-	HP_info fileHandle = BF_OpenFile(fileName);
-	if (fileHandle < 0)
-	{
-		printf("Could not open block level file for the heap file! FileName: %s\n", fileName);
-		BF_PrintError("");
-
-		return nullptr;
-	}
-
-	// Retrieve a pointer to the heap file header block.
-	uint8_t* headerBlockPtr = nullptr;
-	if (BF_ReadBlock(fileHandle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
-	{
-		printf("Could not retrieve pointer to heap file header block! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
-		BF_PrintError("");
-
-		return nullptr;
-	}
-
-	// Since this file exists, we know there's a CommonFileHeader in the first bytes of the header block. So we treat the pointer as such.
-	CommonFileHeader* commonFileHeader = (CommonFileHeader*)headerBlockPtr;
-
-	// Ensure that the file we open is a indeed heap file.
-	if (commonFileHeader->Type != HeapFile)
-	{
-		printf("File specified is not a heap file! FileName: %s\n", fileName);
-		return nullptr;
-	}
-
-	// Store the handle in a global variable so that we can return a pointer to it.
-	s_HandleStorage = fileHandle;
-
-	return &s_HandleStorage;
-}
-
-int32_t HP_CloseFile(HP_info* handle)
+// Fills an empty record index with the locations of all the records of a heap file. Returns 0 on success and -1 on failure.
+static int32_t BuildRecordIndex(HP_info handle, RecordIndex* records)
 {
-	// Ensure that the file we want to close is actually open.
-	if (s_HandleStorage != *handle)
-	{
-		printf("Cannot close heap file since it's not open!\n");
-		return -1;
-	}
-
-	// Close the block level file.
-	if (BF_CloseFile(*handle) < 0)
+	// Retrieve the block size of the heap file, which locates the tombstones of the blocks.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
 	{
-		printf("Could not close block level file! FileHandle: %d\n", *handle);
+		printf("Could not retrieve block size for the heap file! FileHandle: %d\n", handle);
 		BF_PrintError("");
 
 		return -1;
 	}
 
-	// Reset the internal storage.
-	s_HandleStorage = -1;
-
-	return 0;
-}
-
-int32_t HP_InsertEntry(HP_info handle, Record record)
-{
 	// Retrieve a pointer to the heap file header block.
 	uint8_t* headerBlockPtr = nullptr;
 	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
@@ -190,17 +197,24 @@ int32_t HP_InsertEntry(HP_info handle, Record record)
 		return -1;
 	}
 
-	// Since this file exists, we know there's a FileHeader in the first bytes of the header block. So we treat the pointer as such.
-	FileHeader* fileHeader = (FileHeader*)headerBlockPtr;
-
-	// First we need to look for the record and make sure it's not already in the heap file.
-
 	// Start from the first actual block.
-	int32_t currentBlockIndex = fileHeader->NextBlockIndex;
+	int32_t currentBlockIndex = ((FileHeader*)headerBlockPtr)->NextBlockIndex;
+
+	// The first block that has not been read ahead yet.
+	int32_t readaheadBlockIndex = 0;
 
 	// Loop until the end of the allocated blocks.
 	while (currentBlockIndex != INVALID_BLOCK_INDEX)
 	{
+		// Read the blocks ahead, like a scan does.
+		if (currentBlockIndex + READAHEAD_BLOCK_COUNT / 2 >= readaheadBlockIndex)
+		{
+			int32_t firstBlockIndex = (currentBlockIndex > readaheadBlockIndex) ? currentBlockIndex : readaheadBlockIndex;
+			readaheadBlockIndex = currentBlockIndex + READAHEAD_BLOCK_COUNT;
+
+			BF_Prefetch(handle, firstBlockIndex, readaheadBlockIndex - firstBlockIndex);
+		}
+
 		// Retrieve a pointer to the current heap file block.
 		uint8_t* currentBlockPtr = nullptr;
 		if (BF_ReadBlock(handle, currentBlockIndex, (void**)&currentBlockPtr) < 0)
@@ -211,190 +225,291 @@ int32_t HP_InsertEntry(HP_info handle, Record record)
 			return -1;
 		}
 
-		// Since this file exists, we know there's a BlockHeader in the first bytes of the block. So we treat the pointer as such.
 		BlockHeader* currentBlockHeader = (BlockHeader*)currentBlockPtr;
+		Record* currentRecords = (Record*)(currentBlockPtr + sizeof(BlockHeader));
 
-		// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
-		currentBlockPtr += sizeof(BlockHeader);
-
-		// Interate through all the record slots that are occupied in the current block.
-		for (uint32_t recordIndex = 0; recordIndex < currentBlockHeader->RecordCount; recordIndex++)
+		// Add the location of every record that is not deleted.
+		for (uint32_t recordIndex = 0; recordIndex < currentBlockHeader->SlotCount; recordIndex++)
 		{
-			// Treat the current pointer as a record.
-			Record* currentRecord = (Record*)currentBlockPtr;
-
-			// If the current record's key is the same as the one we want to insert, it's already in the heap so we exit.
-			if (currentRecord->ID == record.ID)
-			{
-				printf("The specified record is already in the heap file! RecordID: %d\n", record.ID);
+			if (!IS_SLOT_DELETED(currentBlockPtr, blockSize, recordIndex) &&
+				AddRecordIndexEntry(records, currentRecords[recordIndex].ID, currentBlockIndex, recordIndex) == -1)
 				return -1;
-			}
-
-			// Offset the block poiter by the size of a record so it pointes to the first byte of the next record slot.
-			currentBlockPtr += sizeof(Record);
 		}
 
 		// Update the current block index.
 		currentBlockIndex = currentBlockHeader->NextBlockIndex;
 	}
 
-	// Reset the current block index and prepare for insertion.
-	currentBlockIndex = fileHeader->NextBlockIndex;
+	return 0;
+}
+
+// Opens a heap file and builds it's record index. If saveRecordIndex is set, the record index is loaded from the file it was saved to
+// instead, when the heap file was closed cleanly, and saved there again on close. Returns a pointer to the file handle on success and
+// nullptr on failure.
+static HP_info* OpenHeapFile(char* fileName, bool saveRecordIndex)
+{
+	// Open the block level file.
+	HP_info fileHandle = OpenLoggedFile(fileName);
+	if (fileHandle < 0)
+	{
+		printf("Could not open block level file for the heap file! FileName: %s\n", fileName);
+		BF_PrintError("");
+
+		return nullptr;
+	}
+
+	// Retrieve a pointer to the heap file header block.
+	uint8_t* headerBlockPtr = nullptr;
+	if (BF_ReadBlock(fileHandle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to heap file header block! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
+
+		return nullptr;
+	}
 
-	// The previous block is the header block initially.
-	int32_t previousBlockIndex = HEADER_BLOCK_INDEX;
+	// Since this file exists, we know there's a CommonFileHeader in the first bytes of the header block. So we treat the pointer as such.
+	CommonFileHeader* commonFileHeader = (CommonFileHeader*)headerBlockPtr;
 
-	// Loop until the end of the allocated blocks.
-	while (currentBlockIndex != INVALID_BLOCK_INDEX)
+	// Ensure that the file we open is a indeed heap file.
+	if (commonFileHeader->Type != HeapFile)
 	{
-		// Retrieve a pointer to the current heap file block.
-		uint8_t* currentBlockPtr = nullptr;
-		if (BF_ReadBlock(handle, currentBlockIndex, (void**)&currentBlockPtr) < 0)
+		printf("File specified is not a heap file! FileName: %s\n", fileName);
+		return nullptr;
+	}
+
+	// A saved record index only matches the file until it changes, so it's marked as stale before the file is used. The change is
+	// committed along with the first change to the records.
+	FileHeader* fileHeader = (FileHeader*)headerBlockPtr;
+	bool hasSavedRecordIndex = fileHeader->HasSavedRecordIndex;
+	if (hasSavedRecordIndex)
+	{
+		fileHeader->HasSavedRecordIndex = false;
+		if (BF_WriteBlock(fileHandle, HEADER_BLOCK_INDEX) < 0)
 		{
-			printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, currentBlockIndex);
+			printf("Could not write heap file header block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
 			BF_PrintError("");
+			BF_CloseFile(fileHandle);
 
-			return -1;
+			return nullptr;
 		}
+	}
 
-		// Since this file exists, we know there's a BlockHeader in the first bytes of the block. So we treat the pointer as such.
-		BlockHeader* currentBlockHeader = (BlockHeader*)currentBlockPtr;
-
-		// If there's space in the current block, we insert here.
-		if (currentBlockHeader->RecordCount < MAX_RECORD_COUNT_PER_BLOCK)
+	// The name of the file the record index is saved to.
+	char* recordIndexFileName = nullptr;
+	if (saveRecordIndex)
+	{
+		recordIndexFileName = (char*)malloc(strlen(fileName) + sizeof(".idx"));
+		if (recordIndexFileName == nullptr)
 		{
-			// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
-			currentBlockPtr += sizeof(BlockHeader);
+			printf("Could not allocate the name of the record index file! FileName: %s\n", fileName);
+			BF_CloseFile(fileHandle);
 
-			// Offset the block pointer by the size of the record times the number of records so it points to the first byte
-			// of the first empty record slot.
-			currentBlockPtr += currentBlockHeader->RecordCount * sizeof(Record);
+			return nullptr;
+		}
 
-			// Copy the record into the block.
-			memcpy(currentBlockPtr, &record, sizeof(Record));
+		sprintf(recordIndexFileName, "%s.idx", fileName);
+	}
 
-			// Increment the current block's record count.
-			currentBlockHeader->RecordCount++;
+	// Load the saved record index if it matches the file, otherwise build it from the records.
+	RecordIndex records = { };
+	if (!(hasSavedRecordIndex && saveRecordIndex && LoadRecordIndex(&records, recordIndexFileName) == 0) &&
+		BuildRecordIndex(fileHandle, &records) == -1)
+	{
+		printf("Could not build the record index of the heap file! FileName: %s\n", fileName);
+		DestroyRecordIndex(&records);
+		free(recordIndexFileName);
+		BF_CloseFile(fileHandle);
 
-			// Write the updated contents of the current heap file block to the disk.
-			if (BF_WriteBlock(handle, currentBlockIndex) < 0)
-			{
-				printf("Could not write heap file block to disk! FileHandle: %d, BlockIndex: %d\n", handle, currentBlockIndex);
-				BF_PrintError("");
+		return nullptr;
+	}
 
-				return -1;
-			}
+	// Add the file to the open files table, which stores the handle so that we can return a pointer to it.
+	OpenFile* file = AddOpenFile(&s_OpenFiles, fileHandle);
+	if (file == nullptr)
+	{
+		printf("Cannot open heap file since there are too many files open! FileName: %s\n", fileName);
+		DestroyRecordIndex(&records);
+		free(recordIndexFileName);
+		BF_CloseFile(fileHandle);
+		return nullptr;
+	}
 
-			// Return the current block's index.
-			return currentBlockIndex;
-		}
+	file->Records = records;
+	file->RecordIndexFileName = recordIndexFileName;
 
-		// Update the previous and current block indices.
-		previousBlockIndex = currentBlockIndex;
-		currentBlockIndex = currentBlockHeader->NextBlockIndex;
-	}
+	return &file->Handle;
+}
+
+HP_info* HP_OpenFile(char* fileName)
+{
+	return OpenHeapFile(fileName, false);
+}
+
+HP_info* HP_OpenFileWithSavedIndex(char* fileName)
+{
+	return OpenHeapFile(fileName, true);
+}
 
-	// If we are here, a new block needs to be created. Either because this is the first entry in the heap file or because we ran
-	// out of space in all of the currently allocated blocks.
+// Saves the record index of an open heap file, then marks it as matching the file in the header. Returns 0 on success and -1 on failure.
+static int32_t MarkSavedRecordIndex(HP_info handle, OpenFile* file)
+{
+	// The index is written before the header marks it, so that a crash in between only leaves it stale.
+	if (SaveRecordIndex(&file->Records, file->RecordIndexFileName) == -1)
+		return -1;
 
-	// Allocate a new block.
-	if (BF_AllocateBlock(handle) < 0)
+	// Retrieve a pointer to the heap file header block.
+	uint8_t* headerBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
 	{
-		printf("Could not allocate block for the heap file! FileHandle: %d\n", handle);
+		printf("Could not retrieve pointer to heap file header block! FileHandle: %d, BlockIndex: %d\n", handle, HEADER_BLOCK_INDEX);
 		BF_PrintError("");
 
 		return -1;
 	}
 
-	// Get the new block count.
-	int32_t blockCount = BF_GetBlockCounter(handle);
-	if (blockCount < 0)
+	((FileHeader*)headerBlockPtr)->HasSavedRecordIndex = true;
+
+	// Write the contents of the heap file header block to the disk.
+	if (BF_WriteBlock(handle, HEADER_BLOCK_INDEX) < 0)
 	{
-		printf("Could not retrieve block count for the heap file! FileHandle: %d\n", handle);
+		printf("Could not write heap file header block to disk! FileHandle: %d, BlockIndex: %d\n", handle, HEADER_BLOCK_INDEX);
 		BF_PrintError("");
 
 		return -1;
 	}
 
-	// Calculate the new block index.
-	int32_t newBlockIndex = blockCount - 1;
+	return 0;
+}
 
-	// Retrieve a pointer to the new heap file block.
-	uint8_t* newBlockPtr = nullptr;
-	if (BF_ReadBlock(handle, newBlockIndex, (void**)&newBlockPtr) < 0)
+// Closes a heap file, giving the free blocks at the end of it back to the file system first if truncateFreeBlocks is set.
+// Returns 0 on success and -1 on failure.
+static int32_t CloseFile(HP_info* handle, bool truncateFreeBlocks)
+{
+	// Ensure that the file we want to close is actually open.
+	OpenFile* file = AcquireOpenFile(&s_OpenFiles, *handle, true);
+	if (file == nullptr)
 	{
-		printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, newBlockIndex);
+		printf("Cannot close heap file since it's not open!\n");
+		return -1;
+	}
+
+	// A failed truncation keeps the rest of the free blocks in the list, so the file is still closed.
+	int32_t fileHandle = file->Handle;
+	int32_t result = 0;
+	if (truncateFreeBlocks && TruncateFreeBlocks(fileHandle, FREE_BLOCK_LIST_OFFSET) == -1)
+	{
+		printf("Could not give back the free blocks of the heap file! FileHandle: %d\n", fileHandle);
+		result = -1;
+	}
+
+	// Save the record index and mark it as matching the file. If this fails the next open rebuilds it, so the file is still closed.
+	if (file->RecordIndexFileName != nullptr && MarkSavedRecordIndex(fileHandle, file) == -1)
+	{
+		printf("Could not save the record index of the heap file! FileName: %s\n", file->RecordIndexFileName);
+		result = -1;
+	}
+
+	// The record index is not needed anymore.
+	DestroyRecordIndex(&file->Records);
+	free(file->RecordIndexFileName);
+	file->RecordIndexFileName = nullptr;
+
+	// Close the block level file.
+	if (BF_CloseFile(fileHandle) < 0)
+	{
+		printf("Could not close block level file! FileHandle: %d\n", fileHandle);
 		BF_PrintError("");
+		ReleaseOpenFile(file);
 
 		return -1;
 	}
 
-	// Create the block header and fill it's data.
-	BlockHeader newBlockHeader = { };
-	newBlockHeader.RecordCount = 1;
-	newBlockHeader.NextBlockIndex = INVALID_BLOCK_INDEX;
+	// Remove the file from the table.
+	RemoveOpenFile(&s_OpenFiles, file);
 
-	// Copy the new block header into the new block.
-	memcpy(newBlockPtr, &newBlockHeader, sizeof(BlockHeader));
+	return result;
+}
 
-	// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
-	newBlockPtr += sizeof(BlockHeader);
+int32_t HP_CloseFile(HP_info* handle)
+{
+	return CloseFile(handle, false);
+}
 
-	// Copy the record into the block.
-	memcpy(newBlockPtr, &record, sizeof(Record));
+int32_t HP_CloseFileWithTruncation(HP_info* handle)
+{
+	return CloseFile(handle, true);
+}
 
-	// Write the contents of the new heap file block to the disk.
-	if (BF_WriteBlock(handle, newBlockIndex) < 0)
+// Stores the index of the last block in the heap file header. Returns 0 on success and -1 on failure.
+static int32_t SetLastBlock(HP_info handle, int32_t lastBlockIndex)
+{
+	// Retrieve a pointer to the heap file header block.
+	uint8_t* headerBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
 	{
-		printf("Could not write heap file block to disk! FileHandle: %d, BlockIndex: %d\n", handle, newBlockIndex);
+		printf("Could not retrieve pointer to heap file header block! FileHandle: %d, BlockIndex: %d\n", handle, HEADER_BLOCK_INDEX);
 		BF_PrintError("");
 
 		return -1;
 	}
 
-	// Now we need to update the previous block's NextBlockIndex.
+	// Update the last block index.
+	((FileHeader*)headerBlockPtr)->LastBlockIndex = lastBlockIndex;
 
-	// Retrieve a pointer to the previous heap file block.
-	uint8_t* previousBlockPtr = nullptr;
-	if (BF_ReadBlock(handle, previousBlockIndex, (void**)&previousBlockPtr) < 0)
+	// Write the contents of the heap file header block to the disk.
+	if (BF_WriteBlock(handle, HEADER_BLOCK_INDEX) < 0)
 	{
-		printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, previousBlockIndex);
+		printf("Could not write heap file header block to disk! FileHandle: %d, BlockIndex: %d\n", handle, HEADER_BLOCK_INDEX);
 		BF_PrintError("");
 
 		return -1;
 	}
 
-	// The head has a different header structure so we treat it differently.
-	if (previousBlockIndex == HEADER_BLOCK_INDEX)
+	return 0;
+}
+
+// Sets a link of the list of blocks with space. If blockIndex is invalid the first block of the list, stored in the header block, is set,
+// otherwise the previous or next block of the list stored in the header of the block. Returns 0 on success and -1 on failure.
+static int32_t SetBlockWithSpaceLink(HP_info handle, int32_t blockIndex, bool isNext, int32_t linkedBlockIndex)
+{
+	// The first block of the list is stored in the heap file header.
+	int32_t storingBlockIndex = (blockIndex != INVALID_BLOCK_INDEX) ? blockIndex : HEADER_BLOCK_INDEX;
+
+	// Retrieve a pointer to the block that stores the link.
+	uint8_t* blockPtr = nullptr;
+	if (BF_ReadBlock(handle, storingBlockIndex, (void**)&blockPtr) < 0)
 	{
-		FileHeader* previousBlockHeader = (FileHeader*)previousBlockPtr;
-		previousBlockHeader->NextBlockIndex = newBlockIndex;
+		printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, storingBlockIndex);
+		BF_PrintError("");
+
+		return -1;
 	}
+
+	// The head has a different header structure so we treat it differently.
+	if (storingBlockIndex == HEADER_BLOCK_INDEX)
+		((FileHeader*)blockPtr)->FirstBlockWithSpaceIndex = linkedBlockIndex;
+	else if (isNext)
+		((BlockHeader*)blockPtr)->NextBlockWithSpaceIndex = linkedBlockIndex;
 	else
-	{
-		BlockHeader* previousBlockHeader = (BlockHeader*)previousBlockPtr;
-		previousBlockHeader->NextBlockIndex = newBlockIndex;
-	}
+		((BlockHeader*)blockPtr)->PreviousBlockWithSpaceIndex = linkedBlockIndex;
 
-	// Write the contents of the previous heap file block to the disk.
-	if (BF_WriteBlock(handle, previousBlockIndex) < 0)
+	// Write the contents of the block to the disk.
+	if (BF_WriteBlock(handle, storingBlockIndex) < 0)
 	{
-		printf("Could not write heap file block to disk! FileHandle: %d, BlockIndex: %d\n", handle, previousBlockIndex);
+		printf("Could not write heap file block to disk! FileHandle: %d, BlockIndex: %d\n", handle, storingBlockIndex);
 		BF_PrintError("");
 
 		return -1;
 	}
 
-	// Return the index of the new block.
-	return newBlockIndex;
+	return 0;
 }
 
-int32_t HP_DeleteEntry(HP_info handle, void* keyValue)
+// Adds a block that has a free record slot to the front of the list of blocks with space. Returns 0 on success and -1 on failure.
+static int32_t PushBlockWithSpace(HP_info handle, int32_t blockIndex)
 {
-	// Extract the key from the key value pointer.
-	int32_t key = *(int32_t*)keyValue;
-
-	// Retrieve a pointer to the heap file header block.
+	// Retrieve a pointer to the heap file header block, to find the current first block of the list.
 	uint8_t* headerBlockPtr = nullptr;
 	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
 	{
@@ -404,89 +519,794 @@ int32_t HP_DeleteEntry(HP_info handle, void* keyValue)
 		return -1;
 	}
 
-	// Since this file exists, we know there's a FileHeader in the first bytes of the header block. So we treat the pointer as such.
-	FileHeader* fileHeader = (FileHeader*)headerBlockPtr;
+	int32_t firstBlockIndex = ((FileHeader*)headerBlockPtr)->FirstBlockWithSpaceIndex;
 
-	// Start from the first actual block.
-	int32_t currentBlockIndex = fileHeader->NextBlockIndex;
+	// Link the block in front of the first one.
+	if (SetBlockWithSpaceLink(handle, blockIndex, false, INVALID_BLOCK_INDEX) == -1 ||
+		SetBlockWithSpaceLink(handle, blockIndex, true, firstBlockIndex) == -1 ||
+		SetBlockWithSpaceLink(handle, INVALID_BLOCK_INDEX, true, blockIndex) == -1)
+		return -1;
 
-	// Loop until the end of the allocated blocks.
-	while (currentBlockIndex != INVALID_BLOCK_INDEX)
-	{
-		// Retrieve a pointer to the current heap file block.
-		uint8_t* currentBlockPtr = nullptr;
-		if (BF_ReadBlock(handle, currentBlockIndex, (void**)&currentBlockPtr) < 0)
+	if (firstBlockIndex != INVALID_BLOCK_INDEX && SetBlockWithSpaceLink(handle, firstBlockIndex, false, blockIndex) == -1)
+		return -1;
+
+	return 0;
+}
+
+// Removes a block that filled up or is about to be freed from the list of blocks with space. Returns 0 on success and -1 on failure.
+static int32_t RemoveBlockWithSpace(HP_info handle, int32_t blockIndex)
+{
+	// Retrieve a pointer to the heap file block, to find it's neighbours in the list.
+	uint8_t* blockPtr = nullptr;
+	if (BF_ReadBlock(handle, blockIndex, (void**)&blockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, blockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	BlockHeader* blockHeader = (BlockHeader*)blockPtr;
+	int32_t previousBlockIndex = blockHeader->PreviousBlockWithSpaceIndex;
+	int32_t nextBlockIndex = blockHeader->NextBlockWithSpaceIndex;
+
+	// Link the neighbours of the block to each other, and clear the links of the block.
+	if (SetBlockWithSpaceLink(handle, previousBlockIndex, true, nextBlockIndex) == -1)
+		return -1;
+
+	if (nextBlockIndex != INVALID_BLOCK_INDEX && SetBlockWithSpaceLink(handle, nextBlockIndex, false, previousBlockIndex) == -1)
+		return -1;
+
+	if (SetBlockWithSpaceLink(handle, blockIndex, false, INVALID_BLOCK_INDEX) == -1 ||
+		SetBlockWithSpaceLink(handle, blockIndex, true, INVALID_BLOCK_INDEX) == -1)
+		return -1;
+
+	return 0;
+}
+
+static int32_t InsertEntry(OpenFile* file, Record record)
+{
+	// The block level handle of the file.
+	HP_info handle = file->Handle;
+
+	// Retrieve the block size of the heap file.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the heap file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// The record index tells us whether the record is already in the heap file, without reading any blocks.
+	if (FindRecordIndexEntry(&file->Records, record.ID) != nullptr)
+	{
+		printf("The specified record is already in the heap file! RecordID: %d\n", record.ID);
+		return -1;
+	}
+
+	// Make room for the record in the index before the blocks change, so that adding it can't fail afterwards.
+	if (ReserveRecordIndexEntries(&file->Records, 1) == -1)
+		return -1;
+
+	// Retrieve a pointer to the heap file header block.
+	uint8_t* headerBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to heap file header block! FileHandle: %d, BlockIndex: %d\n", handle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Since this file exists, we know there's a FileHeader in the first bytes of the header block. So we treat the pointer as such.
+	FileHeader* fileHeader = (FileHeader*)headerBlockPtr;
+	int32_t blockWithSpaceIndex = fileHeader->FirstBlockWithSpaceIndex;
+	int32_t lastBlockIndex = fileHeader->LastBlockIndex;
+
+	// If a block has a free record slot, we insert there.
+	if (blockWithSpaceIndex != INVALID_BLOCK_INDEX)
+	{
+		// Retrieve a pointer to the heap file block.
+		uint8_t* blockPtr = nullptr;
+		if (BF_ReadBlock(handle, blockWithSpaceIndex, (void**)&blockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, blockWithSpaceIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// Copy the record into a free slot of the block, which also increments the block's record count.
+		BlockHeader* blockHeader = (BlockHeader*)blockPtr;
+		Record* slot = AddRecordSlot(blockPtr, blockSize, sizeof(BlockHeader), &blockHeader->RecordCount, &blockHeader->SlotCount);
+		memcpy(slot, &record, sizeof(Record));
+
+		// Remember where the record is.
+		uint32_t slotIndex = (uint32_t)(slot - (Record*)(blockPtr + sizeof(BlockHeader)));
+		AddRecordIndexEntry(&file->Records, record.ID, blockWithSpaceIndex, slotIndex);
+
+		bool isFull = blockHeader->RecordCount == MAX_RECORD_COUNT_PER_BLOCK(blockSize);
+
+		// Write the updated contents of the heap file block to the disk.
+		if (BF_WriteBlock(handle, blockWithSpaceIndex) < 0)
+		{
+			printf("Could not write heap file block to disk! FileHandle: %d, BlockIndex: %d\n", handle, blockWithSpaceIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// A block that filled up leaves the list of blocks with space.
+		if (isFull && RemoveBlockWithSpace(handle, blockWithSpaceIndex) == -1)
+			return -1;
+
+		// Return the block's index.
+		return blockWithSpaceIndex;
+	}
+
+	// If we are here, a new block needs to be created. Either because this is the first entry in the heap file or because all of the
+	// currently allocated blocks are full.
+
+	// Allocate a new block, reusing a free one if there is any.
+	uint32_t allocatedBlockCount = 0;
+	int32_t newBlockIndex = AllocateChainBlocks(handle, FREE_BLOCK_LIST_OFFSET, 1, &allocatedBlockCount);
+	if (newBlockIndex == -1)
+		return -1;
+
+	// Retrieve a pointer to the new heap file block.
+	uint8_t* newBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, newBlockIndex, (void**)&newBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, newBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Create the block header and fill it's data.
+	BlockHeader newBlockHeader = { };
+	newBlockHeader.RecordCount = 1;
+	newBlockHeader.SlotCount = 1;
+	newBlockHeader.NextBlockIndex = INVALID_BLOCK_INDEX;
+	newBlockHeader.PreviousBlockIndex = (lastBlockIndex != INVALID_BLOCK_INDEX) ? lastBlockIndex : HEADER_BLOCK_INDEX;
+	newBlockHeader.PreviousBlockWithSpaceIndex = INVALID_BLOCK_INDEX;
+	newBlockHeader.NextBlockWithSpaceIndex = INVALID_BLOCK_INDEX;
+
+	// Copy the new block header into the new block.
+	memcpy(newBlockPtr, &newBlockHeader, sizeof(BlockHeader));
+
+	// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
+	newBlockPtr += sizeof(BlockHeader);
+
+	// Copy the record into the first slot of the block, and remember where it is.
+	memcpy(newBlockPtr, &record, sizeof(Record));
+	AddRecordIndexEntry(&file->Records, record.ID, newBlockIndex, 0);
+
+	// Write the contents of the new heap file block to the disk.
+	if (BF_WriteBlock(handle, newBlockIndex) < 0)
+	{
+		printf("Could not write heap file block to disk! FileHandle: %d, BlockIndex: %d\n", handle, newBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Now we need to link the new block after the last block, or after the header block if the heap file has no blocks.
+	int32_t previousBlockIndex = newBlockHeader.PreviousBlockIndex;
+
+	// Retrieve a pointer to the previous heap file block.
+	uint8_t* previousBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, previousBlockIndex, (void**)&previousBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, previousBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// The head has a different header structure so we treat it differently.
+	if (previousBlockIndex == HEADER_BLOCK_INDEX)
+	{
+		FileHeader* previousBlockHeader = (FileHeader*)previousBlockPtr;
+		previousBlockHeader->NextBlockIndex = newBlockIndex;
+	}
+	else
+	{
+		BlockHeader* previousBlockHeader = (BlockHeader*)previousBlockPtr;
+		previousBlockHeader->NextBlockIndex = newBlockIndex;
+	}
+
+	// Write the contents of the previous heap file block to the disk.
+	if (BF_WriteBlock(handle, previousBlockIndex) < 0)
+	{
+		printf("Could not write heap file block to disk! FileHandle: %d, BlockIndex: %d\n", handle, previousBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// The new block is the last one now.
+	if (SetLastBlock(handle, newBlockIndex) == -1)
+		return -1;
+
+	// The rest of it's record slots are free, so it joins the list of blocks with space.
+	if (MAX_RECORD_COUNT_PER_BLOCK(blockSize) > 1 && PushBlockWithSpace(handle, newBlockIndex) == -1)
+		return -1;
+
+	// Return the index of the new block.
+	return newBlockIndex;
+}
+
+int32_t HP_InsertEntry(HP_info handle, Record record)
+{
+	// Ensure that the file is open.
+	OpenFile* file = AcquireOpenFile(&s_OpenFiles, handle, true);
+	if (file == nullptr)
+	{
+		printf("Cannot insert to heap file since it's not open! FileHandle: %d\n", handle);
+		return -1;
+	}
+
+	// Perform the operation while holding the lock of the file, so that it doesn't interleave with other operations on it.
+	int32_t result = InsertEntry(file, record);
+
+	// Commit the changes, even those of a failed operation, so that their blocks can be written back.
+	if (CommitOpenFile(file) == -1)
+		result = -1;
+
+	return result;
+}
+
+// The records of an append are marked in the record index with this block index until they are stored in a block. No record is ever
+// stored in the header block.
+#define UNPLACED_RECORD_BLOCK_INDEX HEADER_BLOCK_INDEX
+
+// The new blocks of an append are committed in chunks of at most this fraction of the frames of the buffer pool.
+#define APPEND_CHUNK_POOL_SHARE 4
+
+// Finds the next record of an append that is still unplaced, starting from the one recordIndex points to, and advances recordIndex past
+// it. Returns it's entry in the record index.
+static RecordIndexEntry* NextUnplacedRecord(OpenFile* file, const Record* records, size_t recordCount, size_t* recordIndex)
+{
+	while (*recordIndex < recordCount)
+	{
+		RecordIndexEntry* entry = FindRecordIndexEntry(&file->Records, records[(*recordIndex)++].ID);
+
+		// A record whose ID was already placed, earlier in the append or before it, is a duplicate.
+		if (entry->BlockIndex == UNPLACED_RECORD_BLOCK_INDEX)
+			return entry;
+	}
+
+	return nullptr;
+}
+
+// Fills newBlockCount blocks allocated consecutively from firstNewBlockIndex with the next chunkRecordCount unplaced records of an append,
+// writing each block once, and links them after the block previousBlockIndex, which may be the header block. Returns 0 on success and
+// -1 on failure.
+static int32_t StoreAppendedBlocks(OpenFile* file, const Record* records, size_t recordCount, size_t* nextRecordIndex, uint32_t chunkRecordCount,
+	int32_t blockSize, int32_t previousBlockIndex, int32_t firstNewBlockIndex, uint32_t newBlockCount)
+{
+	// The block level handle of the file.
+	HP_info handle = file->Handle;
+
+	uint32_t maxRecordCount = MAX_RECORD_COUNT_PER_BLOCK(blockSize);
+	uint32_t placedCount = 0;
+
+	// Fill each new block in memory and write it once. The blocks are chained in order after the previous block.
+	for (uint32_t blockNumber = 0; blockNumber < newBlockCount; blockNumber++)
+	{
+		int32_t newBlockIndex = firstNewBlockIndex + (int32_t)blockNumber;
+
+		// Retrieve a pointer to the new heap file block.
+		uint8_t* newBlockPtr = nullptr;
+		if (BF_ReadBlock(handle, newBlockIndex, (void**)&newBlockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, newBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// Copy as many records as fit into the consecutive slots of the block, and remember where they are.
+		Record* slots = (Record*)(newBlockPtr + sizeof(BlockHeader));
+		uint32_t slotCount = 0;
+		while (slotCount < maxRecordCount && placedCount < chunkRecordCount)
+		{
+			RecordIndexEntry* entry = NextUnplacedRecord(file, records, recordCount, nextRecordIndex);
+			memcpy(&slots[slotCount], &records[*nextRecordIndex - 1], sizeof(Record));
+
+			entry->BlockIndex = newBlockIndex;
+			entry->SlotIndex = slotCount++;
+			placedCount++;
+		}
+
+		// Create the block header and fill it's data.
+		BlockHeader newBlockHeader = { };
+		newBlockHeader.RecordCount = (uint8_t)slotCount;
+		newBlockHeader.SlotCount = (uint8_t)slotCount;
+		newBlockHeader.NextBlockIndex = (blockNumber + 1 < newBlockCount) ? newBlockIndex + 1 : INVALID_BLOCK_INDEX;
+		newBlockHeader.PreviousBlockIndex = (blockNumber > 0) ? newBlockIndex - 1 : previousBlockIndex;
+		newBlockHeader.PreviousBlockWithSpaceIndex = INVALID_BLOCK_INDEX;
+		newBlockHeader.NextBlockWithSpaceIndex = INVALID_BLOCK_INDEX;
+
+		// Copy the new block header into the new block.
+		memcpy(newBlockPtr, &newBlockHeader, sizeof(BlockHeader));
+
+		// Write the contents of the new heap file block to the disk.
+		if (BF_WriteBlock(handle, newBlockIndex) < 0)
+		{
+			printf("Could not write heap file block to disk! FileHandle: %d, BlockIndex: %d\n", handle, newBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+	}
+
+	// Retrieve a pointer to the previous heap file block.
+	uint8_t* previousBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, previousBlockIndex, (void**)&previousBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, previousBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// The head has a different header structure so we treat it differently.
+	if (previousBlockIndex == HEADER_BLOCK_INDEX)
+		((FileHeader*)previousBlockPtr)->NextBlockIndex = firstNewBlockIndex;
+	else
+		((BlockHeader*)previousBlockPtr)->NextBlockIndex = firstNewBlockIndex;
+
+	// Write the contents of the previous heap file block to the disk.
+	if (BF_WriteBlock(handle, previousBlockIndex) < 0)
+	{
+		printf("Could not write heap file block to disk! FileHandle: %d, BlockIndex: %d\n", handle, previousBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	return 0;
+}
+
+// Stores the records of an append that are unplaced in the record index, appendCount in number, in the free record slots of the last
+// block and in new blocks after it. The new blocks are allocated, linked to the heap file and committed in chunks that fill a share
+// of the buffer pool, so that every chunk can be written back before the next one is filled. The index of the first block of a chunk
+// is stored in firstUnlinkedBlockIndex until it's linked to the heap file. Returns 0 on success and -1 on failure, in which case the
+// blocks of the chunk that was not linked are freed.
+static int32_t StoreAppendedEntries(OpenFile* file, const Record* records, size_t recordCount, uint32_t appendCount, int32_t blockSize,
+	int32_t* firstUnlinkedBlockIndex)
+{
+	// The block level handle of the file.
+	HP_info handle = file->Handle;
+
+	// The records are stored in record order, so the next unplaced one is found by walking them once.
+	size_t nextRecordIndex = 0;
+	uint32_t placedCount = 0;
+	uint32_t maxRecordCount = MAX_RECORD_COUNT_PER_BLOCK(blockSize);
+
+	// Retrieve a pointer to the heap file header block.
+	uint8_t* headerBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to heap file header block! FileHandle: %d, BlockIndex: %d\n", handle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	int32_t lastBlockIndex = ((FileHeader*)headerBlockPtr)->LastBlockIndex;
+
+	// Fill the free record slots of the last block first, writing it once.
+	if (lastBlockIndex != INVALID_BLOCK_INDEX)
+	{
+		// Retrieve a pointer to the last heap file block.
+		uint8_t* blockPtr = nullptr;
+		if (BF_ReadBlock(handle, lastBlockIndex, (void**)&blockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, lastBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		BlockHeader* blockHeader = (BlockHeader*)blockPtr;
+		if (blockHeader->RecordCount < maxRecordCount)
+		{
+			while (blockHeader->RecordCount < maxRecordCount && placedCount < appendCount)
+			{
+				RecordIndexEntry* entry = NextUnplacedRecord(file, records, recordCount, &nextRecordIndex);
+
+				// Copy the record into a free slot of the block, and remember where it is.
+				Record* slot = AddRecordSlot(blockPtr, blockSize, sizeof(BlockHeader), &blockHeader->RecordCount, &blockHeader->SlotCount);
+				memcpy(slot, &records[nextRecordIndex - 1], sizeof(Record));
+
+				entry->BlockIndex = lastBlockIndex;
+				entry->SlotIndex = (uint32_t)(slot - (Record*)(blockPtr + sizeof(BlockHeader)));
+				placedCount++;
+			}
+
+			bool isFull = blockHeader->RecordCount == maxRecordCount;
+
+			// Write the updated contents of the heap file block to the disk.
+			if (BF_WriteBlock(handle, lastBlockIndex) < 0)
+			{
+				printf("Could not write heap file block to disk! FileHandle: %d, BlockIndex: %d\n", handle, lastBlockIndex);
+				BF_PrintError("");
+
+				return -1;
+			}
+
+			// A block that filled up leaves the list of blocks with space.
+			if (isFull && RemoveBlockWithSpace(handle, lastBlockIndex) == -1)
+				return -1;
+		}
+	}
+
+	if (placedCount == appendCount)
+		return 0;
+
+	// The new blocks of a chunk take up a share of the buffer pool, since they stay there until the chunk is committed.
+	uint32_t maxChunkBlockCount = (uint32_t)(BF_GetFrameCount() / APPEND_CHUNK_POOL_SHARE);
+	if (maxChunkBlockCount == 0)
+		maxChunkBlockCount = 1;
+
+	// The new blocks are linked after the last block, or after the header block if the heap file has no blocks.
+	int32_t previousBlockIndex = (lastBlockIndex != INVALID_BLOCK_INDEX) ? lastBlockIndex : HEADER_BLOCK_INDEX;
+	uint32_t lastSlotCount = maxRecordCount;
+
+	while (placedCount < appendCount)
+	{
+		uint32_t chunkRecordCount = appendCount - placedCount;
+		uint32_t newBlockCount = (chunkRecordCount + maxRecordCount - 1) / maxRecordCount;
+		if (newBlockCount > maxChunkBlockCount)
+		{
+			newBlockCount = maxChunkBlockCount;
+			chunkRecordCount = newBlockCount * maxRecordCount;
+		}
+
+		// Allocate the blocks of the chunk consecutively at the end of the file, so that they are written sequentially. Free blocks are not
+		// reused, so that the records stay in the order they were appended.
+		int32_t blockCount = BF_GetBlockCounter(handle);
+		int32_t firstNewBlockIndex = BF_AllocateBlocks(handle, (int32_t)newBlockCount);
+		if (firstNewBlockIndex < 0)
+		{
+			printf("Could not allocate heap file blocks! FileHandle: %d, BlockCount: %u\n", handle, newBlockCount);
+			BF_PrintError("");
+
+			// Free the blocks allocated before the failure.
+			int32_t allocatedBlockCount = BF_GetBlockCounter(handle) - blockCount;
+			if (blockCount >= 0 && allocatedBlockCount > 0)
+				FreeBlocks(handle, FREE_BLOCK_LIST_OFFSET, blockCount, (uint32_t)allocatedBlockCount);
+
+			return -1;
+		}
+
+		*firstUnlinkedBlockIndex = firstNewBlockIndex;
+
+		// Fill the blocks and link them to the heap file. If that fails, the blocks are freed, which also clears the records stored in them.
+		if (StoreAppendedBlocks(file, records, recordCount, &nextRecordIndex, chunkRecordCount, blockSize, previousBlockIndex, firstNewBlockIndex,
+			newBlockCount) == -1)
+		{
+			FreeBlocks(handle, FREE_BLOCK_LIST_OFFSET, firstNewBlockIndex, newBlockCount);
+			return -1;
+		}
+
+		// The new blocks are linked to the heap file, so their records stay in the index even if the rest fails.
+		*firstUnlinkedBlockIndex = INVALID_BLOCK_INDEX;
+		placedCount += chunkRecordCount;
+
+		// The last new block is the last one now.
+		previousBlockIndex = firstNewBlockIndex + (int32_t)newBlockCount - 1;
+		lastSlotCount = chunkRecordCount - (newBlockCount - 1) * maxRecordCount;
+		if (SetLastBlock(handle, previousBlockIndex) == -1)
+			return -1;
+
+		// Commit the chunk, so that it's blocks can be written back while the next one is filled. The caller waits for the last commit.
+		if (placedCount < appendCount && BF_Commit(handle) < 0)
+		{
+			printf("Could not commit the changes to the heap file! FileHandle: %d\n", handle);
+			BF_PrintError("");
+
+			return -1;
+		}
+	}
+
+	// Only the last new block can have free record slots, so it joins the list of blocks with space if it does.
+	if (lastSlotCount < maxRecordCount && PushBlockWithSpace(handle, previousBlockIndex) == -1)
+		return -1;
+
+	return 0;
+}
+
+static int32_t AppendEntries(OpenFile* file, const Record* records, size_t recordCount)
+{
+	// The block level handle of the file.
+	HP_info handle = file->Handle;
+
+	// Retrieve the block size of the heap file.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the heap file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// The number of records appended is returned as an int32_t.
+	if (recordCount > INT32_MAX)
+	{
+		printf("Could not append the records to the heap file, since they are too many! FileHandle: %d\n", handle);
+		return -1;
+	}
+
+	// Make room for the records in the index before the blocks change, so that adding them can't fail afterwards.
+	if (ReserveRecordIndexEntries(&file->Records, (uint32_t)recordCount) == -1)
+		return -1;
+
+	// Add the records to the index as unplaced. The index tells us which ones are duplicates without reading any blocks, and a record
+	// whose ID is repeated in the append is added once.
+	uint32_t appendCount = 0;
+	for (size_t recordIndex = 0; recordIndex < recordCount; recordIndex++)
+	{
+		if (FindRecordIndexEntry(&file->Records, records[recordIndex].ID) != nullptr)
+		{
+			printf("The specified record is already in the heap file! RecordID: %d\n", records[recordIndex].ID);
+			continue;
+		}
+
+		AddRecordIndexEntry(&file->Records, records[recordIndex].ID, UNPLACED_RECORD_BLOCK_INDEX, 0);
+		appendCount++;
+	}
+
+	if (appendCount == 0)
+		return 0;
+
+	// Store the records, and if that fails remove those that were not stored in a block, or were stored in new blocks that are not
+	// linked to the heap file, from the index.
+	int32_t firstUnlinkedBlockIndex = INVALID_BLOCK_INDEX;
+	if (StoreAppendedEntries(file, records, recordCount, appendCount, blockSize, &firstUnlinkedBlockIndex) == -1)
+	{
+		for (size_t recordIndex = 0; recordIndex < recordCount; recordIndex++)
 		{
-			printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, currentBlockIndex);
+			RecordIndexEntry* entry = FindRecordIndexEntry(&file->Records, records[recordIndex].ID);
+			if (entry != nullptr && (entry->BlockIndex == UNPLACED_RECORD_BLOCK_INDEX ||
+				(firstUnlinkedBlockIndex != INVALID_BLOCK_INDEX && entry->BlockIndex >= firstUnlinkedBlockIndex)))
+				RemoveRecordIndexEntry(&file->Records, records[recordIndex].ID);
+		}
+
+		return -1;
+	}
+
+	return (int32_t)appendCount;
+}
+
+int32_t HP_AppendEntries(HP_info handle, const Record* records, size_t recordCount)
+{
+	// Ensure that the file is open.
+	OpenFile* file = AcquireOpenFile(&s_OpenFiles, handle, true);
+	if (file == nullptr)
+	{
+		printf("Cannot append to heap file since it's not open! FileHandle: %d\n", handle);
+		return -1;
+	}
+
+	// Perform the operation while holding the lock of the file, so that it doesn't interleave with other operations on it.
+	int32_t result = AppendEntries(file, records, recordCount);
+
+	// Commit the changes of all the records at once, even those of a failed operation, so that their blocks can be written back.
+	if (CommitOpenFile(file) == -1)
+		result = -1;
+
+	return result;
+}
+
+// Unlinks a heap block that a delete left empty from the chain, linking the previous block, or the header block, and the next one to
+// each other, and frees it. The block must already be out of the list of blocks with space. Returns 0 on success and -1 on failure.
+static int32_t UnlinkEmptyBlock(HP_info handle, int32_t previousBlockIndex, int32_t blockIndex, int32_t nextBlockIndex)
+{
+	// Retrieve a pointer to the previous heap file block.
+	uint8_t* previousBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, previousBlockIndex, (void**)&previousBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, previousBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// The head has a different header structure so we treat it differently.
+	if (previousBlockIndex == HEADER_BLOCK_INDEX)
+		((FileHeader*)previousBlockPtr)->NextBlockIndex = nextBlockIndex;
+	else
+		((BlockHeader*)previousBlockPtr)->NextBlockIndex = nextBlockIndex;
+
+	// Write the contents of the previous heap file block to the disk.
+	if (BF_WriteBlock(handle, previousBlockIndex) < 0)
+	{
+		printf("Could not write heap file block to disk! FileHandle: %d, BlockIndex: %d\n", handle, previousBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Link the next block back to the previous one.
+	if (nextBlockIndex != INVALID_BLOCK_INDEX)
+	{
+		uint8_t* nextBlockPtr = nullptr;
+		if (BF_ReadBlock(handle, nextBlockIndex, (void**)&nextBlockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, nextBlockIndex);
 			BF_PrintError("");
 
 			return -1;
 		}
 
-		// Since this file exists, we know there's a BlockHeader in the first bytes of the block. So we treat the pointer as such.
-		BlockHeader* currentBlockHeader = (BlockHeader*)currentBlockPtr;
-
-		// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
-		currentBlockPtr += sizeof(BlockHeader);
+		((BlockHeader*)nextBlockPtr)->PreviousBlockIndex = previousBlockIndex;
 
-		// Interate through all the record slots that are occupied in the current block.
-		for (uint32_t recordIndex = 0; recordIndex < currentBlockHeader->RecordCount; recordIndex++)
+		if (BF_WriteBlock(handle, nextBlockIndex) < 0)
 		{
-			// Treat the current pointer as a record.
-			Record* currentRecord = (Record*)currentBlockPtr;
+			printf("Could not write heap file block to disk! FileHandle: %d, BlockIndex: %d\n", handle, nextBlockIndex);
+			BF_PrintError("");
 
-			// If the current records ID is the same as the key, we want to delete it and exit.
-			if (currentRecord->ID == key)
-			{
-				// What we want to do is move the contents of the records after the current record up the size of one record.
+			return -1;
+		}
+	}
+
+	// If the block was the last one, the previous block is the last one now.
+	if (nextBlockIndex == INVALID_BLOCK_INDEX &&
+		SetLastBlock(handle, (previousBlockIndex != HEADER_BLOCK_INDEX) ? previousBlockIndex : INVALID_BLOCK_INDEX) == -1)
+		return -1;
+
+	// Free the block so that the next new block reuses it.
+	return FreeBlocks(handle, FREE_BLOCK_LIST_OFFSET, blockIndex, 1);
+}
+
+static int32_t DeleteEntry(OpenFile* file, void* keyValue)
+{
+	// The block level handle of the file.
+	HP_info handle = file->Handle;
+
+	// Extract the key from the key value pointer.
+	int32_t key = *(int32_t*)keyValue;
+
+	// Retrieve the block size of the heap file.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the heap file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
 
-				// Calculate the size of the records after the current record.
-				uint32_t byteCountOfRecordDataAfterCurrentRecord = (currentBlockHeader->RecordCount - (recordIndex + 1)) * sizeof(Record);
+	// Find the block and slot of the record in the record index.
+	RecordIndexEntry* entry = FindRecordIndexEntry(&file->Records, key);
+	if (entry == nullptr)
+	{
+		printf("Could not find record with key %d!\n", key);
+		return -1;
+	}
 
-				// Copy the records after the current record, to the current record's position in the block.
-				memcpy(currentBlockPtr, currentBlockPtr + sizeof(Record), byteCountOfRecordDataAfterCurrentRecord);
+	int32_t blockIndex = entry->BlockIndex;
+	uint32_t slotIndex = entry->SlotIndex;
 
-				// Decrement the current block record count;
-				currentBlockHeader->RecordCount--;
+	// Retrieve a pointer to the heap file block of the record.
+	uint8_t* blockPtr = nullptr;
+	if (BF_ReadBlock(handle, blockIndex, (void**)&blockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, blockIndex);
+		BF_PrintError("");
 
-				// Offset the block pointer by the size of a block times the number of records left in the block after the current one.
-				// This way the pointer points to the first byte of the empty space in the block.
-				currentBlockPtr += byteCountOfRecordDataAfterCurrentRecord;
+		return -1;
+	}
 
-				// Calculate the number of empty bytes in the block.
-				uint32_t emptyByteCount = BLOCK_SIZE - (sizeof(BlockHeader) + currentBlockHeader->RecordCount * sizeof(Record));
+	// Since this file exists, we know there's a BlockHeader in the first bytes of the block. So we treat the pointer as such.
+	BlockHeader* blockHeader = (BlockHeader*)blockPtr;
 
-				// Set the empty bytes to zero.
-				memset(currentBlockPtr, 0, emptyByteCount);
+	// Whether the block was full, and so not in the list of blocks with space.
+	bool wasFull = blockHeader->RecordCount == MAX_RECORD_COUNT_PER_BLOCK(blockSize);
 
-				// Write the updated contents of the current heap file block to the disk.
-				if (BF_WriteBlock(handle, currentBlockIndex) < 0)
-				{
-					printf("Could not write heap file block to disk! FileHandle: %d, BlockIndex: %d\n", handle, currentBlockIndex);
-					BF_PrintError("");
+	// Mark the slot of the record as deleted. The records after it stay where they are.
+	DeleteRecordSlot(blockPtr, blockSize, sizeof(BlockHeader), &blockHeader->RecordCount, &blockHeader->SlotCount, slotIndex);
+	RemoveRecordIndexEntry(&file->Records, key);
 
-					return -1;
-				}
+	uint8_t recordCount = blockHeader->RecordCount;
+	int32_t previousBlockIndex = blockHeader->PreviousBlockIndex;
+	int32_t nextBlockIndex = blockHeader->NextBlockIndex;
 
-				// Exit the function since we deleted.
-				return 0;
-			}
+	// Write the updated contents of the heap file block to the disk.
+	if (BF_WriteBlock(handle, blockIndex) < 0)
+	{
+		printf("Could not write heap file block to disk! FileHandle: %d, BlockIndex: %d\n", handle, blockIndex);
+		BF_PrintError("");
 
-			// Offset the block poiter by the size of a record so it pointer to the first byte of the next record slot.
-			currentBlockPtr += sizeof(Record);
-		}
+		return -1;
+	}
 
-		// Update the current block index.
-		currentBlockIndex = currentBlockHeader->NextBlockIndex;
+	// A block left empty is unlinked, so that scans no longer read it and inserts reuse it.
+	if (recordCount == 0)
+	{
+		if (!wasFull && RemoveBlockWithSpace(handle, blockIndex) == -1)
+			return -1;
+
+		return UnlinkEmptyBlock(handle, previousBlockIndex, blockIndex, nextBlockIndex);
 	}
 
-	// If we're here, the record with key keyValue was not found.
-	printf("Could not find record with key %d!\n", key);
-	return -1;
+	// A block that was full has a free record slot now, so it joins the list of blocks with space.
+	if (wasFull)
+		return PushBlockWithSpace(handle, blockIndex);
+
+	return 0;
 }
 
-int32_t HP_GetAllEntries(HP_info handle, void* keyValue)
+int32_t HP_DeleteEntry(HP_info handle, void* keyValue)
+{
+	// Ensure that the file is open.
+	OpenFile* file = AcquireOpenFile(&s_OpenFiles, handle, true);
+	if (file == nullptr)
+	{
+		printf("Cannot delete from heap file since it's not open! FileHandle: %d\n", handle);
+		return -1;
+	}
+
+	// Perform the operation while holding the lock of the file, so that it doesn't interleave with other operations on it.
+	int32_t result = DeleteEntry(file, keyValue);
+
+	// Commit the changes, even those of a failed operation, so that their blocks can be written back.
+	if (CommitOpenFile(file) == -1)
+		result = -1;
+
+	return result;
+}
+
+static int32_t GetAllEntries(OpenFile* file, void* keyValue)
 {
+	// The block level handle of the file.
+	HP_info handle = file->Handle;
+
+	// Retrieve the block size of the heap file, which locates the tombstones of the blocks.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the heap file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	if (keyValue != nullptr)
+	{
+		// If the key is valid, the record index tells us the block and slot of the record.
+		int32_t key = *(int32_t*)keyValue;
+		RecordIndexEntry* entry = FindRecordIndexEntry(&file->Records, key);
+		if (entry == nullptr)
+		{
+			printf("Could not find record with key %d!\n", key);
+			return -1;
+		}
+
+		// Retrieve a pointer to the heap file block of the record.
+		uint8_t* blockPtr = nullptr;
+		if (BF_ReadBlock(handle, entry->BlockIndex, (void**)&blockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, entry->BlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// Print the record. It's block is the only one we traversed.
+		Record* record = (Record*)(blockPtr + sizeof(BlockHeader)) + entry->SlotIndex;
+		printf("ID: %d, Name: %s, Surname: %s, Address: %s\n", record->ID, record->Name, record->Surname, record->Address);
+
+		return 1;
+	}
+
 	// Retrieve a pointer to the heap file header block.
 	uint8_t* headerBlockPtr = nullptr;
 	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
@@ -503,12 +1323,22 @@ int32_t HP_GetAllEntries(HP_info handle, void* keyValue)
 	// Start from the first actual block.
 	int32_t currentBlockIndex = fileHeader->NextBlockIndex;
 
-	// The number of blocks that we traversed. Set to one to account for the heap file header block.
-	uint32_t blocksTraversed = 1;
+	// The first block that has not been read ahead yet.
+	int32_t readaheadBlockIndex = 0;
 
 	// Loop until the end of the allocated blocks.
 	while (currentBlockIndex != INVALID_BLOCK_INDEX)
 	{
+		// Read the blocks ahead, a window of consecutive blocks at a time, once the scan is half a window away from the
+		// end of the blocks already read ahead. A failed prefetch only means that the blocks are read when they are reached.
+		if (currentBlockIndex + READAHEAD_BLOCK_COUNT / 2 >= readaheadBlockIndex)
+		{
+			int32_t firstBlockIndex = (currentBlockIndex > readaheadBlockIndex) ? currentBlockIndex : readaheadBlockIndex;
+			readaheadBlockIndex = currentBlockIndex + READAHEAD_BLOCK_COUNT;
+
+			BF_Prefetch(handle, firstBlockIndex, readaheadBlockIndex - firstBlockIndex);
+		}
+
 		// Retrieve a pointer to the current heap file block.
 		uint8_t* currentBlockPtr = nullptr;
 		if (BF_ReadBlock(handle, currentBlockIndex, (void**)&currentBlockPtr) < 0)
@@ -519,38 +1349,21 @@ int32_t HP_GetAllEntries(HP_info handle, void* keyValue)
 			return -1;
 		}
 
-		// Increment the blocks traversed counter.
-		blocksTraversed++;
-
 		// Since this file exists, we know there's a BlockHeader in the first bytes of the block. So we treat the pointer as such.
 		BlockHeader* currentBlockHeader = (BlockHeader*)currentBlockPtr;
 
 		// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
 		currentBlockPtr += sizeof(BlockHeader);
 
-		// Interate through all the record slots that are occupied in the current block.
-		for (uint32_t recordIndex = 0; recordIndex < currentBlockHeader->RecordCount; recordIndex++)
+		// Interate through all the record slots that are used in the current block.
+		for (uint32_t recordIndex = 0; recordIndex < currentBlockHeader->SlotCount; recordIndex++)
 		{
 			// Treat the current pointer as a record.
 			Record* currentRecord = (Record*)currentBlockPtr;
 
-			if (keyValue == nullptr)
-			{
-				// If the key value is nullptr, we print the record regardless.
+			// Print the record, unless it's deleted.
+			if (!IS_SLOT_DELETED(currentBlockHeader, blockSize, recordIndex))
 				printf("ID: %d, Name: %s, Surname: %s, Address: %s\n", currentRecord->ID, currentRecord->Name, currentRecord->Surname, currentRecord->Address);
-			}
-			else
-			{
-				// Otherwise, extract the key from the key value pointer.
-				int32_t key = *(int32_t*)keyValue;
-
-				// If the current records ID is the same as the key, we want to print it and exit.
-				if (currentRecord->ID == key)
-				{
-					printf("ID: %d, Name: %s, Surname: %s, Address: %s\n", currentRecord->ID, currentRecord->Name, currentRecord->Surname, currentRecord->Address);
-					return blocksTraversed;
-				}
-			}
 
 			// Offset the block poiter by the size of a record so it pointer to the first byte of the next record slot.
 			currentBlockPtr += sizeof(Record);
@@ -559,21 +1372,223 @@ int32_t HP_GetAllEntries(HP_info handle, void* keyValue)
 		// Update the current block index.
 		currentBlockIndex = currentBlockHeader->NextBlockIndex;
 	}
-	
-	// If we are here and the key value is not nullptr, it means that the record with the specified key was not found in the heap file.
+
+	// We printed all the records.
+	return 0;
+}
+
+int32_t HP_GetAllEntries(HP_info handle, void* keyValue)
+{
+	// Ensure that the file is open.
+	OpenFile* file = AcquireOpenFile(&s_OpenFiles, handle, false);
+	if (file == nullptr)
+	{
+		printf("Cannot get entries from heap file since it's not open! FileHandle: %d\n", handle);
+		return -1;
+	}
+
+	// Perform the operation while holding the lock of the file shared, so that lookups run concurrently with each other.
+	int32_t result = GetAllEntries(file, keyValue);
+	ReleaseOpenFile(file);
+
+	return result;
+}
+
+// Pins a block for a cursor and starts reading the blocks after it ahead. All of it's slots are read, unless the caller changes them.
+// Returns 0 on success and -1 on failure.
+static int32_t PinCursorBlock(HP_Cursor* cursor, int32_t blockIndex)
+{
+	// The block level handle of the file.
+	HP_info handle = cursor->File->Handle;
+
+	// Read the blocks ahead, like a scan does.
+	if (!cursor->IsKeyLookup && blockIndex + READAHEAD_BLOCK_COUNT / 2 >= cursor->ReadaheadBlockIndex)
+	{
+		int32_t firstBlockIndex = (blockIndex > cursor->ReadaheadBlockIndex) ? blockIndex : cursor->ReadaheadBlockIndex;
+		cursor->ReadaheadBlockIndex = blockIndex + READAHEAD_BLOCK_COUNT;
+
+		BF_Prefetch(handle, firstBlockIndex, cursor->ReadaheadBlockIndex - firstBlockIndex);
+	}
+
+	// Pin the block for reading, so that the records returned stay in memory until the cursor moves past it.
+	uint8_t* blockPtr = nullptr;
+	if (BF_PinBlock(handle, blockIndex, BF_LATCH_SHARED, (void**)&blockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to heap file block! FileHandle: %d, BlockIndex: %d\n", handle, blockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	cursor->BlockIndex = blockIndex;
+	cursor->BlockPtr = blockPtr;
+	cursor->SlotIndex = 0;
+	cursor->EndSlotIndex = ((BlockHeader*)blockPtr)->SlotCount;
+
+	return 0;
+}
+
+// Unpins the block of a cursor, if it has one. Returns 0 on success and -1 on failure.
+static int32_t UnpinCursorBlock(HP_Cursor* cursor)
+{
+	if (cursor->BlockIndex == INVALID_BLOCK_INDEX)
+		return 0;
+
+	int32_t blockIndex = cursor->BlockIndex;
+	cursor->BlockIndex = INVALID_BLOCK_INDEX;
+	cursor->BlockPtr = nullptr;
+
+	if (BF_UnpinBlock(cursor->File->Handle, blockIndex) < 0)
+	{
+		printf("Could not unpin heap file block! FileHandle: %d, BlockIndex: %d\n", cursor->File->Handle, blockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	return 0;
+}
+
+// Positions a new cursor on it's first record. Returns 0 on success and -1 on failure.
+static int32_t ScanOpen(HP_Cursor* cursor, void* keyValue)
+{
+	// The block level handle of the file.
+	HP_info handle = cursor->File->Handle;
+
+	// Retrieve the block size of the heap file.
+	cursor->BlockSize = BF_GetBlockSize(handle);
+	if (cursor->BlockSize < 0)
+	{
+		printf("Could not retrieve block size for the heap file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
 	if (keyValue != nullptr)
 	{
-		int32_t key = *(int32_t*)keyValue;
-		printf("Could not find record with key %d!\n", key);
+		// The record index tells us the block and slot of the record with the key, so only that slot is read. If the key is not in
+		// the heap file the scan is empty.
+		cursor->IsKeyLookup = true;
+
+		RecordIndexEntry* entry = FindRecordIndexEntry(&cursor->File->Records, *(int32_t*)keyValue);
+		if (entry == nullptr)
+			return 0;
+
+		if (PinCursorBlock(cursor, entry->BlockIndex) == -1)
+			return -1;
+
+		cursor->SlotIndex = entry->SlotIndex;
+		cursor->EndSlotIndex = entry->SlotIndex + 1;
+
+		return 0;
+	}
+
+	// Retrieve a pointer to the heap file header block.
+	uint8_t* headerBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to heap file header block! FileHandle: %d, BlockIndex: %d\n", handle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Start from the first actual block, if there is one.
+	int32_t firstBlockIndex = ((FileHeader*)headerBlockPtr)->NextBlockIndex;
+	if (firstBlockIndex == INVALID_BLOCK_INDEX)
+		return 0;
+
+	return PinCursorBlock(cursor, firstBlockIndex);
+}
+
+HP_Cursor* HP_ScanOpen(HP_info handle, void* keyValue)
+{
+	// Ensure that the file is open. The cursor holds the lock of the file shared until it's closed, so that the blocks it returns
+	// records from don't change.
+	OpenFile* file = AcquireOpenFile(&s_OpenFiles, handle, false);
+	if (file == nullptr)
+	{
+		printf("Cannot scan heap file since it's not open! FileHandle: %d\n", handle);
+		return nullptr;
+	}
+
+	// Allocate the cursor.
+	HP_Cursor* cursor = (HP_Cursor*)malloc(sizeof(HP_Cursor));
+	if (cursor == nullptr)
+	{
+		printf("Could not allocate the cursor of the heap file! FileHandle: %d\n", handle);
+		ReleaseOpenFile(file);
+
+		return nullptr;
+	}
+
+	cursor->File = file;
+	cursor->BlockIndex = INVALID_BLOCK_INDEX;
+	cursor->BlockPtr = nullptr;
+	cursor->SlotIndex = 0;
+	cursor->EndSlotIndex = 0;
+	cursor->IsKeyLookup = false;
+	cursor->ReadaheadBlockIndex = 0;
+
+	if (ScanOpen(cursor, keyValue) == -1)
+	{
+		UnpinCursorBlock(cursor);
+		ReleaseOpenFile(file);
+		free(cursor);
+
+		return nullptr;
+	}
+
+	return cursor;
+}
+
+int32_t HP_ScanNextBatch(HP_Cursor* cursor, const Record** records, int32_t maxRecordCount)
+{
+	if (maxRecordCount <= 0)
+	{
+		printf("Invalid number of records to scan! RecordCount: %d\n", maxRecordCount);
 		return -1;
 	}
 
-	// Otherwise, we printed all the records.
+	// Loop until a block has records left, or the scan is over.
+	while (cursor->BlockIndex != INVALID_BLOCK_INDEX)
+	{
+		// Return the next records of the pinned block, if any are left.
+		uint32_t recordCount = CollectRecordSlots(cursor->BlockPtr, cursor->BlockSize, sizeof(BlockHeader), cursor->EndSlotIndex,
+			&cursor->SlotIndex, nullptr, records, (uint32_t)maxRecordCount);
+		if (recordCount > 0)
+			return (int32_t)recordCount;
+
+		// Move to the next block, now that we are done with the block. A key lookup reads a single block.
+		int32_t nextBlockIndex = cursor->IsKeyLookup ? INVALID_BLOCK_INDEX : ((BlockHeader*)cursor->BlockPtr)->NextBlockIndex;
+		if (UnpinCursorBlock(cursor) == -1)
+			return -1;
+
+		if (nextBlockIndex != INVALID_BLOCK_INDEX && PinCursorBlock(cursor, nextBlockIndex) == -1)
+			return -1;
+	}
+
 	return 0;
 }
 
+int32_t HP_ScanNext(HP_Cursor* cursor, const Record** record)
+{
+	return HP_ScanNextBatch(cursor, record, 1);
+}
+
+int32_t HP_ScanClose(HP_Cursor* cursor)
+{
+	// Unpin the block of the cursor, and release the lock of the file.
+	int32_t result = UnpinCursorBlock(cursor);
+	ReleaseOpenFile(cursor->File);
+	free(cursor);
+
+	return result;
+}
+
 // TODO: Remove this!
-int32_t HP_DebugPrint(HP_info handle)
+static int32_t DebugPrint(HP_info handle)
 {
 	uint8_t* headerBlockPtr = nullptr;
 	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
@@ -589,6 +1604,8 @@ int32_t HP_DebugPrint(HP_info handle)
 	printf("Block %d:\n", HEADER_BLOCK_INDEX);
 	printf("\tType: %s\n", fileHeader->CommonHeader.Type == HeapFile ? "Heap" : "Hash");
 	printf("\tNextBlockIndex: %d\n", fileHeader->NextBlockIndex);
+	printf("\tLastBlockIndex: %d\n", fileHeader->LastBlockIndex);
+	printf("\tFirstBlockWithSpaceIndex: %d\n", fileHeader->FirstBlockWithSpaceIndex);
 
 	int32_t currentBlockIndex = fileHeader->NextBlockIndex;
 	while (currentBlockIndex != INVALID_BLOCK_INDEX)
@@ -607,13 +1624,15 @@ int32_t HP_DebugPrint(HP_info handle)
 
 		printf("Block %d:\n", currentBlockIndex);
 		printf("\tRecordCount: %d\n", currentBlockHeader->RecordCount);
+		printf("\tSlotCount: %d\n", currentBlockHeader->SlotCount);
+		printf("\tPreviousBlockIndex: %d\n", currentBlockHeader->PreviousBlockIndex);
 		printf("\tNextBlockIndex: %d\n", currentBlockHeader->NextBlockIndex);
 
-		for (uint32_t recordIndex = 0; recordIndex < currentBlockHeader->RecordCount; recordIndex++)
+		for (uint32_t recordIndex = 0; recordIndex < currentBlockHeader->SlotCount; recordIndex++)
 		{
 			Record* currentRecord = (Record*)currentBlockPtr;
 
-			printf("\tRecord %d:\n", recordIndex);
+			printf("\tRecord %d:%s\n", recordIndex, IS_SLOT_DELETED(currentBlockHeader, BF_GetBlockSize(handle), recordIndex) ? " (deleted)" : "");
 			printf("\t\tID: %d\n", currentRecord->ID);
 			printf("\t\tName: %s\n", currentRecord->Name);
 			printf("\t\tSurname: %s\n", currentRecord->Surname);
@@ -627,3 +1646,20 @@ int32_t HP_DebugPrint(HP_info handle)
 
 	return 0;
 }
+
+int32_t HP_DebugPrint(HP_info handle)
+{
+	// Ensure that the file is open.
+	OpenFile* file = AcquireOpenFile(&s_OpenFiles, handle, false);
+	if (file == nullptr)
+	{
+		printf("Cannot print heap file since it's not open! FileHandle: %d\n", handle);
+		return -1;
+	}
+
+	// Perform the operation while holding the lock of the file shared, so that lookups run concurrently with each other.
+	int32_t result = DebugPrint(handle);
+	ReleaseOpenFile(file);
+
+	return result;
+}
@@ -8,22 +8,66 @@ typedef int32_t HP_info;
 // Creates a heap file with the name fileName. Returns 0 on success and -1 on failure.
 int32_t HP_CreateFile(char* fileName, char attributeType, char* attributeName, int32_t attributeLength);
 
-// Opens a heap file and returns a pointer to it's handle. Returns the file handle on success and nullptr on failure.
+// Creates a heap file with the name fileName whose blocks are blockSize bytes. Returns 0 on success and -1 on failure.
+int32_t HP_CreateFileWithBlockSize(char* fileName, char attributeType, char* attributeName, int32_t attributeLength, int32_t blockSize);
+
+// Opens a heap file and returns a pointer to it's handle. The locations of the records are indexed by their IDs in memory, so that
+// the operations on a single record read only it's block. Returns the file handle on success and nullptr on failure.
 HP_info* HP_OpenFile(char* fileName);
 
+// Opens a heap file like HP_OpenFile, but loads the index of the records from the file fileName.idx instead of reading every block,
+// if it was saved there when the heap file was last closed. The index is saved there again when the heap file is closed. Returns the
+// file handle on success and nullptr on failure.
+HP_info* HP_OpenFileWithSavedIndex(char* fileName);
+
 // Closes a heap file. Returns 0 on success and -1 on failure.
 int32_t HP_CloseFile(HP_info* handle);
 
-// Inserts a record to the first available block in the heap file. Creates blocks if required. Returns the block index
-// where the record was inserted on success and -1 on failure.
+// Closes a heap file like HP_CloseFile, but first gives the free blocks at the end of the file back to the file system. Blocks
+// emptied by HP_DeleteEntry are freed and reused by later inserts, and this shrinks the file when they are the last ones.
+// Returns 0 on success and -1 on failure.
+int32_t HP_CloseFileWithTruncation(HP_info* handle);
+
+// Inserts a record to a block of the heap file with a free record slot, which the file keeps a list of. Creates a block after the
+// last one if they are all full. Records whose ID is already in the heap file are rejected. Returns the block index where the record was inserted on success and -1 on failure.
 int32_t HP_InsertEntry(HP_info handle, Record record);
 
-// Deletes a record from the heap file if inserted. Returns 0 on success and -1 on failure.
+// Appends recordCount records to the end of the heap file in order. The free record slots of the last block are filled first, and the
+// rest of the records fill new consecutive blocks that are each written once, so the records are written sequentially. The new blocks
+// are committed in chunks that fit in the buffer pool, so an append of any size never runs out of buffer frames. Free blocks and the
+// free record slots of the other blocks are not reused. Records whose ID is already in the heap file, or earlier in records, are
+// rejected. Returns the number of records appended on success and -1 on failure, in which case the chunks committed before the failure
+// stay in the heap file and the blocks of the failed chunk are freed.
+int32_t HP_AppendEntries(HP_info handle, const Record* records, size_t recordCount);
+
+// Deletes a record from the heap file if inserted. The record's slot is marked as deleted and reused by a later insert, so the other
+// records of it's block keep their place. A block left empty is unlinked from the heap file and freed, so that later
+// inserts reuse it. Returns 0 on success and -1 on failure.
 int32_t HP_DeleteEntry(HP_info handle, void* keyValue);
 
 // If keyValue == nullptr, prints all entries in he heap file, otherwise prints the entry with key == keyValue if it exists.
-// Returns the number of blocks traversed on success and -1 on failure.
+// Returns the number of blocks traversed on success and -1 on failure. Finding a single entry reads only it's block.
 int32_t HP_GetAllEntries(HP_info handle, void* keyValue);
 
+// The state of a scan of the records of a heap file.
+typedef struct HP_Cursor HP_Cursor;
+
+// Opens a cursor over the records of a heap file, or over the record with key == keyValue if keyValue is not nullptr. The records are
+// returned as pointers into the blocks of the heap file, pinned in memory while the cursor reads them, so they are never copied.
+// The cursor holds the lock of the file shared until it's closed, so the file is not modified or closed meanwhile. It must be used
+// and closed by the thread that opened it, before that thread modifies the file. Returns the cursor on success and nullptr on failure.
+HP_Cursor* HP_ScanOpen(HP_info handle, void* keyValue);
+
+// Stores a pointer to the next record of a cursor in record. The record is valid until the next call with the cursor.
+// Returns 1 if there was a record, 0 at the end of the scan and -1 on failure.
+int32_t HP_ScanNext(HP_Cursor* cursor, const Record** record);
+
+// Stores pointers to at most maxRecordCount of the next records of a cursor in records. The records are from the same block, and
+// valid until the next call with the cursor. Returns the number of records stored, 0 at the end of the scan and -1 on failure.
+int32_t HP_ScanNextBatch(HP_Cursor* cursor, const Record** records, int32_t maxRecordCount);
+
+// Closes a cursor, unpinning it's block and releasing the lock of the file. Returns 0 on success and -1 on failure.
+int32_t HP_ScanClose(HP_Cursor* cursor);
+
 // TODO: Remove this!
 int32_t HP_DebugPrint(HP_info handle);
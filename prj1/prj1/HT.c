@@ -23,8 +23,14 @@ typedef struct FileHeader
 
 	// The index of the next block in the hash file.
 	int32_t NextBlockIndex;
+
+	// The data blocks emptied by deletes, which inserts reuse before the file grows.
+	FreeBlockList FreeBlocks;
 } FileHeader;
 
+// The offset of the free block list in the hash file header block.
+#define FREE_BLOCK_LIST_OFFSET offsetof(FileHeader, FreeBlocks)
+
 // The memory layout of a hash table file that containts the buckets. This structure is stored in all hash file
 // blocks that contain buckets.
 typedef struct BucketBlockHeader
@@ -39,18 +45,57 @@ typedef struct DataBlockHeader
 	// The number of records in the current data block.
 	uint8_t RecordCount;
 
+	// The number of record slots in use, deleted ones included. A deleted record keeps it's slot, marked in the tombstone bitmap at the
+	// end of the block, so that the other records of the block never move.
+	uint8_t SlotCount;
+
+	// The number of blocks right after this one that are allocated for the chain of it's bucket, but not linked yet. Only the
+	// last block of a chain reserves blocks.
+	uint8_t ReservedBlockCount;
+
 	// The index of the next data block in the hash file.
 	int32_t NextBlockIndex;
 } DataBlockHeader;
 
-// Calculate at compile time the maximum number of buckets in a block.
-#define MAX_BUCKET_COUNT_PER_BLOCK ((BLOCK_SIZE - sizeof(BucketBlockHeader)) / sizeof(int32_t))
+// Calculate the maximum number of buckets in a block for a given block size.
+#define MAX_BUCKET_COUNT_PER_BLOCK(blockSize) (((blockSize) - sizeof(BucketBlockHeader)) / sizeof(int32_t))
+
+// Calculate the maximum number of records in a hash data block for a given block size. Every record slot also needs a bit of the
+// tombstone bitmap at the end of the block.
+#define MAX_RECORD_COUNT_PER_BLOCK(blockSize) ((((blockSize) - sizeof(DataBlockHeader)) * 8) / (sizeof(Record) * 8 + 1))
+
+// The number of consecutive data blocks allocated at once when the chain of a bucket overflows, so that the chain stays
+// contiguous in the file.
+#define BUCKET_EXTENT_BLOCK_COUNT 4
+
+// The state of a scan of a hash file, opened by HT_ScanOpen.
+struct HT_Cursor
+{
+	// The open hash file, whose lock the cursor holds shared until it's closed.
+	OpenFile* File;
+
+	// The block size of the hash file, which locates the tombstones of the data blocks.
+	int32_t BlockSize;
+
+	// The key of the records returned, if the cursor has one.
+	bool HasKey;
+	int32_t Key;
+
+	// The bucket block of the next bucket to scan, the index of that bucket in it, and the number of buckets left to scan.
+	int32_t BucketBlockIndex;
+	uint32_t BucketIndexInBucketBlock;
+	uint32_t RemainingBucketCount;
+
+	// The data block whose records are returned, pinned until the cursor moves past it, or INVALID_BLOCK_INDEX if there is none.
+	int32_t DataBlockIndex;
+	uint8_t* DataBlockPtr;
 
-// Calculate at compile time the maximum number of records in a hash data block.
-#define MAX_RECORD_COUNT_PER_BLOCK ((BLOCK_SIZE - sizeof(DataBlockHeader)) / sizeof(Record))
+	// The next record slot of the data block to read.
+	uint32_t SlotIndex;
+};
 
-// Storage for the currently open hash file handle.
-static HT_info s_HandleStorage = -1;
+// The open hash files.
+static OpenFileTable s_OpenFiles = OPEN_FILE_TABLE_INITIALIZER;
 
 // Knuth Variant on Cormen Division
 // Reference: https://www.cs.hmc.edu/~geoff/classes/hmc.cs070.200101/homework10/hashfuncs.html
@@ -60,12 +105,18 @@ static int32_t HashFunction(int32_t key, int32_t hashTableSize)
 }
 
 int32_t HT_CreateIndex(char* fileName, char attributeType, char* attributeName, int32_t attributeLength, int32_t bucketCount)
+{
+	return HT_CreateIndexWithBlockSize(fileName, attributeType, attributeName, attributeLength, bucketCount, BF_DEFAULT_BLOCK_SIZE);
+}
+
+int32_t HT_CreateIndexWithBlockSize(char* fileName, char attributeType, char* attributeName, int32_t attributeLength, int32_t bucketCount,
+	int32_t blockSize)
 {
 	// Initialize the block level.
 	BF_Init();
 
 	// Create the block level file.
-	if (BF_CreateFile(fileName) < 0)
+	if (BF_CreateFileWithBlockSize(fileName, blockSize) < 0)
 	{
 		printf("Could not create block level file for the hash file! FileName: %s\n", fileName);
 		BF_PrintError("");
@@ -107,6 +158,7 @@ int32_t HT_CreateIndex(char* fileName, char attributeType, char* attributeName,
 	header.CommonHeader.Type = HashFile;
 	header.BucketCount = bucketCount;
 	header.NextBlockIndex = INVALID_BLOCK_INDEX;
+	header.FreeBlocks.FirstBlockIndex = INVALID_BLOCK_INDEX;
 
 	// Copy the file header into the hash file header block.
 	memcpy(headerBlockPtr, &header, sizeof(FileHeader));
@@ -123,10 +175,10 @@ int32_t HT_CreateIndex(char* fileName, char attributeType, char* attributeName,
 	// Now we need to create all the blocks required to store the hash table.
 
 	// Calculate the required blocks for the bucket count using an integer division.
-	int32_t requiredBlockCount = (bucketCount / MAX_BUCKET_COUNT_PER_BLOCK);
+	int32_t requiredBlockCount = (bucketCount / MAX_BUCKET_COUNT_PER_BLOCK(blockSize));
 
 	// If there is a remainder we add one more block to account for those buckets.
-	requiredBlockCount += ((bucketCount % MAX_BUCKET_COUNT_PER_BLOCK) > 0) ? 1 : 0;
+	requiredBlockCount += ((bucketCount % MAX_BUCKET_COUNT_PER_BLOCK(blockSize)) > 0) ? 1 : 0;
 
 	// Set the previous bucket block index to the header block.
 	int32_t previousBucketBlockIndex = HEADER_BLOCK_INDEX;
@@ -177,11 +229,11 @@ int32_t HT_CreateIndex(char* fileName, char attributeType, char* attributeName,
 		newBucketBlockPtr += sizeof(BucketBlockHeader);
 
 		// Initially set the number of buckets in the current bucket block to max.
-		int32_t bucketCountInCurrentBucketBlock = MAX_BUCKET_COUNT_PER_BLOCK;
+		int32_t bucketCountInCurrentBucketBlock = MAX_BUCKET_COUNT_PER_BLOCK(blockSize);
 
 		// If this is the last bucket block we create, the number of buckets is the remainder of the following division.
 		if (index == requiredBlockCount - 1)
-			bucketCountInCurrentBucketBlock = bucketCount % MAX_BUCKET_COUNT_PER_BLOCK;
+			bucketCountInCurrentBucketBlock = bucketCount % MAX_BUCKET_COUNT_PER_BLOCK(blockSize);
 
 		// Fill the bucketCountInCurrentBucketBlock number of bucket indices to the invalid block index.
 		memset(newBucketBlockPtr, INVALID_BLOCK_INDEX, bucketCountInCurrentBucketBlock * sizeof(int32_t));
@@ -246,15 +298,8 @@ int32_t HT_CreateIndex(char* fileName, char attributeType, char* attributeName,
 
 HT_info* HT_OpenIndex(char* fileName)
 {
-	// Ensure that there are no files currently open.
-	if (s_HandleStorage != -1)
-	{
-		printf("Cannot open hash file since there's another file open!\n");
-		return nullptr;
-	}
-
 	// Open the block level file.
-	HT_info fileHandle = BF_OpenFile(fileName);
+	HT_info fileHandle = OpenLoggedFile(fileName);
 	if (fileHandle < 0)
 	{
 		printf("Could not open block level file for the hash file! FileName: %s\n", fileName);
@@ -283,38 +328,123 @@ HT_info* HT_OpenIndex(char* fileName)
 		return nullptr;
 	}
 
-	// Store the handle in a global variable so that we can return a pointer to it.
-	s_HandleStorage = fileHandle;
+	// Add the file to the open files table, which stores the handle so that we can return a pointer to it.
+	OpenFile* file = AddOpenFile(&s_OpenFiles, fileHandle);
+	if (file == nullptr)
+	{
+		printf("Cannot open hash file since there are too many files open! FileName: %s\n", fileName);
+		BF_CloseFile(fileHandle);
+		return nullptr;
+	}
 
-	return &s_HandleStorage;
+	return &file->Handle;
 }
 
-int32_t HT_CloseIndex(HT_info* handle)
+// Closes a hash file, giving the free blocks at the end of it back to the file system first if truncateFreeBlocks is set.
+// Returns 0 on success and -1 on failure.
+static int32_t CloseIndex(HT_info* handle, bool truncateFreeBlocks)
 {
 	// Ensure that the file we want to close is actually open.
-	if (s_HandleStorage != *handle)
+	OpenFile* file = AcquireOpenFile(&s_OpenFiles, *handle, true);
+	if (file == nullptr)
 	{
 		printf("Cannot close hash file since it's not open!\n");
 		return -1;
 	}
 
+	// A failed truncation keeps the rest of the free blocks in the list, so the file is still closed.
+	int32_t fileHandle = file->Handle;
+	int32_t result = 0;
+	if (truncateFreeBlocks && TruncateFreeBlocks(fileHandle, FREE_BLOCK_LIST_OFFSET) == -1)
+	{
+		printf("Could not give back the free blocks of the hash file! FileHandle: %d\n", fileHandle);
+		result = -1;
+	}
+
 	// Close the block level file.
-	if (BF_CloseFile(*handle) < 0)
+	if (BF_CloseFile(fileHandle) < 0)
 	{
-		printf("Could not close block level file! FileHandle: %d\n", *handle);
+		printf("Could not close block level file! FileHandle: %d\n", fileHandle);
 		BF_PrintError("");
+		ReleaseOpenFile(file);
 
 		return -1;
 	}
 
-	// Reset the internal storage.
-	s_HandleStorage = -1;
+	// Remove the file from the table.
+	RemoveOpenFile(&s_OpenFiles, file);
 
-	return 0;
+	return result;
 }
 
-int32_t HT_InsertEntry(HT_info handle, Record record)
+int32_t HT_CloseIndex(HT_info* handle)
+{
+	return CloseIndex(handle, false);
+}
+
+int32_t HT_CloseIndexWithTruncation(HT_info* handle)
+{
+	return CloseIndex(handle, true);
+}
+
+// Allocates a zeroed data block to append to the chain of a bucket whose last data block is lastDataBlockIndex, or
+// INVALID_BLOCK_INDEX if the bucket is empty. Overflow blocks are taken from the blocks reserved by the last block, then from the
+// free block list, or from a new extent of BUCKET_EXTENT_BLOCK_COUNT blocks. The number of blocks the new block reserves is stored
+// in reservedBlockCount. Returns the index of the new block on success and -1 on failure.
+static int32_t AllocateDataBlock(HT_info handle, int32_t lastDataBlockIndex, uint8_t* reservedBlockCount)
 {
+	// The first data block of a bucket is allocated alone, since most buckets never overflow.
+	uint32_t blockCount = 1;
+
+	if (lastDataBlockIndex != INVALID_BLOCK_INDEX)
+	{
+		// Retrieve a pointer to the last data block of the chain.
+		uint8_t* lastDataBlockPtr = nullptr;
+		if (BF_ReadBlock(handle, lastDataBlockIndex, (void**)&lastDataBlockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, lastDataBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// If the last block reserves blocks, the next one is right after it.
+		DataBlockHeader* lastDataBlockHeader = (DataBlockHeader*)lastDataBlockPtr;
+		if (lastDataBlockHeader->ReservedBlockCount > 0)
+		{
+			*reservedBlockCount = lastDataBlockHeader->ReservedBlockCount - 1;
+			return lastDataBlockIndex + 1;
+		}
+
+		// Otherwise the chain gets a new extent.
+		blockCount = BUCKET_EXTENT_BLOCK_COUNT;
+	}
+
+	// Allocate the new data blocks, or reuse a free one.
+	uint32_t allocatedBlockCount = 0;
+	int32_t dataBlockIndex = AllocateChainBlocks(handle, FREE_BLOCK_LIST_OFFSET, blockCount, &allocatedBlockCount);
+	if (dataBlockIndex == -1)
+	{
+		printf("Could not allocate data block for the hash file! FileHandle: %d\n", handle);
+		return -1;
+	}
+
+	*reservedBlockCount = (uint8_t)(allocatedBlockCount - 1);
+	return dataBlockIndex;
+}
+
+static int32_t InsertEntry(HT_info handle, Record record)
+{
+	// Retrieve the block size of the hash file.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
 	// Retrieve a pointer to the hash file header block.
 	uint8_t* headerBlockPtr = nullptr;
 	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
@@ -334,8 +464,8 @@ int32_t HT_InsertEntry(HT_info handle, Record record)
 	// First we need to find the bucket block where the bucket index is in.
 
 	// Calculate in which block the above bucket index is in. This is similar to calculating the total bucket block size.
-	int32_t bucketBlockNumber = ((bucketIndex + 1) / MAX_BUCKET_COUNT_PER_BLOCK);
-	bucketBlockNumber += (((bucketIndex + 1) % MAX_BUCKET_COUNT_PER_BLOCK) > 0) ? 1 : 0;
+	int32_t bucketBlockNumber = ((bucketIndex + 1) / MAX_BUCKET_COUNT_PER_BLOCK(blockSize));
+	bucketBlockNumber += (((bucketIndex + 1) % MAX_BUCKET_COUNT_PER_BLOCK(blockSize)) > 0) ? 1 : 0;
 
 	// Start from the first actuall bucket block.
 	int32_t currentBucketBlockIndex = fileHeader->NextBlockIndex;
@@ -368,7 +498,7 @@ int32_t HT_InsertEntry(HT_info handle, Record record)
 	int32_t bucketBlockIndex = previousBucketBlockIndex;
 
 	// Find the bucket index relative to the bucket block.
-	int32_t bucketIndexInBucketBlock = bucketIndex % MAX_BUCKET_COUNT_PER_BLOCK;
+	int32_t bucketIndexInBucketBlock = bucketIndex % MAX_BUCKET_COUNT_PER_BLOCK(blockSize);
 
 	// Retrieve a pointer to the bucket block.
 	uint8_t* bucketBlockPtr = nullptr;
@@ -414,14 +544,14 @@ int32_t HT_InsertEntry(HT_info handle, Record record)
 		// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
 		currentDataBlockPtr += sizeof(DataBlockHeader);
 
-		// Interate through all the record slots that are occupied in the current data block.
-		for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->RecordCount; recordIndex++)
+		// Interate through all the record slots that are used in the current data block.
+		for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->SlotCount; recordIndex++)
 		{
 			// Treat the current pointer as a record.
 			Record* currentRecord = (Record*)currentDataBlockPtr;
 
 			// If the current record's key is the same as the one we want to insert, it's already in the hash so we exit.
-			if (currentRecord->ID == record.ID)
+			if (!IS_SLOT_DELETED(currentDataBlockHeader, blockSize, recordIndex) && currentRecord->ID == record.ID)
 			{
 				printf("The specified record is already in the hash file! RecordID: %d\n", record.ID);
 				return -1;
@@ -460,20 +590,12 @@ int32_t HT_InsertEntry(HT_info handle, Record record)
 		DataBlockHeader* currentDataBlockHeader = (DataBlockHeader*)currentDataBlockPtr;
 
 		// If there's space in the current data block, we insert here.
-		if (currentDataBlockHeader->RecordCount < MAX_RECORD_COUNT_PER_BLOCK)
+		if (currentDataBlockHeader->RecordCount < MAX_RECORD_COUNT_PER_BLOCK(blockSize))
 		{
-			// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
-			currentDataBlockPtr += sizeof(DataBlockHeader);
-
-			// Offset the block pointer by the size of the record times the number of records so it points to the first byte
-			// of the first empty record slot.
-			currentDataBlockPtr += currentDataBlockHeader->RecordCount * sizeof(Record);
-
-			// Copy the record into the data block.
-			memcpy(currentDataBlockPtr, &record, sizeof(Record));
-
-			// Increment the current data block's record count.
-			currentDataBlockHeader->RecordCount++;
+			// Copy the record into a free slot of the data block, which also increments the current data block's record count.
+			Record* slot = AddRecordSlot(currentDataBlockPtr, blockSize, sizeof(DataBlockHeader), &currentDataBlockHeader->RecordCount,
+				&currentDataBlockHeader->SlotCount);
+			memcpy(slot, &record, sizeof(Record));
 
 			// Write the updated contents of the current hash file data block to the disk.
 			if (BF_WriteBlock(handle, currentDataBlockIndex) < 0)
@@ -496,27 +618,11 @@ int32_t HT_InsertEntry(HT_info handle, Record record)
 	// If we are here, a new data block needs to be created. Either because this is the first entry in the bucket or because we ran
 	// out of space in all of the currently allocated data blocks.
 
-	// Allocate a new data block.
-	if (BF_AllocateBlock(handle) < 0)
-	{
-		printf("Could not allocate data block for the hash file! FileHandle: %d\n", handle);
-		BF_PrintError("");
-
-		return -1;
-	}
-
-	// Get the new block count.
-	int32_t blockCount = BF_GetBlockCounter(handle);
-	if (blockCount < 0)
-	{
-		printf("Could not retrieve block count for the hash file! FileHandle: %d\n", handle);
-		BF_PrintError("");
-
+	// Allocate a new data block, next to the last one of the chain if it reserved one.
+	uint8_t reservedBlockCount = 0;
+	int32_t newDataBlockIndex = AllocateDataBlock(handle, previousDataBlockIndex, &reservedBlockCount);
+	if (newDataBlockIndex == -1)
 		return -1;
-	}
-
-	// Calculate the new data block index.
-	int32_t newDataBlockIndex = blockCount - 1;
 
 	// Retrieve a pointer to the new data block.
 	uint8_t* newDataBlockPtr = nullptr;
@@ -531,6 +637,8 @@ int32_t HT_InsertEntry(HT_info handle, Record record)
 	// Create the data block header and fill it's data.
 	DataBlockHeader newDataBlockHeader = { };
 	newDataBlockHeader.RecordCount = 1;
+	newDataBlockHeader.SlotCount = 1;
+	newDataBlockHeader.ReservedBlockCount = reservedBlockCount;
 	newDataBlockHeader.NextBlockIndex = INVALID_BLOCK_INDEX;
 
 	// Copy the new data block header into the new data block.
@@ -565,9 +673,10 @@ int32_t HT_InsertEntry(HT_info handle, Record record)
 			return -1;
 		}
 
-		// Get the header and update the next block index.
+		// Get the header and update the next block index. The new block takes over the reserved blocks.
 		DataBlockHeader* previousDataBlockHeader = (DataBlockHeader*)previousDataBlockPtr;
 		previousDataBlockHeader->NextBlockIndex = newDataBlockIndex;
+		previousDataBlockHeader->ReservedBlockCount = 0;
 
 		// Write the contents of the previous hash data block to the disk.
 		if (BF_WriteBlock(handle, previousDataBlockIndex) < 0)
@@ -617,11 +726,125 @@ int32_t HT_InsertEntry(HT_info handle, Record record)
 	return newDataBlockIndex;
 }
 
-int32_t HT_DeleteEntry(HT_info handle, void* keyValue)
+int32_t HT_InsertEntry(HT_info handle, Record record)
+{
+	// Ensure that the file is open.
+	OpenFile* file = AcquireOpenFile(&s_OpenFiles, handle, true);
+	if (file == nullptr)
+	{
+		printf("Cannot insert to hash file since it's not open! FileHandle: %d\n", handle);
+		return -1;
+	}
+
+	// Perform the operation while holding the lock of the file, so that it doesn't interleave with other operations on it.
+	int32_t result = InsertEntry(handle, record);
+
+	// Commit the changes, even those of a failed operation, so that their blocks can be written back.
+	if (CommitOpenFile(file) == -1)
+		result = -1;
+
+	return result;
+}
+
+// Unlinks a data block that a delete left empty from the chain of it's bucket and frees it, along with the blocks it reserves. If
+// it was the last block of the chain and the previous block is right before it, the previous block reserves it instead. The bucket
+// is stored bucketIndexInBucketBlock buckets into the bucket block bucketBlockIndex. Returns 0 on success and -1 on failure.
+static int32_t UnlinkEmptyDataBlock(HT_info handle, int32_t bucketBlockIndex, int32_t bucketIndexInBucketBlock, int32_t previousDataBlockIndex,
+	int32_t dataBlockIndex)
+{
+	// Retrieve a pointer to the empty data block.
+	uint8_t* dataBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, dataBlockIndex, (void**)&dataBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, dataBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Keep the header, since the block may be evicted while the chain is updated.
+	DataBlockHeader dataBlockHeader = *(DataBlockHeader*)dataBlockPtr;
+
+	if (previousDataBlockIndex == INVALID_BLOCK_INDEX)
+	{
+		// The next block becomes the first block of the bucket.
+
+		// Retrieve a pointer to the bucket block.
+		uint8_t* bucketBlockPtr = nullptr;
+		if (BF_ReadBlock(handle, bucketBlockIndex, (void**)&bucketBlockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, bucketBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// Offset the bucket block pointer to the bucket and update it.
+		bucketBlockPtr += sizeof(BucketBlockHeader) + bucketIndexInBucketBlock * sizeof(int32_t);
+		*(int32_t*)bucketBlockPtr = dataBlockHeader.NextBlockIndex;
+
+		// Write the contents of the bucket block to the disk.
+		if (BF_WriteBlock(handle, bucketBlockIndex) < 0)
+		{
+			printf("Could not write hash bucket block to disk! FileHandle: %d, BlockIndex: %d\n", handle, bucketBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+	}
+	else
+	{
+		// Retrieve a pointer to the previous data block.
+		uint8_t* previousDataBlockPtr = nullptr;
+		if (BF_ReadBlock(handle, previousDataBlockIndex, (void**)&previousDataBlockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, previousDataBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// Link the previous block to the next one. If the empty block ended the chain right after it, it takes over the empty block
+		// and the blocks it reserves.
+		DataBlockHeader* previousDataBlockHeader = (DataBlockHeader*)previousDataBlockPtr;
+		previousDataBlockHeader->NextBlockIndex = dataBlockHeader.NextBlockIndex;
+
+		bool isReserved = (dataBlockHeader.NextBlockIndex == INVALID_BLOCK_INDEX && previousDataBlockIndex + 1 == dataBlockIndex);
+		if (isReserved)
+			previousDataBlockHeader->ReservedBlockCount = dataBlockHeader.ReservedBlockCount + 1;
+
+		// Write the contents of the previous hash data block to the disk.
+		if (BF_WriteBlock(handle, previousDataBlockIndex) < 0)
+		{
+			printf("Could not write hash data block to disk! FileHandle: %d, BlockIndex: %d\n", handle, previousDataBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		if (isReserved)
+			return 0;
+	}
+
+	// Free the block so that the next new data block reuses it.
+	return FreeBlocks(handle, FREE_BLOCK_LIST_OFFSET, dataBlockIndex, 1 + dataBlockHeader.ReservedBlockCount);
+}
+
+static int32_t DeleteEntry(HT_info handle, void* keyValue)
 {
 	// The key is an integer so cast the void pointer.
 	int32_t key = *(int32_t*)keyValue;
 
+	// Retrieve the block size of the hash file.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
 	// Retrieve a pointer to the hash file header block.
 	uint8_t* headerBlockPtr = nullptr;
 	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
@@ -641,8 +864,8 @@ int32_t HT_DeleteEntry(HT_info handle, void* keyValue)
 	// First we need to find the bucket block where the bucket index is in.
 
 	// Calculate in which block the above bucket index is in. This is similar to calculating the total bucket block size.
-	int32_t bucketBlockNumber = ((bucketIndex + 1) / MAX_BUCKET_COUNT_PER_BLOCK);
-	bucketBlockNumber += (((bucketIndex + 1) % MAX_BUCKET_COUNT_PER_BLOCK) > 0) ? 1 : 0;
+	int32_t bucketBlockNumber = ((bucketIndex + 1) / MAX_BUCKET_COUNT_PER_BLOCK(blockSize));
+	bucketBlockNumber += (((bucketIndex + 1) % MAX_BUCKET_COUNT_PER_BLOCK(blockSize)) > 0) ? 1 : 0;
 
 	// Start from the first actuall bucket block.
 	int32_t currentBucketBlockIndex = fileHeader->NextBlockIndex;
@@ -675,7 +898,7 @@ int32_t HT_DeleteEntry(HT_info handle, void* keyValue)
 	int32_t bucketBlockIndex = previousBucketBlockIndex;
 
 	// Find the bucket index relative to the bucket block.
-	int32_t bucketIndexInBucketBlock = bucketIndex % MAX_BUCKET_COUNT_PER_BLOCK;
+	int32_t bucketIndexInBucketBlock = bucketIndex % MAX_BUCKET_COUNT_PER_BLOCK(blockSize);
 
 	// Retrieve a pointer to the bucket block.
 	uint8_t* bucketBlockPtr = nullptr;
@@ -700,6 +923,9 @@ int32_t HT_DeleteEntry(HT_info handle, void* keyValue)
 	// Start from the first actual block of data.
 	int32_t currentDataBlockIndex = dataBlockIndex;
 
+	// The previous block is invalid initially.
+	int32_t previousDataBlockIndex = INVALID_BLOCK_INDEX;
+
 	// Loop until the end of the allocated blocks.
 	while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
 	{
@@ -719,35 +945,18 @@ int32_t HT_DeleteEntry(HT_info handle, void* keyValue)
 		// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
 		currentDataBlockPtr += sizeof(DataBlockHeader);
 
-		// Interate through all the record slots that are occupied in the current block.
-		for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->RecordCount; recordIndex++)
+		// Interate through all the record slots that are used in the current block.
+		for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->SlotCount; recordIndex++)
 		{
 			// Treat the current pointer as a record.
 			Record* currentRecord = (Record*)currentDataBlockPtr;
 
 			// If the current records ID is the same as the key, we want to delete it and exit.
-			if (currentRecord->ID == key)
+			if (!IS_SLOT_DELETED(currentDataBlockHeader, blockSize, recordIndex) && currentRecord->ID == key)
 			{
-				// What we want to do is move the contents of the records after the current record up the size of one record.
-
-				// Calculate the size of the records after the current record.
-				uint32_t byteCountOfRecordDataAfterCurrentRecord = (currentDataBlockHeader->RecordCount - (recordIndex + 1)) * sizeof(Record);
-
-				// Copy the records after the current record, to the current record's position in the block.
-				memcpy(currentDataBlockPtr, currentDataBlockPtr + sizeof(Record), byteCountOfRecordDataAfterCurrentRecord);
-
-				// Decrement the current block record count;
-				currentDataBlockHeader->RecordCount--;
-
-				// Offset the block pointer by the size of a block times the number of records left in the block after the current one.
-				// This way the pointer points to the first byte of the empty space in the block.
-				currentDataBlockPtr += byteCountOfRecordDataAfterCurrentRecord;
-
-				// Calculate the number of empty bytes in the block.
-				uint32_t emptyByteCount = BLOCK_SIZE - (sizeof(DataBlockHeader) + currentDataBlockHeader->RecordCount * sizeof(Record));
-
-				// Set the empty bytes to zero.
-				memset(currentDataBlockPtr, 0, emptyByteCount);
+				// Mark the slot of the record as deleted. The records after it stay where they are.
+				DeleteRecordSlot((uint8_t*)currentDataBlockHeader, blockSize, sizeof(DataBlockHeader), &currentDataBlockHeader->RecordCount,
+					&currentDataBlockHeader->SlotCount, recordIndex);
 
 				// Write the updated contents of the current hash data block to the disk.
 				if (BF_WriteBlock(handle, currentDataBlockIndex) < 0)
@@ -758,6 +967,10 @@ int32_t HT_DeleteEntry(HT_info handle, void* keyValue)
 					return -1;
 				}
 
+				// A block left empty is unlinked, so that lookups no longer read it and inserts reuse it.
+				if (currentDataBlockHeader->RecordCount == 0)
+					return UnlinkEmptyDataBlock(handle, bucketBlockIndex, bucketIndexInBucketBlock, previousDataBlockIndex, currentDataBlockIndex);
+
 				// Exit the function since we deleted.
 				return 0;
 			}
@@ -766,7 +979,8 @@ int32_t HT_DeleteEntry(HT_info handle, void* keyValue)
 			currentDataBlockPtr += sizeof(Record);
 		}
 
-		// Update the current block index.
+		// Update the previous and current block indices.
+		previousDataBlockIndex = currentDataBlockIndex;
 		currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
 	}
 
@@ -775,13 +989,43 @@ int32_t HT_DeleteEntry(HT_info handle, void* keyValue)
 	return -1;
 }
 
-int32_t HT_GetAllEntries(HT_info handle, void* keyValue)
+int32_t HT_DeleteEntry(HT_info handle, void* keyValue)
+{
+	// Ensure that the file is open.
+	OpenFile* file = AcquireOpenFile(&s_OpenFiles, handle, true);
+	if (file == nullptr)
+	{
+		printf("Cannot delete from hash file since it's not open! FileHandle: %d\n", handle);
+		return -1;
+	}
+
+	// Perform the operation while holding the lock of the file, so that it doesn't interleave with other operations on it.
+	int32_t result = DeleteEntry(handle, keyValue);
+
+	// Commit the changes, even those of a failed operation, so that their blocks can be written back.
+	if (CommitOpenFile(file) == -1)
+		result = -1;
+
+	return result;
+}
+
+static int32_t GetAllEntries(HT_info handle, void* keyValue)
 {
 	// Key value can be nullptr. If it's not get the actual value otherwise use a dummy.
 	int32_t key = -1;
 	if (keyValue != nullptr)
 		key = *(int32_t*)keyValue;
 
+	// Retrieve the block size of the hash file.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
 	// Retrieve a pointer to the hash file header block.
 	uint8_t* headerBlockPtr = nullptr;
 	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
@@ -808,8 +1052,8 @@ int32_t HT_GetAllEntries(HT_info handle, void* keyValue)
 		uint32_t blocksTraversed = 1;
 
 		// Calculate in which block the above bucket index is in. This is similar to calculating the total bucket block size.
-		int32_t bucketBlockNumber = ((bucketIndex + 1) / MAX_BUCKET_COUNT_PER_BLOCK);
-		bucketBlockNumber += (((bucketIndex + 1) % MAX_BUCKET_COUNT_PER_BLOCK) > 0) ? 1 : 0;
+		int32_t bucketBlockNumber = ((bucketIndex + 1) / MAX_BUCKET_COUNT_PER_BLOCK(blockSize));
+		bucketBlockNumber += (((bucketIndex + 1) % MAX_BUCKET_COUNT_PER_BLOCK(blockSize)) > 0) ? 1 : 0;
 
 		// Start from the first actuall bucket block.
 		int32_t currentBucketBlockIndex = fileHeader->NextBlockIndex;
@@ -845,7 +1089,7 @@ int32_t HT_GetAllEntries(HT_info handle, void* keyValue)
 		int32_t bucketBlockIndex = previousBucketBlockIndex;
 
 		// Find the bucket index relative to the bucket block.
-		int32_t bucketIndexInBucketBlock = bucketIndex % MAX_BUCKET_COUNT_PER_BLOCK;
+		int32_t bucketIndexInBucketBlock = bucketIndex % MAX_BUCKET_COUNT_PER_BLOCK(blockSize);
 
 		// Retrieve a pointer to the bucket block.
 		uint8_t* bucketBlockPtr = nullptr;
@@ -892,14 +1136,14 @@ int32_t HT_GetAllEntries(HT_info handle, void* keyValue)
 			// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
 			currentDataBlockPtr += sizeof(DataBlockHeader);
 
-			// Interate through all the record slots that are occupied in the current block.
-			for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->RecordCount; recordIndex++)
+			// Interate through all the record slots that are used in the current block.
+			for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->SlotCount; recordIndex++)
 			{
 				// Treat the current pointer as a record.
 				Record* currentRecord = (Record*)currentDataBlockPtr;
 
 				// If the current records ID is the same as the key, we want to print it and exit.
-				if (currentRecord->ID == key)
+				if (!IS_SLOT_DELETED(currentDataBlockHeader, blockSize, recordIndex) && currentRecord->ID == key)
 				{
 					printf("ID: %d, Name: %s, Surname: %s, Address: %s\n", currentRecord->ID, currentRecord->Name, currentRecord->Surname, currentRecord->Address);
 					return blocksTraversed;
@@ -943,9 +1187,13 @@ int32_t HT_GetAllEntries(HT_info handle, void* keyValue)
 
 			// Calculate the number of buckets in the current bucket block. If it's not the last one there's the
 			// max number of buckets. Otherwise it's the remainder.
-			int32_t bucketsInCurrentBlock = MAX_BUCKET_COUNT_PER_BLOCK;
+			int32_t bucketsInCurrentBlock = MAX_BUCKET_COUNT_PER_BLOCK(blockSize);
 			if (currentBucketBlockHeader->NextBlockIndex == INVALID_BLOCK_INDEX)
-				bucketsInCurrentBlock = fileHeader->BucketCount % MAX_BUCKET_COUNT_PER_BLOCK;
+				bucketsInCurrentBlock = fileHeader->BucketCount % MAX_BUCKET_COUNT_PER_BLOCK(blockSize);
+
+			// Start reading the first data blocks of the buckets in the block. Empty buckets are skipped by the block level, and
+			// a failed prefetch only means that the blocks are read when they are reached.
+			BF_PrefetchBlocks(handle, (int32_t*)currentBucketBlockPtr, bucketsInCurrentBlock);
 
 			// Loop though all the buckets in the block.
 			for (uint32_t bucketIndex = 0; bucketIndex < bucketsInCurrentBlock; bucketIndex++)
@@ -975,12 +1223,13 @@ int32_t HT_GetAllEntries(HT_info handle, void* keyValue)
 					// Offset the pointer by the size of the header so it points to the beginning of the record data.
 					currentDataBlockPtr += sizeof(DataBlockHeader);
 
-					// Loop through all the records in the block.
-					for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->RecordCount; recordIndex++)
+					// Loop through all the used record slots in the block.
+					for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->SlotCount; recordIndex++)
 					{
-						// Get the current record and print it.
+						// Get the current record and print it, unless it's deleted.
 						Record* currentRecord = (Record*)currentDataBlockPtr;
-						printf("ID: %d, Name: %s, Surname: %s, Address: %s\n", currentRecord->ID, currentRecord->Name, currentRecord->Surname, currentRecord->Address);
+						if (!IS_SLOT_DELETED(currentDataBlockHeader, blockSize, recordIndex))
+							printf("ID: %d, Name: %s, Surname: %s, Address: %s\n", currentRecord->ID, currentRecord->Name, currentRecord->Surname, currentRecord->Address);
 
 						// Increment the pointer by the size of a record so it points to the next record in the block.
 						currentDataBlockPtr += sizeof(Record);
@@ -1002,6 +1251,269 @@ int32_t HT_GetAllEntries(HT_info handle, void* keyValue)
 	}
 }
 
+int32_t HT_GetAllEntries(HT_info handle, void* keyValue)
+{
+	// Ensure that the file is open.
+	OpenFile* file = AcquireOpenFile(&s_OpenFiles, handle, false);
+	if (file == nullptr)
+	{
+		printf("Cannot get entries from hash file since it's not open! FileHandle: %d\n", handle);
+		return -1;
+	}
+
+	// Perform the operation while holding the lock of the file shared, so that lookups run concurrently with each other.
+	int32_t result = GetAllEntries(handle, keyValue);
+	ReleaseOpenFile(file);
+
+	return result;
+}
+
+// Pins a data block for a cursor. Returns 0 on success and -1 on failure.
+static int32_t PinCursorDataBlock(HT_Cursor* cursor, int32_t dataBlockIndex)
+{
+	// Pin the data block for reading, so that the records returned stay in memory until the cursor moves past it.
+	uint8_t* dataBlockPtr = nullptr;
+	if (BF_PinBlock(cursor->File->Handle, dataBlockIndex, BF_LATCH_SHARED, (void**)&dataBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", cursor->File->Handle, dataBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	cursor->DataBlockIndex = dataBlockIndex;
+	cursor->DataBlockPtr = dataBlockPtr;
+	cursor->SlotIndex = 0;
+
+	return 0;
+}
+
+// Unpins the data block of a cursor, if it has one. Returns 0 on success and -1 on failure.
+static int32_t UnpinCursorDataBlock(HT_Cursor* cursor)
+{
+	if (cursor->DataBlockIndex == INVALID_BLOCK_INDEX)
+		return 0;
+
+	int32_t dataBlockIndex = cursor->DataBlockIndex;
+	cursor->DataBlockIndex = INVALID_BLOCK_INDEX;
+	cursor->DataBlockPtr = nullptr;
+
+	if (BF_UnpinBlock(cursor->File->Handle, dataBlockIndex) < 0)
+	{
+		printf("Could not unpin hash data block! FileHandle: %d, BlockIndex: %d\n", cursor->File->Handle, dataBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	return 0;
+}
+
+// Moves a cursor to the first data block of the next bucket it scans, skipping empty buckets. The data block index of the cursor is
+// left invalid if there are no buckets left. Returns 0 on success and -1 on failure.
+static int32_t MoveCursorToNextBucket(HT_Cursor* cursor)
+{
+	// The block level handle of the file.
+	HT_info handle = cursor->File->Handle;
+
+	while (cursor->RemainingBucketCount > 0)
+	{
+		// Retrieve a pointer to the bucket block of the bucket.
+		uint8_t* bucketBlockPtr = nullptr;
+		if (BF_ReadBlock(handle, cursor->BucketBlockIndex, (void**)&bucketBlockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, cursor->BucketBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		int32_t* buckets = (int32_t*)(bucketBlockPtr + sizeof(BucketBlockHeader));
+
+		// Start reading the first data blocks of the buckets of a bucket block when a scan of all the buckets reaches it, like
+		// HT_GetAllEntries does.
+		uint32_t bucketsPerBlock = MAX_BUCKET_COUNT_PER_BLOCK(cursor->BlockSize);
+		if (!cursor->HasKey && cursor->BucketIndexInBucketBlock == 0)
+		{
+			uint32_t bucketsInBlock = (cursor->RemainingBucketCount < bucketsPerBlock) ? cursor->RemainingBucketCount : bucketsPerBlock;
+			BF_PrefetchBlocks(handle, buckets, bucketsInBlock);
+		}
+
+		// Extract the index of the first data block of the bucket, and move to the next bucket.
+		int32_t dataBlockIndex = buckets[cursor->BucketIndexInBucketBlock++];
+		cursor->RemainingBucketCount--;
+
+		if (cursor->BucketIndexInBucketBlock == bucketsPerBlock)
+		{
+			cursor->BucketBlockIndex = ((BucketBlockHeader*)bucketBlockPtr)->NextBlockIndex;
+			cursor->BucketIndexInBucketBlock = 0;
+		}
+
+		if (dataBlockIndex != INVALID_BLOCK_INDEX)
+			return PinCursorDataBlock(cursor, dataBlockIndex);
+	}
+
+	return 0;
+}
+
+// Positions a new cursor on the first bucket it scans. Returns 0 on success and -1 on failure.
+static int32_t ScanOpen(HT_Cursor* cursor, void* keyValue)
+{
+	// The block level handle of the file.
+	HT_info handle = cursor->File->Handle;
+
+	// Retrieve the block size of the hash file.
+	cursor->BlockSize = BF_GetBlockSize(handle);
+	if (cursor->BlockSize < 0)
+	{
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Retrieve a pointer to the hash file header block.
+	uint8_t* headerBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to hash header block! FileHandle: %d, BlockIndex: %d\n", handle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Since this file exists, we know there's a FileHeader in the first bytes of the header block. So we treat the pointer as such.
+	FileHeader* fileHeader = (FileHeader*)headerBlockPtr;
+
+	// Start from the first bucket, and scan all of them.
+	cursor->BucketBlockIndex = fileHeader->NextBlockIndex;
+	cursor->BucketIndexInBucketBlock = 0;
+	cursor->RemainingBucketCount = fileHeader->BucketCount;
+
+	if (keyValue != nullptr)
+	{
+		// If there's a key, only it's bucket is scanned.
+		cursor->HasKey = true;
+		cursor->Key = *(int32_t*)keyValue;
+
+		// Hash the record ID and find the bucket index.
+		int32_t bucketIndex = HashFunction(cursor->Key, fileHeader->BucketCount);
+		uint32_t bucketsPerBlock = MAX_BUCKET_COUNT_PER_BLOCK(cursor->BlockSize);
+
+		// Loop through the bucket blocks before the one the bucket index is in.
+		for (uint32_t bucketBlockNumber = 0; bucketBlockNumber < bucketIndex / bucketsPerBlock; bucketBlockNumber++)
+		{
+			// Retrieve a pointer to the current bucket block.
+			uint8_t* bucketBlockPtr = nullptr;
+			if (BF_ReadBlock(handle, cursor->BucketBlockIndex, (void**)&bucketBlockPtr) < 0)
+			{
+				printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, cursor->BucketBlockIndex);
+				BF_PrintError("");
+
+				return -1;
+			}
+
+			cursor->BucketBlockIndex = ((BucketBlockHeader*)bucketBlockPtr)->NextBlockIndex;
+		}
+
+		cursor->BucketIndexInBucketBlock = bucketIndex % bucketsPerBlock;
+		cursor->RemainingBucketCount = 1;
+	}
+
+	return MoveCursorToNextBucket(cursor);
+}
+
+HT_Cursor* HT_ScanOpen(HT_info handle, void* keyValue)
+{
+	// Ensure that the file is open. The cursor holds the lock of the file shared until it's closed, so that the blocks it returns
+	// records from don't change.
+	OpenFile* file = AcquireOpenFile(&s_OpenFiles, handle, false);
+	if (file == nullptr)
+	{
+		printf("Cannot scan hash file since it's not open! FileHandle: %d\n", handle);
+		return nullptr;
+	}
+
+	// Allocate the cursor.
+	HT_Cursor* cursor = (HT_Cursor*)malloc(sizeof(HT_Cursor));
+	if (cursor == nullptr)
+	{
+		printf("Could not allocate the cursor of the hash file! FileHandle: %d\n", handle);
+		ReleaseOpenFile(file);
+
+		return nullptr;
+	}
+
+	cursor->File = file;
+	cursor->HasKey = false;
+	cursor->Key = 0;
+	cursor->DataBlockIndex = INVALID_BLOCK_INDEX;
+	cursor->DataBlockPtr = nullptr;
+	cursor->SlotIndex = 0;
+
+	if (ScanOpen(cursor, keyValue) == -1)
+	{
+		UnpinCursorDataBlock(cursor);
+		ReleaseOpenFile(file);
+		free(cursor);
+
+		return nullptr;
+	}
+
+	return cursor;
+}
+
+int32_t HT_ScanNextBatch(HT_Cursor* cursor, const Record** records, int32_t maxRecordCount)
+{
+	if (maxRecordCount <= 0)
+	{
+		printf("Invalid number of records to scan! RecordCount: %d\n", maxRecordCount);
+		return -1;
+	}
+
+	// Loop until a data block has records left, or the scan is over.
+	while (cursor->DataBlockIndex != INVALID_BLOCK_INDEX)
+	{
+		DataBlockHeader* dataBlockHeader = (DataBlockHeader*)cursor->DataBlockPtr;
+
+		// Return the next records of the pinned data block, if any are left.
+		uint32_t recordCount = CollectRecordSlots(cursor->DataBlockPtr, cursor->BlockSize, sizeof(DataBlockHeader), dataBlockHeader->SlotCount,
+			&cursor->SlotIndex, cursor->HasKey ? &cursor->Key : nullptr, records, (uint32_t)maxRecordCount);
+		if (recordCount > 0)
+			return (int32_t)recordCount;
+
+		// Move to the next data block of the bucket, or to the next bucket, now that we are done with the data block.
+		int32_t nextDataBlockIndex = dataBlockHeader->NextBlockIndex;
+		if (UnpinCursorDataBlock(cursor) == -1)
+			return -1;
+
+		if (nextDataBlockIndex != INVALID_BLOCK_INDEX)
+		{
+			if (PinCursorDataBlock(cursor, nextDataBlockIndex) == -1)
+				return -1;
+		}
+		else if (MoveCursorToNextBucket(cursor) == -1)
+			return -1;
+	}
+
+	return 0;
+}
+
+int32_t HT_ScanNext(HT_Cursor* cursor, const Record** record)
+{
+	return HT_ScanNextBatch(cursor, record, 1);
+}
+
+int32_t HT_ScanClose(HT_Cursor* cursor)
+{
+	// Unpin the data block of the cursor, and release the lock of the file.
+	int32_t result = UnpinCursorDataBlock(cursor);
+	ReleaseOpenFile(cursor->File);
+	free(cursor);
+
+	return result;
+}
+
 int32_t HashStatistics(char* fileName)
 {
 	// Open the hash file.
@@ -1012,6 +1524,16 @@ int32_t HashStatistics(char* fileName)
 		return -1;
 	}
 
+	// Retrieve the block size of the hash file.
+	int32_t blockSize = BF_GetBlockSize(*handle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", *handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
 	// Retrieve a pointer to the hash file header block.
 	uint8_t* headerBlockPtr = nullptr;
 	if (BF_ReadBlock(*handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
@@ -1060,9 +1582,13 @@ int32_t HashStatistics(char* fileName)
 
 		// Calculate the number of buckets in the current bucket block. If it's not the last one there's the
 		// max number of buckets. Otherwise it's the remainder.
-		int32_t bucketsInCurrentBlock = MAX_BUCKET_COUNT_PER_BLOCK;
+		int32_t bucketsInCurrentBlock = MAX_BUCKET_COUNT_PER_BLOCK(blockSize);
 		if (currentBucketBlockHeader->NextBlockIndex == INVALID_BLOCK_INDEX)
-			bucketsInCurrentBlock = fileHeader->BucketCount % MAX_BUCKET_COUNT_PER_BLOCK;
+			bucketsInCurrentBlock = fileHeader->BucketCount % MAX_BUCKET_COUNT_PER_BLOCK(blockSize);
+
+		// Start reading the first data blocks of the buckets in the block. Empty buckets are skipped by the block level, and
+		// a failed prefetch only means that the blocks are read when they are reached.
+		BF_PrefetchBlocks(*handle, (int32_t*)currentBucketBlockPtr, bucketsInCurrentBlock);
 
 		// Loop though all the buckets in the block.
 		for (uint32_t bucketIndex = 0; bucketIndex < bucketsInCurrentBlock; bucketIndex++)
@@ -1177,8 +1703,18 @@ int32_t HashStatistics(char* fileName)
 }
 
 // TODO: Remove this!
-int32_t HT_DebugPrint(HT_info handle)
+static int32_t DebugPrint(HT_info handle)
 {
+	// Retrieve the block size of the hash file.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
 	uint8_t* headerBlockPtr = nullptr;
 	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
 	{
@@ -1213,9 +1749,9 @@ int32_t HT_DebugPrint(HT_info handle)
 		printf("Block %d:\n", currentBucketBlockIndex);
 		printf("\tNextBlockIndex: %d\n", currentBucketBlockHeader->NextBlockIndex);
 
-		int32_t bucketsInCurrentBlock = MAX_BUCKET_COUNT_PER_BLOCK;
+		int32_t bucketsInCurrentBlock = MAX_BUCKET_COUNT_PER_BLOCK(blockSize);
 		if (currentBucketBlockHeader->NextBlockIndex == INVALID_BLOCK_INDEX)
-			bucketsInCurrentBlock = fileHeader->BucketCount % MAX_BUCKET_COUNT_PER_BLOCK;
+			bucketsInCurrentBlock = fileHeader->BucketCount % MAX_BUCKET_COUNT_PER_BLOCK(blockSize);
 
 		for (uint32_t bucketIndex = 0; bucketIndex < bucketsInCurrentBlock; bucketIndex++)
 		{
@@ -1239,13 +1775,14 @@ int32_t HT_DebugPrint(HT_info handle)
 
 				printf("\t\t\tBlock %d:\n", currentDataBlockIndex);
 				printf("\t\t\t\tRecordCount: %d\n", currentDataBlockHeader->RecordCount);
+				printf("\t\t\t\tSlotCount: %d\n", currentDataBlockHeader->SlotCount);
 				printf("\t\t\t\tNextBlockIndex: %d\n", currentDataBlockHeader->NextBlockIndex);
 
-				for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->RecordCount; recordIndex++)
+				for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->SlotCount; recordIndex++)
 				{
 					Record* currentRecord = (Record*)currentDataBlockPtr;
 
-					printf("\t\t\t\tRecord %d:\n", recordIndex);
+					printf("\t\t\t\tRecord %d:%s\n", recordIndex, IS_SLOT_DELETED(currentDataBlockHeader, blockSize, recordIndex) ? " (deleted)" : "");
 					printf("\t\t\t\t\tID: %d\n", currentRecord->ID);
 					printf("\t\t\t\t\tName: %s\n", currentRecord->Name);
 					printf("\t\t\t\t\tSurname: %s\n", currentRecord->Surname);
@@ -1265,3 +1802,20 @@ int32_t HT_DebugPrint(HT_info handle)
 
 	return 0;
 }
+
+int32_t HT_DebugPrint(HT_info handle)
+{
+	// Ensure that the file is open.
+	OpenFile* file = AcquireOpenFile(&s_OpenFiles, handle, false);
+	if (file == nullptr)
+	{
+		printf("Cannot print hash file since it's not open! FileHandle: %d\n", handle);
+		return -1;
+	}
+
+	// Perform the operation while holding the lock of the file shared, so that lookups run concurrently with each other.
+	int32_t result = DebugPrint(handle);
+	ReleaseOpenFile(file);
+
+	return result;
+}
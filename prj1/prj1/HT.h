@@ -8,23 +8,55 @@ typedef int32_t HT_info;
 // Creates a hash file with bucketCount number of buckets. This returns 0 on success and -1 on failure.
 int32_t HT_CreateIndex(char* fileName, char attributeType, char* attributeName, int32_t attributeLength, int32_t bucketCount);
 
+// Creates a hash file with bucketCount number of buckets whose blocks are blockSize bytes. This returns 0 on success and -1 on failure.
+int32_t HT_CreateIndexWithBlockSize(char* fileName, char attributeType, char* attributeName, int32_t attributeLength, int32_t bucketCount,
+	int32_t blockSize);
+
 // Opens a hash file and returns a pointer to it's handle. Returns the file handle on success and nullptr on failure.
 HT_info* HT_OpenIndex(char* fileName);
 
 // Closes a hash file. Returns 0 on success and -1 on failure.
 int32_t HT_CloseIndex(HT_info* handle);
 
+// Closes a hash file like HT_CloseIndex, but first gives the free data blocks at the end of the file back to the file system.
+// Data blocks emptied by HT_DeleteEntry are freed and reused by later inserts, and this shrinks the file when they are the last
+// ones. Returns 0 on success and -1 on failure.
+int32_t HT_CloseIndexWithTruncation(HT_info* handle);
+
 // Inserts a record to the hash file based on the hasing of the ID. Returns the block index where the record was
 // inserted on success and -1 on failure.
 int32_t HT_InsertEntry(HT_info handle, Record record);
 
-// Deletes a record from the hash file if inserted. Returns 0 on success and -1 on failure.
+// Deletes a record from the hash file if inserted. The record's slot is marked as deleted and reused by a later insert, so the other
+// records of it's data block keep their place. A data block left empty is unlinked from it's bucket and freed, so that later
+// inserts reuse it. Returns 0 on success and -1 on failure.
 int32_t HT_DeleteEntry(HT_info handle, void* keyValue);
 
 // If keyValue == nullptr, prints all entries in he hash file, otherwise prints the entry with key == keyValue if it exists.
 // Returns the number of blocks traversed on success and -1 on failure.
 int32_t HT_GetAllEntries(HT_info handle, void* keyValue);
 
+// The state of a scan of the records of a hash file.
+typedef struct HT_Cursor HT_Cursor;
+
+// Opens a cursor over the records of a hash file, bucket by bucket, or over the record with key == keyValue if keyValue is not
+// nullptr. The records are returned as pointers into the data blocks of the hash file, pinned in memory while the cursor reads them,
+// so they are never copied. The cursor holds the lock of the file shared until it's closed, so the file is not modified or closed
+// meanwhile. It must be used and closed by the thread that opened it, before that thread modifies the file. Returns the cursor on
+// success and nullptr on failure.
+HT_Cursor* HT_ScanOpen(HT_info handle, void* keyValue);
+
+// Stores a pointer to the next record of a cursor in record. The record is valid until the next call with the cursor.
+// Returns 1 if there was a record, 0 at the end of the scan and -1 on failure.
+int32_t HT_ScanNext(HT_Cursor* cursor, const Record** record);
+
+// Stores pointers to at most maxRecordCount of the next records of a cursor in records. The records are from the same data block, and
+// valid until the next call with the cursor. Returns the number of records stored, 0 at the end of the scan and -1 on failure.
+int32_t HT_ScanNextBatch(HT_Cursor* cursor, const Record** records, int32_t maxRecordCount);
+
+// Closes a cursor, unpinning it's data block and releasing the lock of the file. Returns 0 on success and -1 on failure.
+int32_t HT_ScanClose(HT_Cursor* cursor);
+
 // Evaluates the hash function used in the hash file. Returns 0 on success and -1 on failure.
 int32_t HashStatistics(char* fileName);
 
@@ -26,19 +26,197 @@
 #define BFE_BLOCKNOTINBUF           -21
 #define BFE_INVALIDBLOCK            -22
 #define BFE_CANNOTDESTROYFILE		-23
+#define BFE_INVALIDBLOCKSIZE        -24
+#define BFE_INVALIDCONFIG           -25
+#define BFE_LOGUNSUPPORTED          -26
 
 
-/* H metavlhth opou kataxwreitai o kwdikos tou teleftaiou sfalmatos */
-int BF_Errno;
+/* H metavlhth opou kataxwreitai o kwdikos tou teleftaiou sfalmatos. Ka8e nhma (thread) exei th dikh tou. */
+extern _Thread_local int BF_Errno;
+
+/* To mege8os tou block epilegetai ana arxeio kata th dimiourgia tou kai apo8hkevetai sthn kefalida tou arxeiou.
+ * Prepei na einai dynamh tou 2 anamesa sto BF_MIN_BLOCK_SIZE kai to BF_MAX_BLOCK_SIZE.
+*/
+#define BF_MIN_BLOCK_SIZE 512
+#define BF_MAX_BLOCK_SIZE 16384
+
+/* To mege8os block pou xrhsimopoieitai apo thn BF_CreateFile */
+#define BF_DEFAULT_BLOCK_SIZE 4096
+
+
+/* Oi tropoi prosvashs sta blocks enos arxeiou.
+ * BF_BACKEND_BUFFERED:	ta blocks antigrafontai sth mnhmh endiamesou apo8hkefshs (buffer pool) tou epipedou BF.
+ * BF_BACKEND_MMAP:	to arxeio apeikonizetai sth mnhmh (mmap) kai h BF_ReadBlock epistrefei deikth kateftheian sthn apeikonish.
+ * 			Katallhlo gia fortia me polles anagnwseis, afou h prosvash den kanei antigrafh.
+*/
+typedef enum BF_Backend
+{
+	BF_BACKEND_BUFFERED = 0,
+	BF_BACKEND_MMAP
+} BF_Backend;
+
+
+/* Orizei ton tropo prosvashs gia ta arxeia pou 8a anoixtoun apo dw kai pera. Ta hdh anoixta arxeia den ephreazontai.
+ * To BF_BACKEND_MMAP den ypostirizei log, afou o pyrhnas grafei tis selides sto arxeio opote 8elei, opote h
+ * BF_OpenFileWithLog epistrefei BFE_LOGUNSUPPORTED. Ta arxeia HP, HT kai SHT tote anoigoun xwris log, opote an h
+ * BF_SetBackend klh8ei prin ta anoixei h efarmogh apeikonizontai sth mnhmh, alla xanoun thn prostasia tou log.
+ *
+ * backend:	O tropos prosvashs (BF_BACKEND_BUFFERED h BF_BACKEND_MMAP)
+*/
+void BF_SetBackend(const BF_Backend backend);
+
+
+/* Oi politikes antikatastashs twn blocks ths mnhmhs endiamesou apo8hkefshs.
+ * BF_POLICY_LRU:	vgazei to block pou xrhsimopoih8hke pio palia.
+ * BF_POLICY_CLOCK:	proseggish tou LRU me deikth rologiou kai bit anaforas, pio ftino ana prosvash.
+ * BF_POLICY_2Q:	ta blocks pou diavazontai mia fora (p.x. apo mia sarwsh) mpainoun se mikrh oura FIFO kai den
+ * 			vgazoun ta blocks pou xrhsimopoiountai syxna.
+ * BF_POLICY_ARC:	prosarmozei to mege8os ths ouras twn blocks pou diavasthkan mia fora analoga me to fortio.
+ * BF_POLICY_LRU_K:	LRU-2, vgazei to block me thn palioterh proteleftaia prosvash. Antexei stis sarwseis.
+*/
+typedef enum BF_ReplacementPolicy
+{
+	BF_POLICY_LRU = 0,
+	BF_POLICY_CLOCK,
+	BF_POLICY_2Q,
+	BF_POLICY_ARC,
+	BF_POLICY_LRU_K
+} BF_ReplacementPolicy;
+
+
+/* Orizei thn politikh antikatastashs. Mporei na klh8ei prin h meta thn BF_Init. Ta blocks pou einai hdh sth mnhmh
+ * paramenoun, alla h nea politikh xekinaei xwris istoriko.
+ *
+ * policy:	H politikh antikatastashs
+*/
+void BF_SetReplacementPolicy(const BF_ReplacementPolicy policy);
+
+
+/* Ta statistika ths mnhmhs endiamesou apo8hkefshs apo thn arxikopoihsh h thn teleftaia BF_ResetStatistics.
+ * HitCount:		oi anagnwseis block pou vrhkan to block sth mnhmh
+ * MissCount:		oi anagnwseis block pou to diavasan apo to arxeio
+ * EvictionCount:	ta blocks pou vgh8hkan apo th mnhmh gia na xwresoun alla
+ * PrefetchCount:	ta blocks pou diavasthkan ek twn proterwn apo thn BF_Prefetch kai thn BF_PrefetchBlocks
+*/
+typedef struct BF_Statistics
+{
+	unsigned long long HitCount;
+	unsigned long long MissCount;
+	unsigned long long EvictionCount;
+	unsigned long long PrefetchCount;
+} BF_Statistics;
+
+
+/* Epistrefei ta statistika ths mnhmhs endiamesou apo8hkefshs.
+ *
+ * statistics:	Deikths sth domh pou 8a gemisei
+*/
+void BF_GetStatistics(BF_Statistics* statistics);
 
-/* Kathorizei to mege8os enos block apo to arxeio  */
-#define BLOCK_SIZE 512
+
+/* Mhdenizei ta statistika ths mnhmhs endiamesou apo8hkefshs. */
+void BF_ResetStatistics();
+
+
+/* To plh8os twn frames ths mnhmhs endiamesou apo8hkefshs kai twn taftoxrona anoixtwn arxeiwn pou xrhsimopoiei h BF_Init */
+#define BF_DEFAULT_FRAME_COUNT 256
+#define BF_DEFAULT_MAX_OPEN_FILES 25
+
+/* Ka8e posa milliseconds grafei ta allagmena blocks to nhma tou paraskhniou sth leitourgia BF_WRITE_BACK */
+#define BF_DEFAULT_FLUSH_INTERVAL 100
+
+/* Kata posa blocks desmevetai ek twn proterwn o xwros enos arxeiou sto diskos */
+#define BF_DEFAULT_EXTENT_BLOCK_COUNT 64
+
+
+/* Oi tropoi eggrafhs twn blocks.
+ * BF_WRITE_THROUGH:	h BF_WriteBlock grafei to block sto arxeio amesws.
+ * BF_WRITE_BACK:	h BF_WriteBlock mono shmeiwnei to block ws allagmeno. Ena nhma sto paraskhnio grafei ta allagmena
+ * 			blocks taxinomhmena, me mia klhsh pwritev gia ka8e seira diadoxikwn blocks. Ta blocks grafontai
+ * 			epishs otan vgainoun apo th mnhmh endiamesou apo8hkefshs. H BF_Flush kai h BF_CloseFile ta grafoun
+ * 			amesws kai perimenoun na ftasoun sto diskos.
+*/
+typedef enum BF_WriteMode
+{
+	BF_WRITE_THROUGH = 0,
+	BF_WRITE_BACK
+} BF_WriteMode;
+
+
+/* H diamorfwsh tou epipedou BF.
+ * FrameCount:		to plh8os twn frames ths mnhmhs endiamesou apo8hkefshs. Ka8e frame exei mege8os MaxBlockSize.
+ * 			Me to prwto anoigma arxeiou me thn BF_OpenFileWithLog desmevetai akomh ena antigrafo ka8e frame,
+ * 			gia na katagrafontai mono ta bytes pou allaxan, opote h mnhmh diplasiazetai.
+ * MemoryBudget:	an to FrameCount einai 0, ta bytes ths mnhmhs endiamesou apo8hkefshs, apo ta opoia prokyptei to
+ * 			plh8os twn frames. Perilamvanei kai ta antigrafa twn frames gia ta arxeia me log, opote ka8e
+ * 			frame xrewnetai 2 * MaxBlockSize bytes.
+ * MaxBlockSize:	to megalytero mege8os block twn arxeiwn pou anoigontai (dynamh tou 2, apo BF_MIN_BLOCK_SIZE ews
+ * 			BF_MAX_BLOCK_SIZE). Ta frames exoun afto to mege8os, opote mia efarmogh me mikra blocks mporei na to
+ * 			meiwsei wste na mhn spatalaei mnhmh. Tote h BF_CreateFileWithBlockSize kai h BF_OpenFile epistrefoun
+ * 			BFE_INVALIDBLOCKSIZE gia megalytera blocks. H BF_GetDefaultConfig kai h BF_Init xrhsimopoioun to
+ * 			BF_MAX_BLOCK_SIZE.
+ * MaxOpenFiles:	to megisto plh8os taftoxrona anoixtwn arxeiwn. Meta apo afto h BF_OpenFile epistrefei BFE_FTABFULL.
+ * 			Isxyei kai gia ta arxeia HP, HT kai SHT.
+ * UseHugePages:	an einai 1, ta frames apo8hkevontai se megales selides (huge pages), an yparxoun dia8esimes
+ * ReplacementPolicy:	h politikh antikatastashs
+ * WriteMode:		o tropos eggrafhs twn blocks
+ * FlushInterval:	ka8e posa milliseconds grafei ta allagmena blocks to nhma tou paraskhniou sth leitourgia
+ * 			BF_WRITE_BACK
+ * UseDirectIO:		an einai 1, ta arxeia tou BF_BACKEND_BUFFERED anoigoun me O_DIRECT kai ta blocks tous den
+ * 			apo8hkevontai deuterh fora sthn cache tou leitourgikou. An to systhma arxeiwn den to ypostirizei h
+ * 			to mege8os block tou arxeiou den einai pollaplasio ths eu8ygrammishs ths syskeyhs, to arxeio
+ * 			xrhsimopoiei kanonika thn cache.
+ * ExtentBlockCount:	otan ena arxeio megalwnei, o xwros tou sto diskos desmevetai me fallocate gia tosa blocks
+ * 			mazi (extent), wste ta blocks tou na einai synexomena sto diskos. To mege8os tou arxeiou den
+ * 			allazei, kai o xwros pou den xrhsimopoih8hke eleftherwnetai sto kleisimo tou. An einai 0, o xwros
+ * 			den desmevetai ek twn proterwn.
+*/
+typedef struct BF_Config
+{
+	int FrameCount;
+	unsigned long long MemoryBudget;
+	int MaxBlockSize;
+	int MaxOpenFiles;
+	int UseHugePages;
+	BF_ReplacementPolicy ReplacementPolicy;
+	BF_WriteMode WriteMode;
+	int FlushInterval;
+	int UseDirectIO;
+	int ExtentBlockCount;
+} BF_Config;
+
+
+/* Gemizei th diamorfwsh me tis times pou xrhsimopoiei h BF_Init.
+ *
+ * config:	Deikths sth domh pou 8a gemisei
+*/
+void BF_GetDefaultConfig(BF_Config* config);
 
 
 /* Arxikopoiei tin eswterikh plhroforia tin opoia krataei to epipedo block arxeiwn (BF) */
 void BF_Init();
 
 
+/* Opws h BF_Init, alla me th diamorfwsh config. An to epipedo BF exei hdh arxikopoih8ei den kanei tipota.
+ *
+ * config:	H diamorfwsh
+ * Epistrefei:
+ * 		0 se periptwsi epityxias,
+ * 		Mia arnhtikh timh se periptwsh pou symvei kapoio sfalma.
+*/
+int BF_InitWithConfig(const BF_Config* config);
+
+
+/* Epistrefei to megisto plh8os taftoxrona anoixtwn arxeiwn. */
+int BF_GetMaxOpenFiles();
+
+
+/* Epistrefei to plh8os twn frames ths mnhmhs endiamesou apo8hkefshs, h 0 prin thn arxikopoihsh. Oi leitourgies pou
+ * allazoun polla blocks to xrhsimopoioun gia na oloklhrwnoun tis allages tous prin gemisoun th mnhmh.
+*/
+int BF_GetFrameCount();
+
+
 /* Dimiourgei ena neo arxeio epipedou block. An to arxeio yparxei hdh grafetai ek neou apo panw.
  * filename	to onoma tou arxeiou pros dimiourgia
  * Epistrefei:
@@ -49,6 +227,18 @@ void BF_Init();
 int BF_CreateFile(const char* filename);
 
 
+/* Opws h BF_CreateFile, alla ta blocks tou neou arxeiou exoun mege8os blockSize bytes. To blockSize den mporei na
+ * xeperna to MaxBlockSize ths diamorfwshs, wste to arxeio na mporei na anoixei.
+ * filename	to onoma tou arxeiou pros dimiourgia
+ * blockSize	to mege8os tou block (dynamh tou 2, apo BF_MIN_BLOCK_SIZE ews BF_MAX_BLOCK_SIZE)
+ * Epistrefei:
+ * 		0 se periptwsi epityxias,
+ * 		Mia arnhtikh timh se periptwsh pou symvei kapoio sfalma.
+ * Mporeite na kalesete thn BF_PrintError() gia na deite to sfalma pou synevh
+*/
+int BF_CreateFileWithBlockSize(const char* filename, const int blockSize);
+
+
 /* Anoigei ena yparxon arxeio epipedou block.
  *
  * filename:	To onoma tou arxeiou pros anoigma
@@ -61,6 +251,25 @@ int BF_CreateFile(const char* filename);
 int BF_OpenFile(const char* filename);
 
 
+/* Opws h BF_OpenFile, alla oi allages sta blocks tou arxeiou katagrafontai prwta sto arxeio katagrafhs (write ahead log)
+ * "<filename>.wal". H BF_WriteBlock katagrafei mono ta bytes pou allaxan kai ta blocks grafontai sto arxeio mono afou oi
+ * allages tous oloklhrw8oun me thn BF_Commit kai ftasoun sto diskos. An to programma termatistei prin kleisei to arxeio,
+ * to epomeno anoigma tou efarmozei xana tis oloklhrwmenes allages tou log, opote to arxeio den menei pote me mish
+ * leitourgia. Ta blocks me allages pou den exoun oloklhrw8ei den vgainoun apo th mnhmh endiamesou apo8hkefshs, opote
+ * mia leitourgia pou allazei perissotera blocks apo osa xwrane se auth prepei na xwristei se polles me thn BF_Commit,
+ * alliws apotygxanei me BFE_NOBUF. To log xrhsimopoieitai mono me to BF_BACKEND_BUFFERED.
+ *
+ * filename:	To onoma tou arxeiou pros anoigma
+ *
+ * Epistrefei:
+ * 		Enan mh arnhtiko akeraio se periptwsh epityxias, pou einai o anagnwristikos ari8mos tou arxeiou.
+ * 		Enan arnhtiko ari8mo se periptwsh sfalmatos. An to arxeio einai hdh anoixto xwris log epistrefei BFE_FILEOPEN,
+ * 		kai an exei epilegei to BF_BACKEND_MMAP me thn BF_SetBackend epistrefei BFE_LOGUNSUPPORTED.
+ * Mporeite na kalesete thn BF_PrintError() gia na deite to sfalma pou synevh.
+*/
+int BF_OpenFileWithLog(const char* filename);
+
+
 /* Kleinei ena anoixto arxeio me anagnwristiko ari8mo anoixtou arxeiou.
  *
  * fileDesc:	O anagnwristikos ari8mos tou anoigmatos tou arxeiou.
@@ -85,8 +294,20 @@ int BF_CloseFile(const int fileDesc);
 int BF_GetBlockCounter(const int fileDesc);
 
 
+/* Epistrefei to mege8os se bytes twn block tou arxeiou me anagnwristiko ari8mo fileDesc.
+ *
+ * fileDesc:	O anagnwristikos ari8mos tou anoigmatos arxeiou typou block
+ *
+ * Epistrefei:
+ * 		To mege8os tou block, opws oristhke kata th dimiourgia tou arxeiou, se periptwsh epityxias.
+ * 		Enan arnhtiko ari8mo se periptwsh sfalmatos.
+ * Mporeite na kalesete thn BF_PrintError() gia na deite to sfalma pou synevh.
+*/
+int BF_GetBlockSize(const int fileDesc);
+
+
 /* Desmevei ena neo block sto anoixto arxeio epipedou block, me anagnwristiko ari8mo fileDesc.
- * To neo block exei mege8os BLOCK_SIZE kai ola ta bytes tou einai arxikopoihmena se 0.
+ * To neo block exei to mege8os block tou arxeiou kai ola ta bytes tou einai arxikopoihmena se 0.
  * To block afto topo8eteitai sto telos tou trexontos arxeiou, epomenws o ari8mos tou einai
  * BF_getBlockCounter(fileDesc) - 1.
  *
@@ -100,6 +321,35 @@ int BF_GetBlockCounter(const int fileDesc);
 int BF_AllocateBlock(const int fileDesc);
 
 
+/* Desmevei blockCount nea, synexomena blocks sto telos tou arxeiou, opws h BF_AllocateBlock. Kanena allo nhma den
+ * desmevei blocks anamesa tous.
+ *
+ * fileDesc:	Anagnwristikos ari8mos anoigmatos arxeiou epipedou block
+ * blockCount:	To plh8os twn blocks
+ *
+ * Epistrefei:
+ * 		Ton ari8mo tou prwtou neou block se periptwsh epityxous ektelesis.
+ * 		Enan arnhtiko ari8mo se periptwsh sfalmatos. Ta blocks pou desmeftikan prin to sfalma paramenoun.
+ * Mporeite na kalesete thn BF_PrintError() gia na deite to sfalma pou synevh.
+*/
+int BF_AllocateBlocks(const int fileDesc, const int blockCount);
+
+
+/* Kovei to arxeio epipedou block, me anagnwristiko ari8mo fileDesc, sta prwta blockCount blocks tou kai epistrefei
+ * ton xwro tou ypoloipou sto systhma arxeiwn. Oi allages tou arxeiou grafontai prwta, opws me thn BF_Flush. Ta blocks
+ * pou afairountai den prepei na xrhsimopoiountai apo kanena nhma.
+ *
+ * fileDesc:	Anagnwristikos ari8mos anoigmatos arxeiou epipedou block
+ * blockCount:	To neo plh8os twn blocks tou arxeiou, to poly BF_GetBlockCounter(fileDesc)
+ *
+ * Epistrefei:
+ * 		0 se periptwsh epityxous ektelesis.
+ * 		Enan arnhtiko ari8mo se periptwsh sfalmatos.
+ * Mporeite na kalesete thn BF_PrintError() gia na deite to sfalma pou synevh.
+*/
+int BF_TruncateFile(const int fileDesc, const int blockCount);
+
+
 /* Diavazei ena sygkekrimeno block apo to arxeio epipedou block, me anagnwristiko ari8mo fileDesc.
  * To block pou diavazetai antistoixei sto blockNumber-osto block tou arxeiou,
  * me tin ari8misi na xekinaei apo to 0. Prosvash sto neo block parexetai mesw tou teleftaiou orismatos,
@@ -109,6 +359,9 @@ int BF_AllocateBlock(const int fileDesc);
  * blockNumber:	O ari8mos tou block pou prokeitai na diavastei. H ari8misi twn blocks xekinaei apo to 0.
  * block:		Deiktis pros to neo block pou diavastike apo to arxeio.
  *
+ * To block paramenei karfwmeno (pinned) mexri to idio nhma na diavasei alla 8 blocks, opote o deikths menei egkyros
+ * toulaxiston mexri tote. Gia prosvash apo polla nhmata sto idio block xrhsimopoihste thn BF_PinBlock.
+ *
  * Epistrefei:
  * 		0 se periptwsi epityxias
  * 		Enan arnhtiko ari8mo se periptwsh sfalmatos.
@@ -117,6 +370,116 @@ int BF_AllocateBlock(const int fileDesc);
 int BF_ReadBlock(const int fileDesc, const int blockNumber, void** block);
 
 
+/* Xekinaei thn asygxronh anagnwsh (prefetch) blockCount diadoxikwn blocks tou arxeiou, apo to block blockNumber kai meta,
+ * xwris na perimenei na oloklhrw8ei. Ta blocks diavazontai me io_uring, h me mia omada nhmatwn an o pyrhnas den to
+ * ypostirizei, kai oi diadoxika blocks me mia klhsh. Mia BF_ReadBlock pou zhtaei ena block pou diavazetai akomh perimenei
+ * na teleiwsei h anagnwsh tou. Einai mono ypodeixh: ta blocks pou einai hdh sth mnhmh h meta to telos tou arxeiou
+ * agnoountai, kai an yparxoun hdh polles anagnwseis se exelixh oi ypoloipes paralipontai. Gia arxeia me to
+ * BF_BACKEND_MMAP zhtaei apo ton pyrhna na diavasei tis selides ek twn proterwn.
+ *
+ * fileDesc:	Anangwristikos ari8mos anoigmatos arxeiou epipedou block
+ * blockNumber:	O ari8mos tou prwtou block
+ * blockCount:	To plh8os twn blocks
+ *
+ * Epistrefei:
+ * 		0 se periptwsi epityxias
+ * 		Enan arnhtiko ari8mo se periptwsh sfalmatos.
+ * Mporeite na kalesete thn BF_PrintError() gia na deite to sfalma pou synevh.
+*/
+int BF_Prefetch(const int fileDesc, const int blockNumber, const int blockCount);
+
+
+/* Opws h BF_Prefetch, alla gia ta blocks tou pinaka blockNumbers, se opoiadhpote seira. Ta blocks taxinomountai wste ta
+ * diadoxika na diavazontai mazi.
+ *
+ * fileDesc:		Anangwristikos ari8mos anoigmatos arxeiou epipedou block
+ * blockNumbers:	Oi ari8moi twn blocks
+ * blockCount:		To plh8os twn blocks tou pinaka
+ *
+ * Epistrefei:
+ * 		0 se periptwsi epityxias
+ * 		Enan arnhtiko ari8mo se periptwsh sfalmatos.
+ * Mporeite na kalesete thn BF_PrintError() gia na deite to sfalma pou synevh.
+*/
+int BF_PrefetchBlocks(const int fileDesc, const int* blockNumbers, const int blockCount);
+
+
+/* Oi tropoi kleidwmatos (latch) enos block apo thn BF_PinBlock.
+ * BF_LATCH_SHARED:	koino kleidwma, gia anagnwsh. Polla nhmata mporoun na to kratane taftoxrona.
+ * BF_LATCH_EXCLUSIVE:	apokleistiko kleidwma, gia tropopoihsh.
+*/
+typedef enum BF_LatchMode
+{
+	BF_LATCH_SHARED = 0,
+	BF_LATCH_EXCLUSIVE
+} BF_LatchMode;
+
+
+/* Opws h BF_ReadBlock, alla to block karfwnetai (pin) sth mnhmh endiamesou apo8hkefshs kai kleidwnetai me to latch tou
+ * mexri na klh8ei h BF_UnpinBlock. O deikths pou epistrefetai menei egkyros mexri tote, akoma kai an alla nhmata
+ * diavazoun blocks. Etsi polla nhmata mporoun na diavazoun ta idia h diaforetika blocks taftoxrona.
+ *
+ * fileDesc:	Anangwristikos ari8mos anoigmatos arxeiou epipedou block
+ * blockNumber:	O ari8mos tou block pou prokeitai na diavastei. H ari8misi twn blocks xekinaei apo to 0.
+ * mode:	O tropos kleidwmatos tou block (BF_LATCH_SHARED h BF_LATCH_EXCLUSIVE)
+ * block:	Deiktis pros to block pou diavastike apo to arxeio.
+ *
+ * Epistrefei:
+ * 		0 se periptwsi epityxias
+ * 		Enan arnhtiko ari8mo se periptwsh sfalmatos.
+ * Mporeite na kalesete thn BF_PrintError() gia na deite to sfalma pou synevh.
+*/
+int BF_PinBlock(const int fileDesc, const int blockNumber, const BF_LatchMode mode, void** block);
+
+
+/* Apeleftherwnei to latch kai to pin enos block pou epestrepse h BF_PinBlock. Meta thn klhsh o deikths sto block
+ * den prepei na xrhsimopoih8ei.
+ *
+ * fileDesc:	Anangwristikos ari8mos anoigmatos arxeiou epipedou block
+ * blockNumber:	O ari8mos tou block
+ *
+ * Epistrefei:
+ * 		0 se periptwsi epityxias.
+ *		Enan arnhtiko ari8mo se periptwsh sfalmatos.
+ * Mporeite na kalesete thn BF_PrintError() gia na deite to sfalma pou synevh.
+*/
+int BF_UnpinBlock(const int fileDesc, const int blockNumber);
+
+
+/* Diavazei ta blockCount blocks tou pinaka blockNumbers kai ta karfwnei (pin) ola mazi, me koino kleidwma (BF_LATCH_SHARED),
+ * opws h BF_PinBlock. Ta blocks pou den einai sth mnhmh endiamesou apo8hkefshs taxinomountai kai ta diadoxika diavazontai
+ * me mia klhsh preadv, opote polla blocks kostizoun enan gyro anagnwshs. O deikths tou block blockNumbers[i] grafetai
+ * sto blocks[i]. Ka8e block apeleftherwnetai me thn BF_UnpinBlock h me thn BF_UnpinBlocks. Ta blocks prepei na xwrane
+ * sth mnhmh endiamesou apo8hkefshs taftoxrona, alliws epistrefei BFE_NOBUF. Se periptwsh sfalmatos kanena block den
+ * menei karfwmeno.
+ *
+ * fileDesc:		Anangwristikos ari8mos anoigmatos arxeiou epipedou block
+ * blockNumbers:	Oi ari8moi twn blocks, se opoiadhpote seira
+ * blockCount:		To plh8os twn blocks
+ * blocks:		Pinakas me blockCount 8eseis gia tous deiktes pros ta blocks
+ *
+ * Epistrefei:
+ * 		0 se periptwsi epityxias
+ * 		Enan arnhtiko ari8mo se periptwsh sfalmatos.
+ * Mporeite na kalesete thn BF_PrintError() gia na deite to sfalma pou synevh.
+*/
+int BF_ReadBlocks(const int fileDesc, const int* blockNumbers, const int blockCount, void** blocks);
+
+
+/* Apeleftherwnei ta blocks pou epestrepse h BF_ReadBlocks, kalwntas thn BF_UnpinBlock gia ka8e ena.
+ *
+ * fileDesc:		Anangwristikos ari8mos anoigmatos arxeiou epipedou block
+ * blockNumbers:	Oi ari8moi twn blocks
+ * blockCount:		To plh8os twn blocks
+ *
+ * Epistrefei:
+ * 		0 se periptwsi epityxias.
+ *		Enan arnhtiko ari8mo se periptwsh sfalmatos.
+ * Mporeite na kalesete thn BF_PrintError() gia na deite to sfalma pou synevh.
+*/
+int BF_UnpinBlocks(const int fileDesc, const int* blockNumbers, const int blockCount);
+
+
 /* Grafei sto arxeio epipedou block ta dedomena pou yparxoun sto block yp' ari8mon blockNumber,
  * opws afto ziti8ike apo tin BF_ReadBlock, apo to arxeio me anagnwristiko ari8mo anoigmatos fileDesc.
  *
@@ -131,6 +494,49 @@ int BF_ReadBlock(const int fileDesc, const int blockNumber, void** block);
 int BF_WriteBlock(const int fileDesc, const int blockNumber);
 
 
+/* Grafei sto arxeio me anagnwristiko ari8mo anoigmatos fileDesc ola ta allagmena blocks tou kai perimenei mexri na
+ * ftasoun sto diskos, mazi me osa grafthkan prin. H BF_CloseFile kanei to idio prin kleisei to arxeio. Gia arxeia pou
+ * anoix8hkan me thn BF_OpenFileWithLog oloklhrwnei prwta tis allages tous me thn BF_Commit kai meta adeiazei to log.
+ *
+ * fileDesc:	Anangwristikos ari8mos anoigmatos arxeiou epipedou block
+ *
+ * Epistrefei:
+ * 		0 se periptwsi epityxias.
+ *		Enan arnhtiko ari8mo se periptwsh sfalmatos.
+ * Mporeite na kalesete thn BF_PrintError() gia na deite to sfalma pou synevh.
+*/
+int BF_Flush(const int fileDesc);
+
+
+/* Oloklhrwnei (commit) tis allages pou katagrafhkan sto log tou arxeiou apo thn prohgoumenh BF_Commit. Den perimenei na
+ * ftasoun sto diskos, alla epistrefei enan ari8mo pou dinetai sthn BF_WaitForCommit. Ena nhma sto paraskhnio grafei
+ * to log, opote oi oloklhrwseis pollwn nhmatwn ftanoun sto diskos me mia klhsh fdatasync (group commit).
+ *
+ * fileDesc:	Anangwristikos ari8mos anoigmatos arxeiou epipedou block
+ *
+ * Epistrefei:
+ * 		Enan mh arnhtiko ari8mo se periptwsi epityxias. Gia arxeia xwris log epistrefei 0.
+ *		Enan arnhtiko ari8mo se periptwsh sfalmatos.
+ * Mporeite na kalesete thn BF_PrintError() gia na deite to sfalma pou synevh.
+*/
+long long BF_Commit(const int fileDesc);
+
+
+/* Perimenei mexri h oloklhrwsh pou epestrepse h BF_Commit na ftasei sto diskos. Den xreiazetai na krataei kaneis to
+ * arxeio kleidwmeno, wste alla nhmata na oloklhrwnoun tis allages tous taftoxrona. An to arxeio exei kleisei en tw
+ * metaxy, oi allages tou exoun hdh grafei.
+ *
+ * fileDesc:	Anangwristikos ari8mos anoigmatos arxeiou epipedou block
+ * ticket:	O ari8mos pou epestrepse h BF_Commit
+ *
+ * Epistrefei:
+ * 		0 se periptwsi epityxias.
+ *		Enan arnhtiko ari8mo se periptwsh sfalmatos.
+ * Mporeite na kalesete thn BF_PrintError() gia na deite to sfalma pou synevh.
+*/
+int BF_WaitForCommit(const int fileDesc, const long long ticket);
+
+
 /* Typwnei to mhnyma message sto standard error, akolou8oumeno apo mia perigrafh tou teleftaiou sfalmatos
  * pou prokli8ike sto BF epipedo.
  *
@@ -6,21 +6,111 @@
 #include <string.h>
 #include <stdio.h>
 
-int32_t HashStatistics(char* fileName)
+// Allocates bucketBlockCount contiguous bucket blocks at the end of the file, which must start at firstBucketBlockIndex,
+// and fills them with empty buckets. Returns 0 on success and -1 on failure.
+static int32_t AllocateBucketBlocks(int32_t fileHandle, uint32_t bucketBlockCount, int32_t firstBucketBlockIndex)
 {
-	// Open the hash file.
-	int32_t handle = BF_OpenFile(fileName);
-	if (handle == nullptr)
+	// Retrieve the block size of the hash file.
+	int32_t blockSize = BF_GetBlockSize(fileHandle);
+	if (blockSize < 0)
 	{
-		printf("Could not open hash file!\n");
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", fileHandle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Loop through all the required bucket blocks.
+	for (uint32_t index = 0; index < bucketBlockCount; index++)
+	{
+		// Allocate a new bucket block.
+		if (BF_AllocateBlock(fileHandle) < 0)
+		{
+			printf("Could not allocate bucket block for the hash file! FileHandle: %d\n", fileHandle);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// Retrieve the block count of the hash file.
+		int32_t blockCount = BF_GetBlockCounter(fileHandle);
+		if (blockCount < 0)
+		{
+			printf("Could not retrieve block count for the hash file! FileHandle: %d\n", fileHandle);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// Ensure that the bucket blocks stay contiguous, since they are addressed arithmetically.
+		int32_t newBucketBlockIndex = blockCount - 1;
+		if (newBucketBlockIndex != firstBucketBlockIndex + (int32_t)index)
+		{
+			printf("Bucket block was not allocated contiguously! FileHandle: %d, BlockIndex: %d\n", fileHandle, newBucketBlockIndex);
+			return -1;
+		}
+
+		// Retrieve a pointer to the new bucket block.
+		uint8_t* newBucketBlockPtr = nullptr;
+		if (BF_ReadBlock(fileHandle, newBucketBlockIndex, (void**)&newBucketBlockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", fileHandle, newBucketBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// Fill the whole block with invalid block indices, so that the buckets added when the file grows start out empty.
+		memset(newBucketBlockPtr, INVALID_BLOCK_INDEX, blockSize);
+
+		// Write the new bucket block to the disk.
+		if (BF_WriteBlock(fileHandle, newBucketBlockIndex) < 0)
+		{
+			printf("Could not write hash bucket block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, newBucketBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int32_t CreateBucketBlocks(int32_t fileHandle, uint32_t bucketCount, int32_t firstBucketBlockIndex)
+{
+	// Retrieve the block size of the hash file.
+	int32_t blockSize = BF_GetBlockSize(fileHandle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", fileHandle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	return AllocateBucketBlocks(fileHandle, BUCKET_BLOCK_COUNT(bucketCount, MAX_BUCKET_COUNT_PER_BLOCK(blockSize)), firstBucketBlockIndex);
+}
+
+int32_t LoadBucketDirectory(int32_t fileHandle, HashBucketDirectory* directory)
+{
+	// Start with an empty directory so that it can always be freed.
+	memset(directory, 0, sizeof(HashBucketDirectory));
+
+	// Retrieve the block size of the hash file.
+	int32_t blockSize = BF_GetBlockSize(fileHandle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", fileHandle);
+		BF_PrintError("");
+
 		return -1;
 	}
 
 	// Retrieve a pointer to the hash file header block.
 	uint8_t* headerBlockPtr = nullptr;
-	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	if (BF_ReadBlock(fileHandle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
 	{
-		printf("Could not retrieve pointer to hash header block! FileHandle: %d, BlockIndex: %d\n", handle, HEADER_BLOCK_INDEX);
+		printf("Could not retrieve pointer to hash header block! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
 		BF_PrintError("");
 
 		return -1;
@@ -29,122 +119,781 @@ int32_t HashStatistics(char* fileName)
 	// Since this file exists, we know there's a FileHeader in the first bytes of the header block. So we treat the pointer as such.
 	HashFileHeader* fileHeader = (HashFileHeader*)headerBlockPtr;
 
-	if (fileHeader->CommonHeader.Type != HashFile && fileHeader->CommonHeader.Type != SecondaryHashFile)
+	// Copy the bucket layout and the linear hashing state.
+	directory->BucketCount = fileHeader->BucketCount;
+	directory->BucketsPerBlock = MAX_BUCKET_COUNT_PER_BLOCK(blockSize);
+	directory->BucketBlockCount = fileHeader->BucketBlockCount;
+	directory->FirstBucketBlockIndex = fileHeader->FirstBucketBlockIndex;
+	directory->InitialBucketCount = fileHeader->InitialBucketCount;
+	directory->Level = fileHeader->Level;
+	directory->SplitIndex = fileHeader->SplitIndex;
+	directory->RecordCount = fileHeader->RecordCount;
+	directory->MaxLoadFactor = fileHeader->MaxLoadFactor;
+	directory->FirstFreeBlockIndex = fileHeader->FirstFreeBlockIndex;
+	directory->FreeBlockCount = fileHeader->FreeBlockCount;
+
+	// Allocate the in memory directory, with room for every bucket of the allocated bucket blocks.
+	directory->Buckets = (int32_t*)malloc(directory->BucketBlockCount * directory->BucketsPerBlock * sizeof(int32_t));
+	if (directory->Buckets == nullptr)
 	{
-		printf("The file provided is not a hash file! FileName: %s\n", fileName);
+		printf("Could not allocate the bucket directory! BucketCount: %d\n", directory->BucketCount);
 		return -1;
 	}
 
-	uint32_t bucketCount = fileHeader->BucketCount;
+	// Loop through all the contiguous bucket blocks a batch at a time, so that every batch is read with one call, and copy their buckets.
+	for (uint32_t batchStart = 0; batchStart < directory->BucketBlockCount; batchStart += BUCKET_BLOCK_BATCH_SIZE)
+	{
+		uint32_t batchSize = directory->BucketBlockCount - batchStart;
+		if (batchSize > BUCKET_BLOCK_BATCH_SIZE)
+			batchSize = BUCKET_BLOCK_BATCH_SIZE;
+
+		// Retrieve pointers to the bucket blocks of the batch.
+		int32_t bucketBlockIndices[BUCKET_BLOCK_BATCH_SIZE];
+		uint8_t* bucketBlockPtrs[BUCKET_BLOCK_BATCH_SIZE];
+		for (uint32_t batchIndex = 0; batchIndex < batchSize; batchIndex++)
+			bucketBlockIndices[batchIndex] = directory->FirstBucketBlockIndex + batchStart + batchIndex;
 
-	// Initialize the statistics.
-	uint32_t minElementCount = UINT32_MAX;
-	uint32_t maxElementCount = 0;
-	uint32_t totalElementCount = 0;
-	uint32_t* overflowBlocksPerBucket = (uint32_t*)malloc(bucketCount * sizeof(uint32_t));
-	memset(overflowBlocksPerBucket, 0, bucketCount * sizeof(uint32_t));
+		if (BF_ReadBlocks(fileHandle, bucketBlockIndices, batchSize, (void**)bucketBlockPtrs) < 0)
+		{
+			printf("Could not retrieve pointers to hash bucket blocks! FileHandle: %d, BlockIndex: %d\n", fileHandle, bucketBlockIndices[0]);
+			BF_PrintError("");
+			FreeBucketDirectory(directory);
+
+			return -1;
+		}
 
-	// Start from the first bucket block.
-	int32_t currentBucketBlockIndex = fileHeader->NextBlockIndex;
+		// Copy the buckets.
+		for (uint32_t batchIndex = 0; batchIndex < batchSize; batchIndex++)
+			memcpy(&directory->Buckets[(batchStart + batchIndex) * directory->BucketsPerBlock], bucketBlockPtrs[batchIndex], directory->BucketsPerBlock * sizeof(int32_t));
 
-	// The index of the bucket NOT relative to the current bucket block.c
-	uint32_t globalBucketIndex = 0;
+		// Unpin the bucket blocks, now that their buckets are copied.
+		BF_UnpinBlocks(fileHandle, bucketBlockIndices, batchSize);
+	}
+
+	return 0;
+}
+
+int32_t SetBucketFirstBlock(int32_t fileHandle, HashBucketDirectory* directory, uint32_t bucketIndex, int32_t dataBlockIndex)
+{
+	// Update the in memory directory.
+	directory->Buckets[bucketIndex] = dataBlockIndex;
+
+	// Calculate the bucket block the bucket is stored in.
+	int32_t bucketBlockIndex = BUCKET_BLOCK_INDEX(directory->FirstBucketBlockIndex, bucketIndex, directory->BucketsPerBlock);
+
+	// Retrieve a pointer to the bucket block.
+	uint8_t* bucketBlockPtr = nullptr;
+	if (BF_ReadBlock(fileHandle, bucketBlockIndex, (void**)&bucketBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", fileHandle, bucketBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Offset the bucket block pointer by the buckets before this one in the block.
+	bucketBlockPtr += (bucketIndex % directory->BucketsPerBlock) * sizeof(int32_t);
+
+	// Update the bucket.
+	*(int32_t*)bucketBlockPtr = dataBlockIndex;
 
-	// Loop through all the bucket blocks.
-	while (currentBucketBlockIndex != INVALID_BLOCK_INDEX)
+	// Write the contents of the bucket block to the disk.
+	if (BF_WriteBlock(fileHandle, bucketBlockIndex) < 0)
+	{
+		printf("Could not write hash bucket block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, bucketBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	return 0;
+}
+
+uint32_t GetBucketIndex(const HashBucketDirectory* directory, uint32_t hash)
+{
+	// The number of buckets at the start of the current level.
+	uint32_t levelBucketCount = directory->InitialBucketCount << directory->Level;
+
+	// Address the bucket using the current level.
+	uint32_t bucketIndex = hash % levelBucketCount;
+
+	// The buckets before the split index have already been split, so they are addressed using the next level.
+	if (bucketIndex < directory->SplitIndex)
+		bucketIndex = hash % (levelBucketCount * 2);
+
+	return bucketIndex;
+}
+
+int32_t StoreBucketBlocks(int32_t fileHandle, const HashBucketDirectory* directory, uint32_t bucketBlockNumber, uint32_t bucketBlockCount)
+{
+	// Loop through all the bucket blocks of the range.
+	for (uint32_t index = bucketBlockNumber; index < bucketBlockNumber + bucketBlockCount; index++)
 	{
 		// Retrieve a pointer to the current bucket block.
+		int32_t currentBucketBlockIndex = directory->FirstBucketBlockIndex + index;
 		uint8_t* currentBucketBlockPtr = nullptr;
-		if (BF_ReadBlock(handle, currentBucketBlockIndex, (void**)&currentBucketBlockPtr) < 0)
+		if (BF_ReadBlock(fileHandle, currentBucketBlockIndex, (void**)&currentBucketBlockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", fileHandle, currentBucketBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// Copy the buckets.
+		memcpy(currentBucketBlockPtr, &directory->Buckets[index * directory->BucketsPerBlock], directory->BucketsPerBlock * sizeof(int32_t));
+
+		// Write the current bucket block to the disk.
+		if (BF_WriteBlock(fileHandle, currentBucketBlockIndex) < 0)
 		{
-			printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, currentBucketBlockIndex);
+			printf("Could not write hash bucket block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, currentBucketBlockIndex);
 			BF_PrintError("");
 
 			return -1;
 		}
+	}
+
+	return 0;
+}
+
+// Ensures the bucket blocks have room for bucketCount buckets. If they don't, the directory is moved to a new contiguous range at
+// the end of the file, of at least twice the size. Returns 0 on success and -1 on failure.
+static int32_t EnsureBucketCapacity(int32_t fileHandle, HashBucketDirectory* directory, uint32_t bucketCount)
+{
+	// Nothing to do if the allocated bucket blocks have room.
+	if (bucketCount <= directory->BucketBlockCount * directory->BucketsPerBlock)
+		return 0;
+
+	// Calculate the size of the new range.
+	uint32_t currentBucketBlockCount = directory->BucketBlockCount;
+	uint32_t newBucketBlockCount = currentBucketBlockCount * 2;
+	if (newBucketBlockCount < BUCKET_BLOCK_COUNT(bucketCount, directory->BucketsPerBlock))
+		newBucketBlockCount = BUCKET_BLOCK_COUNT(bucketCount, directory->BucketsPerBlock);
+
+	// Grow the in memory directory first so that a failure doesn't leave it pointing to the new blocks.
+	int32_t* newBuckets = (int32_t*)realloc(directory->Buckets, newBucketBlockCount * directory->BucketsPerBlock * sizeof(int32_t));
+	if (newBuckets == nullptr)
+	{
+		printf("Could not grow the bucket directory! BucketCount: %d\n", bucketCount);
+		return -1;
+	}
+
+	directory->Buckets = newBuckets;
+
+	// The buckets past the current ones start out empty.
+	uint32_t currentCapacity = currentBucketBlockCount * directory->BucketsPerBlock;
+	memset(&directory->Buckets[currentCapacity], INVALID_BLOCK_INDEX, (newBucketBlockCount * directory->BucketsPerBlock - currentCapacity) * sizeof(int32_t));
+
+	// The new bucket blocks start at the end of the file.
+	int32_t newFirstBucketBlockIndex = BF_GetBlockCounter(fileHandle);
+	if (newFirstBucketBlockIndex < 0)
+	{
+		printf("Could not retrieve block count for the hash file! FileHandle: %d\n", fileHandle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Allocate the new bucket blocks.
+	if (AllocateBucketBlocks(fileHandle, newBucketBlockCount, newFirstBucketBlockIndex) == -1)
+		return -1;
+
+	// Point the directory to the new bucket blocks.
+	directory->FirstBucketBlockIndex = newFirstBucketBlockIndex;
+	directory->BucketBlockCount = newBucketBlockCount;
+
+	// Copy the current buckets into the new bucket blocks. The old bucket blocks are left unused.
+	return StoreBucketBlocks(fileHandle, directory, 0, currentBucketBlockCount);
+}
+
+int32_t AddBucket(int32_t fileHandle, HashBucketDirectory* directory)
+{
+	// Make room for one more bucket.
+	if (EnsureBucketCapacity(fileHandle, directory, directory->BucketCount + 1) == -1)
+		return -1;
+
+	// Append the empty bucket.
+	directory->Buckets[directory->BucketCount] = INVALID_BLOCK_INDEX;
+	directory->BucketCount++;
+
+	return 0;
+}
+
+int32_t DoubleBucketDirectory(int32_t fileHandle, HashBucketDirectory* directory)
+{
+	uint32_t bucketCount = directory->BucketCount;
+
+	// Make room for twice the buckets.
+	if (EnsureBucketCapacity(fileHandle, directory, bucketCount * 2) == -1)
+		return -1;
+
+	// Every new bucket shares the data blocks of the bucket it mirrors.
+	memcpy(&directory->Buckets[bucketCount], directory->Buckets, bucketCount * sizeof(int32_t));
 
-		// Since this block exists, we know there's a BucketBlockHeader in the first bytes of the header block. So we treat the pointer as such.
-		HashBucketBlockHeader* currentBucketBlockHeader = (HashBucketBlockHeader*)currentBucketBlockPtr;
+	// Write the bucket blocks that contain the new buckets.
+	uint32_t firstBucketBlockNumber = bucketCount / directory->BucketsPerBlock;
+	uint32_t lastBucketBlockNumber = (bucketCount * 2 - 1) / directory->BucketsPerBlock;
+	if (StoreBucketBlocks(fileHandle, directory, firstBucketBlockNumber, lastBucketBlockNumber - firstBucketBlockNumber + 1) == -1)
+		return -1;
+
+	// Update the bucket count and the level.
+	directory->BucketCount = bucketCount * 2;
+	directory->Level++;
+
+	return 0;
+}
+
+bool IsSharedBucket(const HashBucketDirectory* directory, uint32_t bucketIndex, uint32_t localDepth)
+{
+	// The bucket that owns the data blocks is the one with the same lowest localDepth bits of the index.
+	uint32_t ownerBucketIndex = bucketIndex & ((1u << localDepth) - 1);
+
+	return ownerBucketIndex != bucketIndex && directory->Buckets[ownerBucketIndex] == directory->Buckets[bucketIndex];
+}
+
+int32_t StoreBucketDirectoryHeader(int32_t fileHandle, const HashBucketDirectory* directory)
+{
+	// Retrieve a pointer to the hash file header block.
+	uint8_t* headerBlockPtr = nullptr;
+	if (BF_ReadBlock(fileHandle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to hash header block! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Since this file exists, we know there's a FileHeader in the first bytes of the header block. So we treat the pointer as such.
+	HashFileHeader* fileHeader = (HashFileHeader*)headerBlockPtr;
+
+	// Update the bucket layout, the linear hashing state and the free block list.
+	fileHeader->BucketCount = directory->BucketCount;
+	fileHeader->FirstBucketBlockIndex = directory->FirstBucketBlockIndex;
+	fileHeader->BucketBlockCount = directory->BucketBlockCount;
+	fileHeader->Level = directory->Level;
+	fileHeader->SplitIndex = directory->SplitIndex;
+	fileHeader->RecordCount = directory->RecordCount;
+	fileHeader->FirstFreeBlockIndex = directory->FirstFreeBlockIndex;
+	fileHeader->FreeBlockCount = directory->FreeBlockCount;
+
+	// Write the hash file header block to the disk.
+	if (BF_WriteBlock(fileHandle, HEADER_BLOCK_INDEX) < 0)
+	{
+		printf("Could not write hash header block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
 
-		// Offset the pointer by the size of the header so it points to the first bucket.
-		currentBucketBlockPtr += sizeof(HashBucketBlockHeader);
+		return -1;
+	}
+
+	return 0;
+}
+
+void FreeBucketDirectory(HashBucketDirectory* directory)
+{
+	free(directory->Buckets);
+
+	memset(directory, 0, sizeof(HashBucketDirectory));
+}
 
-		// Update the current bucket block to point to the next one.
-		currentBucketBlockIndex = currentBucketBlockHeader->NextBlockIndex;
+void ReadaheadBuckets(int32_t fileHandle, const HashBucketDirectory* directory, uint32_t bucketIndex)
+{
+	// Read half a window at a time, so that the next half is already in flight while the scan reaches it.
+	uint32_t halfWindow = SCAN_READAHEAD_BUCKET_COUNT / 2;
+	if (bucketIndex % halfWindow != 0)
+		return;
+
+	uint32_t firstBucketIndex = (bucketIndex == 0) ? 0 : bucketIndex + halfWindow;
+	uint32_t endBucketIndex = bucketIndex + SCAN_READAHEAD_BUCKET_COUNT;
+	if (endBucketIndex > directory->BucketCount)
+		endBucketIndex = directory->BucketCount;
+
+	// Collect the first data blocks of the non empty buckets.
+	int32_t blockIndices[SCAN_READAHEAD_BUCKET_COUNT];
+	int32_t blockCount = 0;
+	for (uint32_t index = firstBucketIndex; index < endBucketIndex; index++)
+	{
+		if (directory->Buckets[index] != INVALID_BLOCK_INDEX)
+			blockIndices[blockCount++] = directory->Buckets[index];
+	}
 
-		// Calculate the number of buckets in the current bucket block. If it's not the last one there's the
-		// max number of buckets. Otherwise it's the remainder.
-		int32_t bucketsInCurrentBlock = MAX_BUCKET_COUNT_PER_BLOCK;
-		if (currentBucketBlockHeader->NextBlockIndex == INVALID_BLOCK_INDEX)
-			bucketsInCurrentBlock = bucketCount % MAX_BUCKET_COUNT_PER_BLOCK;
+	// A failed prefetch only means that the blocks are read when the scan reaches them.
+	BF_PrefetchBlocks(fileHandle, blockIndices, blockCount);
+}
 
-		// Store the values for the buckets because the block will get unloaded.
-		int32_t* bucketValues = (int32_t*)malloc(bucketsInCurrentBlock * sizeof(int32_t));
-		memcpy(bucketValues, currentBucketBlockPtr, bucketsInCurrentBlock * sizeof(int32_t));
+int32_t AllocateChainBlock(int32_t fileHandle, HashBucketDirectory* directory, int32_t lastDataBlockIndex, uint32_t* reservedBlockCount)
+{
+	// The first data block of a bucket is allocated alone, since most buckets never overflow.
+	uint32_t blockCount = 1;
 
-		// Loop though all the buckets in the block.
-		for (uint32_t bucketIndex = 0; bucketIndex < bucketsInCurrentBlock; bucketIndex++)
+	if (lastDataBlockIndex != INVALID_BLOCK_INDEX)
+	{
+		// Retrieve a pointer to the last data block of the chain.
+		uint8_t* lastDataBlockPtr = nullptr;
+		if (BF_ReadBlock(fileHandle, lastDataBlockIndex, (void**)&lastDataBlockPtr) < 0)
 		{
-			// Start from the first data block.
-			int32_t currentDataBlockIndex = bucketValues[bucketIndex];
+			printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", fileHandle, lastDataBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
 
-			// The number of elements in the bucket.
-			uint32_t elementCount = 0;
+		// If the last block reserves blocks, the next one is right after it.
+		HashDataBlockHeader* lastDataBlockHeader = (HashDataBlockHeader*)lastDataBlockPtr;
+		if (lastDataBlockHeader->ReservedBlockCount > 0)
+		{
+			*reservedBlockCount = lastDataBlockHeader->ReservedBlockCount - 1;
+			return lastDataBlockIndex + 1;
+		}
 
-			// The number of blocks in the bucket.
-			uint32_t blockCount = 0;
+		// Otherwise the chain gets a new extent.
+		blockCount = BUCKET_EXTENT_BLOCK_COUNT;
+	}
 
-			// Loop through all the data blocks in the bucket.
-			while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
-			{
-				// Retrieve a pointer to the data block.
-				uint8_t* currentDataBlockPtr = nullptr;
-				if (BF_ReadBlock(handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
-				{
-					printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
-					BF_PrintError("");
+	// Reuse a free block before growing the file.
+	if (directory->FreeBlockCount > 0)
+	{
+		int32_t freeDataBlockIndex = directory->FirstFreeBlockIndex;
 
-					return -1;
-				}
+		// Retrieve a pointer to the first free block.
+		uint8_t* freeDataBlockPtr = nullptr;
+		if (BF_ReadBlock(fileHandle, freeDataBlockIndex, (void**)&freeDataBlockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", fileHandle, freeDataBlockIndex);
+			BF_PrintError("");
 
-				// Increment the number of blocks in the bucket.
-				blockCount++;
+			return -1;
+		}
 
-				// Since this block exists we know there is a DataBlockHeader is the first byte so treat is as such.
-				HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
+		// Pop it from the free block list.
+		directory->FirstFreeBlockIndex = ((HashDataBlockHeader*)freeDataBlockPtr)->NextBlockIndex;
+		directory->FreeBlockCount--;
+		if (StoreBucketDirectoryHeader(fileHandle, directory) == -1)
+			return -1;
 
-				// Increment the record count by the number of records in the block.
-				elementCount += currentDataBlockHeader->ElementCount;
+		// Clear the block, the caller writes it along with it's first record.
+		memset(freeDataBlockPtr, 0, BF_GetBlockSize(fileHandle));
 
-				// Update the current data block to point to the next one.
-				currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
-			}
+		*reservedBlockCount = 0;
+		return freeDataBlockIndex;
+	}
+
+	// Allocate the new data blocks.
+	int32_t dataBlockIndex = BF_AllocateBlocks(fileHandle, blockCount);
+	if (dataBlockIndex < 0)
+	{
+		printf("Could not allocate data block for the hash file! FileHandle: %d\n", fileHandle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	*reservedBlockCount = blockCount - 1;
+	return dataBlockIndex;
+}
+
+int32_t FreeDataBlocks(int32_t fileHandle, HashBucketDirectory* directory, int32_t firstDataBlockIndex, uint32_t blockCount)
+{
+	// Push the blocks from the last one, so that the list starts with them in ascending order.
+	for (uint32_t blockNumber = blockCount; blockNumber > 0; blockNumber--)
+	{
+		int32_t dataBlockIndex = firstDataBlockIndex + blockNumber - 1;
+
+		// Retrieve a pointer to the data block.
+		uint8_t* dataBlockPtr = nullptr;
+		if (BF_ReadBlock(fileHandle, dataBlockIndex, (void**)&dataBlockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", fileHandle, dataBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// A free block is an empty data block that links to the next free block.
+		HashDataBlockHeader dataBlockHeader = { };
+		dataBlockHeader.NextBlockIndex = (directory->FreeBlockCount > 0) ? directory->FirstFreeBlockIndex : INVALID_BLOCK_INDEX;
+
+		memset(dataBlockPtr, 0, BF_GetBlockSize(fileHandle));
+		memcpy(dataBlockPtr, &dataBlockHeader, sizeof(HashDataBlockHeader));
+
+		// Write the free block to the disk.
+		if (BF_WriteBlock(fileHandle, dataBlockIndex) < 0)
+		{
+			printf("Could not write hash data block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, dataBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		directory->FirstFreeBlockIndex = dataBlockIndex;
+		directory->FreeBlockCount++;
+	}
+
+	return StoreBucketDirectoryHeader(fileHandle, directory);
+}
+
+// Orders block indices.
+static int CompareBlockIndices(const void* left, const void* right)
+{
+	int32_t leftBlockIndex = *(const int32_t*)left;
+	int32_t rightBlockIndex = *(const int32_t*)right;
+
+	return (leftBlockIndex > rightBlockIndex) - (leftBlockIndex < rightBlockIndex);
+}
+
+int32_t TruncateFreeBlocks(int32_t fileHandle, HashBucketDirectory* directory)
+{
+	if (directory->FreeBlockCount == 0)
+		return 0;
+
+	// Allocate room for the indices of the free blocks.
+	int32_t* freeBlockIndices = (int32_t*)malloc(directory->FreeBlockCount * sizeof(int32_t));
+	if (freeBlockIndices == nullptr)
+	{
+		printf("Could not allocate memory for the free block list! FileHandle: %d, FreeBlockCount: %d\n", fileHandle, directory->FreeBlockCount);
+		return -1;
+	}
+
+	// Walk the free block list and collect it's blocks.
+	int32_t currentDataBlockIndex = directory->FirstFreeBlockIndex;
+	for (uint32_t index = 0; index < directory->FreeBlockCount; index++)
+	{
+		// Retrieve a pointer to the current free block.
+		uint8_t* currentDataBlockPtr = nullptr;
+		if (BF_ReadBlock(fileHandle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", fileHandle, currentDataBlockIndex);
+			BF_PrintError("");
+			free(freeBlockIndices);
+
+			return -1;
+		}
+
+		freeBlockIndices[index] = currentDataBlockIndex;
+		currentDataBlockIndex = ((HashDataBlockHeader*)currentDataBlockPtr)->NextBlockIndex;
+	}
+
+	qsort(freeBlockIndices, directory->FreeBlockCount, sizeof(int32_t), CompareBlockIndices);
+
+	// Count the free blocks that end the file.
+	int32_t blockCount = BF_GetBlockCounter(fileHandle);
+	uint32_t freeBlockCount = directory->FreeBlockCount;
+	while (freeBlockCount > 0 && freeBlockIndices[freeBlockCount - 1] == blockCount - 1)
+	{
+		freeBlockCount--;
+		blockCount--;
+	}
+
+	// There's nothing to give back if the last block of the file is in use.
+	if (freeBlockCount == directory->FreeBlockCount)
+	{
+		free(freeBlockIndices);
+		return 0;
+	}
+
+	// Relink the free blocks that stay, so that the list no longer reaches the blocks that are removed.
+	directory->FirstFreeBlockIndex = INVALID_BLOCK_INDEX;
+	directory->FreeBlockCount = 0;
+
+	int32_t result = 0;
+	for (uint32_t index = freeBlockCount; index > 0 && result == 0; index--)
+		result = FreeDataBlocks(fileHandle, directory, freeBlockIndices[index - 1], 1);
+
+	free(freeBlockIndices);
+
+	// An empty list still has to be stored.
+	if (result == 0 && freeBlockCount == 0)
+		result = StoreBucketDirectoryHeader(fileHandle, directory);
+
+	// Remove the blocks. The changes above are written first, so the list never refers to blocks past the end of the file.
+	if (result == 0 && BF_TruncateFile(fileHandle, blockCount) < 0)
+	{
+		printf("Could not truncate the hash file! FileHandle: %d, BlockCount: %d\n", fileHandle, blockCount);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	return result;
+}
+
+int32_t OpenLoggedFile(const char* fileName)
+{
+	// The memory mapped backend can't log the changes, so if the application selected it, it gets the mapping without the log.
+	int32_t fileHandle = BF_OpenFileWithLog(fileName);
+	if (fileHandle == BFE_LOGUNSUPPORTED)
+		fileHandle = BF_OpenFile(fileName);
+
+	return fileHandle;
+}
+
+OpenHashFile* AddOpenHashFile(OpenHashFileTable* table, int32_t fileHandle, FileType type, char* fileName)
+{
+	pthread_mutex_lock(&table->Lock);
+
+	// Allocate the entries the first time the table is used, once the block level knows how many files it can open.
+	if (!table->IsInitialized)
+	{
+		table->Files = (OpenHashFile*)calloc(BF_GetMaxOpenFiles(), sizeof(OpenHashFile));
+		if (table->Files == nullptr)
+		{
+			pthread_mutex_unlock(&table->Lock);
+			return nullptr;
+		}
+
+		table->FileCount = BF_GetMaxOpenFiles();
+		for (uint32_t fileIndex = 0; fileIndex < table->FileCount; fileIndex++)
+			pthread_rwlock_init(&table->Files[fileIndex].Lock, nullptr);
+
+		table->IsInitialized = true;
+	}
+
+	// Find a free entry.
+	OpenHashFile* file = nullptr;
+	for (uint32_t fileIndex = 0; fileIndex < table->FileCount && file == nullptr; fileIndex++)
+		if (!table->Files[fileIndex].IsOpen)
+			file = &table->Files[fileIndex];
+
+	if (file == nullptr)
+	{
+		pthread_mutex_unlock(&table->Lock);
+		return nullptr;
+	}
+
+	// Reserve the entry. No lookup matches it until it has a handle, so nobody sees it half initialized.
+	file->IsOpen = true;
+	file->Handle = -1;
+
+	pthread_mutex_unlock(&table->Lock);
+
+	// Lock the entry without holding the table lock, since the entry lock is always acquired first.
+	pthread_rwlock_wrlock(&file->Lock);
+
+	// Keep a copy of the name, since the caller's string may not outlive the file.
+	file->FileName = (char*)malloc(strlen(fileName) + 1);
+	if (file->FileName != nullptr)
+		memcpy(file->FileName, fileName, strlen(fileName) + 1);
+
+	file->Type = type;
+	memset(&file->Directory, 0, sizeof(HashBucketDirectory));
+
+	// Make the entry visible to the lookups.
+	SetOpenHashFileHandle(table, file, fileHandle);
 
-			// If the current bucket is not invalid, we need to update the results.
-			if (bucketValues[bucketIndex] != INVALID_BLOCK_INDEX)
+	return file;
+}
+
+OpenHashFile* AcquireOpenHashFile(OpenHashFileTable* table, int32_t fileHandle, bool isExclusive)
+{
+	// Find the entry of the file.
+	pthread_mutex_lock(&table->Lock);
+
+	OpenHashFile* file = nullptr;
+	for (uint32_t fileIndex = 0; fileIndex < table->FileCount && file == nullptr; fileIndex++)
+		if (table->Files[fileIndex].IsOpen && table->Files[fileIndex].Handle == fileHandle)
+			file = &table->Files[fileIndex];
+
+	pthread_mutex_unlock(&table->Lock);
+
+	if (file == nullptr)
+		return nullptr;
+
+	// Lock the entry outside of the table lock, so that a long operation on one file doesn't block the lookups of the others.
+	if (isExclusive)
+		pthread_rwlock_wrlock(&file->Lock);
+	else
+		pthread_rwlock_rdlock(&file->Lock);
+
+	// The file may have been closed while we were waiting for the lock.
+	if (!file->IsOpen || file->Handle != fileHandle)
+	{
+		pthread_rwlock_unlock(&file->Lock);
+		return nullptr;
+	}
+
+	return file;
+}
+
+void SetOpenHashFileHandle(OpenHashFileTable* table, OpenHashFile* file, int32_t fileHandle)
+{
+	// The handle is what lookups match against, so change it under the table lock.
+	pthread_mutex_lock(&table->Lock);
+	file->Handle = fileHandle;
+	pthread_mutex_unlock(&table->Lock);
+}
+
+void ReleaseOpenHashFile(OpenHashFile* file)
+{
+	pthread_rwlock_unlock(&file->Lock);
+}
+
+int32_t CommitOpenHashFile(OpenHashFile* file)
+{
+	// Commit the logged changes while the file is locked, so that they don't mix with the changes of the next operation.
+	int32_t handle = file->Handle;
+	long long ticket = BF_Commit(handle);
+	ReleaseOpenHashFile(file);
+
+	if (ticket < 0)
+	{
+		printf("Could not commit the changes to the hash file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Wait for the commit without the lock.
+	if (BF_WaitForCommit(handle, ticket) < 0)
+	{
+		printf("Could not write the changes of the hash file to the log! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	return 0;
+}
+
+void RemoveOpenHashFile(OpenHashFileTable* table, OpenHashFile* file)
+{
+	// Free the per file state.
+	FreeBucketDirectory(&file->Directory);
+	free(file->FileName);
+	file->FileName = nullptr;
+	file->Type = None;
+
+	// Mark the entry as free.
+	pthread_mutex_lock(&table->Lock);
+	file->IsOpen = false;
+	file->Handle = -1;
+	pthread_mutex_unlock(&table->Lock);
+
+	pthread_rwlock_unlock(&file->Lock);
+}
+
+int32_t HashStatistics(char* fileName)
+{
+	// Open the hash file.
+	int32_t handle = BF_OpenFile(fileName);
+	if (handle < 0)
+	{
+		printf("Could not open hash file!\n");
+		return -1;
+	}
+
+	// Retrieve a pointer to the hash file header block.
+	uint8_t* headerBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to hash header block! FileHandle: %d, BlockIndex: %d\n", handle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Since this file exists, we know there's a FileHeader in the first bytes of the header block. So we treat the pointer as such.
+	HashFileHeader* fileHeader = (HashFileHeader*)headerBlockPtr;
+
+	if (fileHeader->CommonHeader.Type != HashFile && fileHeader->CommonHeader.Type != SecondaryHashFile &&
+		fileHeader->CommonHeader.Type != LinearHashFile && fileHeader->CommonHeader.Type != ExtendibleHashFile)
+	{
+		printf("The file provided is not a hash file! FileName: %s\n", fileName);
+		return -1;
+	}
+
+	// Load the bucket directory so that the buckets don't have to be read block by block.
+	HashBucketDirectory directory;
+	if (LoadBucketDirectory(handle, &directory) == -1)
+	{
+		printf("Could not load the bucket directory! FileName: %s\n", fileName);
+		return -1;
+	}
+
+	uint32_t bucketCount = directory.BucketCount;
+
+	// Initialize the statistics.
+	uint32_t minElementCount = UINT32_MAX;
+	uint32_t maxElementCount = 0;
+	uint32_t totalElementCount = 0;
+	uint32_t* overflowBlocksPerBucket = (uint32_t*)malloc(bucketCount * sizeof(uint32_t));
+	memset(overflowBlocksPerBucket, 0, bucketCount * sizeof(uint32_t));
+
+	// Loop though all the buckets.
+	for (uint32_t bucketIndex = 0; bucketIndex < bucketCount; bucketIndex++)
+	{
+		// Read the next buckets ahead while this one is counted.
+		ReadaheadBuckets(handle, &directory, bucketIndex);
+
+		// Start from the first data block.
+		int32_t currentDataBlockIndex = directory.Buckets[bucketIndex];
+
+		// The number of elements in the bucket.
+		uint32_t elementCount = 0;
+
+		// The number of blocks in the bucket.
+		uint32_t blockCount = 0;
+
+		// Whether the bucket shares the data blocks of an earlier bucket.
+		bool isSharedBucket = false;
+
+		// Loop through all the data blocks in the bucket.
+		while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
+		{
+			// Retrieve a pointer to the data block.
+			uint8_t* currentDataBlockPtr = nullptr;
+			if (BF_ReadBlock(handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
 			{
-				// Update the min record count.
-				if (elementCount < minElementCount)
-					minElementCount = elementCount;
+				printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
+				BF_PrintError("");
 
-				// Update the max record count.
-				if (elementCount > maxElementCount)
-					maxElementCount = elementCount;
+				return -1;
+			}
 
-				// Update the total record count.
-				totalElementCount += elementCount;
+			// Since this block exists we know there is a DataBlockHeader is the first byte so treat is as such.
+			HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
 
-				// Update the overflow block counts. Subtract one to account for the first block.
-				overflowBlocksPerBucket[globalBucketIndex] = blockCount - 1;
+			// If the blocks of the bucket belong to an earlier bucket, they have already been counted.
+			if (blockCount == 0 && IsSharedBucket(&directory, bucketIndex, currentDataBlockHeader->LocalDepth))
+			{
+				isSharedBucket = true;
+				break;
 			}
 
-			// Increment the global bucket index.
-			globalBucketIndex++;
+			// Increment the number of blocks in the bucket.
+			blockCount++;
+
+			// Start reading the overflow block, if there is one.
+			if (currentDataBlockHeader->NextBlockIndex != INVALID_BLOCK_INDEX)
+				BF_Prefetch(handle, currentDataBlockHeader->NextBlockIndex, 1);
+
+			// Increment the record count by the number of records in the block.
+			elementCount += currentDataBlockHeader->ElementCount;
+
+			// Update the current data block to point to the next one.
+			currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
 		}
 
-		free(bucketValues);
+		// If the current bucket is not invalid, we need to update the results.
+		if (directory.Buckets[bucketIndex] != INVALID_BLOCK_INDEX && !isSharedBucket)
+		{
+			// Update the min record count.
+			if (elementCount < minElementCount)
+				minElementCount = elementCount;
+
+			// Update the max record count.
+			if (elementCount > maxElementCount)
+				maxElementCount = elementCount;
+
+			// Update the total record count.
+			totalElementCount += elementCount;
+
+			// Update the overflow block counts. Subtract one to account for the first block.
+			overflowBlocksPerBucket[bucketIndex] = blockCount - 1;
+		}
 	}
 
+	// Free the bucket directory.
+	FreeBucketDirectory(&directory);
+
 	// Retrieve the block count.
 	int32_t blockCount = BF_GetBlockCounter(handle);
 	if (blockCount < 0)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <pthread.h>
 
 // A NULL type for pointers.
 #define nullptr 0
@@ -49,6 +50,9 @@ int32_t HashStatistics(char* fileName);
 // The index of the hash file header block and the secondary hash file header block.
 #define HEADER_BLOCK_INDEX 0
 
+// The index of the first bucket block of every hash file, right after the header block.
+#define FIRST_BUCKET_BLOCK_INDEX (HEADER_BLOCK_INDEX + 1)
+
 // The type of files created by the application.
 typedef enum FileType
 {
@@ -62,7 +66,13 @@ typedef enum FileType
 	HashFile,
 
 	// A secondary hash file.
-	SecondaryHashFile
+	SecondaryHashFile,
+
+	// A hash file that uses linear hashing to grow it's bucket count with the data.
+	LinearHashFile,
+
+	// A hash file that uses extendible hashing, where the buckets are a directory of 2^depth entries that share data blocks.
+	ExtendibleHashFile
 } FileType;
 
 // A common file header for all files created by the application.
@@ -82,17 +92,36 @@ typedef struct HashFileHeader
 	// The number of buckets in the hash file.
 	uint32_t BucketCount;
 
-	// The index of the next block in the hash file.
-	int32_t NextBlockIndex;
-} HashFileHeader;
+	// The index of the first bucket block. The bucket blocks are allocated contiguously and contain nothing but
+	// the buckets, so the bucket block of any bucket can be calculated with BUCKET_BLOCK_INDEX.
+	int32_t FirstBucketBlockIndex;
 
-// The memory layout of a hash file block that containts the buckets.
-// This structure is stored in all hash file blocks that contain buckets, both primary and secondary.
-typedef struct HashBucketBlockHeader
-{
-	// The index of the next bucket block in the hash file.
-	int32_t NextBlockIndex;
-} HashBucketBlockHeader;
+	// The number of allocated bucket blocks. This can be more than the bucket count requires if the file grows.
+	uint32_t BucketBlockCount;
+
+	// The number of buckets the file was created with.
+	uint32_t InitialBucketCount;
+
+	// The number of times the bucket count has doubled. Only linear and extendible hash files change it. For extendible hash
+	// files the initial bucket count is 1, so this is the global depth.
+	uint32_t Level;
+
+	// The index of the next bucket to split. Only linear hash files change it.
+	uint32_t SplitIndex;
+
+	// The number of records in the file. Only linear hash files maintain it.
+	uint32_t RecordCount;
+
+	// The load factor above which a linear hash file splits a bucket. Zero for the files that never grow.
+	float MaxLoadFactor;
+
+	// The first block of the list of free data blocks, linked through their NextBlockIndex. Data blocks emptied by deletes are
+	// unlinked from their chains and pushed on the list, so that new data blocks reuse them before the file grows.
+	int32_t FirstFreeBlockIndex;
+
+	// The number of blocks in the free block list.
+	uint32_t FreeBlockCount;
+} HashFileHeader;
 
 // The memory layout of the hash file data block. This structure is stored on the
 // first block of a hash file data block, both primary and secondary.
@@ -101,9 +130,201 @@ typedef struct HashDataBlockHeader
 	// The number of elements in the hash file.
 	uint32_t ElementCount;
 
+	// The number of record slots in use, deleted ones included. A deleted record keeps it's slot, marked in the tombstone bitmap at the
+	// end of the block, so that the other records of the block never move. Secondary hash files never delete, so they don't use it.
+	uint32_t SlotCount;
+
 	// The index of the next data block in the hash file.
 	int32_t NextBlockIndex;
+
+	// The number of low hash bits shared by all the elements of the block. Only extendible hash files use it.
+	uint32_t LocalDepth;
+
+	// The number of blocks right after this one that are allocated for the chain of it's bucket, but not linked yet. Only the
+	// last block of a chain reserves blocks.
+	uint32_t ReservedBlockCount;
 } HashDataBlockHeader;
 
-// Calculate at compile time the maximum number of buckets in a block.
-#define MAX_BUCKET_COUNT_PER_BLOCK ((BLOCK_SIZE - sizeof(HashBucketBlockHeader)) / sizeof(int32_t))
+// Whether a record slot of a primary hash data block holds a deleted record. The tombstone bitmap starts from the last byte of the block
+// and grows backwards, so the bit of a slot doesn't depend on the number of slots of the block.
+#define IS_SLOT_DELETED(blockPtr, blockSize, slotIndex) \
+	((((const uint8_t*)(blockPtr))[(blockSize) - 1 - (slotIndex) / 8] >> ((slotIndex) % 8)) & 1)
+
+// Mark a record slot of a primary hash data block as deleted.
+#define MARK_SLOT_DELETED(blockPtr, blockSize, slotIndex) \
+	(((uint8_t*)(blockPtr))[(blockSize) - 1 - (slotIndex) / 8] |= (uint8_t)(1 << ((slotIndex) % 8)))
+
+// Mark a record slot of a primary hash data block as used or free.
+#define UNMARK_SLOT_DELETED(blockPtr, blockSize, slotIndex) \
+	(((uint8_t*)(blockPtr))[(blockSize) - 1 - (slotIndex) / 8] &= (uint8_t)~(1 << ((slotIndex) % 8)))
+
+// Calculate the maximum number of buckets in a block for a given block size.
+#define MAX_BUCKET_COUNT_PER_BLOCK(blockSize) ((blockSize) / sizeof(int32_t))
+
+// Calculate the number of bucket blocks required to store bucketCount buckets, rounding up for the remainder.
+#define BUCKET_BLOCK_COUNT(bucketCount, bucketsPerBlock) (((bucketCount) + (bucketsPerBlock) - 1) / (bucketsPerBlock))
+
+// Calculate the index of the bucket block that stores a bucket, without reading any blocks.
+#define BUCKET_BLOCK_INDEX(firstBucketBlockIndex, bucketIndex, bucketsPerBlock) ((firstBucketBlockIndex) + (bucketIndex) / (bucketsPerBlock))
+
+// An in memory copy of the bucket directory of a hash file, both primary and secondary. It's loaded when the file
+// is opened so that finding the first data block of a bucket doesn't read any bucket blocks.
+typedef struct HashBucketDirectory
+{
+	// The number of buckets in the hash file.
+	uint32_t BucketCount;
+
+	// The number of buckets stored in every bucket block.
+	uint32_t BucketsPerBlock;
+
+	// The index of the first data block of every bucket, or INVALID_BLOCK_INDEX if the bucket is empty.
+	int32_t* Buckets;
+
+	// The number of allocated bucket blocks in the hash file. The Buckets array has room for all of their buckets.
+	uint32_t BucketBlockCount;
+
+	// The index of the first bucket block.
+	int32_t FirstBucketBlockIndex;
+
+	// The linear hashing state, copied from the HashFileHeader.
+	uint32_t InitialBucketCount;
+	uint32_t Level;
+	uint32_t SplitIndex;
+	uint32_t RecordCount;
+	float MaxLoadFactor;
+
+	// The free block list, copied from the HashFileHeader.
+	int32_t FirstFreeBlockIndex;
+	uint32_t FreeBlockCount;
+} HashBucketDirectory;
+
+// Allocates and initializes the contiguous bucket blocks of a new hash file, both primary and secondary. The blocks must
+// be allocated right after the header block so they start at firstBucketBlockIndex. Returns 0 on success and -1 on failure.
+int32_t CreateBucketBlocks(int32_t fileHandle, uint32_t bucketCount, int32_t firstBucketBlockIndex);
+
+// The number of bucket blocks LoadBucketDirectory reads with one BF_ReadBlocks call.
+#define BUCKET_BLOCK_BATCH_SIZE 8
+
+// Loads the bucket directory of an open block level hash file, both primary and secondary. Returns 0 on success and -1 on failure.
+int32_t LoadBucketDirectory(int32_t fileHandle, HashBucketDirectory* directory);
+
+// Sets the first data block of a bucket, both in the directory and in the bucket block on the disk.
+// Returns 0 on success and -1 on failure.
+int32_t SetBucketFirstBlock(int32_t fileHandle, HashBucketDirectory* directory, uint32_t bucketIndex, int32_t dataBlockIndex);
+
+// Calculates the bucket of a hash value using the linear hashing addressing. For files that never grow it's hash % BucketCount.
+uint32_t GetBucketIndex(const HashBucketDirectory* directory, uint32_t hash);
+
+// Appends an empty bucket to the directory. If the bucket blocks are full, they are moved to a new contiguous range of twice
+// the size at the end of the file. The header is not updated, use StoreBucketDirectoryHeader for that. Returns 0 on success
+// and -1 on failure.
+int32_t AddBucket(int32_t fileHandle, HashBucketDirectory* directory);
+
+// Doubles the bucket count of the directory and increments it's level. Every new bucket shares the data blocks of the bucket
+// with the same lowest bits. The header is not updated, use StoreBucketDirectoryHeader for that. Returns 0 on success and -1 on failure.
+int32_t DoubleBucketDirectory(int32_t fileHandle, HashBucketDirectory* directory);
+
+// Returns whether the data blocks of a bucket belong to an earlier bucket, given the local depth of it's first data block. Only
+// extendible hash files share data blocks between buckets, so scans of all the buckets use this to visit every block once.
+bool IsSharedBucket(const HashBucketDirectory* directory, uint32_t bucketIndex, uint32_t localDepth);
+
+// Writes the in memory buckets of bucketBlockCount bucket blocks, starting from the bucketBlockNumber-th one, to the disk.
+// Returns 0 on success and -1 on failure.
+int32_t StoreBucketBlocks(int32_t fileHandle, const HashBucketDirectory* directory, uint32_t bucketBlockNumber, uint32_t bucketBlockCount);
+
+// Writes the bucket layout, the linear hashing state and the free block list of the directory to the hash file header. Returns 0 on
+// success and -1 on failure.
+int32_t StoreBucketDirectoryHeader(int32_t fileHandle, const HashBucketDirectory* directory);
+
+// Frees the memory held by a bucket directory.
+void FreeBucketDirectory(HashBucketDirectory* directory);
+
+// The number of buckets whose first data blocks a scan of all the buckets reads ahead.
+#define SCAN_READAHEAD_BUCKET_COUNT 32
+
+// Starts reading the first data blocks of the buckets ahead of bucketIndex asynchronously, so that a scan of all the buckets
+// doesn't wait for every block in turn. Called for every bucket the scan visits, in order.
+void ReadaheadBuckets(int32_t fileHandle, const HashBucketDirectory* directory, uint32_t bucketIndex);
+
+// The number of consecutive data blocks allocated at once when the chain of a bucket overflows, so that the chain stays
+// contiguous in the file.
+#define BUCKET_EXTENT_BLOCK_COUNT 4
+
+// Allocates a zeroed data block to append to the chain of a bucket, both primary and secondary, whose last data block is
+// lastDataBlockIndex, or INVALID_BLOCK_INDEX if the bucket is empty. Overflow blocks are taken from the blocks reserved by the
+// last block, then from the free block list of the directory, or from a new extent of BUCKET_EXTENT_BLOCK_COUNT blocks. The number
+// of blocks the new block reserves is stored in reservedBlockCount, and the caller clears the reservation of the last block when
+// it links the new one. Returns the index of the new block on success and -1 on failure.
+int32_t AllocateChainBlock(int32_t fileHandle, HashBucketDirectory* directory, int32_t lastDataBlockIndex, uint32_t* reservedBlockCount);
+
+// Pushes blockCount consecutive data blocks, starting from firstDataBlockIndex, on the free block list of the directory and updates
+// the header. The blocks must already be unlinked from their chains. Returns 0 on success and -1 on failure.
+int32_t FreeDataBlocks(int32_t fileHandle, HashBucketDirectory* directory, int32_t firstDataBlockIndex, uint32_t blockCount);
+
+// Gives the free blocks at the end of the file back to the file system, and relinks the rest of the free block list in ascending
+// order so that they are reused front to back. Returns 0 on success and -1 on failure.
+int32_t TruncateFreeBlocks(int32_t fileHandle, HashBucketDirectory* directory);
+
+// The state of an open hash file, both primary and secondary. The open functions return a pointer to it's handle.
+typedef struct OpenHashFile
+{
+	// Whether the entry holds an open file.
+	bool IsOpen;
+
+	// The block level handle of the file.
+	int32_t Handle;
+
+	// The type of the file.
+	FileType Type;
+
+	// The name the file was opened with, so that it can be rebuilt.
+	char* FileName;
+
+	// The cached bucket directory of the file.
+	HashBucketDirectory Directory;
+
+	// Held shared by the lookups and exclusively by the operations that modify the file, so lookups run concurrently.
+	pthread_rwlock_t Lock;
+} OpenHashFile;
+
+// A table of the open hash files of a file type.
+typedef struct OpenHashFileTable
+{
+	// The entries of the table. There is one for every file the block level can open, so the table fills up along with
+	// the block level file table.
+	OpenHashFile* Files;
+	uint32_t FileCount;
+
+	// Whether the entries have been allocated.
+	bool IsInitialized;
+
+	// Guards the IsOpen and Handle fields of the entries.
+	pthread_mutex_t Lock;
+} OpenHashFileTable;
+
+// Initializes an OpenHashFileTable with static storage duration.
+#define OPEN_HASH_FILE_TABLE_INITIALIZER { .Files = nullptr, .FileCount = 0, .IsInitialized = false, .Lock = PTHREAD_MUTEX_INITIALIZER }
+
+// Opens a block level file with a write ahead log, or without one if the selected backend doesn't support logging. Returns the
+// file handle on success and a negative BF error code on failure.
+int32_t OpenLoggedFile(const char* fileName);
+
+// Adds an open block level file to the table. Returns the new entry locked, or nullptr if the table is full.
+OpenHashFile* AddOpenHashFile(OpenHashFileTable* table, int32_t fileHandle, FileType type, char* fileName);
+
+// Finds and locks the entry of an open file, shared or exclusively. Returns nullptr if the file is not in the table.
+OpenHashFile* AcquireOpenHashFile(OpenHashFileTable* table, int32_t fileHandle, bool isExclusive);
+
+// Changes the block level handle of a locked entry, for operations that reopen the file. A handle of -1 makes the file
+// unreachable until the entry is removed.
+void SetOpenHashFileHandle(OpenHashFileTable* table, OpenHashFile* file, int32_t fileHandle);
+
+// Unlocks an entry returned by AddOpenHashFile or AcquireOpenHashFile.
+void ReleaseOpenHashFile(OpenHashFile* file);
+
+// Commits the changes an operation made to an exclusively locked hash file and unlocks it, then waits until they are durable.
+// Waiting without the lock lets the commits of concurrent writers share one log write. Returns 0 on success and -1 on failure.
+int32_t CommitOpenHashFile(OpenHashFile* file);
+
+// Removes a locked entry from the table, freeing it's bucket directory and name, and unlocks it.
+void RemoveOpenHashFile(OpenHashFileTable* table, OpenHashFile* file);
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "SHT.h"
 
@@ -229,11 +230,104 @@ static int32_t DemoSHT(int32_t primaryBucketCount, int32_t secondaryBucketCount,
 	return 0;
 }
 
+// This function showcases the bulk load of a hash file with more records than the buffer pool holds, and checks that they were all
+// loaded.
+static int32_t DemoBulkLoad(int32_t bucketCount, int32_t recordCount)
+{
+	printf("=============================\n");
+	printf("==== HASH BULK LOAD DEMO ====\n");
+	printf("=============================\n");
+	printf("\n");
+
+	// Create and open a test hash file.
+	if (HT_CreateIndex("TestBulkLoadHashFile", 'i', "TestBulkLoadHashFile", 7, bucketCount) == -1)
+	{
+		printf("Could not create bulk load hash file!\n");
+		return -1;
+	}
+
+	HT_info* hashFileHandle = HT_OpenIndex("TestBulkLoadHashFile");
+	if (hashFileHandle == nullptr)
+	{
+		printf("Could not open bulk load hash file!\n");
+		return -1;
+	}
+
+	// Generate the records.
+	Record* records = (Record*)malloc(recordCount * sizeof(Record));
+	if (records == nullptr)
+	{
+		printf("Could not allocate the bulk load records!\n");
+		return -1;
+	}
+
+	for (int32_t recordIndex = 0; recordIndex < recordCount; recordIndex++)
+	{
+		Record record = { };
+		record.ID = recordIndex;
+		sprintf(record.Name, "Name%d", recordIndex);
+		sprintf(record.Surname, "Surname%d", recordIndex);
+		sprintf(record.Address, "Address%d", recordIndex);
+
+		records[recordIndex] = record;
+	}
+
+	// Load them at once. They take up more blocks than the buffer pool holds.
+	int32_t insertedCount = HT_BulkLoad(*hashFileHandle, records, recordCount, nullptr);
+	free(records);
+
+	if (insertedCount != recordCount)
+	{
+		printf("Could not bulk load the records! Inserted: %d\n", insertedCount);
+		return -1;
+	}
+
+	// Count the records in the hash file.
+	HT_Cursor* cursor = HT_ScanOpen(*hashFileHandle, nullptr);
+	if (cursor == nullptr)
+	{
+		printf("Could not open a cursor over the bulk load hash file!\n");
+		return -1;
+	}
+
+	int32_t scannedCount = 0;
+	const Record* record = nullptr;
+	while (HT_ScanNext(cursor, &record) == 1)
+		scannedCount++;
+
+	HT_ScanClose(cursor);
+
+	if (scannedCount != recordCount)
+	{
+		printf("The bulk load hash file has %d records instead of %d!\n", scannedCount, recordCount);
+		return -1;
+	}
+
+	if (HT_CloseIndex(hashFileHandle) == -1)
+	{
+		printf("Could not close bulk load hash file!\n");
+		return -1;
+	}
+
+	printf("Bulk loaded %d records into the hash file! This was the end of the bulk load demo.\n", recordCount);
+
+	return 0;
+}
+
 // Entry point.
 int32_t main()
 {
-	// Initialize the block level.
-	BF_Init();
+	// Initialize the block level. Blocks are written back in batches, and closing the files makes them durable.
+	BF_Config config = { };
+	BF_GetDefaultConfig(&config);
+	config.WriteMode = BF_WRITE_BACK;
+
+	if (BF_InitWithConfig(&config) < 0)
+	{
+		printf("Could not initialize the block level!\n");
+		BF_PrintError("");
+		return -1;
+	}
 
 	// Demo the heap file.
 	printf("\n");
@@ -248,5 +342,23 @@ int32_t main()
 	if (DemoSHT(primaryHashBucketCount, secondaryHashBucketCount, hashRecordCount) == -1)
 		return -1;
 
+	// Demo the bulk load.
+	printf("\n");
+	printf("Press enter to start the bulk load demo...\n");
+	printf("\n");
+	getchar();
+
+	int32_t bulkLoadBucketCount = 997;
+	int32_t bulkLoadRecordCount = 20000;
+
+	if (DemoBulkLoad(bulkLoadBucketCount, bulkLoadRecordCount) == -1)
+		return -1;
+
+	// Print the buffer pool statistics, so that the replacement policies can be compared.
+	BF_Statistics statistics = { };
+	BF_GetStatistics(&statistics);
+	printf("\n");
+	printf("Buffer pool hits: %llu, misses: %llu, evictions: %llu\n", statistics.HitCount, statistics.MissCount, statistics.EvictionCount);
+
 	return 0;
 }
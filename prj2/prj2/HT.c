@@ -1,4 +1,5 @@
 #include "HT.h"
+#include "SHT.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -6,15 +7,100 @@
 
 #include "BF/BF.h"
 
-// Calculate at compile time the maximum number of records in a hash data block.
-#define MAX_RECORD_COUNT_PER_BLOCK ((BLOCK_SIZE - sizeof(HashDataBlockHeader)) / sizeof(Record))
+// Calculate the maximum number of records in a hash data block for a given block size. Every record slot also needs a bit of the
+// tombstone bitmap at the end of the block.
+#define MAX_RECORD_COUNT_PER_BLOCK(blockSize) ((((blockSize) - sizeof(HashDataBlockHeader)) * 8) / (sizeof(Record) * 8 + 1))
 
-// Storage for the currently open hash file handle.
-static HT_info s_HandleStorage = -1;
+// The memory used by HT_Resize to gather the records of a batch of new buckets.
+#define RESIZE_BATCH_BYTE_COUNT (4 * 1024 * 1024)
 
-// The hash function used to insert keys in the hash table.
+// A bulk load commits the blocks it changed once they fill this fraction of the frames of the buffer pool, so that they can be
+// written back to make room for the next ones. HT_BulkLoadFile reads as many records at a time as fill that many blocks.
+#define BULK_LOAD_POOL_SHARE 4
+
+// The maximum global depth of an extendible hash file. Past it, full data blocks get overflow blocks instead of splitting.
+#define MAX_GLOBAL_DEPTH 20
+
+// The open hash files, along with their cached bucket directories.
+static OpenHashFileTable s_OpenFiles = OPEN_HASH_FILE_TABLE_INITIALIZER;
+
+// A record gathered by HT_Resize, along with it's new bucket and the block it was stored in.
+typedef struct ResizeEntry
+{
+	Record Record;
+	uint32_t BucketIndex;
+	int32_t OldBlockIndex;
+} ResizeEntry;
+
+// A record of a bulk load, identified by it's index in the loaded records and ordered by bucket and then by ID.
+typedef struct BulkLoadEntry
+{
+	uint32_t BucketIndex;
+	int32_t ID;
+	uint32_t RecordIndex;
+} BulkLoadEntry;
+
+// The state of a scan of a hash file, opened by HT_ScanOpen.
+struct HT_Cursor
+{
+	// The open hash file, whose lock the cursor holds shared until it's closed.
+	OpenHashFile* File;
+
+	// The block size of the hash file, which locates the tombstones of the data blocks.
+	int32_t BlockSize;
+
+	// The key of the records returned, if the cursor has one.
+	bool HasKey;
+	int32_t Key;
+
+	// The next bucket to scan, and the bucket after the last one to scan.
+	uint32_t BucketIndex;
+	uint32_t EndBucketIndex;
+
+	// The data block whose records are returned, pinned until the cursor moves past it, or INVALID_BLOCK_INDEX if there is none.
+	int32_t DataBlockIndex;
+	uint8_t* DataBlockPtr;
+
+	// The next record slot of the data block to read.
+	uint32_t SlotIndex;
+};
+
+// Orders bulk load entries by bucket and then by ID, so that duplicates end up next to each other.
+static int CompareBulkLoadEntries(const void* left, const void* right)
+{
+	const BulkLoadEntry* leftEntry = (const BulkLoadEntry*)left;
+	const BulkLoadEntry* rightEntry = (const BulkLoadEntry*)right;
+
+	if (leftEntry->BucketIndex != rightEntry->BucketIndex)
+		return (leftEntry->BucketIndex < rightEntry->BucketIndex) ? -1 : 1;
+
+	if (leftEntry->ID != rightEntry->ID)
+		return (leftEntry->ID < rightEntry->ID) ? -1 : 1;
+
+	// Keep the first occurrence of a duplicate first, so that it's the one inserted.
+	return (leftEntry->RecordIndex < rightEntry->RecordIndex) ? -1 : 1;
+}
+
+// Finds the entry with the given ID among the count entries of a bucket, or returns nullptr.
+static BulkLoadEntry* FindBulkLoadEntry(BulkLoadEntry* entries, uint32_t count, int32_t id)
+{
+	uint32_t low = 0;
+	uint32_t high = count;
+	while (low < high)
+	{
+		uint32_t middle = low + (high - low) / 2;
+		if (entries[middle].ID < id)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return (low < count && entries[low].ID == id) ? &entries[low] : nullptr;
+}
+
+// The hash function used to insert keys in the hash table. The bucket is selected from the hash with GetBucketIndex.
 // Reference for the algorith: https://burtleburtle.net/bob/hash/integer.html
-static int32_t HashFunction(int32_t key, int32_t hashTableSize)
+static uint32_t HashFunction(int32_t key)
 {
 	key -= (key << 6);
 	key ^= (key >> 17);
@@ -24,344 +110,660 @@ static int32_t HashFunction(int32_t key, int32_t hashTableSize)
 	key ^= (key << 10);
 	key ^= (key >> 15);
 
-	return key % hashTableSize;
+	return (uint32_t)key;
 }
 
-int32_t HT_CreateIndex(char* fileName, char attributeType, char* attributeName, int32_t attributeLength, int32_t bucketCount)
+// Takes a free record slot of a primary hash data block that is not full and counts the record that will be stored in it. The first
+// deleted slot is reused before the used slots are extended. Returns a pointer to the slot.
+static Record* AddRecordSlot(uint8_t* dataBlockPtr, int32_t blockSize)
 {
-	// Create the block level file.
-	if (BF_CreateFile(fileName) < 0)
+	HashDataBlockHeader* dataBlockHeader = (HashDataBlockHeader*)dataBlockPtr;
+	Record* records = (Record*)(dataBlockPtr + sizeof(HashDataBlockHeader));
+
+	// Extend the used slots if none of them is deleted.
+	uint32_t slotIndex = dataBlockHeader->SlotCount;
+	if (dataBlockHeader->ElementCount == dataBlockHeader->SlotCount)
+		dataBlockHeader->SlotCount++;
+	else
 	{
-		printf("Could not create block level file for the hash file! FileName: %s\n", fileName);
-		BF_PrintError("");
+		// Otherwise find the first deleted slot and clear it's tombstone.
+		for (slotIndex = 0; !IS_SLOT_DELETED(dataBlockPtr, blockSize, slotIndex); slotIndex++)
+			;
 
-		return -1;
+		UNMARK_SLOT_DELETED(dataBlockPtr, blockSize, slotIndex);
 	}
 
-	// Open the block level file.
-	HT_info fileHandle = BF_OpenFile(fileName);
-	if (fileHandle < 0)
-	{
-		printf("Could not open block level file for the hash file! FileName: %s\n", fileName);
-		BF_PrintError("");
+	dataBlockHeader->ElementCount++;
 
-		return -1;
-	}
+	return &records[slotIndex];
+}
 
-	// Allocate the hash file header block.
-	if (BF_AllocateBlock(fileHandle) < 0)
-	{
-		printf("Could not allocate header block for the hash file! FileHandle: %d\n", fileHandle);
-		BF_PrintError("");
+// Deletes the record in a slot of a primary hash data block. The slot gets a tombstone instead of the later records moving into it,
+// so the slots of the other records stay the same. The deleted slots at the end of the block are freed.
+static void DeleteRecordSlot(uint8_t* dataBlockPtr, int32_t blockSize, uint32_t slotIndex)
+{
+	HashDataBlockHeader* dataBlockHeader = (HashDataBlockHeader*)dataBlockPtr;
+	Record* records = (Record*)(dataBlockPtr + sizeof(HashDataBlockHeader));
 
-		return -1;
-	}
+	// Clear the record and mark it's slot as deleted.
+	memset(&records[slotIndex], 0, sizeof(Record));
+	MARK_SLOT_DELETED(dataBlockPtr, blockSize, slotIndex);
+	dataBlockHeader->ElementCount--;
 
-	// Retrieve a pointer to the hash file header block.
-	uint8_t* headerBlockPtr = nullptr;
-	if (BF_ReadBlock(fileHandle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	// Free the deleted slots at the end of the block, so that they are not scanned.
+	while (dataBlockHeader->SlotCount > 0 && IS_SLOT_DELETED(dataBlockPtr, blockSize, dataBlockHeader->SlotCount - 1))
 	{
-		printf("Could not retrieve pointer to hash header block! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
-		BF_PrintError("");
-
-		return -1;
+		dataBlockHeader->SlotCount--;
+		UNMARK_SLOT_DELETED(dataBlockPtr, blockSize, dataBlockHeader->SlotCount);
 	}
+}
 
-	// Create the hash file header and fill it's data.
-	HashFileHeader header = { };
-	header.CommonHeader.Type = HashFile;
-	header.BucketCount = bucketCount;
-	header.NextBlockIndex = INVALID_BLOCK_INDEX;
-
-	// Copy the file header into the hash file header block.
-	memcpy(headerBlockPtr, &header, sizeof(HashFileHeader));
+// Collects pointers to the records of a primary hash data block, reading it's slots from the one slotIndex points to. Deleted slots
+// are skipped, and so are records whose ID is not *key, unless key is nullptr. At most maxRecordCount records are collected, and
+// slotIndex is advanced past the last slot read. Returns the number of records collected.
+static uint32_t CollectRecordSlots(const uint8_t* dataBlockPtr, int32_t blockSize, uint32_t* slotIndex, const int32_t* key,
+	const Record** records, uint32_t maxRecordCount)
+{
+	const HashDataBlockHeader* dataBlockHeader = (const HashDataBlockHeader*)dataBlockPtr;
+	const Record* slots = (const Record*)(dataBlockPtr + sizeof(HashDataBlockHeader));
 
-	// Write the hash file header block to the disk.
-	if (BF_WriteBlock(fileHandle, HEADER_BLOCK_INDEX) < 0)
+	// Collect the records of the slots that are not deleted, and that have the key if there is one.
+	uint32_t recordCount = 0;
+	while (*slotIndex < dataBlockHeader->SlotCount && recordCount < maxRecordCount)
 	{
-		printf("Could not write hash header block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
-		BF_PrintError("");
-
-		return -1;
+		uint32_t currentSlotIndex = (*slotIndex)++;
+		if (!IS_SLOT_DELETED(dataBlockPtr, blockSize, currentSlotIndex) && (key == nullptr || slots[currentSlotIndex].ID == *key))
+			records[recordCount++] = &slots[currentSlotIndex];
 	}
 
-	// Now we need to create all the blocks required to store the hash table.
-
-	// Calculate the required blocks for the bucket count using an integer division.
-	int32_t requiredBlockCount = (bucketCount / MAX_BUCKET_COUNT_PER_BLOCK);
-
-	// If there is a remainder we add one more block to account for those buckets.
-	requiredBlockCount += ((bucketCount % MAX_BUCKET_COUNT_PER_BLOCK) > 0) ? 1 : 0;
-
-	// Set the previous bucket block index to the header block.
-	int32_t previousBucketBlockIndex = HEADER_BLOCK_INDEX;
+	return recordCount;
+}
 
-	// Loop through all the required hash file bucket blocks.
-	for (int32_t index = 0; index < requiredBlockCount; index++)
+// Writes recordCount records into the chain of the blockCount data blocks given, filling them in order. Blocks left without
+// records stay linked at the end of the chain as empty blocks. The last block reserves reservedBlockCount blocks. Returns 0 on
+// success and -1 on failure.
+static int32_t WriteRecordChain(HT_info handle, int32_t blockSize, const int32_t* blockIndices, uint32_t blockCount, const Record* records,
+	uint32_t recordCount, uint32_t reservedBlockCount)
+{
+	// Loop through all the data blocks of the chain.
+	for (uint32_t blockNumber = 0; blockNumber < blockCount; blockNumber++)
 	{
-		// Allocate a new bucket block.
-		if (BF_AllocateBlock(fileHandle) < 0)
+		// Retrieve a pointer to the current data block.
+		uint8_t* currentDataBlockPtr = nullptr;
+		if (BF_ReadBlock(handle, blockIndices[blockNumber], (void**)&currentDataBlockPtr) < 0)
 		{
-			printf("Could not allocate bucket block for the hash file! FileHandle: %d\n", fileHandle);
+			printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, blockIndices[blockNumber]);
 			BF_PrintError("");
 
 			return -1;
 		}
 
-		// Retrieve the block count of the hash file.
-		int32_t blockCount = BF_GetBlockCounter(fileHandle);
-		if (blockCount < 0)
-		{
-			printf("Could not retrieve block count for the hash file! FileHandle: %d\n", fileHandle);
-			BF_PrintError("");
+		// The current data block gets the next records, up to it's capacity.
+		uint32_t elementCount = (recordCount > MAX_RECORD_COUNT_PER_BLOCK(blockSize)) ? MAX_RECORD_COUNT_PER_BLOCK(blockSize) : recordCount;
 
-			return -1;
-		}
+		// Create the data block header and link it to the next block of the chain.
+		HashDataBlockHeader dataBlockHeader = { };
+		dataBlockHeader.ElementCount = elementCount;
+		dataBlockHeader.SlotCount = elementCount;
+		dataBlockHeader.NextBlockIndex = (blockNumber + 1 < blockCount) ? blockIndices[blockNumber + 1] : INVALID_BLOCK_INDEX;
+		dataBlockHeader.ReservedBlockCount = (blockNumber + 1 < blockCount) ? 0 : reservedBlockCount;
 
-		// Calculate the index of the new bucket block.
-		int32_t newBucketBlockIndex = blockCount - 1;
+		// Clear the block, then copy the header and the records into it.
+		memset(currentDataBlockPtr, 0, blockSize);
+		memcpy(currentDataBlockPtr, &dataBlockHeader, sizeof(HashDataBlockHeader));
+		memcpy(currentDataBlockPtr + sizeof(HashDataBlockHeader), records, elementCount * sizeof(Record));
 
-		// Retrieve a pointer to the new bucket block.
-		uint8_t* newBucketBlockPtr = nullptr;
-		if (BF_ReadBlock(fileHandle, newBucketBlockIndex, (void**)&newBucketBlockPtr) < 0)
+		// Write the current data block to the disk.
+		if (BF_WriteBlock(handle, blockIndices[blockNumber]) < 0)
 		{
-			printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", fileHandle, newBucketBlockIndex);
+			printf("Could not write hash data block to disk! FileHandle: %d, BlockIndex: %d\n", handle, blockIndices[blockNumber]);
 			BF_PrintError("");
 
 			return -1;
 		}
 
-		// Create the bucket block header and set it's data.
-		HashBucketBlockHeader newBucketBlockHeader = { };
-		newBucketBlockHeader.NextBlockIndex = INVALID_BLOCK_INDEX;
-
-		// Copy the new bucket block header to he beginning of the new bucket block.
-		memcpy(newBucketBlockPtr, &newBucketBlockHeader, sizeof(HashBucketBlockHeader));
-
-		// Offset the new bucket block pointer to point to the first byte of the bucket indices.
-		newBucketBlockPtr += sizeof(HashBucketBlockHeader);
+		// Move on to the records of the next block.
+		records += elementCount;
+		recordCount -= elementCount;
+	}
 
-		// Initially set the number of buckets in the current bucket block to max.
-		int32_t bucketCountInCurrentBucketBlock = MAX_BUCKET_COUNT_PER_BLOCK;
+	return 0;
+}
 
-		// If this is the last bucket block we create, the number of buckets is the remainder of the following division.
-		if (index == requiredBlockCount - 1)
-			bucketCountInCurrentBucketBlock = bucketCount % MAX_BUCKET_COUNT_PER_BLOCK;
+// Splits the bucket at the split index of the open linear hash file. The records of the bucket are divided between it and a new
+// bucket at the end of the directory, reusing the data blocks of the bucket. Returns 0 on success and -1 on failure.
+static int32_t SplitBucket(HT_info handle, HashBucketDirectory* directory, int32_t blockSize)
+{
+	// The number of buckets at the start of the current level and the bucket to split.
+	uint32_t levelBucketCount = directory->InitialBucketCount << directory->Level;
+	uint32_t splitBucketIndex = directory->SplitIndex;
+	uint32_t newBucketIndex = splitBucketIndex + levelBucketCount;
 
-		// Fill the bucketCountInCurrentBucketBlock number of bucket indices to the invalid block index.
-		memset(newBucketBlockPtr, INVALID_BLOCK_INDEX, bucketCountInCurrentBucketBlock * sizeof(int32_t));
+	// Append the new bucket to the directory.
+	if (AddBucket(handle, directory) == -1)
+		return -1;
 
-		// Write the new bucket block to the disk.
-		if (BF_WriteBlock(fileHandle, newBucketBlockIndex) < 0)
+	// Count the data blocks of the bucket that splits.
+	uint32_t blockCount = 0;
+	int32_t currentDataBlockIndex = directory->Buckets[splitBucketIndex];
+	while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
+	{
+		// Retrieve a pointer to the current data block.
+		uint8_t* currentDataBlockPtr = nullptr;
+		if (BF_ReadBlock(handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
 		{
-			printf("Could not write hash bucket block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, newBucketBlockIndex);
+			printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
 			BF_PrintError("");
 
 			return -1;
 		}
 
-		// Now we need to update the previous bucket block's NextBlockIndex.
+		blockCount++;
+		currentDataBlockIndex = ((HashDataBlockHeader*)currentDataBlockPtr)->NextBlockIndex;
+	}
+
+	// Allocate room for the block indices, with one extra in case the records need a new block, and for the records of both buckets.
+	uint32_t maxRecordCount = blockCount * MAX_RECORD_COUNT_PER_BLOCK(blockSize);
+	int32_t* blockIndices = (int32_t*)malloc((blockCount + 1) * sizeof(int32_t));
+	Record* records = (Record*)malloc((maxRecordCount + 1) * sizeof(Record));
+	if (blockIndices == nullptr || records == nullptr)
+	{
+		printf("Could not allocate memory for the bucket split! FileHandle: %d, BucketIndex: %d\n", handle, splitBucketIndex);
+		free(blockIndices);
+		free(records);
+
+		return -1;
+	}
 
-		// Retrieve a pointer to the previous bucket block.
-		uint8_t* previousBucketBlockPtr = nullptr;
-		if (BF_ReadBlock(fileHandle, previousBucketBlockIndex, (void**)&previousBucketBlockPtr) < 0)
+	// The blocks reserved by the last block of the chain. They stay reserved by the last block of the array.
+	uint32_t reservedBlockCount = 0;
+
+	// Collect the records of the bucket. The ones that stay are gathered from the start of the array and the ones that move from the end.
+	uint32_t stayingRecordCount = 0;
+	uint32_t movingRecordCount = 0;
+	uint32_t blockNumber = 0;
+	currentDataBlockIndex = directory->Buckets[splitBucketIndex];
+	while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
+	{
+		// Retrieve a pointer to the current data block.
+		uint8_t* currentDataBlockPtr = nullptr;
+		if (BF_ReadBlock(handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
 		{
-			printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", fileHandle, previousBucketBlockIndex);
+			printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
 			BF_PrintError("");
+			free(blockIndices);
+			free(records);
 
 			return -1;
 		}
 
-		// If the previous bucket block is the header block, we need to treat it differently since it has a different header structure.
-		if (previousBucketBlockIndex == HEADER_BLOCK_INDEX)
-		{
-			HashFileHeader* previousBlockHeader = (HashFileHeader*)previousBucketBlockPtr;
-			previousBlockHeader->NextBlockIndex = newBucketBlockIndex;
-		}
-		else
+		// Remember the block so that it can be reused.
+		blockIndices[blockNumber++] = currentDataBlockIndex;
+
+		// Since this block exists we know there is a DataBlockHeader is the first byte so treat is as such.
+		HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
+		Record* currentRecords = (Record*)(currentDataBlockPtr + sizeof(HashDataBlockHeader));
+
+		// Address every record using the next level, which puts it either in the bucket that splits or the new one.
+		for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->SlotCount; recordIndex++)
 		{
-			HashBucketBlockHeader* previousBlockHeader = (HashBucketBlockHeader*)previousBucketBlockPtr;
-			previousBlockHeader->NextBlockIndex = newBucketBlockIndex;
+			// Skip the deleted records.
+			if (IS_SLOT_DELETED(currentDataBlockPtr, blockSize, recordIndex))
+				continue;
+
+			if (HashFunction(currentRecords[recordIndex].ID) % (levelBucketCount * 2) == splitBucketIndex)
+				records[stayingRecordCount++] = currentRecords[recordIndex];
+			else
+				records[maxRecordCount - ++movingRecordCount] = currentRecords[recordIndex];
 		}
 
-		// Write the updated previous bucket block to the disk.
-		if (BF_WriteBlock(fileHandle, previousBucketBlockIndex) < 0)
+		// Update the current data block to point to the next one.
+		reservedBlockCount = currentDataBlockHeader->ReservedBlockCount;
+		currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
+	}
+
+	// Calculate the blocks each bucket needs.
+	uint32_t recordsPerBlock = MAX_RECORD_COUNT_PER_BLOCK(blockSize);
+	uint32_t stayingBlockCount = (stayingRecordCount + recordsPerBlock - 1) / recordsPerBlock;
+	uint32_t movingBlockCount = (movingRecordCount + recordsPerBlock - 1) / recordsPerBlock;
+
+	// Splitting a partially filled block in two can need one more block than the bucket had. The chain's next reserved block is
+	// used if there is one.
+	if (stayingBlockCount + movingBlockCount > blockCount && reservedBlockCount > 0)
+	{
+		blockIndices[blockCount] = blockIndices[blockCount - 1] + 1;
+		blockCount++;
+		reservedBlockCount--;
+	}
+	else if (stayingBlockCount + movingBlockCount > blockCount)
+	{
+		// Allocate a new data block, reusing a free one if there is any.
+		uint32_t newReservedBlockCount = 0;
+		int32_t newDataBlockIndex = AllocateChainBlock(handle, directory, INVALID_BLOCK_INDEX, &newReservedBlockCount);
+		if (newDataBlockIndex == -1)
 		{
-			printf("Could not write hash bucket block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, previousBucketBlockIndex);
-			BF_PrintError("");
+			free(blockIndices);
+			free(records);
 
 			return -1;
 		}
 
-		// Update the previous bucket block index to the new bucket block index.
-		previousBucketBlockIndex = newBucketBlockIndex;
+		blockIndices[blockCount++] = newDataBlockIndex;
 	}
 
-	// Close the block level file.
-	if (BF_CloseFile(fileHandle) < 0)
-	{
-		printf("Could not close block level file! FileHandle: %d\n", fileHandle);
-		BF_PrintError("");
-
+	// The moving records get the last blocks and the staying records the first ones. The blocks left empty between them are freed.
+	// The chain that ends with the last block keeps the reserved blocks, unless that block is left empty and they are freed with it.
+	uint32_t keptBlockCount = blockCount - movingBlockCount;
+	bool isLastBlockEmpty = (movingBlockCount == 0 && stayingBlockCount < blockCount);
+	int32_t result = 0;
+	if (WriteRecordChain(handle, blockSize, blockIndices, stayingBlockCount, records, stayingRecordCount,
+			(movingBlockCount == 0 && !isLastBlockEmpty) ? reservedBlockCount : 0) == -1 ||
+		WriteRecordChain(handle, blockSize, blockIndices + keptBlockCount, movingBlockCount, records + maxRecordCount - movingRecordCount, movingRecordCount,
+			reservedBlockCount) == -1 ||
+		SetBucketFirstBlock(handle, directory, splitBucketIndex, (stayingBlockCount > 0) ? blockIndices[0] : INVALID_BLOCK_INDEX) == -1 ||
+		SetBucketFirstBlock(handle, directory, newBucketIndex, (movingBlockCount > 0) ? blockIndices[keptBlockCount] : INVALID_BLOCK_INDEX) == -1)
+		result = -1;
+
+	for (uint32_t blockNumber = stayingBlockCount; blockNumber < keptBlockCount && result == 0; blockNumber++)
+		result = FreeDataBlocks(handle, directory, blockIndices[blockNumber], (blockNumber + 1 == blockCount) ? 1 + reservedBlockCount : 1);
+
+	free(blockIndices);
+	free(records);
+
+	if (result == -1)
 		return -1;
+
+	// Advance the split index, and move on to the next level once every bucket of the current level has been split.
+	directory->SplitIndex++;
+	if (directory->SplitIndex == levelBucketCount)
+	{
+		directory->Level++;
+		directory->SplitIndex = 0;
 	}
 
 	return 0;
 }
 
-HT_info* HT_OpenIndex(char* fileName)
+// Splits the data block of a bucket of the open extendible hash file, doubling the directory first if the block is already at the
+// global depth. The records are divided between the block and a new one by the next hash bit, and the buckets that now address the
+// new block are updated. Returns 0 on success and -1 on failure.
+static int32_t SplitDataBlock(HT_info handle, HashBucketDirectory* directory, int32_t blockSize, uint32_t bucketIndex)
 {
-	// Ensure that there are no files currently open.
-	if (s_HandleStorage != -1)
+	int32_t dataBlockIndex = directory->Buckets[bucketIndex];
+
+	// Retrieve a pointer to the data block.
+	uint8_t* dataBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, dataBlockIndex, (void**)&dataBlockPtr) < 0)
 	{
-		printf("Cannot open hash file since there's another file open!\n");
-		return nullptr;
+		printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, dataBlockIndex);
+		BF_PrintError("");
+
+		return -1;
 	}
 
-	// Open the block level file.
-	HT_info fileHandle = BF_OpenFile(fileName);
-	if (fileHandle < 0)
+	// Keep the local depth, since the block may be evicted while the directory grows.
+	uint32_t localDepth = ((HashDataBlockHeader*)dataBlockPtr)->LocalDepth;
+
+	// If the block is addressed by a single bucket, the directory needs to double so that the block can be split.
+	if (localDepth == directory->Level)
 	{
-		printf("Could not open block level file for the hash file! FileName: %s\n", fileName);
-		BF_PrintError("");
+		if (DoubleBucketDirectory(handle, directory) == -1)
+			return -1;
 
-		return nullptr;
+		if (StoreBucketDirectoryHeader(handle, directory) == -1)
+			return -1;
 	}
 
-	// Retrieve a pointer to the hash file header block.
-	uint8_t* headerBlockPtr = nullptr;
-	if (BF_ReadBlock(fileHandle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	// Allocate the new data block, reusing a free one if there is any.
+	uint32_t reservedBlockCount = 0;
+	int32_t newDataBlockIndex = AllocateChainBlock(handle, directory, INVALID_BLOCK_INDEX, &reservedBlockCount);
+	if (newDataBlockIndex == -1)
+		return -1;
+
+	// Retrieve the pointer to the data block again, since it may have been evicted.
+	if (BF_ReadBlock(handle, dataBlockIndex, (void**)&dataBlockPtr) < 0)
 	{
-		printf("Could not retrieve pointer to hash header block! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
+		printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, dataBlockIndex);
 		BF_PrintError("");
 
-		return nullptr;
+		return -1;
 	}
 
-	// Since this file exists, we know there's a CommonFileHeader in the first bytes of the header block. So we treat the pointer as such.
-	CommonFileHeader* commonFileHeader = (CommonFileHeader*)headerBlockPtr;
+	// Divide the records by the hash bit after the local depth. The ones with the bit set move to the new data block, while the rest
+	// keep their slots.
+	HashDataBlockHeader* dataBlockHeader = (HashDataBlockHeader*)dataBlockPtr;
+	Record* records = (Record*)(dataBlockPtr + sizeof(HashDataBlockHeader));
+	Record* movingRecords = (Record*)malloc(dataBlockHeader->ElementCount * sizeof(Record) + 1);
+	if (movingRecords == nullptr)
+	{
+		printf("Could not allocate memory for the data block split! FileHandle: %d, BlockIndex: %d\n", handle, dataBlockIndex);
+		return -1;
+	}
 
-	// Ensure that the file we open is a indeed hash file.
-	if (commonFileHeader->Type != HashFile)
+	uint32_t movingRecordCount = 0;
+	for (uint32_t recordIndex = 0; recordIndex < dataBlockHeader->SlotCount; recordIndex++)
 	{
-		printf("File specified is not a hash file! FileName: %s\n", fileName);
-		return nullptr;
+		if (!IS_SLOT_DELETED(dataBlockPtr, blockSize, recordIndex) && ((HashFunction(records[recordIndex].ID) >> localDepth) & 1))
+		{
+			movingRecords[movingRecordCount++] = records[recordIndex];
+			DeleteRecordSlot(dataBlockPtr, blockSize, recordIndex);
+		}
 	}
 
-	// Store the handle in a global variable so that we can return a pointer to it.
-	s_HandleStorage = fileHandle;
+	// Update the local depth of the data block.
+	dataBlockHeader->LocalDepth = localDepth + 1;
 
-	return &s_HandleStorage;
-}
+	// Write the data block to the disk.
+	if (BF_WriteBlock(handle, dataBlockIndex) < 0)
+	{
+		printf("Could not write hash data block to disk! FileHandle: %d, BlockIndex: %d\n", handle, dataBlockIndex);
+		BF_PrintError("");
+		free(movingRecords);
 
-int32_t HT_CloseIndex(HT_info* handle)
-{
-	// Ensure that the file we want to close is actually open.
-	if (s_HandleStorage != *handle)
+		return -1;
+	}
+
+	// Retrieve a pointer to the new data block.
+	uint8_t* newDataBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, newDataBlockIndex, (void**)&newDataBlockPtr) < 0)
 	{
-		printf("Cannot close hash file since it's not open!\n");
+		printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, newDataBlockIndex);
+		BF_PrintError("");
+		free(movingRecords);
+
 		return -1;
 	}
 
-	// Close the block level file.
-	if (BF_CloseFile(*handle) < 0)
+	// Create the new data block header and copy it, along with the moving records, into the new data block.
+	HashDataBlockHeader newDataBlockHeader = { };
+	newDataBlockHeader.ElementCount = movingRecordCount;
+	newDataBlockHeader.SlotCount = movingRecordCount;
+	newDataBlockHeader.NextBlockIndex = INVALID_BLOCK_INDEX;
+	newDataBlockHeader.LocalDepth = localDepth + 1;
+	memcpy(newDataBlockPtr, &newDataBlockHeader, sizeof(HashDataBlockHeader));
+	memcpy(newDataBlockPtr + sizeof(HashDataBlockHeader), movingRecords, movingRecordCount * sizeof(Record));
+	free(movingRecords);
+
+	// Write the new data block to the disk.
+	if (BF_WriteBlock(handle, newDataBlockIndex) < 0)
 	{
-		printf("Could not close block level file! FileHandle: %d\n", *handle);
+		printf("Could not write hash data block to disk! FileHandle: %d, BlockIndex: %d\n", handle, newDataBlockIndex);
 		BF_PrintError("");
 
 		return -1;
 	}
 
-	// Reset the internal storage.
-	s_HandleStorage = -1;
+	// Point the buckets that share the lowest localDepth bits with the bucket and have the next bit set, to the new data block.
+	uint32_t firstMovingBucketIndex = (bucketIndex & ((1u << localDepth) - 1)) | (1u << localDepth);
+	for (uint32_t movingBucketIndex = firstMovingBucketIndex; movingBucketIndex < directory->BucketCount; movingBucketIndex += 1u << (localDepth + 1))
+	{
+		if (SetBucketFirstBlock(handle, directory, movingBucketIndex, newDataBlockIndex) == -1)
+			return -1;
+	}
 
 	return 0;
 }
 
-int32_t HT_InsertEntry(HT_info handle, Record record)
+// Creates a hash file of the given type, static, linear or extendible. Returns 0 on success and -1 on failure.
+static int32_t CreateIndex(char* fileName, FileType type, int32_t bucketCount, int32_t blockSize, float maxLoadFactor)
 {
-	// Retrieve a pointer to the hash file header block.
-	uint8_t* headerBlockPtr = nullptr;
-	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	// Create the block level file.
+	if (BF_CreateFileWithBlockSize(fileName, blockSize) < 0)
 	{
-		printf("Could not retrieve pointer to hash header block! FileHandle: %d, BlockIndex: %d\n", handle, HEADER_BLOCK_INDEX);
+		printf("Could not create block level file for the hash file! FileName: %s\n", fileName);
 		BF_PrintError("");
 
 		return -1;
 	}
 
-	// Since this file exists, we know there's a FileHeader in the first bytes of the header block. So we treat the pointer as such.
-	HashFileHeader* fileHeader = (HashFileHeader*)headerBlockPtr;
-
-	// Hash the record ID and find the bucket index.
-	int32_t bucketIndex = HashFunction(record.ID, fileHeader->BucketCount);
-
-	// First we need to find the bucket block where the bucket index is in.
+	// Open the block level file.
+	HT_info fileHandle = BF_OpenFile(fileName);
+	if (fileHandle < 0)
+	{
+		printf("Could not open block level file for the hash file! FileName: %s\n", fileName);
+		BF_PrintError("");
 
-	// Calculate in which block the above bucket index is in. This is similar to calculating the total bucket block size.
-	int32_t bucketBlockNumber = ((bucketIndex + 1) / MAX_BUCKET_COUNT_PER_BLOCK);
-	bucketBlockNumber += (((bucketIndex + 1) % MAX_BUCKET_COUNT_PER_BLOCK) > 0) ? 1 : 0;
+		return -1;
+	}
 
-	// Start from the first actuall bucket block.
-	int32_t currentBucketBlockIndex = fileHeader->NextBlockIndex;
+	// Allocate the hash file header block.
+	if (BF_AllocateBlock(fileHandle) < 0)
+	{
+		printf("Could not allocate header block for the hash file! FileHandle: %d\n", fileHandle);
+		BF_PrintError("");
 
-	// Start with an invalid index since there's no previous bucket block.
-	int32_t previousBucketBlockIndex = INVALID_BLOCK_INDEX;
+		return -1;
+	}
 
-	// Loop through all the blocks to find the index of the block the bucket index is in.
-	for (int32_t index = 0; index < bucketBlockNumber; index++)
+	// Retrieve a pointer to the hash file header block.
+	uint8_t* headerBlockPtr = nullptr;
+	if (BF_ReadBlock(fileHandle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
 	{
-		// Retrieve a pointer to the new bucket block.
-		uint8_t* currentBucketBlockPtr = nullptr;
-		if (BF_ReadBlock(handle, currentBucketBlockIndex, (void**)&currentBucketBlockPtr) < 0)
-		{
-			printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, currentBucketBlockIndex);
-			BF_PrintError("");
+		printf("Could not retrieve pointer to hash header block! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
 
-			return -1;
-		}
+		return -1;
+	}
 
-		// Since this file exists, we know there's a BucketBlockHeader in the first bytes of the header block. So we treat the pointer as such.
-		HashBucketBlockHeader* currentBucketBlockHeader = (HashBucketBlockHeader*)currentBucketBlockPtr;
+	// Create the hash file header and fill it's data.
+	HashFileHeader header = { };
+	header.CommonHeader.Type = type;
+	header.BucketCount = bucketCount;
+	header.FirstBucketBlockIndex = FIRST_BUCKET_BLOCK_INDEX;
+	header.BucketBlockCount = BUCKET_BLOCK_COUNT(bucketCount, MAX_BUCKET_COUNT_PER_BLOCK(blockSize));
+	header.InitialBucketCount = bucketCount;
+	header.MaxLoadFactor = maxLoadFactor;
+	header.FirstFreeBlockIndex = INVALID_BLOCK_INDEX;
+
+	// An extendible hash file starts from a single bucket that has doubled until it reached the bucket count.
+	if (type == ExtendibleHashFile)
+	{
+		header.InitialBucketCount = 1;
+		while ((1 << header.Level) < bucketCount)
+			header.Level++;
 
-		// Update the previous and current bucket block index to the next one until we exit out of the loop.
-		previousBucketBlockIndex = currentBucketBlockIndex;
-		currentBucketBlockIndex = currentBucketBlockHeader->NextBlockIndex;
+		header.BucketCount = 1 << header.Level;
+		header.BucketBlockCount = BUCKET_BLOCK_COUNT(header.BucketCount, MAX_BUCKET_COUNT_PER_BLOCK(blockSize));
 	}
 
-	// This is the bucket block index where the bucket index is.
-	int32_t bucketBlockIndex = previousBucketBlockIndex;
-
-	// Find the bucket index relative to the bucket block.
-	int32_t bucketIndexInBucketBlock = bucketIndex % MAX_BUCKET_COUNT_PER_BLOCK;
+	// Copy the file header into the hash file header block.
+	memcpy(headerBlockPtr, &header, sizeof(HashFileHeader));
 
-	// Retrieve a pointer to the bucket block.
-	uint8_t* bucketBlockPtr = nullptr;
-	if (BF_ReadBlock(handle, bucketBlockIndex, (void**)&bucketBlockPtr) < 0)
+	// Write the hash file header block to the disk.
+	if (BF_WriteBlock(fileHandle, HEADER_BLOCK_INDEX) < 0)
 	{
-		printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, bucketBlockIndex);
+		printf("Could not write hash header block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
 		BF_PrintError("");
 
 		return -1;
 	}
 
-	// Offset the bucket block pointer by the size of the header so it points at the beginning of it's section of the hash table.
-	bucketBlockPtr += sizeof(HashBucketBlockHeader);
+	// Now we need to create all the contiguous blocks required to store the hash table.
+	if (CreateBucketBlocks(fileHandle, header.BucketCount, FIRST_BUCKET_BLOCK_INDEX) < 0)
+	{
+		printf("Could not create bucket blocks for the hash file! FileHandle: %d\n", fileHandle);
+		return -1;
+	}
 
-	// Offset the bucket block pointer by the index of the bucket index times the size of a bucket index, so in points at the beginning
-	// of the bucket index we want.
-	bucketBlockPtr += bucketIndexInBucketBlock * sizeof(int32_t);
+	// Close the block level file.
+	if (BF_CloseFile(fileHandle) < 0)
+	{
+		printf("Could not close block level file! FileHandle: %d\n", fileHandle);
+		BF_PrintError("");
 
-	// Extract the index of the data block from the bucket.
-	int32_t dataBlockIndex = *(int32_t*)bucketBlockPtr;
+		return -1;
+	}
 
-	// Now we need to look for the record and make sure it's not already in the hash file.
+	return 0;
+}
 
-	// Start from the first data block.
-	int32_t currentDataBlockIndex = dataBlockIndex;
+int32_t HT_CreateIndex(char* fileName, char attributeType, char* attributeName, int32_t attributeLength, int32_t bucketCount)
+{
+	return HT_CreateIndexWithBlockSize(fileName, attributeType, attributeName, attributeLength, bucketCount, BF_DEFAULT_BLOCK_SIZE);
+}
 
-	// Loop until the end of the allocated data blocks.
-	while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
+int32_t HT_CreateIndexWithBlockSize(char* fileName, char attributeType, char* attributeName, int32_t attributeLength, int32_t bucketCount,
+	int32_t blockSize)
+{
+	return CreateIndex(fileName, HashFile, bucketCount, blockSize, 0.0f);
+}
+
+int32_t HT_CreateLinearIndex(char* fileName, char attributeType, char* attributeName, int32_t attributeLength, int32_t bucketCount,
+	float maxLoadFactor)
+{
+	// A linear hash file needs a positive threshold, otherwise it would split on every insert.
+	if (maxLoadFactor <= 0.0f)
+	{
+		printf("Invalid maximum load factor for the linear hash file! MaxLoadFactor: %f\n", maxLoadFactor);
+		return -1;
+	}
+
+	return CreateIndex(fileName, LinearHashFile, bucketCount, BF_DEFAULT_BLOCK_SIZE, maxLoadFactor);
+}
+
+int32_t HT_CreateExtendibleIndex(char* fileName, char attributeType, char* attributeName, int32_t attributeLength, int32_t bucketCount)
+{
+	// The directory size is a power of two, so the global depth is limited.
+	if (bucketCount > (1 << MAX_GLOBAL_DEPTH))
+	{
+		printf("Invalid bucket count for the extendible hash file! BucketCount: %d\n", bucketCount);
+		return -1;
+	}
+
+	return CreateIndex(fileName, ExtendibleHashFile, bucketCount, BF_DEFAULT_BLOCK_SIZE, 0.0f);
+}
+
+HT_info* HT_OpenIndex(char* fileName)
+{
+	// Open the block level file.
+	HT_info fileHandle = OpenLoggedFile(fileName);
+	if (fileHandle < 0)
+	{
+		printf("Could not open block level file for the hash file! FileName: %s\n", fileName);
+		BF_PrintError("");
+
+		return nullptr;
+	}
+
+	// Retrieve a pointer to the hash file header block.
+	uint8_t* headerBlockPtr = nullptr;
+	if (BF_ReadBlock(fileHandle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to hash header block! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
+
+		return nullptr;
+	}
+
+	// Since this file exists, we know there's a CommonFileHeader in the first bytes of the header block. So we treat the pointer as such.
+	CommonFileHeader* commonFileHeader = (CommonFileHeader*)headerBlockPtr;
+
+	// Ensure that the file we open is a indeed hash file.
+	if (commonFileHeader->Type != HashFile && commonFileHeader->Type != LinearHashFile && commonFileHeader->Type != ExtendibleHashFile)
+	{
+		printf("File specified is not a hash file! FileName: %s\n", fileName);
+		return nullptr;
+	}
+
+	// Add the file to the open files table, which stores the handle so that we can return a pointer to it.
+	OpenHashFile* file = AddOpenHashFile(&s_OpenFiles, fileHandle, commonFileHeader->Type, fileName);
+	if (file == nullptr)
+	{
+		printf("Cannot open hash file since there are too many files open! FileName: %s\n", fileName);
+		BF_CloseFile(fileHandle);
+		return nullptr;
+	}
+
+	// Load the bucket directory so that operations don't have to walk the bucket blocks.
+	if (LoadBucketDirectory(fileHandle, &file->Directory) == -1)
+	{
+		printf("Could not load the bucket directory of the hash file! FileName: %s\n", fileName);
+		RemoveOpenHashFile(&s_OpenFiles, file);
+		BF_CloseFile(fileHandle);
+		return nullptr;
+	}
+
+	ReleaseOpenHashFile(file);
+
+	return &file->Handle;
+}
+
+// Closes a hash file, giving the free blocks at the end of it back to the file system first if truncateFreeBlocks is set.
+// Returns 0 on success and -1 on failure.
+static int32_t CloseIndex(HT_info* handle, bool truncateFreeBlocks)
+{
+	// Ensure that the file we want to close is actually open.
+	OpenHashFile* file = AcquireOpenHashFile(&s_OpenFiles, *handle, true);
+	if (file == nullptr)
+	{
+		printf("Cannot close hash file since it's not open!\n");
+		return -1;
+	}
+
+	// A failed truncation keeps the rest of the free blocks in the list, so the file is still closed.
+	int32_t fileHandle = file->Handle;
+	int32_t result = 0;
+	if (truncateFreeBlocks && TruncateFreeBlocks(fileHandle, &file->Directory) == -1)
+	{
+		printf("Could not give back the free blocks of the hash file! FileHandle: %d\n", fileHandle);
+		result = -1;
+	}
+
+	// Close the block level file.
+	if (BF_CloseFile(fileHandle) < 0)
+	{
+		printf("Could not close block level file! FileHandle: %d\n", fileHandle);
+		BF_PrintError("");
+		ReleaseOpenHashFile(file);
+
+		return -1;
+	}
+
+	// Remove the file from the table, which frees the cached bucket directory. It's kept in sync with the disk on every
+	// insert so there's nothing to write.
+	RemoveOpenHashFile(&s_OpenFiles, file);
+
+	return result;
+}
+
+int32_t HT_CloseIndex(HT_info* handle)
+{
+	return CloseIndex(handle, false);
+}
+
+int32_t HT_CloseIndexWithTruncation(HT_info* handle)
+{
+	return CloseIndex(handle, true);
+}
+
+static int32_t InsertEntry(OpenHashFile* file, Record record)
+{
+	// The block level handle of the file.
+	HT_info handle = file->Handle;
+
+	// Retrieve the block size of the hash file.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Hash the record ID and find the bucket index.
+	int32_t bucketIndex = GetBucketIndex(&file->Directory, HashFunction(record.ID));
+
+	// Extract the index of the first data block of the bucket from the cached bucket directory.
+	int32_t dataBlockIndex = file->Directory.Buckets[bucketIndex];
+
+	// Now we need to look for the record and make sure it's not already in the hash file.
+
+	// Start from the first data block.
+	int32_t currentDataBlockIndex = dataBlockIndex;
+
+	// Loop until the end of the allocated data blocks.
+	while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
 	{
 		// Retrieve a pointer to the current data block.
 		uint8_t* currentDataBlockPtr = nullptr;
@@ -379,14 +781,14 @@ int32_t HT_InsertEntry(HT_info handle, Record record)
 		// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
 		currentDataBlockPtr += sizeof(HashDataBlockHeader);
 
-		// Interate through all the record slots that are occupied in the current data block.
-		for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->ElementCount; recordIndex++)
+		// Interate through all the record slots that are used in the current data block.
+		for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->SlotCount; recordIndex++)
 		{
 			// Treat the current pointer as a record.
 			Record* currentRecord = (Record*)currentDataBlockPtr;
 
 			// If the current record's key is the same as the one we want to insert, it's already in the hash so we exit.
-			if (currentRecord->ID == record.ID)
+			if (!IS_SLOT_DELETED(currentDataBlockHeader, blockSize, recordIndex) && currentRecord->ID == record.ID)
 			{
 				printf("The specified record is already in the hash file! RecordID: %d\n", record.ID);
 				return -1;
@@ -402,6 +804,71 @@ int32_t HT_InsertEntry(HT_info handle, Record record)
 
 	// If we're here the record is not in the hash so we try to insert it.
 
+	// A linear hash file counts it's records and splits a bucket before inserting, if the new record would exceed the load factor.
+	// Splitting first means that the returned block index is where the record is, until the next split moves it.
+	if (file->Type == LinearHashFile)
+	{
+		// Increment the record count.
+		file->Directory.RecordCount++;
+
+		// Calculate the load factor the file would have after the insertion.
+		float loadFactor = (float)file->Directory.RecordCount / (float)(file->Directory.BucketCount * MAX_RECORD_COUNT_PER_BLOCK(blockSize));
+
+		// Split the next bucket if needed.
+		if (loadFactor > file->Directory.MaxLoadFactor)
+		{
+			if (SplitBucket(handle, &file->Directory, blockSize) == -1)
+			{
+				printf("Could not split bucket of the linear hash file! FileHandle: %d, BucketIndex: %d\n", handle, file->Directory.SplitIndex);
+				return -1;
+			}
+		}
+
+		// Write the updated record count, and the new state if we split, to the header.
+		if (StoreBucketDirectoryHeader(handle, &file->Directory) == -1)
+			return -1;
+
+		// The split may have moved the bucket of the record, so find it again.
+		bucketIndex = GetBucketIndex(&file->Directory, HashFunction(record.ID));
+		dataBlockIndex = file->Directory.Buckets[bucketIndex];
+	}
+
+	// An extendible hash file splits the data block of the bucket instead of adding an overflow block, while the global depth allows it.
+	if (file->Type == ExtendibleHashFile)
+	{
+		while (dataBlockIndex != INVALID_BLOCK_INDEX)
+		{
+			// Retrieve a pointer to the data block of the bucket.
+			uint8_t* dataBlockPtr = nullptr;
+			if (BF_ReadBlock(handle, dataBlockIndex, (void**)&dataBlockPtr) < 0)
+			{
+				printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, dataBlockIndex);
+				BF_PrintError("");
+
+				return -1;
+			}
+
+			// Since this block exists we know there is a DataBlockHeader is the first byte so treat is as such.
+			HashDataBlockHeader* dataBlockHeader = (HashDataBlockHeader*)dataBlockPtr;
+
+			// Stop once there's space, or the block already overflows, or it can't be split any further.
+			if (dataBlockHeader->ElementCount < MAX_RECORD_COUNT_PER_BLOCK(blockSize) || dataBlockHeader->NextBlockIndex != INVALID_BLOCK_INDEX ||
+				dataBlockHeader->LocalDepth == MAX_GLOBAL_DEPTH)
+				break;
+
+			// Split the data block.
+			if (SplitDataBlock(handle, &file->Directory, blockSize, bucketIndex) == -1)
+			{
+				printf("Could not split data block of the extendible hash file! FileHandle: %d, BlockIndex: %d\n", handle, dataBlockIndex);
+				return -1;
+			}
+
+			// The record may now belong to the new data block, so find the bucket again.
+			bucketIndex = GetBucketIndex(&file->Directory, HashFunction(record.ID));
+			dataBlockIndex = file->Directory.Buckets[bucketIndex];
+		}
+	}
+
 	// Reset the current data block index and prepare for insertion.
 	currentDataBlockIndex = dataBlockIndex;
 
@@ -425,20 +892,10 @@ int32_t HT_InsertEntry(HT_info handle, Record record)
 		HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
 
 		// If there's space in the current data block, we insert here.
-		if (currentDataBlockHeader->ElementCount < MAX_RECORD_COUNT_PER_BLOCK)
+		if (currentDataBlockHeader->ElementCount < MAX_RECORD_COUNT_PER_BLOCK(blockSize))
 		{
-			// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
-			currentDataBlockPtr += sizeof(HashDataBlockHeader);
-
-			// Offset the block pointer by the size of the record times the number of records so it points to the first byte
-			// of the first empty record slot.
-			currentDataBlockPtr += currentDataBlockHeader->ElementCount * sizeof(Record);
-
-			// Copy the record into the data block.
-			memcpy(currentDataBlockPtr, &record, sizeof(Record));
-
-			// Increment the current data block's record count.
-			currentDataBlockHeader->ElementCount++;
+			// Copy the record into a free slot of the data block, which also increments the data block's record count.
+			memcpy(AddRecordSlot(currentDataBlockPtr, blockSize), &record, sizeof(Record));
 
 			// Write the updated contents of the current hash file data block to the disk.
 			if (BF_WriteBlock(handle, currentDataBlockIndex) < 0)
@@ -461,27 +918,11 @@ int32_t HT_InsertEntry(HT_info handle, Record record)
 	// If we are here, a new data block needs to be created. Either because this is the first entry in the bucket or because we ran
 	// out of space in all of the currently allocated data blocks.
 
-	// Allocate a new data block.
-	if (BF_AllocateBlock(handle) < 0)
-	{
-		printf("Could not allocate data block for the hash file! FileHandle: %d\n", handle);
-		BF_PrintError("");
-
-		return -1;
-	}
-
-	// Get the new block count.
-	int32_t blockCount = BF_GetBlockCounter(handle);
-	if (blockCount < 0)
-	{
-		printf("Could not retrieve block count for the hash file! FileHandle: %d\n", handle);
-		BF_PrintError("");
-
+	// Allocate a new data block, next to the last one of the chain if it reserved one.
+	uint32_t reservedBlockCount = 0;
+	int32_t newDataBlockIndex = AllocateChainBlock(handle, &file->Directory, previousDataBlockIndex, &reservedBlockCount);
+	if (newDataBlockIndex == -1)
 		return -1;
-	}
-
-	// Calculate the new data block index.
-	int32_t newDataBlockIndex = blockCount - 1;
 
 	// Retrieve a pointer to the new data block.
 	uint8_t* newDataBlockPtr = nullptr;
@@ -496,7 +937,13 @@ int32_t HT_InsertEntry(HT_info handle, Record record)
 	// Create the data block header and fill it's data.
 	HashDataBlockHeader newDataBlockHeader = { };
 	newDataBlockHeader.ElementCount = 1;
+	newDataBlockHeader.SlotCount = 1;
 	newDataBlockHeader.NextBlockIndex = INVALID_BLOCK_INDEX;
+	newDataBlockHeader.ReservedBlockCount = reservedBlockCount;
+
+	// In an extendible hash file a new bucket block belongs only to the bucket it was created for.
+	if (file->Type == ExtendibleHashFile)
+		newDataBlockHeader.LocalDepth = file->Directory.Level;
 
 	// Copy the new data block header into the new data block.
 	memcpy(newDataBlockPtr, &newDataBlockHeader, sizeof(HashDataBlockHeader));
@@ -530,9 +977,10 @@ int32_t HT_InsertEntry(HT_info handle, Record record)
 			return -1;
 		}
 
-		// Get the header and update the next block index.
+		// Get the header and update the next block index. The new block takes over the reserved blocks.
 		HashDataBlockHeader* previousDataBlockHeader = (HashDataBlockHeader*)previousDataBlockPtr;
 		previousDataBlockHeader->NextBlockIndex = newDataBlockIndex;
+		previousDataBlockHeader->ReservedBlockCount = 0;
 
 		// Write the contents of the previous hash data block to the disk.
 		if (BF_WriteBlock(handle, previousDataBlockIndex) < 0)
@@ -545,430 +993,1438 @@ int32_t HT_InsertEntry(HT_info handle, Record record)
 	}
 	else
 	{
-		// Otherwise we need to update the bucket block.
+		// Otherwise we need to update the bucket, both in the cached directory and on the disk.
+		if (SetBucketFirstBlock(handle, &file->Directory, bucketIndex, newDataBlockIndex) == -1)
+			return -1;
+	}
+
+	// Return the index of the new block.
+	return newDataBlockIndex;
+}
+
+int32_t HT_InsertEntry(HT_info handle, Record record)
+{
+	// Ensure that the file is open, since that's where it's bucket directory is cached.
+	OpenHashFile* file = AcquireOpenHashFile(&s_OpenFiles, handle, true);
+	if (file == nullptr)
+	{
+		printf("Cannot insert to hash file since it's not open! FileHandle: %d\n", handle);
+		return -1;
+	}
+
+	// Perform the operation while holding the lock of the file, so that it sees a consistent bucket directory.
+	int32_t result = InsertEntry(file, record);
+
+	// Commit the changes, even those of a failed operation, so that their blocks can be written back.
+	if (CommitOpenHashFile(file) == -1)
+		result = -1;
+
+	return result;
+}
+
+// Unlinks a data block that a delete left empty from the chain of it's bucket and frees it, along with the blocks it reserves. If
+// it was the last block of the chain and the previous block is right before it, the previous block reserves it instead. The first
+// data block of a bucket of an extendible hash file stays, since other buckets may share it. Returns 0 on success and -1 on failure.
+static int32_t UnlinkEmptyDataBlock(OpenHashFile* file, uint32_t bucketIndex, int32_t previousDataBlockIndex, int32_t dataBlockIndex)
+{
+	// The block level handle of the file.
+	HT_info handle = file->Handle;
+
+	if (file->Type == ExtendibleHashFile && previousDataBlockIndex == INVALID_BLOCK_INDEX)
+		return 0;
+
+	// Retrieve a pointer to the empty data block.
+	uint8_t* dataBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, dataBlockIndex, (void**)&dataBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, dataBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Keep the header, since the block may be evicted while the chain is updated.
+	HashDataBlockHeader dataBlockHeader = *(HashDataBlockHeader*)dataBlockPtr;
+
+	if (previousDataBlockIndex == INVALID_BLOCK_INDEX)
+	{
+		// The next block becomes the first block of the bucket, both in the cached directory and on the disk.
+		if (SetBucketFirstBlock(handle, &file->Directory, bucketIndex, dataBlockHeader.NextBlockIndex) == -1)
+			return -1;
+	}
+	else
+	{
+		// Retrieve a pointer to the previous data block.
+		uint8_t* previousDataBlockPtr = nullptr;
+		if (BF_ReadBlock(handle, previousDataBlockIndex, (void**)&previousDataBlockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, previousDataBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// Link the previous block to the next one. If the empty block ended the chain right after it, it takes over the empty block
+		// and the blocks it reserves.
+		HashDataBlockHeader* previousDataBlockHeader = (HashDataBlockHeader*)previousDataBlockPtr;
+		previousDataBlockHeader->NextBlockIndex = dataBlockHeader.NextBlockIndex;
+
+		bool isReserved = (dataBlockHeader.NextBlockIndex == INVALID_BLOCK_INDEX && previousDataBlockIndex + 1 == dataBlockIndex);
+		if (isReserved)
+			previousDataBlockHeader->ReservedBlockCount = dataBlockHeader.ReservedBlockCount + 1;
+
+		// Write the contents of the previous hash data block to the disk.
+		if (BF_WriteBlock(handle, previousDataBlockIndex) < 0)
+		{
+			printf("Could not write hash data block to disk! FileHandle: %d, BlockIndex: %d\n", handle, previousDataBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		if (isReserved)
+			return 0;
+	}
+
+	// Free the block so that the next new data block reuses it.
+	return FreeDataBlocks(handle, &file->Directory, dataBlockIndex, 1 + dataBlockHeader.ReservedBlockCount);
+}
+
+static int32_t DeleteEntry(OpenHashFile* file, void* keyValue)
+{
+	// The block level handle of the file.
+	HT_info handle = file->Handle;
+
+	// The key is an integer so cast the void pointer.
+	int32_t key = *(int32_t*)keyValue;
+
+	// Retrieve the block size of the hash file.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Hash the record ID and find the bucket index.
+	int32_t bucketIndex = GetBucketIndex(&file->Directory, HashFunction(key));
+
+	// Extract the index of the first data block of the bucket from the cached bucket directory.
+	int32_t dataBlockIndex = file->Directory.Buckets[bucketIndex];
+
+	// Start from the first actual block of data.
+	int32_t currentDataBlockIndex = dataBlockIndex;
+
+	// The previous block is invalid initially.
+	int32_t previousDataBlockIndex = INVALID_BLOCK_INDEX;
+
+	// Loop until the end of the allocated blocks.
+	while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
+	{
+		// Retrieve a pointer to the current hash data block.
+		uint8_t* currentDataBlockPtr = nullptr;
+		if (BF_ReadBlock(handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// Since this file exists, we know there's a DataBlockHeader in the first bytes of the block. So we treat the pointer as such.
+		HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
+
+		// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
+		currentDataBlockPtr += sizeof(HashDataBlockHeader);
+
+		// Interate through all the record slots that are used in the current block.
+		for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->SlotCount; recordIndex++)
+		{
+			// Treat the current pointer as a record.
+			Record* currentRecord = (Record*)currentDataBlockPtr;
+
+			// If the current records ID is the same as the key, we want to delete it and exit.
+			if (!IS_SLOT_DELETED(currentDataBlockHeader, blockSize, recordIndex) && currentRecord->ID == key)
+			{
+				// Mark the slot of the record as deleted. The records after it stay where they are.
+				DeleteRecordSlot((uint8_t*)currentDataBlockHeader, blockSize, recordIndex);
+
+				// Write the updated contents of the current hash data block to the disk.
+				if (BF_WriteBlock(handle, currentDataBlockIndex) < 0)
+				{
+					printf("Could not write hash data block to disk! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
+					BF_PrintError("");
+
+					return -1;
+				}
+
+				// A block left empty is unlinked, so that lookups no longer read it and new data blocks reuse it.
+				if (currentDataBlockHeader->ElementCount == 0 &&
+					UnlinkEmptyDataBlock(file, bucketIndex, previousDataBlockIndex, currentDataBlockIndex) == -1)
+					return -1;
+
+				// A linear hash file also needs to update it's record count.
+				if (file->Type == LinearHashFile)
+				{
+					file->Directory.RecordCount--;
+					if (StoreBucketDirectoryHeader(handle, &file->Directory) == -1)
+						return -1;
+				}
+
+				// Exit the function since we deleted.
+				return 0;
+			}
+
+			// Offset the block poiter by the size of a record so it pointer to the first byte of the next record slot.
+			currentDataBlockPtr += sizeof(Record);
+		}
+
+		// Update the previous and current block indices.
+		previousDataBlockIndex = currentDataBlockIndex;
+		currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
+	}
+
+	// If we're here, the record with key keyValue was not found.
+	printf("Could not find record with key %d!\n", key);
+	return -1;
+}
+
+int32_t HT_DeleteEntry(HT_info handle, void* keyValue)
+{
+	// Ensure that the file is open, since that's where it's bucket directory is cached.
+	OpenHashFile* file = AcquireOpenHashFile(&s_OpenFiles, handle, true);
+	if (file == nullptr)
+	{
+		printf("Cannot delete from hash file since it's not open! FileHandle: %d\n", handle);
+		return -1;
+	}
+
+	// Perform the operation while holding the lock of the file, so that it sees a consistent bucket directory.
+	int32_t result = DeleteEntry(file, keyValue);
+
+	// Commit the changes, even those of a failed operation, so that their blocks can be written back.
+	if (CommitOpenHashFile(file) == -1)
+		result = -1;
+
+	return result;
+}
+
+static int32_t GetAllEntries(OpenHashFile* file, void* keyValue)
+{
+	// The block level handle of the file.
+	HT_info handle = file->Handle;
+
+	// Key value can be nullptr. If it's not get the actual value otherwise use a dummy.
+	int32_t key = -1;
+	if (keyValue != nullptr)
+		key = *(int32_t*)keyValue;
+
+	// Retrieve the block size of the hash file, which locates the tombstones of the data blocks.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// The number of blocks that we traversed. The bucket directory is cached so only data blocks are counted.
+	uint32_t blocksTraversed = 0;
+
+	if (key != -1)
+	{
+		// If key is valid, search for the entry.
+
+		// Hash the record ID and find the bucket index.
+		int32_t bucketIndex = GetBucketIndex(&file->Directory, HashFunction(key));
+
+		// Start from the first data block of the bucket.
+		int32_t currentDataBlockIndex = file->Directory.Buckets[bucketIndex];
+
+		// Loop until the end of the allocated blocks.
+		while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
+		{
+			// Pin the current hash data block for reading, so that other threads can't evict or change it while we search it.
+			uint8_t* currentDataBlockPtr = nullptr;
+			if (BF_PinBlock(handle, currentDataBlockIndex, BF_LATCH_SHARED, (void**)&currentDataBlockPtr) < 0)
+			{
+				printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
+				BF_PrintError("");
+
+				return -1;
+			}
+
+			// Increment the blocks traversed counter.
+			blocksTraversed++;
+
+			// Since this file exists, we know there's a BlockHeader in the first bytes of the block. So we treat the pointer as such.
+			HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
+
+			// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
+			currentDataBlockPtr += sizeof(HashDataBlockHeader);
+
+			// Interate through all the record slots that are used in the current block.
+			for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->SlotCount; recordIndex++)
+			{
+				// Treat the current pointer as a record.
+				Record* currentRecord = (Record*)currentDataBlockPtr;
+
+				// If the current records ID is the same as the key, we want to print it and exit.
+				if (!IS_SLOT_DELETED(currentDataBlockHeader, blockSize, recordIndex) && currentRecord->ID == key)
+				{
+					printf("ID: %d, Name: %s, Surname: %s, Address: %s\n", currentRecord->ID, currentRecord->Name, currentRecord->Surname, currentRecord->Address);
+					BF_UnpinBlock(handle, currentDataBlockIndex);
+					return blocksTraversed;
+				}
+
+				// Offset the block poiter by the size of a record so it pointer to the first byte of the next record slot.
+				currentDataBlockPtr += sizeof(Record);
+			}
+
+			// Update the current block index, now that we are done with the block.
+			int32_t nextDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
+			BF_UnpinBlock(handle, currentDataBlockIndex);
+			currentDataBlockIndex = nextDataBlockIndex;
+		}
+
+		// If we are here, it means that the record with the specified key was not found in the hash file.
+		printf("Could not find record with key %d!\n", key);
+		return -1;
+	}
+	else
+	{
+		// Loop though all the buckets of the cached bucket directory.
+		for (uint32_t bucketIndex = 0; bucketIndex < file->Directory.BucketCount; bucketIndex++)
+		{
+			// Read the next buckets ahead while this one is printed.
+			ReadaheadBuckets(handle, &file->Directory, bucketIndex);
+
+			// Start from the first data block.
+			int32_t currentDataBlockIndex = file->Directory.Buckets[bucketIndex];
+
+			// Loop through all the data blocks in the bucket.
+			while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
+			{
+				// Pin the data block for reading.
+				uint8_t* currentDataBlockPtr = nullptr;
+				if (BF_PinBlock(handle, currentDataBlockIndex, BF_LATCH_SHARED, (void**)&currentDataBlockPtr) < 0)
+				{
+					printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
+					BF_PrintError("");
+
+					return -1;
+				}
+
+				// Since this block exists we know there is a DataBlockHeader is the first byte so treat is as such.
+				HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
+
+				// If the blocks of the bucket belong to an earlier bucket, they have already been printed.
+				if (currentDataBlockIndex == file->Directory.Buckets[bucketIndex] &&
+					IsSharedBucket(&file->Directory, bucketIndex, currentDataBlockHeader->LocalDepth))
+				{
+					BF_UnpinBlock(handle, currentDataBlockIndex);
+					break;
+				}
+
+				// Increment the blocks traversed counter.
+				blocksTraversed++;
+
+				// Start reading the overflow block, if there is one.
+				if (currentDataBlockHeader->NextBlockIndex != INVALID_BLOCK_INDEX)
+					BF_Prefetch(handle, currentDataBlockHeader->NextBlockIndex, 1);
+
+				// Offset the pointer by the size of the header so it points to the beginning of the record data.
+				currentDataBlockPtr += sizeof(HashDataBlockHeader);
+
+				// Loop through all the used record slots in the block.
+				for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->SlotCount; recordIndex++)
+				{
+					// Get the current record and print it, unless it's deleted.
+					Record* currentRecord = (Record*)currentDataBlockPtr;
+					if (!IS_SLOT_DELETED(currentDataBlockHeader, blockSize, recordIndex))
+						printf("ID: %d, Name: %s, Surname: %s, Address: %s\n", currentRecord->ID, currentRecord->Name, currentRecord->Surname, currentRecord->Address);
+
+					// Increment the pointer by the size of a record so it points to the next record in the block.
+					currentDataBlockPtr += sizeof(Record);
+				}
+
+				// Update the current data block to point to the next one, now that we are done with the block.
+				int32_t nextDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
+				BF_UnpinBlock(handle, currentDataBlockIndex);
+				currentDataBlockIndex = nextDataBlockIndex;
+			}
+		}
+
+		return blocksTraversed;
+	}
+}
+
+int32_t HT_GetAllEntries(HT_info handle, void* keyValue)
+{
+	// Ensure that the file is open, since that's where it's bucket directory is cached.
+	OpenHashFile* file = AcquireOpenHashFile(&s_OpenFiles, handle, false);
+	if (file == nullptr)
+	{
+		printf("Cannot get entries from hash file since it's not open! FileHandle: %d\n", handle);
+		return -1;
+	}
+
+	// Perform the operation while holding the lock of the file shared, so that lookups run concurrently with each other.
+	int32_t result = GetAllEntries(file, keyValue);
+	ReleaseOpenHashFile(file);
+
+	return result;
+}
+
+// Pins a data block for a cursor and starts reading it's overflow block, if there is one. Returns 0 on success and -1 on failure.
+static int32_t PinCursorDataBlock(HT_Cursor* cursor, int32_t dataBlockIndex)
+{
+	// Pin the data block for reading, so that the records returned stay in memory until the cursor moves past it.
+	uint8_t* dataBlockPtr = nullptr;
+	if (BF_PinBlock(cursor->File->Handle, dataBlockIndex, BF_LATCH_SHARED, (void**)&dataBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", cursor->File->Handle, dataBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	cursor->DataBlockIndex = dataBlockIndex;
+	cursor->DataBlockPtr = dataBlockPtr;
+	cursor->SlotIndex = 0;
+
+	// Start reading the overflow block, if there is one.
+	int32_t nextDataBlockIndex = ((HashDataBlockHeader*)dataBlockPtr)->NextBlockIndex;
+	if (nextDataBlockIndex != INVALID_BLOCK_INDEX)
+		BF_Prefetch(cursor->File->Handle, nextDataBlockIndex, 1);
+
+	return 0;
+}
+
+// Unpins the data block of a cursor, if it has one. Returns 0 on success and -1 on failure.
+static int32_t UnpinCursorDataBlock(HT_Cursor* cursor)
+{
+	if (cursor->DataBlockIndex == INVALID_BLOCK_INDEX)
+		return 0;
+
+	int32_t dataBlockIndex = cursor->DataBlockIndex;
+	cursor->DataBlockIndex = INVALID_BLOCK_INDEX;
+	cursor->DataBlockPtr = nullptr;
+
+	if (BF_UnpinBlock(cursor->File->Handle, dataBlockIndex) < 0)
+	{
+		printf("Could not unpin hash data block! FileHandle: %d, BlockIndex: %d\n", cursor->File->Handle, dataBlockIndex);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	return 0;
+}
+
+// Moves a cursor to the first data block of the next bucket it scans, skipping empty buckets and, in a scan of all the buckets, the
+// buckets that share the data blocks of an earlier one. The data block index of the cursor is left invalid if there are no buckets
+// left. Returns 0 on success and -1 on failure.
+static int32_t MoveCursorToNextBucket(HT_Cursor* cursor)
+{
+	while (cursor->BucketIndex < cursor->EndBucketIndex)
+	{
+		uint32_t bucketIndex = cursor->BucketIndex++;
+
+		// Read the next buckets ahead while this one is returned.
+		if (!cursor->HasKey)
+			ReadaheadBuckets(cursor->File->Handle, &cursor->File->Directory, bucketIndex);
+
+		int32_t dataBlockIndex = cursor->File->Directory.Buckets[bucketIndex];
+		if (dataBlockIndex == INVALID_BLOCK_INDEX)
+			continue;
+
+		if (PinCursorDataBlock(cursor, dataBlockIndex) == -1)
+			return -1;
+
+		// If the blocks of the bucket belong to an earlier bucket, they have already been returned.
+		HashDataBlockHeader* dataBlockHeader = (HashDataBlockHeader*)cursor->DataBlockPtr;
+		if (!cursor->HasKey && IsSharedBucket(&cursor->File->Directory, bucketIndex, dataBlockHeader->LocalDepth))
+		{
+			if (UnpinCursorDataBlock(cursor) == -1)
+				return -1;
+
+			continue;
+		}
+
+		return 0;
+	}
+
+	return 0;
+}
+
+HT_Cursor* HT_ScanOpen(HT_info handle, void* keyValue)
+{
+	// Ensure that the file is open, since that's where it's bucket directory is cached. The cursor holds the lock of the file shared
+	// until it's closed, so that the blocks it returns records from don't change.
+	OpenHashFile* file = AcquireOpenHashFile(&s_OpenFiles, handle, false);
+	if (file == nullptr)
+	{
+		printf("Cannot scan hash file since it's not open! FileHandle: %d\n", handle);
+		return nullptr;
+	}
+
+	// Retrieve the block size of the hash file.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+		ReleaseOpenHashFile(file);
+
+		return nullptr;
+	}
+
+	// Allocate the cursor.
+	HT_Cursor* cursor = (HT_Cursor*)malloc(sizeof(HT_Cursor));
+	if (cursor == nullptr)
+	{
+		printf("Could not allocate the cursor of the hash file! FileHandle: %d\n", handle);
+		ReleaseOpenHashFile(file);
+
+		return nullptr;
+	}
+
+	cursor->File = file;
+	cursor->BlockSize = blockSize;
+	cursor->HasKey = false;
+	cursor->Key = 0;
+	cursor->BucketIndex = 0;
+	cursor->EndBucketIndex = file->Directory.BucketCount;
+	cursor->DataBlockIndex = INVALID_BLOCK_INDEX;
+	cursor->DataBlockPtr = nullptr;
+	cursor->SlotIndex = 0;
+
+	// If there's a key, only it's bucket is scanned.
+	if (keyValue != nullptr)
+	{
+		cursor->HasKey = true;
+		cursor->Key = *(int32_t*)keyValue;
+		cursor->BucketIndex = GetBucketIndex(&file->Directory, HashFunction(cursor->Key));
+		cursor->EndBucketIndex = cursor->BucketIndex + 1;
+	}
+
+	if (MoveCursorToNextBucket(cursor) == -1)
+	{
+		ReleaseOpenHashFile(file);
+		free(cursor);
+
+		return nullptr;
+	}
+
+	return cursor;
+}
+
+int32_t HT_ScanNextBatch(HT_Cursor* cursor, const Record** records, int32_t maxRecordCount)
+{
+	if (maxRecordCount <= 0)
+	{
+		printf("Invalid number of records to scan! RecordCount: %d\n", maxRecordCount);
+		return -1;
+	}
+
+	// Loop until a data block has records left, or the scan is over.
+	while (cursor->DataBlockIndex != INVALID_BLOCK_INDEX)
+	{
+		// Return the next records of the pinned data block, if any are left.
+		uint32_t recordCount = CollectRecordSlots(cursor->DataBlockPtr, cursor->BlockSize, &cursor->SlotIndex,
+			cursor->HasKey ? &cursor->Key : nullptr, records, (uint32_t)maxRecordCount);
+		if (recordCount > 0)
+			return (int32_t)recordCount;
+
+		// Move to the next data block of the bucket, or to the next bucket, now that we are done with the data block.
+		int32_t nextDataBlockIndex = ((HashDataBlockHeader*)cursor->DataBlockPtr)->NextBlockIndex;
+		if (UnpinCursorDataBlock(cursor) == -1)
+			return -1;
+
+		if (nextDataBlockIndex != INVALID_BLOCK_INDEX)
+		{
+			if (PinCursorDataBlock(cursor, nextDataBlockIndex) == -1)
+				return -1;
+		}
+		else if (MoveCursorToNextBucket(cursor) == -1)
+			return -1;
+	}
+
+	return 0;
+}
+
+int32_t HT_ScanNext(HT_Cursor* cursor, const Record** record)
+{
+	return HT_ScanNextBatch(cursor, record, 1);
+}
+
+int32_t HT_ScanClose(HT_Cursor* cursor)
+{
+	// Unpin the data block of the cursor, and release the lock of the file.
+	int32_t result = UnpinCursorDataBlock(cursor);
+	ReleaseOpenHashFile(cursor->File);
+	free(cursor);
+
+	return result;
+}
+
+static int32_t Resize(OpenHashFile* file, HT_info* handle, int32_t newBucketCount, char** secondaryFileNames, int32_t secondaryFileCount)
+{
+	// The name is needed to rebuild the file.
+	if (file->FileName == nullptr)
+	{
+		printf("Cannot resize hash file since it's name is unknown! FileHandle: %d\n", *handle);
+		return -1;
+	}
+
+	// Linear and extendible hash files grow on their own, only the static ones are resized.
+	if (file->Type != HashFile || newBucketCount <= 0)
+	{
+		printf("Cannot resize hash file! FileHandle: %d, BucketCount: %d\n", *handle, newBucketCount);
+		return -1;
+	}
+
+	// Retrieve the block size of the hash file.
+	int32_t blockSize = BF_GetBlockSize(*handle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", *handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Count the records, so that the new buckets can be divided in batches whose records fit in the batch memory.
+	uint32_t recordCount = 0;
+	for (uint32_t bucketIndex = 0; bucketIndex < file->Directory.BucketCount; bucketIndex++)
+	{
+		int32_t currentDataBlockIndex = file->Directory.Buckets[bucketIndex];
+		while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
+		{
+			// Retrieve a pointer to the data block.
+			uint8_t* currentDataBlockPtr = nullptr;
+			if (BF_ReadBlock(*handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
+			{
+				printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", *handle, currentDataBlockIndex);
+				BF_PrintError("");
+
+				return -1;
+			}
+
+			HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
+			recordCount += currentDataBlockHeader->ElementCount;
+			currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
+		}
+	}
+
+	// Create the new hash file next to the current one.
+	char* newFileName = (char*)malloc(strlen(file->FileName) + sizeof(".resize"));
+	if (newFileName == nullptr)
+	{
+		printf("Could not allocate the name of the resized hash file! FileName: %s\n", file->FileName);
+		return -1;
+	}
+
+	sprintf(newFileName, "%s.resize", file->FileName);
+
+	if (CreateIndex(newFileName, HashFile, newBucketCount, blockSize, 0.0f) == -1)
+	{
+		printf("Could not create the resized hash file! FileName: %s\n", newFileName);
+		free(newFileName);
+
+		return -1;
+	}
+
+	// Open the new hash file and load it's empty bucket directory.
+	HT_info newFileHandle = BF_OpenFile(newFileName);
+	HashBucketDirectory newDirectory = { };
+	if (newFileHandle < 0 || LoadBucketDirectory(newFileHandle, &newDirectory) == -1)
+	{
+		printf("Could not open the resized hash file! FileName: %s\n", newFileName);
+		BF_PrintError("");
+		free(newFileName);
+
+		return -1;
+	}
+
+	// Calculate the number of new buckets per batch, from the average number of records in a bucket.
+	uint32_t batchEntryCapacity = RESIZE_BATCH_BYTE_COUNT / sizeof(ResizeEntry);
+	uint32_t batchBucketCount = newBucketCount;
+	if (recordCount > batchEntryCapacity)
+	{
+		batchBucketCount = (uint32_t)(((uint64_t)newBucketCount * batchEntryCapacity) / recordCount);
+		if (batchBucketCount == 0)
+			batchBucketCount = 1;
+	}
+
+	// The records of a batch, both in the order they were found and sorted by bucket, and their per bucket counts. A batch may
+	// exceed the average, in which case the arrays grow.
+	uint32_t entryCapacity = batchEntryCapacity;
+	ResizeEntry* entries = (ResizeEntry*)malloc(entryCapacity * sizeof(ResizeEntry));
+	ResizeEntry* sortedEntries = (ResizeEntry*)malloc(entryCapacity * sizeof(ResizeEntry));
+	uint32_t* bucketOffsets = (uint32_t*)malloc((batchBucketCount + 1) * sizeof(uint32_t));
+
+	// The new locations of the records, for the secondary hash files.
+	SHT_BlockIDRemap* remaps = nullptr;
+	if (secondaryFileCount > 0)
+		remaps = (SHT_BlockIDRemap*)malloc((recordCount + 1) * sizeof(SHT_BlockIDRemap));
+	uint32_t remapCount = 0;
+
+	int32_t result = 0;
+	if (entries == nullptr || sortedEntries == nullptr || bucketOffsets == nullptr || (secondaryFileCount > 0 && remaps == nullptr))
+	{
+		printf("Could not allocate memory for the hash file resize! FileHandle: %d\n", *handle);
+		result = -1;
+	}
+
+	// Loop through all the batches of new buckets.
+	for (uint32_t batchStart = 0; batchStart < (uint32_t)newBucketCount && result == 0; batchStart += batchBucketCount)
+	{
+		uint32_t batchEnd = batchStart + batchBucketCount;
+		if (batchEnd > (uint32_t)newBucketCount)
+			batchEnd = newBucketCount;
+
+		// Stream all the records of the current file and keep the ones that belong to the batch.
+		uint32_t entryCount = 0;
+		memset(bucketOffsets, 0, (batchBucketCount + 1) * sizeof(uint32_t));
+		for (uint32_t bucketIndex = 0; bucketIndex < file->Directory.BucketCount && result == 0; bucketIndex++)
+		{
+			int32_t currentDataBlockIndex = file->Directory.Buckets[bucketIndex];
+			while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
+			{
+				// Retrieve a pointer to the data block.
+				uint8_t* currentDataBlockPtr = nullptr;
+				if (BF_ReadBlock(*handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
+				{
+					printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", *handle, currentDataBlockIndex);
+					BF_PrintError("");
+					result = -1;
+
+					break;
+				}
+
+				HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
+				Record* currentRecords = (Record*)(currentDataBlockPtr + sizeof(HashDataBlockHeader));
+
+				// Keep the records that hash into the batch.
+				for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->SlotCount; recordIndex++)
+				{
+					if (IS_SLOT_DELETED(currentDataBlockPtr, blockSize, recordIndex))
+						continue;
+
+					uint32_t newBucketIndex = GetBucketIndex(&newDirectory, HashFunction(currentRecords[recordIndex].ID));
+					if (newBucketIndex < batchStart || newBucketIndex >= batchEnd)
+						continue;
+
+					// Grow the arrays if the batch has more records than the average.
+					if (entryCount == entryCapacity)
+					{
+						entryCapacity *= 2;
+						ResizeEntry* newEntries = (ResizeEntry*)realloc(entries, entryCapacity * sizeof(ResizeEntry));
+						ResizeEntry* newSortedEntries = (newEntries != nullptr) ? (ResizeEntry*)realloc(sortedEntries, entryCapacity * sizeof(ResizeEntry)) : nullptr;
+						if (newEntries != nullptr)
+							entries = newEntries;
+						if (newSortedEntries == nullptr)
+						{
+							printf("Could not allocate memory for the hash file resize! FileHandle: %d\n", *handle);
+							result = -1;
+
+							break;
+						}
+
+						sortedEntries = newSortedEntries;
+					}
+
+					entries[entryCount].Record = currentRecords[recordIndex];
+					entries[entryCount].BucketIndex = newBucketIndex;
+					entries[entryCount].OldBlockIndex = currentDataBlockIndex;
+					entryCount++;
+
+					bucketOffsets[newBucketIndex - batchStart + 1]++;
+				}
+
+				if (result == -1)
+					break;
+
+				currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
+			}
+		}
+
+		if (result == -1)
+			break;
+
+		// Sort the records by bucket, turning the counts into the offsets of each bucket.
+		for (uint32_t index = 1; index <= batchEnd - batchStart; index++)
+			bucketOffsets[index] += bucketOffsets[index - 1];
+
+		for (uint32_t entryIndex = 0; entryIndex < entryCount; entryIndex++)
+			sortedEntries[bucketOffsets[entries[entryIndex].BucketIndex - batchStart]++] = entries[entryIndex];
+
+		// The offsets now point to the end of each bucket, so the first bucket starts at 0 and every other at the end of the previous.
+		uint32_t bucketStart = 0;
+		for (uint32_t newBucketIndex = batchStart; newBucketIndex < batchEnd && result == 0; newBucketIndex++)
+		{
+			uint32_t bucketEnd = bucketOffsets[newBucketIndex - batchStart];
+
+			// Write the records of the bucket in full data blocks, allocated one after the other at the end of the new file.
+			for (uint32_t entryIndex = bucketStart; entryIndex < bucketEnd; entryIndex += MAX_RECORD_COUNT_PER_BLOCK(blockSize))
+			{
+				// Allocate a new data block.
+				if (BF_AllocateBlock(newFileHandle) < 0)
+				{
+					printf("Could not allocate data block for the hash file! FileHandle: %d\n", newFileHandle);
+					BF_PrintError("");
+					result = -1;
+
+					break;
+				}
+
+				// Get the new block count, the new data block is the last one.
+				int32_t newDataBlockIndex = BF_GetBlockCounter(newFileHandle) - 1;
+
+				// Retrieve a pointer to the new data block.
+				uint8_t* newDataBlockPtr = nullptr;
+				if (BF_ReadBlock(newFileHandle, newDataBlockIndex, (void**)&newDataBlockPtr) < 0)
+				{
+					printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", newFileHandle, newDataBlockIndex);
+					BF_PrintError("");
+					result = -1;
+
+					break;
+				}
+
+				// The number of records in this block, and whether another block follows it.
+				uint32_t elementCount = bucketEnd - entryIndex;
+				if (elementCount > MAX_RECORD_COUNT_PER_BLOCK(blockSize))
+					elementCount = MAX_RECORD_COUNT_PER_BLOCK(blockSize);
+
+				// Create the data block header. The next block of the bucket is always the next one allocated.
+				HashDataBlockHeader newDataBlockHeader = { };
+				newDataBlockHeader.ElementCount = elementCount;
+				newDataBlockHeader.SlotCount = elementCount;
+				newDataBlockHeader.NextBlockIndex = (entryIndex + elementCount < bucketEnd) ? newDataBlockIndex + 1 : INVALID_BLOCK_INDEX;
+				memcpy(newDataBlockPtr, &newDataBlockHeader, sizeof(HashDataBlockHeader));
+
+				// Copy the records and remember where they went.
+				Record* newRecords = (Record*)(newDataBlockPtr + sizeof(HashDataBlockHeader));
+				for (uint32_t recordIndex = 0; recordIndex < elementCount; recordIndex++)
+				{
+					newRecords[recordIndex] = sortedEntries[entryIndex + recordIndex].Record;
+
+					if (remaps != nullptr)
+					{
+						remaps[remapCount].OldBlockID = sortedEntries[entryIndex + recordIndex].OldBlockIndex;
+						remaps[remapCount].NewBlockID = newDataBlockIndex;
+						memcpy(remaps[remapCount].Surname, newRecords[recordIndex].Surname, sizeof(remaps[remapCount].Surname));
+						remapCount++;
+					}
+				}
 
-		// Retrieve a pointer to the bucket block.
-		uint8_t* bucketBlockPtr = nullptr;
-		if (BF_ReadBlock(handle, bucketBlockIndex, (void**)&bucketBlockPtr) < 0)
-		{
-			printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, bucketBlockIndex);
-			BF_PrintError("");
+				// Write the new data block to the disk.
+				if (BF_WriteBlock(newFileHandle, newDataBlockIndex) < 0)
+				{
+					printf("Could not write hash data block to disk! FileHandle: %d, BlockIndex: %d\n", newFileHandle, newDataBlockIndex);
+					BF_PrintError("");
+					result = -1;
 
-			return -1;
-		}
+					break;
+				}
+
+				// The first block of the bucket goes in the new bucket directory.
+				if (entryIndex == bucketStart)
+					newDirectory.Buckets[newBucketIndex] = newDataBlockIndex;
+			}
 
-		// Offset the bucket block pointer by the size of the header so it points at the beginning of it's section of the hash table.
-		bucketBlockPtr += sizeof(HashBucketBlockHeader);
+			bucketStart = bucketEnd;
+		}
+	}
 
-		// Offset the bucket block pointer by the index of the bucket index times the size of a bucket index, so in points at the beginning
-		// of the bucket index we want.
-		bucketBlockPtr += bucketIndexInBucketBlock * sizeof(int32_t);
+	free(entries);
+	free(sortedEntries);
+	free(bucketOffsets);
 
-		// Extract the index of the data block from the bucket.
-		int32_t* dataBlockIndex = (int32_t*)bucketBlockPtr;
-		*dataBlockIndex = newDataBlockIndex;
+	// Write the whole bucket directory of the new file at once.
+	if (result == 0 && StoreBucketBlocks(newFileHandle, &newDirectory, 0, newDirectory.BucketBlockCount) == -1)
+		result = -1;
 
-		// Write the contents of the bucket block to the disk.
-		if (BF_WriteBlock(handle, bucketBlockIndex) < 0)
-		{
-			printf("Could not write hash bucket block to disk! FileHandle: %d, BlockIndex: %d\n", handle, bucketBlockIndex);
-			BF_PrintError("");
+	FreeBucketDirectory(&newDirectory);
 
-			return -1;
-		}
+	// Close the new file, and drop it if anything failed so the current file stays as it was.
+	if (BF_CloseFile(newFileHandle) < 0)
+	{
+		printf("Could not close block level file! FileHandle: %d\n", newFileHandle);
+		BF_PrintError("");
+		result = -1;
 	}
 
-	// Return the index of the new block.
-	return newDataBlockIndex;
-}
+	if (result == -1)
+	{
+		remove(newFileName);
+		free(newFileName);
+		free(remaps);
 
-int32_t HT_DeleteEntry(HT_info handle, void* keyValue)
-{
-	// The key is an integer so cast the void pointer.
-	int32_t key = *(int32_t*)keyValue;
+		return -1;
+	}
 
-	// Retrieve a pointer to the hash file header block.
-	uint8_t* headerBlockPtr = nullptr;
-	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	// Close the current file, then atomically replace it with the new one and open that instead.
+	if (BF_CloseFile(*handle) < 0)
 	{
-		printf("Could not retrieve pointer to hash header block! FileHandle: %d, BlockIndex: %d\n", handle, HEADER_BLOCK_INDEX);
+		printf("Could not close block level file! FileHandle: %d\n", *handle);
 		BF_PrintError("");
+		remove(newFileName);
+		free(newFileName);
+		free(remaps);
 
-		return nullptr;
+		return -1;
 	}
 
-	// Since this file exists, we know there's a FileHeader in the first bytes of the header block. So we treat the pointer as such.
-	HashFileHeader* fileHeader = (HashFileHeader*)headerBlockPtr;
+	FreeBucketDirectory(&file->Directory);
 
-	// Hash the record ID and find the bucket index.
-	int32_t bucketIndex = HashFunction(key, fileHeader->BucketCount);
+	// If the resized file can't replace the current one, discard it. The records stay where they were, so the secondary hash files
+	// must not be remapped.
+	bool isReplaced = (rename(newFileName, file->FileName) == 0);
+	if (!isReplaced)
+	{
+		printf("Could not replace the hash file with the resized one! FileName: %s\n", file->FileName);
+		remove(newFileName);
+	}
+
+	free(newFileName);
+
+	// Reopen the file, which is the resized one unless the rename failed.
+	HT_info fileHandle = OpenLoggedFile(file->FileName);
+	if (fileHandle < 0 || LoadBucketDirectory(fileHandle, &file->Directory) == -1)
+	{
+		printf("Could not reopen the hash file! FileName: %s\n", file->FileName);
+		BF_PrintError("");
+		free(remaps);
 
-	// First we need to find the bucket block where the bucket index is in.
+		// Invalidate the handle of the entry, so that HT_Resize removes it from the table.
+		SetOpenHashFileHandle(&s_OpenFiles, file, -1);
 
-	// Calculate in which block the above bucket index is in. This is similar to calculating the total bucket block size.
-	int32_t bucketBlockNumber = ((bucketIndex + 1) / MAX_BUCKET_COUNT_PER_BLOCK);
-	bucketBlockNumber += (((bucketIndex + 1) % MAX_BUCKET_COUNT_PER_BLOCK) > 0) ? 1 : 0;
+		return -1;
+	}
 
-	// Start from the first actuall bucket block.
-	int32_t currentBucketBlockIndex = fileHeader->NextBlockIndex;
+	SetOpenHashFileHandle(&s_OpenFiles, file, fileHandle);
+	*handle = fileHandle;
 
-	// Start with an invalid index since there's no previous bucket block.
-	int32_t previousBucketBlockIndex = INVALID_BLOCK_INDEX;
+	if (!isReplaced)
+	{
+		free(remaps);
+		return -1;
+	}
 
-	// Loop through all the blocks to find the index of the block the bucket index is in.
-	for (int32_t index = 0; index < bucketBlockNumber; index++)
+	// Point the secondary hash files to the new locations of the records.
+	for (int32_t index = 0; index < secondaryFileCount; index++)
 	{
-		// Retrieve a pointer to the new bucket block.
-		uint8_t* currentBucketBlockPtr = nullptr;
-		if (BF_ReadBlock(handle, currentBucketBlockIndex, (void**)&currentBucketBlockPtr) < 0)
+		if (SHT_RemapBlockIDs(secondaryFileNames[index], remaps, remapCount) == -1)
 		{
-			printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, currentBucketBlockIndex);
-			BF_PrintError("");
-
-			return -1;
+			printf("Could not remap the block IDs of the secondary hash file! FileName: %s\n", secondaryFileNames[index]);
+			result = -1;
 		}
+	}
+
+	free(remaps);
 
-		// Since this file exists, we know there's a BucketBlockHeader in the first bytes of the header block. So we treat the pointer as such.
-		HashBucketBlockHeader* currentBucketBlockHeader = (HashBucketBlockHeader*)currentBucketBlockPtr;
+	return result;
+}
 
-		// Update the previous and current bucket block index to the next one until we exit out of the loop.
-		previousBucketBlockIndex = currentBucketBlockIndex;
-		currentBucketBlockIndex = currentBucketBlockHeader->NextBlockIndex;
+int32_t HT_Resize(HT_info* handle, int32_t newBucketCount, char** secondaryFileNames, int32_t secondaryFileCount)
+{
+	// Ensure that the file is open, since that's where it's bucket directory is cached.
+	OpenHashFile* file = AcquireOpenHashFile(&s_OpenFiles, *handle, true);
+	if (file == nullptr)
+	{
+		printf("Cannot resize hash file since it's not open! FileHandle: %d\n", *handle);
+		return -1;
 	}
 
-	// This is the bucket block index where the bucket index is.
-	int32_t bucketBlockIndex = previousBucketBlockIndex;
+	// Perform the operation while holding the lock of the file, so that it sees a consistent bucket directory.
+	int32_t result = Resize(file, handle, newBucketCount, secondaryFileNames, secondaryFileCount);
+
+	// If the file could not be reopened, it's no longer open.
+	if (file->Handle == -1)
+		RemoveOpenHashFile(&s_OpenFiles, file);
+	else
+		ReleaseOpenHashFile(file);
+
+	return result;
+}
 
-	// Find the bucket index relative to the bucket block.
-	int32_t bucketIndexInBucketBlock = bucketIndex % MAX_BUCKET_COUNT_PER_BLOCK;
+// Returns the number of blocks a bulk load changes before it commits them.
+static uint32_t GetBulkLoadBlockCount()
+{
+	int32_t blockCount = BF_GetFrameCount() / BULK_LOAD_POOL_SHARE;
+	return (blockCount > 0) ? (uint32_t)blockCount : 1;
+}
 
-	// Retrieve a pointer to the bucket block.
-	uint8_t* bucketBlockPtr = nullptr;
-	if (BF_ReadBlock(handle, bucketBlockIndex, (void**)&bucketBlockPtr) < 0)
+// Commits the changes of a bulk load so far, without waiting for them, so that their blocks can be written back. Returns 0 on success
+// and -1 on failure.
+static int32_t CommitBulkLoadBatch(HT_info handle)
+{
+	if (BF_Commit(handle) < 0)
 	{
-		printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, bucketBlockIndex);
+		printf("Could not commit the changes to the hash file! FileHandle: %d\n", handle);
 		BF_PrintError("");
 
 		return -1;
 	}
 
-	// Offset the bucket block pointer by the size of the header so it points at the beginning of it's section of the hash table.
-	bucketBlockPtr += sizeof(HashBucketBlockHeader);
-
-	// Offset the bucket block pointer by the index of the bucket index times the size of a bucket index, so in points at the beginning
-	// of the bucket index we want.
-	bucketBlockPtr += bucketIndexInBucketBlock * sizeof(int32_t);
+	return 0;
+}
 
-	// Extract the index of the data block from the bucket.
-	int32_t dataBlockIndex = *(int32_t*)bucketBlockPtr;
+// Finds the data block of the record with the given ID in it's bucket chain. Returns the block index on success, INVALID_BLOCK_INDEX
+// if the record is not in the hash file and -2 on failure.
+static int32_t FindEntryBlock(OpenHashFile* file, int32_t blockSize, int32_t id)
+{
+	// The block level handle of the file.
+	HT_info handle = file->Handle;
 
-	// Start from the first actual block of data.
-	int32_t currentDataBlockIndex = dataBlockIndex;
+	// Hash the ID and start from the first data block of the bucket.
+	int32_t currentDataBlockIndex = file->Directory.Buckets[GetBucketIndex(&file->Directory, HashFunction(id))];
 
-	// Loop until the end of the allocated blocks.
+	// Loop until the end of the bucket chain.
 	while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
 	{
-		// Retrieve a pointer to the current hash data block.
+		// Retrieve a pointer to the current data block.
 		uint8_t* currentDataBlockPtr = nullptr;
 		if (BF_ReadBlock(handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
 		{
 			printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
 			BF_PrintError("");
 
-			return -1;
+			return -2;
 		}
 
-		// Since this file exists, we know there's a DataBlockHeader in the first bytes of the block. So we treat the pointer as such.
+		// Since this block exists we know there is a DataBlockHeader is the first byte so treat is as such.
 		HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
+		Record* currentRecords = (Record*)(currentDataBlockPtr + sizeof(HashDataBlockHeader));
 
-		// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
-		currentDataBlockPtr += sizeof(HashDataBlockHeader);
-
-		// Interate through all the record slots that are occupied in the current block.
-		for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->ElementCount; recordIndex++)
+		// Look for the ID in the record slots that are used.
+		for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->SlotCount; recordIndex++)
 		{
-			// Treat the current pointer as a record.
-			Record* currentRecord = (Record*)currentDataBlockPtr;
-
-			// If the current records ID is the same as the key, we want to delete it and exit.
-			if (currentRecord->ID == key)
-			{
-				// What we want to do is move the contents of the records after the current record up the size of one record.
-
-				// Calculate the size of the records after the current record.
-				uint32_t byteCountOfRecordDataAfterCurrentRecord = (currentDataBlockHeader->ElementCount - (recordIndex + 1)) * sizeof(Record);
+			if (!IS_SLOT_DELETED(currentDataBlockHeader, blockSize, recordIndex) && currentRecords[recordIndex].ID == id)
+				return currentDataBlockIndex;
+		}
 
-				// Copy the records after the current record, to the current record's position in the block.
-				memcpy(currentDataBlockPtr, currentDataBlockPtr + sizeof(Record), byteCountOfRecordDataAfterCurrentRecord);
+		// Update the current block index.
+		currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
+	}
 
-				// Decrement the current block record count;
-				currentDataBlockHeader->ElementCount--;
+	return INVALID_BLOCK_INDEX;
+}
 
-				// Offset the block pointer by the size of a block times the number of records left in the block after the current one.
-				// This way the pointer points to the first byte of the empty space in the block.
-				currentDataBlockPtr += byteCountOfRecordDataAfterCurrentRecord;
+static int32_t BulkLoad(OpenHashFile* file, const Record* records, size_t recordCount, int32_t* blockIDs)
+{
+	// The block level handle of the file.
+	HT_info handle = file->Handle;
 
-				// Calculate the number of empty bytes in the block.
-				uint32_t emptyByteCount = BLOCK_SIZE - (sizeof(HashDataBlockHeader) + currentDataBlockHeader->ElementCount * sizeof(Record));
+	// Every record starts out as not inserted.
+	if (blockIDs != nullptr)
+	{
+		for (size_t recordIndex = 0; recordIndex < recordCount; recordIndex++)
+			blockIDs[recordIndex] = INVALID_BLOCK_INDEX;
+	}
 
-				// Set the empty bytes to zero.
-				memset(currentDataBlockPtr, 0, emptyByteCount);
+	// The changed blocks are committed in batches that fit in the buffer pool.
+	uint32_t maxUncommittedBlockCount = GetBulkLoadBlockCount();
+	uint32_t uncommittedBlockCount = 0;
 
-				// Write the updated contents of the current hash data block to the disk.
-				if (BF_WriteBlock(handle, currentDataBlockIndex) < 0)
+	// Linear and extendible hash files split while they grow, so their records are inserted one at a time. Every insert changes at least
+	// one block.
+	if (file->Type != HashFile)
+	{
+		int32_t insertedCount = 0;
+		for (size_t recordIndex = 0; recordIndex < recordCount; recordIndex++)
+		{
+			if (++uncommittedBlockCount >= maxUncommittedBlockCount)
+			{
+				if (CommitBulkLoadBatch(handle) == -1)
 				{
-					printf("Could not write hash data block to disk! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
-					BF_PrintError("");
-
-					return -1;
+					insertedCount = -1;
+					break;
 				}
 
-				// Exit the function since we deleted.
-				return 0;
+				uncommittedBlockCount = 0;
 			}
 
-			// Offset the block poiter by the size of a record so it pointer to the first byte of the next record slot.
-			currentDataBlockPtr += sizeof(Record);
+			int32_t blockIndex = InsertEntry(file, records[recordIndex]);
+			if (blockIndex == -1)
+				continue;
+
+			if (blockIDs != nullptr)
+				blockIDs[recordIndex] = blockIndex;
+
+			insertedCount++;
 		}
 
-		// Update the current block index.
-		currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
-	}
+		if (blockIDs == nullptr)
+			return insertedCount;
 
-	// If we're here, the record with key keyValue was not found.
-	printf("Could not find record with key %d!\n", key);
-	return -1;
-}
+		// Retrieve the block size of the hash file.
+		int32_t blockSize = BF_GetBlockSize(handle);
+		if (blockSize < 0)
+		{
+			printf("Could not retrieve block size for the hash file! FileHandle: %d\n", handle);
+			BF_PrintError("");
 
-int32_t HT_GetAllEntries(HT_info handle, void* keyValue)
-{
-	// Key value can be nullptr. If it's not get the actual value otherwise use a dummy.
-	int32_t key = -1;
-	if (keyValue != nullptr)
-		key = *(int32_t*)keyValue;
+			return -1;
+		}
 
-	// Retrieve a pointer to the hash file header block.
-	uint8_t* headerBlockPtr = nullptr;
-	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+		// The splits of later inserts may have moved the records inserted before them, so find the data block of every inserted record
+		// now that the load is over.
+		for (size_t recordIndex = 0; recordIndex < recordCount; recordIndex++)
+		{
+			if (blockIDs[recordIndex] == INVALID_BLOCK_INDEX)
+				continue;
+
+			int32_t blockIndex = FindEntryBlock(file, blockSize, records[recordIndex].ID);
+			if (blockIndex == -2)
+				return -1;
+
+			blockIDs[recordIndex] = blockIndex;
+		}
+
+		return insertedCount;
+	}
+
+	// Retrieve the block size of the hash file.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
 	{
-		printf("Could not retrieve pointer to hash header block! FileHandle: %d, BlockIndex: %d\n", handle, HEADER_BLOCK_INDEX);
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", handle);
 		BF_PrintError("");
 
 		return -1;
 	}
 
-	// Since this file exists, we know there's a FileHeader in the first bytes of the header block. So we treat the pointer as such.
-	HashFileHeader* fileHeader = (HashFileHeader*)headerBlockPtr;
-
-	// The number of blocks that we traversed. Set to one to account for the hash file header block.
-	uint32_t blocksTraversed = 1;
+	// Partition the records by bucket and sort them by ID inside each bucket.
+	BulkLoadEntry* entries = (BulkLoadEntry*)malloc((recordCount + 1) * sizeof(BulkLoadEntry));
+	if (entries == nullptr)
+	{
+		printf("Could not allocate memory for the bulk load! RecordCount: %zu\n", recordCount);
+		return -1;
+	}
 
-	if (key != -1)
+	for (size_t recordIndex = 0; recordIndex < recordCount; recordIndex++)
 	{
-		// If key is valid, search for the entry.
+		entries[recordIndex].BucketIndex = GetBucketIndex(&file->Directory, HashFunction(records[recordIndex].ID));
+		entries[recordIndex].ID = records[recordIndex].ID;
+		entries[recordIndex].RecordIndex = (uint32_t)recordIndex;
+	}
 
-		// Hash the record ID and find the bucket index.
-		int32_t bucketIndex = HashFunction(key, fileHeader->BucketCount);
+	qsort(entries, recordCount, sizeof(BulkLoadEntry), CompareBulkLoadEntries);
+
+	int32_t insertedCount = 0;
+	int32_t result = 0;
 
-		// First we need to find the bucket block where the bucket index is in.
+	// Loop through the records of every bucket.
+	size_t bucketStart = 0;
+	while (bucketStart < recordCount && result == 0)
+	{
+		uint32_t bucketIndex = entries[bucketStart].BucketIndex;
 
-		// Calculate in which block the above bucket index is in. This is similar to calculating the total bucket block size.
-		int32_t bucketBlockNumber = ((bucketIndex + 1) / MAX_BUCKET_COUNT_PER_BLOCK);
-		bucketBlockNumber += (((bucketIndex + 1) % MAX_BUCKET_COUNT_PER_BLOCK) > 0) ? 1 : 0;
+		// Find the end of the bucket's records and mark the duplicates among them.
+		size_t bucketEnd = bucketStart + 1;
+		while (bucketEnd < recordCount && entries[bucketEnd].BucketIndex == bucketIndex)
+		{
+			if (entries[bucketEnd].ID == entries[bucketEnd - 1].ID)
+			{
+				printf("The specified record is already in the hash file! RecordID: %d\n", entries[bucketEnd].ID);
+				entries[bucketEnd].RecordIndex = UINT32_MAX;
+			}
 
-		// Start from the first actuall bucket block.
-		int32_t currentBucketBlockIndex = fileHeader->NextBlockIndex;
+			bucketEnd++;
+		}
 
-		// Start with an invalid index since there's no previous bucket block.
-		int32_t previousBucketBlockIndex = INVALID_BLOCK_INDEX;
+		BulkLoadEntry* bucketEntries = &entries[bucketStart];
+		uint32_t bucketEntryCount = (uint32_t)(bucketEnd - bucketStart);
 
-		// Loop through all the blocks to find the index of the block the bucket index is in.
-		for (int32_t index = 0; index < bucketBlockNumber; index++)
+		// Walk the existing chain once to mark the records that are already in the file, count it's free slots and find it's last block.
+		uint32_t freeSlotCount = 0;
+		int32_t lastDataBlockIndex = INVALID_BLOCK_INDEX;
+		int32_t currentDataBlockIndex = file->Directory.Buckets[bucketIndex];
+		while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
 		{
-			// Retrieve a pointer to the new bucket block.
-			uint8_t* currentBucketBlockPtr = nullptr;
-			if (BF_ReadBlock(handle, currentBucketBlockIndex, (void**)&currentBucketBlockPtr) < 0)
+			// Retrieve a pointer to the current data block.
+			uint8_t* currentDataBlockPtr = nullptr;
+			if (BF_ReadBlock(handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
 			{
-				printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, currentBucketBlockIndex);
+				printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
 				BF_PrintError("");
+				result = -1;
 
-				return -1;
+				break;
 			}
 
-			// Increment the blocks traversed counter.
-			blocksTraversed++;
+			HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
+			Record* currentRecords = (Record*)(currentDataBlockPtr + sizeof(HashDataBlockHeader));
 
-			// Since this file exists, we know there's a BucketBlockHeader in the first bytes of the header block. So we treat the pointer as such.
-			HashBucketBlockHeader* currentBucketBlockHeader = (HashBucketBlockHeader*)currentBucketBlockPtr;
+			// Mark the loaded records whose ID is already in the block.
+			for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->SlotCount; recordIndex++)
+			{
+				if (IS_SLOT_DELETED(currentDataBlockPtr, blockSize, recordIndex))
+					continue;
 
-			// Update the previous and current bucket block index to the next one until we exit out of the loop.
-			previousBucketBlockIndex = currentBucketBlockIndex;
-			currentBucketBlockIndex = currentBucketBlockHeader->NextBlockIndex;
-		}
+				BulkLoadEntry* entry = FindBulkLoadEntry(bucketEntries, bucketEntryCount, currentRecords[recordIndex].ID);
+				if (entry != nullptr && entry->RecordIndex != UINT32_MAX)
+				{
+					printf("The specified record is already in the hash file! RecordID: %d\n", entry->ID);
+					entry->RecordIndex = UINT32_MAX;
+				}
+			}
 
-		// This is the bucket block index where the bucket index is.
-		int32_t bucketBlockIndex = previousBucketBlockIndex;
+			freeSlotCount += MAX_RECORD_COUNT_PER_BLOCK(blockSize) - currentDataBlockHeader->ElementCount;
+			lastDataBlockIndex = currentDataBlockIndex;
+			currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
+		}
 
-		// Find the bucket index relative to the bucket block.
-		int32_t bucketIndexInBucketBlock = bucketIndex % MAX_BUCKET_COUNT_PER_BLOCK;
+		if (result == -1)
+			break;
 
-		// Retrieve a pointer to the bucket block.
-		uint8_t* bucketBlockPtr = nullptr;
-		if (BF_ReadBlock(handle, bucketBlockIndex, (void**)&bucketBlockPtr) < 0)
+		// Count the records that will actually be inserted.
+		uint32_t pendingCount = 0;
+		for (uint32_t entryIndex = 0; entryIndex < bucketEntryCount; entryIndex++)
 		{
-			printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, bucketBlockIndex);
-			BF_PrintError("");
-
-			return -1;
+			if (bucketEntries[entryIndex].RecordIndex != UINT32_MAX)
+				pendingCount++;
 		}
 
-		// Offset the bucket block pointer by the size of the header so it points at the beginning of it's section of the hash table.
-		bucketBlockPtr += sizeof(HashBucketBlockHeader);
-
-		// Offset the bucket block pointer by the index of the bucket index times the size of a bucket index, so in points at the beginning
-		// of the bucket index we want.
-		bucketBlockPtr += bucketIndexInBucketBlock * sizeof(int32_t);
+		// The index the first appended block will get, since the appended blocks are allocated one after the other.
+		int32_t firstNewDataBlockIndex = BF_GetBlockCounter(handle);
+		bool needsNewDataBlocks = pendingCount > freeSlotCount;
 
-		// Extract the index of the data block from the bucket.
-		int32_t dataBlockIndex = *(int32_t*)bucketBlockPtr;
+		// The blocks the last block reserved, which it gives up when it's linked to the appended blocks.
+		uint32_t givenUpBlockCount = 0;
 
-		// Start from the first actual block of data.
-		int32_t currentDataBlockIndex = dataBlockIndex;
-
-		// Loop until the end of the allocated blocks.
+		// Walk the chain a second time and fill the free slots, writing every block that changes once. The last block is linked to
+		// the blocks appended after it before it's written.
+		uint32_t entryIndex = 0;
+		currentDataBlockIndex = (pendingCount > 0) ? file->Directory.Buckets[bucketIndex] : INVALID_BLOCK_INDEX;
 		while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
 		{
-			// Retrieve a pointer to the current hash data block.
+			// Retrieve a pointer to the current data block.
 			uint8_t* currentDataBlockPtr = nullptr;
 			if (BF_ReadBlock(handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
 			{
 				printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
 				BF_PrintError("");
+				result = -1;
 
-				return -1;
+				break;
 			}
 
-			// Increment the blocks traversed counter.
-			blocksTraversed++;
-
-			// Since this file exists, we know there's a BlockHeader in the first bytes of the block. So we treat the pointer as such.
 			HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
+			bool isModified = false;
 
-			// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
-			currentDataBlockPtr += sizeof(HashDataBlockHeader);
+			// Fill the free slots of the block.
+			while (currentDataBlockHeader->ElementCount < MAX_RECORD_COUNT_PER_BLOCK(blockSize) && entryIndex < bucketEntryCount)
+			{
+				uint32_t recordIndex = bucketEntries[entryIndex++].RecordIndex;
+				if (recordIndex == UINT32_MAX)
+					continue;
+
+				*AddRecordSlot(currentDataBlockPtr, blockSize) = records[recordIndex];
+				if (blockIDs != nullptr)
+					blockIDs[recordIndex] = currentDataBlockIndex;
+
+				insertedCount++;
+				isModified = true;
+			}
 
-			// Interate through all the record slots that are occupied in the current block.
-			for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->ElementCount; recordIndex++)
+			// Link the last block to the appended ones. They are contiguous already, so the blocks it reserved are given up.
+			if (currentDataBlockIndex == lastDataBlockIndex && needsNewDataBlocks)
 			{
-				// Treat the current pointer as a record.
-				Record* currentRecord = (Record*)currentDataBlockPtr;
+				givenUpBlockCount = currentDataBlockHeader->ReservedBlockCount;
+				currentDataBlockHeader->NextBlockIndex = firstNewDataBlockIndex;
+				currentDataBlockHeader->ReservedBlockCount = 0;
+				isModified = true;
+			}
 
-				// If the current records ID is the same as the key, we want to print it and exit.
-				if (currentRecord->ID == key)
-				{
-					printf("ID: %d, Name: %s, Surname: %s, Address: %s\n", currentRecord->ID, currentRecord->Name, currentRecord->Surname, currentRecord->Address);
-					return blocksTraversed;
-				}
+			int32_t nextDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
 
-				// Offset the block poiter by the size of a record so it pointer to the first byte of the next record slot.
-				currentDataBlockPtr += sizeof(Record);
+			// Write the block to the disk if it changed.
+			if (isModified && BF_WriteBlock(handle, currentDataBlockIndex) < 0)
+			{
+				printf("Could not write hash data block to disk! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
+				BF_PrintError("");
+				result = -1;
+
+				break;
 			}
 
-			// Update the current block index.
-			currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
+			if (isModified)
+				uncommittedBlockCount++;
+
+			// Stop at the last block, the rest of the chain are the blocks appended below.
+			currentDataBlockIndex = (currentDataBlockIndex == lastDataBlockIndex) ? INVALID_BLOCK_INDEX : nextDataBlockIndex;
 		}
 
-		// If we are here, it means that the record with the specified key was not found in the hash file.
-		printf("Could not find record with key %d!\n", key);
-		return -1;
-	}
-	else
-	{
-		// Start from the first bucket block.
-		int32_t currentBucketBlockIndex = fileHeader->NextBlockIndex;
-		uint32_t bucketCount = fileHeader->BucketCount;
+		// The given up blocks are freed, so that later inserts reuse them.
+		if (result == 0 && givenUpBlockCount > 0 && FreeDataBlocks(handle, &file->Directory, lastDataBlockIndex + 1, givenUpBlockCount) == -1)
+			result = -1;
 
-		// Loop through all the bucket blocks.
-		while (currentBucketBlockIndex != INVALID_BLOCK_INDEX)
+		// Append the remaining records in full data blocks.
+		bool isFirstNewDataBlock = true;
+		while (result == 0 && needsNewDataBlocks)
 		{
-			// Retrieve a pointer to the current bucket block.
-			uint8_t* currentBucketBlockPtr = nullptr;
-			if (BF_ReadBlock(handle, currentBucketBlockIndex, (void**)&currentBucketBlockPtr) < 0)
+			// Allocate a new data block.
+			if (BF_AllocateBlock(handle) < 0)
 			{
-				printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, currentBucketBlockIndex);
+				printf("Could not allocate data block for the hash file! FileHandle: %d\n", handle);
 				BF_PrintError("");
+				result = -1;
 
-				return -1;
+				break;
 			}
 
-			// Increment the blocks traversed counter.
-			blocksTraversed++;
+			// Get the new block count, the new data block is the last one.
+			int32_t newDataBlockIndex = BF_GetBlockCounter(handle) - 1;
+
+			// Retrieve a pointer to the new data block.
+			uint8_t* newDataBlockPtr = nullptr;
+			if (BF_ReadBlock(handle, newDataBlockIndex, (void**)&newDataBlockPtr) < 0)
+			{
+				printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, newDataBlockIndex);
+				BF_PrintError("");
+				result = -1;
+
+				break;
+			}
+
+			HashDataBlockHeader* newDataBlockHeader = (HashDataBlockHeader*)newDataBlockPtr;
 
-			// Since this block exists, we know there's a BucketBlockHeader in the first bytes of the header block. So we treat the pointer as such.
-			HashBucketBlockHeader* currentBucketBlockHeader = (HashBucketBlockHeader*)currentBucketBlockPtr;
+			// Fill the new block.
+			while (newDataBlockHeader->ElementCount < MAX_RECORD_COUNT_PER_BLOCK(blockSize) && entryIndex < bucketEntryCount)
+			{
+				uint32_t recordIndex = bucketEntries[entryIndex++].RecordIndex;
+				if (recordIndex == UINT32_MAX)
+					continue;
 
-			// Offset the pointer by the size of the header so it points to the first bucket.
-			currentBucketBlockPtr += sizeof(HashBucketBlockHeader);
+				*AddRecordSlot(newDataBlockPtr, blockSize) = records[recordIndex];
+				if (blockIDs != nullptr)
+					blockIDs[recordIndex] = newDataBlockIndex;
 
-			// Update the current bucket block to point to the next one.
-			currentBucketBlockIndex = currentBucketBlockHeader->NextBlockIndex;
+				insertedCount++;
+			}
 
-			// Calculate the number of buckets in the current bucket block. If it's not the last one there's the
-			// max number of buckets. Otherwise it's the remainder.
-			int32_t bucketsInCurrentBlock = MAX_BUCKET_COUNT_PER_BLOCK;
-			if (currentBucketBlockHeader->NextBlockIndex == INVALID_BLOCK_INDEX)
-				bucketsInCurrentBlock = bucketCount % MAX_BUCKET_COUNT_PER_BLOCK;
+			// Skip any duplicates left at the end, so that we know if another block follows.
+			while (entryIndex < bucketEntryCount && bucketEntries[entryIndex].RecordIndex == UINT32_MAX)
+				entryIndex++;
 
-			// Store the values for the buckets because the block will get unloaded.
-			int32_t* bucketValues = (int32_t*)malloc(bucketsInCurrentBlock * sizeof(int32_t));
-			memcpy(bucketValues, currentBucketBlockPtr, bucketsInCurrentBlock * sizeof(int32_t));
+			needsNewDataBlocks = entryIndex < bucketEntryCount;
+			newDataBlockHeader->NextBlockIndex = needsNewDataBlocks ? newDataBlockIndex + 1 : INVALID_BLOCK_INDEX;
 
-			for (uint32_t bucketIndex = 0; bucketIndex < bucketsInCurrentBlock; bucketIndex++)
+			// Write the new data block to the disk.
+			if (BF_WriteBlock(handle, newDataBlockIndex) < 0)
 			{
-				// Start from the first data block.
-				int32_t currentDataBlockIndex = bucketValues[bucketIndex];
+				printf("Could not write hash data block to disk! FileHandle: %d, BlockIndex: %d\n", handle, newDataBlockIndex);
+				BF_PrintError("");
+				result = -1;
 
-				// Loop through all the data blocks in the bucket.
-				while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
-				{
-					// Retrieve a pointer to the data block.
-					uint8_t* currentDataBlockPtr = nullptr;
-					if (BF_ReadBlock(handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
-					{
-						printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
-						BF_PrintError("");
+				break;
+			}
 
-						return -1;
-					}
+			uncommittedBlockCount++;
 
-					// Increment the blocks traversed counter.
-					blocksTraversed++;
+			// If the bucket was empty, the first new block is it's first block.
+			if (isFirstNewDataBlock && lastDataBlockIndex == INVALID_BLOCK_INDEX &&
+				SetBucketFirstBlock(handle, &file->Directory, bucketIndex, newDataBlockIndex) == -1)
+				result = -1;
 
-					// Since this block exists we know there is a DataBlockHeader is the first byte so treat is as such.
-					HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
+			isFirstNewDataBlock = false;
+		}
 
-					// Offset the pointer by the size of the header so it points to the beginning of the record data.
-					currentDataBlockPtr += sizeof(HashDataBlockHeader);
+		// Commit the buckets loaded so far once their blocks fill the share of the buffer pool. Buckets are committed whole, so that a
+		// crash never leaves a chain half linked.
+		if (result == 0 && uncommittedBlockCount >= maxUncommittedBlockCount)
+		{
+			result = CommitBulkLoadBatch(handle);
+			uncommittedBlockCount = 0;
+		}
 
-					// Loop through all the records in the block.
-					for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->ElementCount; recordIndex++)
-					{
-						// Get the current record and print it.
-						Record* currentRecord = (Record*)currentDataBlockPtr;
-						printf("ID: %d, Name: %s, Surname: %s, Address: %s\n", currentRecord->ID, currentRecord->Name, currentRecord->Surname, currentRecord->Address);
+		bucketStart = bucketEnd;
+	}
 
-						// Increment the pointer by the size of a record so it points to the next record in the block.
-						currentDataBlockPtr += sizeof(Record);
-					}
+	free(entries);
 
-					// Update the current data block to point to the next one.
-					currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
-				}
-			}
+	return (result == 0) ? insertedCount : -1;
+}
+
+int32_t HT_BulkLoad(HT_info handle, const Record* records, size_t recordCount, int32_t* blockIDs)
+{
+	// Ensure that the file is open, since that's where it's bucket directory is cached.
+	OpenHashFile* file = AcquireOpenHashFile(&s_OpenFiles, handle, true);
+	if (file == nullptr)
+	{
+		printf("Cannot bulk load to hash file since it's not open! FileHandle: %d\n", handle);
+		return -1;
+	}
+
+	// Perform the operation while holding the lock of the file, so that it sees a consistent bucket directory.
+	int32_t result = BulkLoad(file, records, recordCount, blockIDs);
+
+	// Commit the changes, even those of a failed operation, so that their blocks can be written back.
+	if (CommitOpenHashFile(file) == -1)
+		result = -1;
+
+	return result;
+}
+
+int32_t HT_BulkLoadFile(HT_info handle, char* recordFileName, int32_t* blockIDs)
+{
+	// Retrieve the block size of the hash file.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
+	{
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", handle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Open the record file.
+	FILE* recordFile = fopen(recordFileName, "rb");
+	if (recordFile == nullptr)
+	{
+		printf("Could not open record file! FileName: %s\n", recordFileName);
+		return -1;
+	}
+
+	// Allocate the batch of records, which fill as many blocks as a bulk load changes before it commits them.
+	size_t batchRecordCount = GetBulkLoadBlockCount() * MAX_RECORD_COUNT_PER_BLOCK(blockSize);
+	Record* records = (Record*)malloc(batchRecordCount * sizeof(Record));
+	if (records == nullptr)
+	{
+		printf("Could not allocate memory for the bulk load! FileName: %s\n", recordFileName);
+		fclose(recordFile);
 
-			free(bucketValues);
+		return -1;
+	}
+
+	// Load the records in batches, keeping the block IDs in the order of the file.
+	int32_t insertedCount = 0;
+	size_t loadedCount = 0;
+	size_t readCount = 0;
+	while ((readCount = fread(records, sizeof(Record), batchRecordCount, recordFile)) > 0)
+	{
+		int32_t batchInsertedCount = HT_BulkLoad(handle, records, readCount, (blockIDs != nullptr) ? blockIDs + loadedCount : nullptr);
+		if (batchInsertedCount == -1)
+		{
+			insertedCount = -1;
+			break;
 		}
 
-		return blocksTraversed;
+		insertedCount += batchInsertedCount;
+		loadedCount += readCount;
 	}
+
+	free(records);
+	fclose(recordFile);
+
+	return insertedCount;
 }
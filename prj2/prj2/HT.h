@@ -2,25 +2,94 @@
 
 #include "Common.h"
 
+#include <stddef.h>
+
 // The handle of a hash file.
 typedef int32_t HT_info;
 
 // Creates a hash file with bucketCount number of buckets. This returns 0 on success and -1 on failure.
 int32_t HT_CreateIndex(char* fileName, char attributeType, char* attributeName, int32_t attributeLength, int32_t bucketCount);
 
+// Creates a hash file with bucketCount number of buckets whose blocks are blockSize bytes. This returns 0 on success and -1 on failure.
+int32_t HT_CreateIndexWithBlockSize(char* fileName, char attributeType, char* attributeName, int32_t attributeLength, int32_t bucketCount,
+	int32_t blockSize);
+
+// Creates a linear hash file that starts with bucketCount buckets and splits one bucket at a time whenever the records
+// exceed maxLoadFactor of the data block capacity of the buckets. Splits move records between data blocks, so the block indices
+// returned by HT_InsertEntry are only valid until the next insert, and a linear hash file can't be the primary file of a
+// secondary hash file. This returns 0 on success and -1 on failure.
+int32_t HT_CreateLinearIndex(char* fileName, char attributeType, char* attributeName, int32_t attributeLength, int32_t bucketCount,
+	float maxLoadFactor);
+
+// Creates an extendible hash file whose directory starts with bucketCount buckets, rounded up to a power of two. Instead of
+// overflow blocks, a full data block is split in two and the directory doubles when needed, so a lookup reads a single data
+// block. Like in linear hash files, the block indices returned by HT_InsertEntry are only valid until the next insert, and
+// an extendible hash file can't be the primary file of a secondary hash file. This returns 0 on success and -1 on failure.
+int32_t HT_CreateExtendibleIndex(char* fileName, char attributeType, char* attributeName, int32_t attributeLength, int32_t bucketCount);
+
 // Opens a hash file and returns a pointer to it's handle. Returns the file handle on success and nullptr on failure.
 HT_info* HT_OpenIndex(char* fileName);
 
 // Closes a hash file. Returns 0 on success and -1 on failure.
 int32_t HT_CloseIndex(HT_info* handle);
 
+// Closes a hash file like HT_CloseIndex, but first gives the free data blocks at the end of the file back to the file system.
+// Data blocks emptied by HT_DeleteEntry are freed and reused by later inserts, and this shrinks the file when they are the last
+// ones. Returns 0 on success and -1 on failure.
+int32_t HT_CloseIndexWithTruncation(HT_info* handle);
+
 // Inserts a record to the hash file based on the hasing of the ID. Returns the block index where the record was
 // inserted on success and -1 on failure.
 int32_t HT_InsertEntry(HT_info handle, Record record);
 
-// Deletes a record from the hash file if inserted. Returns 0 on success and -1 on failure.
+// Deletes a record from the hash file if inserted. The record's slot is marked as deleted and reused by a later insert, so the other
+// records of it's data block keep their place. A data block left empty is unlinked from it's bucket and freed, so that later
+// inserts reuse it. Returns 0 on success and -1 on failure.
 int32_t HT_DeleteEntry(HT_info handle, void* keyValue);
 
 // If keyValue == nullptr, prints all entries in he hash file, otherwise prints the entry with key == keyValue if it exists.
 // Returns the number of blocks traversed on success and -1 on failure.
 int32_t HT_GetAllEntries(HT_info handle, void* keyValue);
+
+// The state of a scan of the records of a hash file.
+typedef struct HT_Cursor HT_Cursor;
+
+// Opens a cursor over the records of a hash file, bucket by bucket, or over the record with key == keyValue if keyValue is not
+// nullptr. The records are returned as pointers into the data blocks of the hash file, pinned in memory while the cursor reads them,
+// so they are never copied. The cursor holds the lock of the file shared until it's closed, so the file is not modified, resized or
+// closed meanwhile. It must be used and closed by the thread that opened it, before that thread modifies the file. Returns the cursor
+// on success and nullptr on failure.
+HT_Cursor* HT_ScanOpen(HT_info handle, void* keyValue);
+
+// Stores a pointer to the next record of a cursor in record. The record is valid until the next call with the cursor.
+// Returns 1 if there was a record, 0 at the end of the scan and -1 on failure.
+int32_t HT_ScanNext(HT_Cursor* cursor, const Record** record);
+
+// Stores pointers to at most maxRecordCount of the next records of a cursor in records. The records are from the same data block, and
+// valid until the next call with the cursor. Returns the number of records stored, 0 at the end of the scan and -1 on failure.
+int32_t HT_ScanNextBatch(HT_Cursor* cursor, const Record** records, int32_t maxRecordCount);
+
+// Closes a cursor, unpinning it's data block and releasing the lock of the file. Returns 0 on success and -1 on failure.
+int32_t HT_ScanClose(HT_Cursor* cursor);
+
+// Rebuilds the open static hash file with newBucketCount buckets. The records are streamed from the current data blocks in batches
+// of new buckets that fit in a bounded amount of memory and written in full data blocks to a new file, which then atomically
+// replaces the current one. The handle is updated to the reopened file. The block IDs stored in the secondaryFileCount secondary
+// hash files named in secondaryFileNames are remapped to the new data blocks. Returns 0 on success and -1 on failure.
+int32_t HT_Resize(HT_info* handle, int32_t newBucketCount, char** secondaryFileNames, int32_t secondaryFileCount);
+
+// Inserts recordCount records to the hash file at once. The records are partitioned by bucket and sorted in memory, so that
+// duplicates are detected without scanning the chains per record, and every bucket chain is walked once and written with
+// packed blocks. The buckets are committed in batches whose blocks fit in the buffer pool, so a load of any size never runs
+// out of buffer frames. If blockIDs is not nullptr, the block index of every record is stored at the same index, or -1 if the
+// record was a duplicate. Linear and extendible hash files insert the records one at a time and look up their block indices
+// once the load is over, which stay valid until the next insert. Returns the number of records inserted on success and -1 on
+// failure. A failed load is partial: the records inserted before the failure, whose block index was stored in blockIDs, stay
+// in the hash file.
+int32_t HT_BulkLoad(HT_info handle, const Record* records, size_t recordCount, int32_t* blockIDs);
+
+// Same as HT_BulkLoad, but the records are read from the file recordFileName, which contains Record structures as written
+// by fwrite, in batches that fill a share of the buffer pool. If blockIDs is not nullptr, it needs room for every record in
+// the file. Returns the number of records inserted on success and -1 on failure, in which case the batches loaded before
+// the failure stay in the hash file.
+int32_t HT_BulkLoadFile(HT_info handle, char* recordFileName, int32_t* blockIDs);
@@ -3,9 +3,17 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #include "BF/BF.h"
 
+// The number of threads that scan the primary hash file, and the number of threads that write the secondary hash file,
+// when a secondary hash file is created.
+#define BUILD_THREAD_COUNT 4
+
+// The number of primary hash data blocks a lookup reads with one BF_ReadBlocks call.
+#define LOOKUP_BATCH_SIZE 8
+
 // The memory layout of a "record" in the secondary hash file.
 typedef struct DataSegment
 {
@@ -16,13 +24,63 @@ typedef struct DataSegment
 	int32_t BlockID;
 } DataSegment;
 
-// Calculate at compile time the maximum number of data segments in a secondary hash data block.
-#define MAX_DATA_SEGMENT_COUNT_PER_BLOCK ((BLOCK_SIZE - sizeof(HashDataBlockHeader)) / sizeof(DataSegment))
+// Calculate the maximum number of data segments in a secondary hash data block for a given block size.
+#define MAX_DATA_SEGMENT_COUNT_PER_BLOCK(blockSize) (((blockSize) - sizeof(HashDataBlockHeader)) / sizeof(DataSegment))
+
+// The state of a scan of the records with a surname, opened by SHT_ScanOpen.
+struct SHT_Cursor
+{
+	// The open secondary hash file, whose lock the cursor holds shared until it's closed.
+	OpenHashFile* File;
+
+	// The primary hash file the records are read from, and it's block size, which locates the tombstones of it's data blocks.
+	HT_info PrimaryHandle;
+	int32_t PrimaryBlockSize;
+
+	// The surname of the records returned.
+	char Key[25];
+
+	// The primary hash data blocks that hold the records with the surname, in ascending order.
+	int32_t* PrimaryBlockIDs;
+	uint32_t PrimaryBlockCount;
+
+	// The batch of primary hash data blocks whose records are returned, pinned until the cursor moves past it. It starts from the
+	// BatchStart-th block and has BatchSize blocks, or none at all.
+	uint32_t BatchStart;
+	uint32_t BatchSize;
+	uint8_t* BatchBlockPtrs[LOOKUP_BATCH_SIZE];
+
+	// The block of the batch, and the next record slot of it, to read.
+	uint32_t BatchIndex;
+	uint32_t SlotIndex;
+};
+
+// The open secondary hash files, along with their cached bucket directories.
+static OpenHashFileTable s_OpenFiles = OPEN_HASH_FILE_TABLE_INITIALIZER;
+
+// Orders block IDs.
+static int CompareBlockIDs(const void* left, const void* right)
+{
+	int32_t leftBlockID = *(const int32_t*)left;
+	int32_t rightBlockID = *(const int32_t*)right;
+
+	return (leftBlockID > rightBlockID) - (leftBlockID < rightBlockID);
+}
+
+// Orders block ID remaps by the old block ID and then by surname.
+static int CompareBlockIDRemaps(const void* left, const void* right)
+{
+	const SHT_BlockIDRemap* leftRemap = (const SHT_BlockIDRemap*)left;
+	const SHT_BlockIDRemap* rightRemap = (const SHT_BlockIDRemap*)right;
+
+	if (leftRemap->OldBlockID != rightRemap->OldBlockID)
+		return (leftRemap->OldBlockID < rightRemap->OldBlockID) ? -1 : 1;
 
-// Storage for the currently open secondary hash file handle.
-static SHT_info s_HandleStorage = -1;
+	return strcmp(leftRemap->Surname, rightRemap->Surname);
+}
 
-// Utility function that ensures a hash file exists and is valid.
+// Utility function that ensures a hash file exists and is valid. Linear and extendible hash files are not valid primary files, since
+// their splits move records without updating the block IDs stored in the secondary hash files.
 static bool CheckForPrimaryHashFile(const char* fileName)
 {
 	// Open the block level file.
@@ -37,16 +95,14 @@ static bool CheckForPrimaryHashFile(const char* fileName)
 
 	// Since this file exists, we know there's a CommonFileHeader in the first bytes of the header block. So we treat the pointer as such.
 	CommonFileHeader* commonFileHeader = (CommonFileHeader*)headerBlockPtr;
-
-	// Ensure that the file we open is a indeed hash file.
-	if (commonFileHeader->Type != HashFile)
-		return false;
+	FileType type = commonFileHeader->Type;
 
 	// Close the block level file.
 	if (BF_CloseFile(fileHandle) < 0)
 		return false;
 
-	return true;
+	// Ensure that the file we open is a indeed hash file.
+	return type == HashFile;
 }
 
 // The hash function used to insert keys in the secondary hash table.
@@ -65,292 +121,704 @@ uint32_t HashFunction(const char* string, int32_t hashTableSize)
 	return hash % hashTableSize;
 }
 
-int32_t SHT_CreateSecondaryIndex(char* fileName, char attributeType, char* attributeName, int32_t attributeLength,
-	int32_t bucketCount, char* primaryFileName)
+// Inserts a data segment for the record in a secondary hash file, using the given bucket directory of that file.
+// Returns 0 on success and -1 on failure.
+static int32_t InsertDataSegment(SHT_info handle, HashBucketDirectory* directory, SecondaryRecord record)
 {
-	// Ensure the primary hash file exists and it's a valid hash file.
-	if (!CheckForPrimaryHashFile(primaryFileName))
-	{
-		printf("The primary hash file was invalid at the time of SHT creation! PrimaryFileName: %s\n", primaryFileName);
-		return -1;
-	}
-
-	// Create the block level file.
-	if (BF_CreateFile(fileName) < 0)
+	// Retrieve the block size of the secondary hash file.
+	int32_t blockSize = BF_GetBlockSize(handle);
+	if (blockSize < 0)
 	{
-		printf("Could not create block level file for the secondary hash file! FileName: %s\n", fileName);
+		printf("Could not retrieve block size for the secondary hash file! FileHandle: %d\n", handle);
 		BF_PrintError("");
 
 		return -1;
 	}
 
-	// Open the block level file.
-	SHT_info fileHandle = BF_OpenFile(fileName);
-	if (fileHandle < 0)
-	{
-		printf("Could not open block level file for the secondary hash file! FileName: %s\n", fileName);
-		BF_PrintError("");
+	// Hash the record surname and find the bucket index.
+	const char* surname = record.Record.Surname;
+	int32_t bucketIndex = HashFunction(surname, directory->BucketCount);
 
-		return -1;
-	}
+	// Extract the index of the first data block of the bucket from the bucket directory.
+	int32_t dataBlockIndex = directory->Buckets[bucketIndex];
 
-	// Allocate the hash file header block.
-	if (BF_AllocateBlock(fileHandle) < 0)
-	{
-		printf("Could not allocate header block for the secondary hash file! FileHandle: %d\n", fileHandle);
-		BF_PrintError("");
+	// Now we need to look for the record and make sure it's not already in the hash file.
 
-		return -1;
-	}
+	// Start from the first data block.
+	int32_t currentDataBlockIndex = dataBlockIndex;
 
-	// Retrieve a pointer to the header block.
-	uint8_t* headerBlockPtr = nullptr;
-	if (BF_ReadBlock(fileHandle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	// Loop until the end of the allocated data blocks.
+	while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
 	{
-		printf("Could not retrieve pointer to secondary hash header block! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
-		BF_PrintError("");
+		// Retrieve a pointer to the current data block.
+		uint8_t* currentDataBlockPtr = nullptr;
+		if (BF_ReadBlock(handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
+		{
+			printf("Could not retrieve pointer to secondary hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
+			BF_PrintError("");
 
-		return -1;
-	}
+			return -1;
+		}
 
-	// Create the hash file header and fill it's data.
-	HashFileHeader header = { };
-	header.CommonHeader.Type = SecondaryHashFile;
-	header.BucketCount = bucketCount;
-	header.NextBlockIndex = INVALID_BLOCK_INDEX;
+		// Since this file exists, we know there's a DataBlockHeader in the first bytes of the block. So we treat the pointer as such.
+		HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
 
-	// Copy the file header into the hash file header block.
-	memcpy(headerBlockPtr, &header, sizeof(HashFileHeader));
+		// Offset the block pointer by the size of the header so it points to the first byte of the first data segment slot.
+		currentDataBlockPtr += sizeof(HashDataBlockHeader);
 
-	// Write the hash file header block to the disk.
-	if (BF_WriteBlock(fileHandle, HEADER_BLOCK_INDEX) < 0)
-	{
-		printf("Could not write secondary hash header block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
-		BF_PrintError("");
+		// Interate through all the data segment slots that are occupied in the current data block.
+		for (uint32_t dataSegmentIndex = 0; dataSegmentIndex < currentDataBlockHeader->ElementCount; dataSegmentIndex++)
+		{
+			// Treat the current pointer as a data segment.
+			DataSegment* currentDataSegment = (DataSegment*)currentDataBlockPtr;
 
-		return -1;
-	}
+			// If the current record's key is the same as the one we want to insert, it's already in the hash so we exit.
+			if (strcmp(currentDataSegment->Surname, surname) == 0)
+			{
+				printf("The specified record is already in the secondary hash file! RecordID: %s\n", surname);
+				return -1;
+			}
 
-	// Now we need to create all the blocks required to store the hash table.
+			// Offset the block poiter by the size of a data segment so it pointes to the first byte of the next data segment slot.
+			currentDataBlockPtr += sizeof(DataSegment);
+		}
 
-	// Calculate the required blocks for the bucket count using an integer division.
-	int32_t requiredBlockCount = (bucketCount / MAX_BUCKET_COUNT_PER_BLOCK);
+		// Update the current block index.
+		currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
+	}
 
-	// If there is a remainder we add one more block to account for those buckets.
-	requiredBlockCount += ((bucketCount % MAX_BUCKET_COUNT_PER_BLOCK) > 0) ? 1 : 0;
+	// If we're here the record is not in the hash so we try to insert it.
 
-	// Set the previous bucket block index to the header block.
-	int32_t previousBucketBlockIndex = HEADER_BLOCK_INDEX;
+	// Create the data segment.
+	DataSegment dataSegment = { };
+	memcpy(dataSegment.Surname, surname, 25 * sizeof(char));
+	dataSegment.BlockID = record.BlockID;
 
-	// Loop through all the required secondary hash file bucket blocks.
-	for (int32_t index = 0; index < requiredBlockCount; index++)
-	{
-		// Allocate a new bucket block.
-		if (BF_AllocateBlock(fileHandle) < 0)
-		{
-			printf("Could not allocate bucket block for the secondary hash file! FileHandle: %d\n", fileHandle);
-			BF_PrintError("");
+	// Reset the current data block index and prepare for insertion.
+	currentDataBlockIndex = dataBlockIndex;
 
-			return -1;
-		}
+	// The previous block is invalid initially.
+	int32_t previousDataBlockIndex = INVALID_BLOCK_INDEX;
 
-		// Retrieve the block count of the hash file.
-		int32_t blockCount = BF_GetBlockCounter(fileHandle);
-		if (blockCount < 0)
+	// Loop until the end of the allocated data blocks.
+	while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
+	{
+		// Retrieve a pointer to the current data block.
+		uint8_t* currentDataBlockPtr = nullptr;
+		if (BF_ReadBlock(handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
 		{
-			printf("Could not retrieve block count for the secondary hash file! FileHandle: %d\n", fileHandle);
+			printf("Could not retrieve pointer to secondary hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
 			BF_PrintError("");
 
 			return -1;
 		}
 
-		// Calculate the index of the new bucket block.
-		int32_t newBucketBlockIndex = blockCount - 1;
+		// Since this file exists, we know there's a DataBlockHeader in the first bytes of the block. So we treat the pointer as such.
+		HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
 
-		// Retrieve a pointer to the new bucket block.
-		uint8_t* newBucketBlockPtr = nullptr;
-		if (BF_ReadBlock(fileHandle, newBucketBlockIndex, (void**)&newBucketBlockPtr) < 0)
+		// If there's space in the current data block, we insert here.
+		if (currentDataBlockHeader->ElementCount < MAX_DATA_SEGMENT_COUNT_PER_BLOCK(blockSize))
 		{
-			printf("Could not retrieve pointer to secondary hash bucket block! FileHandle: %d, BlockIndex: %d\n", fileHandle, newBucketBlockIndex);
-			BF_PrintError("");
+			// Offset the block pointer by the size of the header so it points to the first byte of the first data segment slot.
+			currentDataBlockPtr += sizeof(HashDataBlockHeader);
 
-			return -1;
-		}
+			// Offset the block pointer by the size of the data segment times the number of data segments so it points to the first byte
+			// of the first empty data segment slot.
+			currentDataBlockPtr += currentDataBlockHeader->ElementCount * sizeof(DataSegment);
 
-		// Create the bucket block header and set it's data.
-		HashBucketBlockHeader newBucketBlockHeader = { };
-		newBucketBlockHeader.NextBlockIndex = INVALID_BLOCK_INDEX;
+			// Copy the data segment into the data block.
+			memcpy(currentDataBlockPtr, &dataSegment, sizeof(DataSegment));
 
-		// Copy the new bucket block header to he beginning of the new bucket block.
-		memcpy(newBucketBlockPtr, &newBucketBlockHeader, sizeof(HashBucketBlockHeader));
+			// Increment the current data block's data segment count.
+			currentDataBlockHeader->ElementCount++;
 
-		// Offset the new bucket block pointer to point to the first byte of the bucket indices.
-		newBucketBlockPtr += sizeof(HashBucketBlockHeader);
+			// Write the updated contents of the current hash file data block to the disk.
+			if (BF_WriteBlock(handle, currentDataBlockIndex) < 0)
+			{
+				printf("Could not write secondary hash data block to disk! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
+				BF_PrintError("");
 
-		// Initially set the number of buckets in the current bucket block to max.
-		int32_t bucketCountInCurrentBucketBlock = MAX_BUCKET_COUNT_PER_BLOCK;
+				return -1;
+			}
 
-		// If this is the last bucket block we create, the number of buckets is the remainder of the following division.
-		if (index == requiredBlockCount - 1)
-			bucketCountInCurrentBucketBlock = bucketCount % MAX_BUCKET_COUNT_PER_BLOCK;
+			// Return a successful code.
+			return 0;
+		}
 
-		// Fill the bucketCountInCurrentBucketBlock number of bucket indices to the invalid block index.
-		memset(newBucketBlockPtr, INVALID_BLOCK_INDEX, bucketCountInCurrentBucketBlock * sizeof(int32_t));
+		// Update the previous and current block indices.
+		previousDataBlockIndex = currentDataBlockIndex;
+		currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
+	}
 
-		// Write the new bucket block to the disk.
-		if (BF_WriteBlock(fileHandle, newBucketBlockIndex) < 0)
-		{
-			printf("Could not write secondary hash bucket block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, newBucketBlockIndex);
-			BF_PrintError("");
+	// If we are here, a new data block needs to be created. Either because this is the first entry in the bucket or because we ran
+	// out of space in all of the currently allocated data blocks.
 
-			return -1;
-		}
+	// Allocate a new data block, next to the last one of the chain if it reserved one.
+	uint32_t reservedBlockCount = 0;
+	int32_t newDataBlockIndex = AllocateChainBlock(handle, directory, previousDataBlockIndex, &reservedBlockCount);
+	if (newDataBlockIndex == -1)
+		return -1;
 
-		// Now we need to update the previous bucket block's NextBlockIndex.
+	// Retrieve a pointer to the new data block.
+	uint8_t* newDataBlockPtr = nullptr;
+	if (BF_ReadBlock(handle, newDataBlockIndex, (void**)&newDataBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to secondary hash data block! FileHandle: %d, BlockIndex: %d\n", handle, newDataBlockIndex);
+		BF_PrintError("");
 
-		// Retrieve a pointer to the previous bucket block.
-		uint8_t* previousBucketBlockPtr = nullptr;
-		if (BF_ReadBlock(fileHandle, previousBucketBlockIndex, (void**)&previousBucketBlockPtr) < 0)
-		{
-			printf("Could not retrieve pointer to secondary hash bucket block! FileHandle: %d, BlockIndex: %d\n", fileHandle, previousBucketBlockIndex);
-			BF_PrintError("");
+		return -1;
+	}
 
-			return -1;
-		}
+	// Create the data block header and fill it's data.
+	HashDataBlockHeader newDataBlockHeader = { };
+	newDataBlockHeader.ElementCount = 1;
+	newDataBlockHeader.NextBlockIndex = INVALID_BLOCK_INDEX;
+	newDataBlockHeader.ReservedBlockCount = reservedBlockCount;
 
-		// If the previous bucket block is the header block, we need to treat it differently since it has a different header structure.
-		if (previousBucketBlockIndex == HEADER_BLOCK_INDEX)
-		{
-			HashFileHeader* previousBlockHeader = (HashFileHeader*)previousBucketBlockPtr;
-			previousBlockHeader->NextBlockIndex = newBucketBlockIndex;
-		}
-		else
-		{
-			HashBucketBlockHeader* previousBlockHeader = (HashBucketBlockHeader*)previousBucketBlockPtr;
-			previousBlockHeader->NextBlockIndex = newBucketBlockIndex;
-		}
+	// Copy the new data block header into the new data block.
+	memcpy(newDataBlockPtr, &newDataBlockHeader, sizeof(HashDataBlockHeader));
 
-		// Write the updated previous bucket block to the disk.
-		if (BF_WriteBlock(fileHandle, previousBucketBlockIndex) < 0)
-		{
-			printf("Could not write secondary hash bucket block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, previousBucketBlockIndex);
-			BF_PrintError("");
+	// Offset the data block pointer by the size of the header so it points to the first byte of the first data segment slot.
+	newDataBlockPtr += sizeof(HashDataBlockHeader);
 
-			return -1;
-		}
+	// Copy the data segment into the block.
+	memcpy(newDataBlockPtr, &dataSegment, sizeof(DataSegment));
 
-		// Update the previous bucket block index to the new bucket block index.
-		previousBucketBlockIndex = newBucketBlockIndex;
+	// Write the contents of the new hash data block to the disk.
+	if (BF_WriteBlock(handle, newDataBlockIndex) < 0)
+	{
+		printf("Could not write secondary hash data block to disk! FileHandle: %d, BlockIndex: %d\n", handle, newDataBlockIndex);
+		BF_PrintError("");
+
+		return -1;
 	}
 
-	// Now we need to insert any elements that were already in the primary hash file, into he secondary hash file.
+	if (previousDataBlockIndex != INVALID_BLOCK_INDEX)
 	{
-		uint32_t elementsInserted = 0;
+		// If a previous data block exists, we need to update the NextBlockIndex.
 
-		HT_info primaryHashFileHandle = BF_OpenFile(primaryFileName);
-		if (primaryHashFileHandle < 0)
+		// Retrieve a pointer to the previous data block.
+		uint8_t* previousDataBlockPtr = nullptr;
+		if (BF_ReadBlock(handle, previousDataBlockIndex, (void**)&previousDataBlockPtr) < 0)
 		{
-			printf("Could not open block level file for the hash file! FileName: %s\n", primaryFileName);
+			printf("Could not retrieve pointer to secondary hash data block! FileHandle: %d, BlockIndex: %d\n", handle, previousDataBlockIndex);
 			BF_PrintError("");
 
 			return -1;
 		}
 
-		// Retrieve a pointer to the hash file header block.
-		uint8_t* primaryHashHeaderBlockPtr = nullptr;
-		if (BF_ReadBlock(primaryHashFileHandle, HEADER_BLOCK_INDEX, (void**)&primaryHashHeaderBlockPtr) < 0)
+		// Get the header and update the next block index. The new block takes over the reserved blocks.
+		HashDataBlockHeader* previousDataBlockHeader = (HashDataBlockHeader*)previousDataBlockPtr;
+		previousDataBlockHeader->NextBlockIndex = newDataBlockIndex;
+		previousDataBlockHeader->ReservedBlockCount = 0;
+
+		// Write the contents of the previous hash data block to the disk.
+		if (BF_WriteBlock(handle, previousDataBlockIndex) < 0)
 		{
-			printf("Could not retrieve pointer to hash header block! FileHandle: %d, BlockIndex: %d\n", primaryHashFileHandle, HEADER_BLOCK_INDEX);
+			printf("Could not write secondary hash data block to disk! FileHandle: %d, BlockIndex: %d\n", handle, previousDataBlockIndex);
 			BF_PrintError("");
 
 			return -1;
 		}
+	}
+	else
+	{
+		// Otherwise we need to update the bucket, both in the bucket directory and on the disk.
+		if (SetBucketFirstBlock(handle, directory, bucketIndex, newDataBlockIndex) == -1)
+			return -1;
+	}
 
-		HashFileHeader* primaryHashFileHeader = (HashFileHeader*)primaryHashHeaderBlockPtr;
+	return 0;
+}
 
-		// Start from the first bucket block.
-		int32_t currentBucketBlockIndex = primaryHashFileHeader->NextBlockIndex;
-		uint32_t bucketCount = primaryHashFileHeader->BucketCount;
+// A data segment gathered while building a secondary hash file, along with it's bucket and it's position in the primary hash file.
+typedef struct BuildSegment
+{
+	DataSegment Segment;
+	uint32_t BucketIndex;
+	uint32_t Sequence;
+} BuildSegment;
 
-		// Loop through all the bucket blocks.
-		while (currentBucketBlockIndex != INVALID_BLOCK_INDEX)
-		{
-			// Retrieve a pointer to the current bucket block.
-			uint8_t* currentBucketBlockPtr = nullptr;
-			if (BF_ReadBlock(primaryHashFileHandle, currentBucketBlockIndex, (void**)&currentBucketBlockPtr) < 0)
-			{
-				printf("Could not retrieve pointer to hash bucket block! FileHandle: %d, BlockIndex: %d\n", primaryHashFileHandle, currentBucketBlockIndex);
-				BF_PrintError("");
+// A growable array of data segments, that a scanner thread fills for a writer thread.
+typedef struct BuildPartition
+{
+	BuildSegment* Segments;
+	uint32_t Count;
+	uint32_t Capacity;
+} BuildPartition;
 
-				return -1;
-			}
+// The state shared by the threads that build a secondary hash file.
+typedef struct BuildContext
+{
+	// The primary hash file.
+	HT_info PrimaryHandle;
+	const HashBucketDirectory* PrimaryDirectory;
+	int32_t PrimaryBlockSize;
+
+	// The secondary hash file.
+	SHT_info SecondaryHandle;
+	HashBucketDirectory* SecondaryDirectory;
+	int32_t SecondaryBlockSize;
+
+	// The number of secondary buckets each writer thread owns, a multiple of the buckets per bucket block, so that no two writers
+	// update the same bucket block.
+	uint32_t WriterBucketCount;
+
+	// The partitions, one per scanner and writer thread pair.
+	BuildPartition Partitions[BUILD_THREAD_COUNT][BUILD_THREAD_COUNT];
+
+	// The number of data segments written, and -1 if any thread failed. The block level calls are thread safe, so the threads share
+	// nothing else and only access this atomically.
+	int32_t Result;
+} BuildContext;
+
+// The argument of a build thread.
+typedef struct BuildThread
+{
+	BuildContext* Context;
+	uint32_t Index;
+} BuildThread;
 
-			// Since this block exists, we know there's a BucketBlockHeader in the first bytes of the header block. So we treat the pointer as such.
-			HashBucketBlockHeader* currentBucketBlockHeader = (HashBucketBlockHeader*)currentBucketBlockPtr;
+// Orders build segments by bucket, then by surname, then by their position in the primary hash file.
+static int CompareBuildSegments(const void* left, const void* right)
+{
+	const BuildSegment* leftSegment = (const BuildSegment*)left;
+	const BuildSegment* rightSegment = (const BuildSegment*)right;
 
-			// Offset the pointer by the size of the header so it points to the first bucket.
-			currentBucketBlockPtr += sizeof(HashBucketBlockHeader);
+	if (leftSegment->BucketIndex != rightSegment->BucketIndex)
+		return (leftSegment->BucketIndex < rightSegment->BucketIndex) ? -1 : 1;
 
-			// Update the current bucket block to point to the next one.
-			currentBucketBlockIndex = currentBucketBlockHeader->NextBlockIndex;
+	int comparison = strcmp(leftSegment->Segment.Surname, rightSegment->Segment.Surname);
+	if (comparison != 0)
+		return comparison;
 
-			// Calculate the number of buckets in the current bucket block. If it's not the last one there's the
-			// max number of buckets. Otherwise it's the remainder.
-			int32_t bucketsInCurrentBlock = MAX_BUCKET_COUNT_PER_BLOCK;
-			if (currentBucketBlockHeader->NextBlockIndex == INVALID_BLOCK_INDEX)
-				bucketsInCurrentBlock = bucketCount % MAX_BUCKET_COUNT_PER_BLOCK;
+	return (leftSegment->Sequence < rightSegment->Sequence) ? -1 : 1;
+}
 
-			// Store the values for the buckets because the block will get unloaded.
-			int32_t* bucketValues = (int32_t*)malloc(bucketsInCurrentBlock * sizeof(int32_t));
-			memcpy(bucketValues, currentBucketBlockPtr, bucketsInCurrentBlock * sizeof(int32_t));
+// Marks the build as failed.
+static void FailBuild(BuildContext* context)
+{
+	__atomic_store_n(&context->Result, -1, __ATOMIC_RELAXED);
+}
 
-			for (uint32_t bucketIndex = 0; bucketIndex < bucketsInCurrentBlock; bucketIndex++)
-			{
-				// Start from the first data block.
-				int32_t currentDataBlockIndex = bucketValues[bucketIndex];
+// Returns whether any thread has failed the build.
+static bool IsBuildFailed(BuildContext* context)
+{
+	return __atomic_load_n(&context->Result, __ATOMIC_RELAXED) == -1;
+}
 
-				// Loop through all the data blocks in the bucket.
-				while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
-				{
-					// Retrieve a pointer to the data block.
-					uint8_t* currentDataBlockPtr = nullptr;
-					if (BF_ReadBlock(primaryHashFileHandle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
-					{
-						printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", primaryHashFileHandle, currentDataBlockIndex);
-						BF_PrintError("");
+// Adds the data segments written by a thread to the result, unless the build has failed.
+static void AddBuildSegments(BuildContext* context, uint32_t segmentCount)
+{
+	int32_t result = __atomic_load_n(&context->Result, __ATOMIC_RELAXED);
+	while (result != -1 &&
+		!__atomic_compare_exchange_n(&context->Result, &result, result + (int32_t)segmentCount, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
 
-						return -1;
-					}
+// Scans a range of primary buckets and partitions the data segments of their records by the writer of their secondary bucket.
+static void* ScanPrimaryBuckets(void* argument)
+{
+	BuildThread* thread = (BuildThread*)argument;
+	BuildContext* context = thread->Context;
 
-					// Since this block exists we know there is a DataBlockHeader is the first byte so treat is as such.
-					HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
+	// Calculate the range of primary buckets of the thread.
+	uint32_t bucketCount = context->PrimaryDirectory->BucketCount;
+	uint32_t firstBucketIndex = (uint32_t)(((uint64_t)bucketCount * thread->Index) / BUILD_THREAD_COUNT);
+	uint32_t lastBucketIndex = (uint32_t)(((uint64_t)bucketCount * (thread->Index + 1)) / BUILD_THREAD_COUNT);
 
-					// Offset the pointer by the size of the header so it points to the beginning of the record data.
-					currentDataBlockPtr += sizeof(HashDataBlockHeader);
+	uint32_t sequence = 0;
+	for (uint32_t bucketIndex = firstBucketIndex; bucketIndex < lastBucketIndex && !IsBuildFailed(context); bucketIndex++)
+	{
+		// Start from the first data block.
+		int32_t currentDataBlockIndex = context->PrimaryDirectory->Buckets[bucketIndex];
 
-					// Loop through all the records in the block.
-					for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->ElementCount; recordIndex++)
-					{
-						// Get the current record and print it.
-						Record* currentRecord = (Record*)currentDataBlockPtr;
+		// Loop through all the data blocks in the bucket.
+		while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
+		{
+			// Pin the data block while it's records are partitioned. The threads pin only the block they process, so that they fit in
+			// the buffer pool together.
+			uint8_t* dataBlock = nullptr;
+			if (BF_PinBlock(context->PrimaryHandle, currentDataBlockIndex, BF_LATCH_SHARED, (void**)&dataBlock) < 0)
+			{
+				printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", context->PrimaryHandle, currentDataBlockIndex);
+				BF_PrintError("");
+				FailBuild(context);
 
-						SecondaryRecord secondaryRecord = { };
-						secondaryRecord.Record = *currentRecord;
-						secondaryRecord.BlockID = currentDataBlockIndex;
+				break;
+			}
 
-						SHT_SecondaryInsertEntry(fileHandle, secondaryRecord);
-						elementsInserted++;
+			// Since this block exists we know there is a DataBlockHeader is the first byte so treat is as such.
+			HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)dataBlock;
+			Record* currentRecords = (Record*)(dataBlock + sizeof(HashDataBlockHeader));
 
-						// Increment the pointer by the size of a record so it points to the next record in the block.
-						currentDataBlockPtr += sizeof(Record);
-					}
+			// Hash the surname of every record that is not deleted and add it's data segment to the partition of the writer of it's bucket.
+			for (uint32_t recordIndex = 0; recordIndex < currentDataBlockHeader->SlotCount; recordIndex++)
+			{
+				if (IS_SLOT_DELETED(dataBlock, context->PrimaryBlockSize, recordIndex))
+					continue;
 
-					// Update the current data block to point to the next one.
-					currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
-				}
-			}
+				uint32_t secondaryBucketIndex = HashFunction(currentRecords[recordIndex].Surname, context->SecondaryDirectory->BucketCount);
+				BuildPartition* partition = &context->Partitions[thread->Index][secondaryBucketIndex / context->WriterBucketCount];
 
-			free(bucketValues);
+				// Grow the partition if it's full.
+				if (partition->Count == partition->Capacity)
+				{
+					uint32_t newCapacity = (partition->Capacity > 0) ? partition->Capacity * 2 : 1024;
+					BuildSegment* newSegments = (BuildSegment*)realloc(partition->Segments, newCapacity * sizeof(BuildSegment));
+					if (newSegments == nullptr)
+					{
+						FailBuild(context);
+						break;
+					}
+
+					partition->Segments = newSegments;
+					partition->Capacity = newCapacity;
+				}
+
+				BuildSegment* segment = &partition->Segments[partition->Count++];
+				memset(segment, 0, sizeof(BuildSegment));
+				memcpy(segment->Segment.Surname, currentRecords[recordIndex].Surname, sizeof(segment->Segment.Surname));
+				segment->Segment.BlockID = currentDataBlockIndex;
+				segment->BucketIndex = secondaryBucketIndex;
+				segment->Sequence = sequence++;
+			}
+
+			// Update the current data block to point to the next one.
+			int32_t nextDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
+			BF_UnpinBlock(context->PrimaryHandle, currentDataBlockIndex);
+			currentDataBlockIndex = nextDataBlockIndex;
+		}
+	}
+
+	return nullptr;
+}
+
+// Gathers the partitions of a range of secondary buckets from all the scanner threads, drops the duplicate surnames and writes
+// every bucket in packed, consecutively allocated data blocks.
+static void* WriteSecondaryBuckets(void* argument)
+{
+	BuildThread* thread = (BuildThread*)argument;
+	BuildContext* context = thread->Context;
+
+	// Concatenate the partitions in scanner order, so that the sequence keeps the order of the primary hash file.
+	uint32_t segmentCount = 0;
+	for (uint32_t scannerIndex = 0; scannerIndex < BUILD_THREAD_COUNT; scannerIndex++)
+		segmentCount += context->Partitions[scannerIndex][thread->Index].Count;
+
+	BuildSegment* segments = (BuildSegment*)malloc((segmentCount + 1) * sizeof(BuildSegment));
+	if (segments == nullptr)
+	{
+		FailBuild(context);
+		return nullptr;
+	}
+
+	uint32_t offset = 0;
+	for (uint32_t scannerIndex = 0; scannerIndex < BUILD_THREAD_COUNT; scannerIndex++)
+	{
+		BuildPartition* partition = &context->Partitions[scannerIndex][thread->Index];
+		memcpy(&segments[offset], partition->Segments, partition->Count * sizeof(BuildSegment));
+		offset += partition->Count;
+	}
+
+	for (uint32_t segmentIndex = 0; segmentIndex < segmentCount; segmentIndex++)
+		segments[segmentIndex].Sequence = segmentIndex;
+
+	// Sort by bucket and surname, so that duplicates are next to each other.
+	qsort(segments, segmentCount, sizeof(BuildSegment), CompareBuildSegments);
+
+	// Drop the duplicate surnames, keeping the first one like the secondary insert does.
+	uint32_t uniqueCount = 0;
+	for (uint32_t segmentIndex = 0; segmentIndex < segmentCount; segmentIndex++)
+	{
+		if (uniqueCount > 0 && segments[uniqueCount - 1].BucketIndex == segments[segmentIndex].BucketIndex &&
+			strcmp(segments[uniqueCount - 1].Segment.Surname, segments[segmentIndex].Segment.Surname) == 0)
+		{
+			printf("The specified record is already in the secondary hash file! RecordID: %s\n", segments[segmentIndex].Segment.Surname);
+			continue;
+		}
+
+		segments[uniqueCount++] = segments[segmentIndex];
+	}
+
+	// Write every bucket. The data blocks of a bucket are allocated at once, so that they are consecutive even while the other writers
+	// allocate theirs.
+	uint32_t maxSegmentCount = MAX_DATA_SEGMENT_COUNT_PER_BLOCK(context->SecondaryBlockSize);
+	uint32_t bucketStart = 0;
+	while (bucketStart < uniqueCount && !IsBuildFailed(context))
+	{
+		uint32_t bucketIndex = segments[bucketStart].BucketIndex;
+		uint32_t bucketEnd = bucketStart;
+		while (bucketEnd < uniqueCount && segments[bucketEnd].BucketIndex == bucketIndex)
+			bucketEnd++;
+
+		// Allocate the data blocks of the bucket.
+		int32_t dataBlockCount = (int32_t)((bucketEnd - bucketStart + maxSegmentCount - 1) / maxSegmentCount);
+		int32_t firstDataBlockIndex = BF_AllocateBlocks(context->SecondaryHandle, dataBlockCount);
+		if (firstDataBlockIndex < 0)
+		{
+			printf("Could not allocate data blocks for the secondary hash file! FileHandle: %d\n", context->SecondaryHandle);
+			BF_PrintError("");
+			FailBuild(context);
+
+			break;
+		}
+
+		int32_t result = 0;
+		int32_t newDataBlockIndex = firstDataBlockIndex;
+		for (uint32_t segmentIndex = bucketStart; segmentIndex < bucketEnd && result == 0; segmentIndex += maxSegmentCount, newDataBlockIndex++)
+		{
+			// Pin the new data block while it's filled.
+			uint8_t* newDataBlockPtr = nullptr;
+			if (BF_PinBlock(context->SecondaryHandle, newDataBlockIndex, BF_LATCH_EXCLUSIVE, (void**)&newDataBlockPtr) < 0)
+			{
+				printf("Could not retrieve pointer to secondary hash data block! FileHandle: %d, BlockIndex: %d\n", context->SecondaryHandle,
+					newDataBlockIndex);
+				BF_PrintError("");
+				result = -1;
+
+				break;
+			}
+
+			// Fill the data block and link it to the next one, which is allocated right after it.
+			uint32_t elementCount = (bucketEnd - segmentIndex < maxSegmentCount) ? bucketEnd - segmentIndex : maxSegmentCount;
+			HashDataBlockHeader newDataBlockHeader = { };
+			newDataBlockHeader.ElementCount = elementCount;
+			newDataBlockHeader.NextBlockIndex = (segmentIndex + elementCount < bucketEnd) ? newDataBlockIndex + 1 : INVALID_BLOCK_INDEX;
+			memcpy(newDataBlockPtr, &newDataBlockHeader, sizeof(HashDataBlockHeader));
+
+			DataSegment* newDataSegments = (DataSegment*)(newDataBlockPtr + sizeof(HashDataBlockHeader));
+			for (uint32_t index = 0; index < elementCount; index++)
+				newDataSegments[index] = segments[segmentIndex + index].Segment;
+
+			// Write the new data block to the disk.
+			int32_t writeResult = BF_WriteBlock(context->SecondaryHandle, newDataBlockIndex);
+			BF_UnpinBlock(context->SecondaryHandle, newDataBlockIndex);
+			if (writeResult < 0)
+			{
+				printf("Could not write secondary hash data block to disk! FileHandle: %d, BlockIndex: %d\n", context->SecondaryHandle, newDataBlockIndex);
+				BF_PrintError("");
+				result = -1;
+
+				break;
+			}
+
+			// The first data block goes in the bucket.
+			if (segmentIndex == bucketStart)
+				result = SetBucketFirstBlock(context->SecondaryHandle, context->SecondaryDirectory, bucketIndex, newDataBlockIndex);
+		}
+
+		// Update the shared result.
+		if (result == -1)
+			FailBuild(context);
+		else
+			AddBuildSegments(context, bucketEnd - bucketStart);
+
+		bucketStart = bucketEnd;
+	}
+
+	free(segments);
+
+	return nullptr;
+}
+
+// Inserts the records of the primary hash file into the new, empty, secondary hash file. The primary buckets are scanned by
+// BUILD_THREAD_COUNT threads that partition the data segments by secondary bucket range, and then BUILD_THREAD_COUNT threads
+// write one range each. Returns the number of data segments inserted on success and -1 on failure.
+static int32_t BuildSecondaryIndex(SHT_info fileHandle, HashBucketDirectory* directory, HT_info primaryHandle,
+	const HashBucketDirectory* primaryDirectory)
+{
+	BuildContext* context = (BuildContext*)calloc(1, sizeof(BuildContext));
+	if (context == nullptr)
+	{
+		printf("Could not allocate memory for the secondary hash file build!\n");
+		return -1;
+	}
+
+	context->PrimaryHandle = primaryHandle;
+	context->PrimaryDirectory = primaryDirectory;
+	context->PrimaryBlockSize = BF_GetBlockSize(primaryHandle);
+	context->SecondaryHandle = fileHandle;
+	context->SecondaryDirectory = directory;
+	context->SecondaryBlockSize = BF_GetBlockSize(fileHandle);
+	uint32_t writerBucketBlockCount = (directory->BucketCount + BUILD_THREAD_COUNT * directory->BucketsPerBlock - 1) /
+		(BUILD_THREAD_COUNT * directory->BucketsPerBlock);
+	context->WriterBucketCount = writerBucketBlockCount * directory->BucketsPerBlock;
+
+	BuildThread threads[BUILD_THREAD_COUNT];
+	pthread_t threadIDs[BUILD_THREAD_COUNT];
+
+	// Run the scanners, and then the writers once every partition is complete.
+	void* (*phases[2])(void*) = { ScanPrimaryBuckets, WriteSecondaryBuckets };
+	for (uint32_t phase = 0; phase < 2 && !IsBuildFailed(context); phase++)
+	{
+		uint32_t startedCount = 0;
+		for (uint32_t index = 0; index < BUILD_THREAD_COUNT; index++)
+		{
+			threads[index].Context = context;
+			threads[index].Index = index;
+			if (pthread_create(&threadIDs[index], nullptr, phases[phase], &threads[index]) != 0)
+			{
+				printf("Could not create secondary hash file build thread!\n");
+				FailBuild(context);
+
+				break;
+			}
+
+			startedCount++;
+		}
+
+		for (uint32_t index = 0; index < startedCount; index++)
+			pthread_join(threadIDs[index], nullptr);
+	}
+
+	int32_t result = context->Result;
+
+	// Free the partitions.
+	for (uint32_t scannerIndex = 0; scannerIndex < BUILD_THREAD_COUNT; scannerIndex++)
+	{
+		for (uint32_t writerIndex = 0; writerIndex < BUILD_THREAD_COUNT; writerIndex++)
+			free(context->Partitions[scannerIndex][writerIndex].Segments);
+	}
+
+	free(context);
+
+	return result;
+}
+
+int32_t SHT_CreateSecondaryIndex(char* fileName, char attributeType, char* attributeName, int32_t attributeLength,
+	int32_t bucketCount, char* primaryFileName)
+{
+	return SHT_CreateSecondaryIndexWithBlockSize(fileName, attributeType, attributeName, attributeLength, bucketCount, primaryFileName,
+		BF_DEFAULT_BLOCK_SIZE);
+}
+
+int32_t SHT_CreateSecondaryIndexWithBlockSize(char* fileName, char attributeType, char* attributeName, int32_t attributeLength,
+	int32_t bucketCount, char* primaryFileName, int32_t blockSize)
+{
+	// Ensure the primary hash file exists and it's a valid hash file.
+	if (!CheckForPrimaryHashFile(primaryFileName))
+	{
+		printf("The primary hash file was invalid at the time of SHT creation! PrimaryFileName: %s\n", primaryFileName);
+		return -1;
+	}
+
+	// Create the block level file.
+	if (BF_CreateFileWithBlockSize(fileName, blockSize) < 0)
+	{
+		printf("Could not create block level file for the secondary hash file! FileName: %s\n", fileName);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Open the block level file.
+	SHT_info fileHandle = BF_OpenFile(fileName);
+	if (fileHandle < 0)
+	{
+		printf("Could not open block level file for the secondary hash file! FileName: %s\n", fileName);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Allocate the hash file header block.
+	if (BF_AllocateBlock(fileHandle) < 0)
+	{
+		printf("Could not allocate header block for the secondary hash file! FileHandle: %d\n", fileHandle);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Retrieve a pointer to the header block.
+	uint8_t* headerBlockPtr = nullptr;
+	if (BF_ReadBlock(fileHandle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to secondary hash header block! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Create the hash file header and fill it's data.
+	HashFileHeader header = { };
+	header.CommonHeader.Type = SecondaryHashFile;
+	header.BucketCount = bucketCount;
+	header.FirstBucketBlockIndex = FIRST_BUCKET_BLOCK_INDEX;
+	header.BucketBlockCount = BUCKET_BLOCK_COUNT(bucketCount, MAX_BUCKET_COUNT_PER_BLOCK(blockSize));
+	header.InitialBucketCount = bucketCount;
+	header.FirstFreeBlockIndex = INVALID_BLOCK_INDEX;
+
+	// Copy the file header into the hash file header block.
+	memcpy(headerBlockPtr, &header, sizeof(HashFileHeader));
+
+	// Write the hash file header block to the disk.
+	if (BF_WriteBlock(fileHandle, HEADER_BLOCK_INDEX) < 0)
+	{
+		printf("Could not write secondary hash header block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
+
+		return -1;
+	}
+
+	// Now we need to create all the contiguous blocks required to store the hash table.
+	if (CreateBucketBlocks(fileHandle, bucketCount, FIRST_BUCKET_BLOCK_INDEX) < 0)
+	{
+		printf("Could not create bucket blocks for the secondary hash file! FileHandle: %d\n", fileHandle);
+		return -1;
+	}
+
+	// Now we need to insert any elements that were already in the primary hash file, into he secondary hash file.
+	{
+		HT_info primaryHashFileHandle = BF_OpenFile(primaryFileName);
+		if (primaryHashFileHandle < 0)
+		{
+			printf("Could not open block level file for the hash file! FileName: %s\n", primaryFileName);
+			BF_PrintError("");
+
+			return -1;
+		}
+
+		// Load the bucket directories of both files, so that neither has to be walked per record.
+		HashBucketDirectory primaryDirectory;
+		if (LoadBucketDirectory(primaryHashFileHandle, &primaryDirectory) == -1)
+		{
+			printf("Could not load the bucket directory of the hash file! FileName: %s\n", primaryFileName);
+			return -1;
+		}
+
+		HashBucketDirectory secondaryDirectory;
+		if (LoadBucketDirectory(fileHandle, &secondaryDirectory) == -1)
+		{
+			printf("Could not load the bucket directory of the secondary hash file! FileName: %s\n", fileName);
+			FreeBucketDirectory(&primaryDirectory);
+
+			return -1;
+		}
+
+		// Build the secondary hash file from the records of the primary one.
+		int32_t elementsInserted = BuildSecondaryIndex(fileHandle, &secondaryDirectory, primaryHashFileHandle, &primaryDirectory);
+		if (elementsInserted == -1)
+		{
+			printf("Could not insert the records of the hash file to the secondary hash file! FileName: %s\n", fileName);
+			FreeBucketDirectory(&secondaryDirectory);
+			FreeBucketDirectory(&primaryDirectory);
+			BF_CloseFile(primaryHashFileHandle);
+
+			return -1;
+		}
+
+		FreeBucketDirectory(&secondaryDirectory);
+		FreeBucketDirectory(&primaryDirectory);
+
+		// Close the primary hash file.
+		if (BF_CloseFile(primaryHashFileHandle) < 0)
+		{
+			printf("Could not close block level file! FileHandle: %d\n", primaryHashFileHandle);
+			BF_PrintError("");
+
+			return -1;
 		}
 
 		if (elementsInserted > 0)
@@ -371,15 +839,8 @@ int32_t SHT_CreateSecondaryIndex(char* fileName, char attributeType, char* attri
 
 SHT_info* SHT_OpenSecondaryIndex(char* fileName)
 {
-	// Ensure that there are no files currently open.
-	if (s_HandleStorage != -1)
-	{
-		printf("Cannot open secondary hash file since there's another file open!\n");
-		return nullptr;
-	}
-
 	// Open the block level file.
-	SHT_info fileHandle = BF_OpenFile(fileName);
+	SHT_info fileHandle = OpenLoggedFile(fileName);
 	if (fileHandle < 0)
 	{
 		printf("Could not open block level file for the secondary hash file! FileName: %s\n", fileName);
@@ -408,152 +869,155 @@ SHT_info* SHT_OpenSecondaryIndex(char* fileName)
 		return nullptr;
 	}
 
-	// Store the handle in a global variable so that we can return a pointer to it.
-	s_HandleStorage = fileHandle;
+	// Add the file to the open files table, which stores the handle so that we can return a pointer to it.
+	OpenHashFile* file = AddOpenHashFile(&s_OpenFiles, fileHandle, SecondaryHashFile, fileName);
+	if (file == nullptr)
+	{
+		printf("Cannot open secondary hash file since there are too many files open! FileName: %s\n", fileName);
+		BF_CloseFile(fileHandle);
+		return nullptr;
+	}
+
+	// Load the bucket directory so that operations don't have to walk the bucket blocks.
+	if (LoadBucketDirectory(fileHandle, &file->Directory) == -1)
+	{
+		printf("Could not load the bucket directory of the secondary hash file! FileName: %s\n", fileName);
+		RemoveOpenHashFile(&s_OpenFiles, file);
+		BF_CloseFile(fileHandle);
+		return nullptr;
+	}
+
+	ReleaseOpenHashFile(file);
 
-	return &s_HandleStorage;
+	return &file->Handle;
 }
 
 int32_t SHT_CloseSecondaryIndex(SHT_info* handle)
 {
 	// Ensure that the file we want to close is actually open.
-	if (s_HandleStorage != *handle)
+	OpenHashFile* file = AcquireOpenHashFile(&s_OpenFiles, *handle, true);
+	if (file == nullptr)
 	{
 		printf("Cannot close secondary hash file since it's not open!\n");
 		return -1;
 	}
 
 	// Close the block level file.
-	if (BF_CloseFile(*handle) < 0)
+	int32_t fileHandle = file->Handle;
+	if (BF_CloseFile(fileHandle) < 0)
 	{
-		printf("Could not close block level file! FileHandle: %d\n", *handle);
+		printf("Could not close block level file! FileHandle: %d\n", fileHandle);
 		BF_PrintError("");
+		ReleaseOpenHashFile(file);
 
 		return -1;
 	}
 
-	// Reset the internal storage.
-	s_HandleStorage = -1;
+	// Remove the file from the table, which frees the cached bucket directory. It's kept in sync with the disk on every
+	// insert so there's nothing to write.
+	RemoveOpenHashFile(&s_OpenFiles, file);
 
 	return 0;
 }
 
 int32_t SHT_SecondaryInsertEntry(SHT_info handle, SecondaryRecord record)
 {
-	// Retrieve a pointer to the secondary hash file header block.
-	uint8_t* headerBlockPtr = nullptr;
-	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	// Ensure that the file is open, since that's where it's bucket directory is cached.
+	OpenHashFile* file = AcquireOpenHashFile(&s_OpenFiles, handle, true);
+	if (file == nullptr)
 	{
-		printf("Could not retrieve pointer to secondary hash header block! FileHandle: %d, BlockIndex: %d\n", handle, HEADER_BLOCK_INDEX);
-		BF_PrintError("");
-
+		printf("Cannot insert to secondary hash file since it's not open! FileHandle: %d\n", handle);
 		return -1;
 	}
 
-	// Since this file exists, we know there's a FileHeader in the first bytes of the header block. So we treat the pointer as such.
-	HashFileHeader* fileHeader = (HashFileHeader*)headerBlockPtr;
-
-	// Hash the record surname and find the bucket index.
-	const char* surname = record.Record.Surname;
-	int32_t bucketIndex = HashFunction(surname, fileHeader->BucketCount);
-
-	// First we need to find the bucket block where the bucket index is in.
-
-	// Calculate in which block the above bucket index is in. This is similar to calculating the total bucket block size.
-	int32_t bucketBlockNumber = ((bucketIndex + 1) / MAX_BUCKET_COUNT_PER_BLOCK);
-	bucketBlockNumber += (((bucketIndex + 1) % MAX_BUCKET_COUNT_PER_BLOCK) > 0) ? 1 : 0;
-
-	// Start from the first actuall bucket block.
-	int32_t currentBucketBlockIndex = fileHeader->NextBlockIndex;
-
-	// Start with an invalid index since there's no previous bucket block.
-	int32_t previousBucketBlockIndex = INVALID_BLOCK_INDEX;
-
-	// Loop through all the blocks to find the index of the block the bucket index is in.
-	for (int32_t index = 0; index < bucketBlockNumber; index++)
-	{
-		// Retrieve a pointer to the new bucket block.
-		uint8_t* currentBucketBlockPtr = nullptr;
-		if (BF_ReadBlock(handle, currentBucketBlockIndex, (void**)&currentBucketBlockPtr) < 0)
-		{
-			printf("Could not retrieve pointer to secondary hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, currentBucketBlockIndex);
-			BF_PrintError("");
-
-			return -1;
-		}
-
-		// Since this file exists, we know there's a BucketBlockHeader in the first bytes of the header block. So we treat the pointer as such.
-		HashBucketBlockHeader* currentBucketBlockHeader = (HashBucketBlockHeader*)currentBucketBlockPtr;
-
-		// Update the previous and current bucket block index to the next one until we exit out of the loop.
-		previousBucketBlockIndex = currentBucketBlockIndex;
-		currentBucketBlockIndex = currentBucketBlockHeader->NextBlockIndex;
-	}
-
-	// This is the bucket block index where the bucket index is.
-	int32_t bucketBlockIndex = previousBucketBlockIndex;
+	// Perform the operation while holding the lock of the file, so that it sees a consistent bucket directory.
+	int32_t result = InsertDataSegment(handle, &file->Directory, record);
 
-	// Find the bucket index relative to the bucket block.
-	int32_t bucketIndexInBucketBlock = bucketIndex % MAX_BUCKET_COUNT_PER_BLOCK;
+	// Commit the changes, even those of a failed operation, so that their blocks can be written back.
+	if (CommitOpenHashFile(file) == -1)
+		result = -1;
 
-	// Retrieve a pointer to the bucket block.
-	uint8_t* bucketBlockPtr = nullptr;
-	if (BF_ReadBlock(handle, bucketBlockIndex, (void**)&bucketBlockPtr) < 0)
-	{
-		printf("Could not retrieve pointer to secondary hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, bucketBlockIndex);
-		BF_PrintError("");
-
-		return -1;
-	}
+	return result;
+}
 
-	// Offset the bucket block pointer by the size of the header so it points at the beginning of it's section of the hash table.
-	bucketBlockPtr += sizeof(HashBucketBlockHeader);
+// Finds the primary hash data blocks that the data segments with the surname key point to, in ascending order and without duplicates.
+// Blocks past the end of the primary hash file, which a truncation gave back, are left out. The block IDs are stored in an array that
+// the caller frees, or nullptr if there are none. Returns the number of secondary hash data blocks traversed on success and -1 on failure.
+static int32_t FindPrimaryBlockIDs(OpenHashFile* file, HT_info primaryHandle, const char* key, int32_t** blockIDs, uint32_t* blockCount)
+{
+	// The block level handle of the file.
+	SHT_info handle = file->Handle;
 
-	// Offset the bucket block pointer by the index of the bucket index times the size of a bucket index, so in points at the beginning
-	// of the bucket index we want.
-	bucketBlockPtr += bucketIndexInBucketBlock * sizeof(int32_t);
+	// The number of blocks that we traversed. The bucket directory is cached so only data blocks are counted.
+	uint32_t blocksTraversed = 0;
 
-	// Extract the index of the data block from the bucket.
-	int32_t dataBlockIndex = *(int32_t*)bucketBlockPtr;
+	// Hash the surname and find the bucket index.
+	int32_t bucketIndex = HashFunction(key, file->Directory.BucketCount);
 
-	// Now we need to look for the record and make sure it's not already in the hash file.
+	// Extract the index of the first data block of the bucket from the cached bucket directory.
+	int32_t dataBlockIndex = file->Directory.Buckets[bucketIndex];
 
-	// Start from the first data block.
+	// Start from the first actual block of data.
 	int32_t currentDataBlockIndex = dataBlockIndex;
 
-	// Loop until the end of the allocated data blocks.
+	// The primary hash data blocks of the data segments with the key. They are collected first, so that they can be read together.
+	int32_t* primaryBlockIDs = nullptr;
+	uint32_t primaryBlockCount = 0;
+	uint32_t primaryBlockCapacity = 0;
+
+	// Loop until the end of the allocated blocks.
 	while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
 	{
-		// Retrieve a pointer to the current data block.
+		// Retrieve a pointer to the current hash data block.
 		uint8_t* currentDataBlockPtr = nullptr;
 		if (BF_ReadBlock(handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
 		{
 			printf("Could not retrieve pointer to secondary hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
 			BF_PrintError("");
+			free(primaryBlockIDs);
 
 			return -1;
 		}
 
-		// Since this file exists, we know there's a DataBlockHeader in the first bytes of the block. So we treat the pointer as such.
+		// Increment the blocks traversed counter.
+		blocksTraversed++;
+
+		// Since this file exists, we know there's a BlockHeader in the first bytes of the block. So we treat the pointer as such.
 		HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
 
 		// Offset the block pointer by the size of the header so it points to the first byte of the first data segment slot.
 		currentDataBlockPtr += sizeof(HashDataBlockHeader);
 
-		// Interate through all the data segment slots that are occupied in the current data block.
+		// Interate through all the data segment slots that are occupied in the current block.
 		for (uint32_t dataSegmentIndex = 0; dataSegmentIndex < currentDataBlockHeader->ElementCount; dataSegmentIndex++)
 		{
 			// Treat the current pointer as a data segment.
 			DataSegment* currentDataSegment = (DataSegment*)currentDataBlockPtr;
 
-			// If the current record's key is the same as the one we want to insert, it's already in the hash so we exit.
-			if (strcmp(currentDataSegment->Surname, surname) == 0)
+			// If the surname of the current data segment is the key, remember the primary hash data block it points to.
+			if (strcmp(currentDataSegment->Surname, key) == 0)
 			{
-				printf("The specified record is already in the secondary hash file! RecordID: %s\n", surname);
-				return -1;
+				// Grow the array of block IDs if it's full.
+				if (primaryBlockCount == primaryBlockCapacity)
+				{
+					uint32_t newCapacity = (primaryBlockCapacity == 0) ? LOOKUP_BATCH_SIZE : primaryBlockCapacity * 2;
+					int32_t* newPrimaryBlockIDs = (int32_t*)realloc(primaryBlockIDs, newCapacity * sizeof(int32_t));
+					if (newPrimaryBlockIDs == nullptr)
+					{
+						printf("Could not allocate the primary hash data block IDs! BlockCount: %d\n", newCapacity);
+						free(primaryBlockIDs);
+
+						return -1;
+					}
+
+					primaryBlockIDs = newPrimaryBlockIDs;
+					primaryBlockCapacity = newCapacity;
+				}
+
+				primaryBlockIDs[primaryBlockCount++] = currentDataSegment->BlockID;
 			}
 
-			// Offset the block poiter by the size of a data segment so it pointes to the first byte of the next data segment slot.
+			// Offset the block poiter by the size of a data segment so it pointer to the first byte of the next data segment slot.
 			currentDataBlockPtr += sizeof(DataSegment);
 		}
 
@@ -561,383 +1025,449 @@ int32_t SHT_SecondaryInsertEntry(SHT_info handle, SecondaryRecord record)
 		currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
 	}
 
-	// If we're here the record is not in the hash so we try to insert it.
+	// Sort the block IDs and drop the duplicates, since records with the same surname often share a block.
+	uint32_t uniqueBlockCount = 0;
+	if (primaryBlockCount > 0)
+	{
+		qsort(primaryBlockIDs, primaryBlockCount, sizeof(int32_t), CompareBlockIDs);
 
-	// Create the data segment.
-	DataSegment dataSegment = { };
-	memcpy(dataSegment.Surname, surname, 25 * sizeof(char));
-	dataSegment.BlockID = record.BlockID;
+		uniqueBlockCount = 1;
+		for (uint32_t index = 1; index < primaryBlockCount; index++)
+		{
+			if (primaryBlockIDs[index] != primaryBlockIDs[uniqueBlockCount - 1])
+				primaryBlockIDs[uniqueBlockCount++] = primaryBlockIDs[index];
+		}
+	}
 
-	// Reset the current data block index and prepare for insertion.
-	currentDataBlockIndex = dataBlockIndex;
+	// The blocks a truncated primary hash file gave back hold none of the records.
+	int32_t primaryFileBlockCount = BF_GetBlockCounter(primaryHandle);
+	while (uniqueBlockCount > 0 && primaryBlockIDs[uniqueBlockCount - 1] >= primaryFileBlockCount)
+		uniqueBlockCount--;
 
-	// The previous block is invalid initially.
-	int32_t previousDataBlockIndex = INVALID_BLOCK_INDEX;
+	*blockIDs = primaryBlockIDs;
+	*blockCount = uniqueBlockCount;
 
-	// Loop until the end of the allocated data blocks.
-	while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
+	return blocksTraversed;
+}
+
+static int32_t GetAllEntries(OpenHashFile* file, HT_info primaryHandle, void* keyValue)
+{
+	// Key value can be nullptr. If it's not get the actual value otherwise use a dummy.
+	char key[25];
+	memset(key, 0, 25 * sizeof(char));
+	bool printAll = true;
+
+	if (keyValue != nullptr)
 	{
-		// Retrieve a pointer to the current data block.
-		uint8_t* currentDataBlockPtr = nullptr;
-		if (BF_ReadBlock(handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
+		memcpy(key, keyValue, (strlen((const char*)keyValue) + 1) * sizeof(char));
+		printAll = false;
+	}
+
+	if (!printAll)
+	{
+		// If key is valid, search for the entry.
+
+		// Find the primary hash data blocks of the data segments with the key, so that they can be read together.
+		int32_t* primaryBlockIDs = nullptr;
+		uint32_t uniqueBlockCount = 0;
+		int32_t secondaryBlocksTraversed = FindPrimaryBlockIDs(file, primaryHandle, key, &primaryBlockIDs, &uniqueBlockCount);
+		if (secondaryBlocksTraversed == -1)
+			return -1;
+
+		// The number of blocks that we traversed. The bucket directory is cached so only data blocks are counted.
+		uint32_t blocksTraversed = (uint32_t)secondaryBlocksTraversed;
+
+		// If we are here with no block IDs, it means that the record with the specified key was not found in the hash file.
+		if (uniqueBlockCount == 0)
 		{
-			printf("Could not retrieve pointer to secondary hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
-			BF_PrintError("");
+			printf("Could not find record with key %s!\n", key);
+			free(primaryBlockIDs);
 
 			return -1;
 		}
 
-		// Since this file exists, we know there's a DataBlockHeader in the first bytes of the block. So we treat the pointer as such.
-		HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
-
-		// If there's space in the current data block, we insert here.
-		if (currentDataBlockHeader->ElementCount < MAX_DATA_SEGMENT_COUNT_PER_BLOCK)
+		// The block size of the primary hash file, which locates the tombstones of it's data blocks.
+		int32_t primaryBlockSize = BF_GetBlockSize(primaryHandle);
+		if (primaryBlockSize < 0)
 		{
-			// Offset the block pointer by the size of the header so it points to the first byte of the first data segment slot.
-			currentDataBlockPtr += sizeof(HashDataBlockHeader);
+			printf("Could not retrieve block size for the hash file! FileHandle: %d\n", primaryHandle);
+			BF_PrintError("");
+			free(primaryBlockIDs);
 
-			// Offset the block pointer by the size of the data segment times the number of data segments so it points to the first byte
-			// of the first empty data segment slot.
-			currentDataBlockPtr += currentDataBlockHeader->ElementCount * sizeof(DataSegment);
+			return -1;
+		}
 
-			// Copy the data segment into the data block.
-			memcpy(currentDataBlockPtr, &dataSegment, sizeof(DataSegment));
+		// The number of records with the key that were found in the primary hash file.
+		uint32_t foundRecordCount = 0;
 
-			// Increment the current data block's data segment count.
-			currentDataBlockHeader->ElementCount++;
+		// Read the primary hash data blocks a batch at a time, so that every batch costs one round of reads.
+		for (uint32_t batchStart = 0; batchStart < uniqueBlockCount; batchStart += LOOKUP_BATCH_SIZE)
+		{
+			uint32_t batchSize = uniqueBlockCount - batchStart;
+			if (batchSize > LOOKUP_BATCH_SIZE)
+				batchSize = LOOKUP_BATCH_SIZE;
 
-			// Write the updated contents of the current hash file data block to the disk.
-			if (BF_WriteBlock(handle, currentDataBlockIndex) < 0)
+			// Pin the blocks of the batch for reading.
+			uint8_t* primaryHashDataBlockPtrs[LOOKUP_BATCH_SIZE];
+			if (BF_ReadBlocks(primaryHandle, &primaryBlockIDs[batchStart], batchSize, (void**)primaryHashDataBlockPtrs) < 0)
 			{
-				printf("Could not write secondary hash data block to disk! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
+				printf("Could not retrieve pointers to hash data blocks! FileHandle: %d, BlockIndex: %d\n", primaryHandle, primaryBlockIDs[batchStart]);
 				BF_PrintError("");
+				free(primaryBlockIDs);
 
 				return -1;
 			}
 
-			// Return a successful code.
-			return 0;
+			// Increment the blocks traversed counter.
+			blocksTraversed += batchSize;
+
+			for (uint32_t batchIndex = 0; batchIndex < batchSize; batchIndex++)
+			{
+				uint8_t* primaryHashDataBlockPtr = primaryHashDataBlockPtrs[batchIndex];
+
+				// Since this file exists, we know there's a BlockHeader in the first bytes of the block. So we treat the pointer as such.
+				HashDataBlockHeader* primaryHashDataBlockHeader = (HashDataBlockHeader*)primaryHashDataBlockPtr;
+
+				// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
+				primaryHashDataBlockPtr += sizeof(HashDataBlockHeader);
+
+				// Interate through all the record slots that are used in the current block.
+				for (uint32_t recordIndex = 0; recordIndex < primaryHashDataBlockHeader->SlotCount; recordIndex++)
+				{
+					// Treat the current pointer as a record.
+					Record* currentRecord = (Record*)primaryHashDataBlockPtr;
+
+					// If the current records surname is the key and it's not deleted, we want to print it.
+					if (!IS_SLOT_DELETED(primaryHashDataBlockHeader, primaryBlockSize, recordIndex) && strcmp(currentRecord->Surname, key) == 0)
+					{
+						printf("ID: %d, Name: %s, Surname: %s, Address: %s\n", currentRecord->ID, currentRecord->Name, currentRecord->Surname, currentRecord->Address);
+						foundRecordCount++;
+					}
+
+					// Offset the block poiter by the size of a record so it pointer to the first byte of the next record slot.
+					primaryHashDataBlockPtr += sizeof(Record);
+				}
+			}
+
+			// Unpin the blocks of the batch, now that we are done with them.
+			BF_UnpinBlocks(primaryHandle, &primaryBlockIDs[batchStart], batchSize);
 		}
 
-		// Update the previous and current block indices.
-		previousDataBlockIndex = currentDataBlockIndex;
-		currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
-	}
+		free(primaryBlockIDs);
 
-	// If we are here, a new data block needs to be created. Either because this is the first entry in the bucket or because we ran
-	// out of space in all of the currently allocated data blocks.
+		// Return an error if the records were not found in the primary index.
+		if (foundRecordCount == 0)
+			return -1;
 
-	// Allocate a new data block.
-	if (BF_AllocateBlock(handle) < 0)
+		return blocksTraversed;
+	}
+	else
 	{
-		printf("Could not allocate data block for the secondary hash file! FileHandle: %d\n", handle);
-		BF_PrintError("");
-
+		printf("Invalid key!\n");
 		return -1;
 	}
 
-	// Get the new block count.
-	int32_t blockCount = BF_GetBlockCounter(handle);
-	if (blockCount < 0)
-	{
-		printf("Could not retrieve block count for the secondary hash file! FileHandle: %d\n", handle);
-		BF_PrintError("");
+	return -1;
+}
 
+int32_t SHT_SecondaryGetAllEntries(SHT_info handle, HT_info primaryHandle, void* keyValue)
+{
+	// Ensure that the file is open, since that's where it's bucket directory is cached.
+	OpenHashFile* file = AcquireOpenHashFile(&s_OpenFiles, handle, false);
+	if (file == nullptr)
+	{
+		printf("Cannot get entries from secondary hash file since it's not open! FileHandle: %d\n", handle);
 		return -1;
 	}
 
-	// Calculate the new data block index.
-	int32_t newDataBlockIndex = blockCount - 1;
+	// Perform the operation while holding the lock of the file shared, so that lookups run concurrently with each other.
+	int32_t result = GetAllEntries(file, primaryHandle, keyValue);
+	ReleaseOpenHashFile(file);
 
-	// Retrieve a pointer to the new data block.
-	uint8_t* newDataBlockPtr = nullptr;
-	if (BF_ReadBlock(handle, newDataBlockIndex, (void**)&newDataBlockPtr) < 0)
+	return result;
+}
+
+// Unpins the batch of primary hash data blocks of a cursor, if it has one. Returns 0 on success and -1 on failure.
+static int32_t UnpinCursorBatch(SHT_Cursor* cursor)
+{
+	if (cursor->BatchSize == 0)
+		return 0;
+
+	uint32_t batchSize = cursor->BatchSize;
+	cursor->BatchSize = 0;
+
+	if (BF_UnpinBlocks(cursor->PrimaryHandle, &cursor->PrimaryBlockIDs[cursor->BatchStart], batchSize) < 0)
 	{
-		printf("Could not retrieve pointer to secondary hash data block! FileHandle: %d, BlockIndex: %d\n", handle, newDataBlockIndex);
+		printf("Could not unpin hash data blocks! FileHandle: %d, BlockIndex: %d\n", cursor->PrimaryHandle, cursor->PrimaryBlockIDs[cursor->BatchStart]);
 		BF_PrintError("");
 
 		return -1;
 	}
 
-	// Create the data block header and fill it's data.
-	HashDataBlockHeader newDataBlockHeader = { };
-	newDataBlockHeader.ElementCount = 1;
-	newDataBlockHeader.NextBlockIndex = INVALID_BLOCK_INDEX;
+	return 0;
+}
 
-	// Copy the new data block header into the new data block.
-	memcpy(newDataBlockPtr, &newDataBlockHeader, sizeof(HashDataBlockHeader));
+// Pins the next batch of primary hash data blocks of a cursor, if there are blocks left, so that every batch costs one round of reads.
+// Returns 0 on success and -1 on failure.
+static int32_t PinCursorBatch(SHT_Cursor* cursor, uint32_t batchStart)
+{
+	cursor->BatchStart = batchStart;
+	cursor->BatchIndex = 0;
+	cursor->SlotIndex = 0;
 
-	// Offset the data block pointer by the size of the header so it points to the first byte of the first data segment slot.
-	newDataBlockPtr += sizeof(HashDataBlockHeader);
+	if (batchStart >= cursor->PrimaryBlockCount)
+		return 0;
 
-	// Copy the data segment into the block.
-	memcpy(newDataBlockPtr, &dataSegment, sizeof(DataSegment));
+	uint32_t batchSize = cursor->PrimaryBlockCount - batchStart;
+	if (batchSize > LOOKUP_BATCH_SIZE)
+		batchSize = LOOKUP_BATCH_SIZE;
 
-	// Write the contents of the new hash data block to the disk.
-	if (BF_WriteBlock(handle, newDataBlockIndex) < 0)
+	// Pin the blocks of the batch for reading.
+	if (BF_ReadBlocks(cursor->PrimaryHandle, &cursor->PrimaryBlockIDs[batchStart], batchSize, (void**)cursor->BatchBlockPtrs) < 0)
 	{
-		printf("Could not write secondary hash data block to disk! FileHandle: %d, BlockIndex: %d\n", handle, newDataBlockIndex);
+		printf("Could not retrieve pointers to hash data blocks! FileHandle: %d, BlockIndex: %d\n", cursor->PrimaryHandle, cursor->PrimaryBlockIDs[batchStart]);
 		BF_PrintError("");
 
 		return -1;
 	}
 
-	if (previousDataBlockIndex != INVALID_BLOCK_INDEX)
-	{
-		// If a previous data block exists, we need to update the NextBlockIndex.
-
-		// Retrieve a pointer to the previous data block.
-		uint8_t* previousDataBlockPtr = nullptr;
-		if (BF_ReadBlock(handle, previousDataBlockIndex, (void**)&previousDataBlockPtr) < 0)
-		{
-			printf("Could not retrieve pointer to secondary hash data block! FileHandle: %d, BlockIndex: %d\n", handle, previousDataBlockIndex);
-			BF_PrintError("");
-
-			return -1;
-		}
+	cursor->BatchSize = batchSize;
 
-		// Get the header and update the next block index.
-		HashDataBlockHeader* previousDataBlockHeader = (HashDataBlockHeader*)previousDataBlockPtr;
-		previousDataBlockHeader->NextBlockIndex = newDataBlockIndex;
+	return 0;
+}
 
-		// Write the contents of the previous hash data block to the disk.
-		if (BF_WriteBlock(handle, previousDataBlockIndex) < 0)
-		{
-			printf("Could not write secondary hash data block to disk! FileHandle: %d, BlockIndex: %d\n", handle, previousDataBlockIndex);
-			BF_PrintError("");
+SHT_Cursor* SHT_ScanOpen(SHT_info handle, HT_info primaryHandle, void* keyValue)
+{
+	// Only lookups by surname are supported.
+	if (keyValue == nullptr)
+	{
+		printf("Invalid key!\n");
+		return nullptr;
+	}
 
-			return -1;
-		}
+	// Ensure that the file is open, since that's where it's bucket directory is cached. The cursor holds the lock of the file shared
+	// until it's closed.
+	OpenHashFile* file = AcquireOpenHashFile(&s_OpenFiles, handle, false);
+	if (file == nullptr)
+	{
+		printf("Cannot scan secondary hash file since it's not open! FileHandle: %d\n", handle);
+		return nullptr;
 	}
-	else
+
+	// The block size of the primary hash file, which locates the tombstones of it's data blocks.
+	int32_t primaryBlockSize = BF_GetBlockSize(primaryHandle);
+	if (primaryBlockSize < 0)
 	{
-		// Otherwise we need to update the bucket block.
+		printf("Could not retrieve block size for the hash file! FileHandle: %d\n", primaryHandle);
+		BF_PrintError("");
+		ReleaseOpenHashFile(file);
 
-		// Retrieve a pointer to the bucket block.
-		uint8_t* bucketBlockPtr = nullptr;
-		if (BF_ReadBlock(handle, bucketBlockIndex, (void**)&bucketBlockPtr) < 0)
-		{
-			printf("Could not retrieve pointer to secondary hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, bucketBlockIndex);
-			BF_PrintError("");
+		return nullptr;
+	}
 
-			return -1;
-		}
+	// Allocate the cursor.
+	SHT_Cursor* cursor = (SHT_Cursor*)malloc(sizeof(SHT_Cursor));
+	if (cursor == nullptr)
+	{
+		printf("Could not allocate the cursor of the secondary hash file! FileHandle: %d\n", handle);
+		ReleaseOpenHashFile(file);
 
-		// Offset the bucket block pointer by the size of the header so it points at the beginning of it's section of the hash table.
-		bucketBlockPtr += sizeof(HashBucketBlockHeader);
+		return nullptr;
+	}
 
-		// Offset the bucket block pointer by the index of the bucket index times the size of a bucket index, so in points at the beginning
-		// of the bucket index we want.
-		bucketBlockPtr += bucketIndexInBucketBlock * sizeof(int32_t);
+	cursor->File = file;
+	cursor->PrimaryHandle = primaryHandle;
+	cursor->PrimaryBlockSize = primaryBlockSize;
+	cursor->PrimaryBlockIDs = nullptr;
+	cursor->PrimaryBlockCount = 0;
+	cursor->BatchSize = 0;
 
-		// Extract the index of the data block from the bucket.
-		int32_t* dataBlockIndex = (int32_t*)bucketBlockPtr;
-		*dataBlockIndex = newDataBlockIndex;
+	memset(cursor->Key, 0, sizeof(cursor->Key));
+	strncpy(cursor->Key, (const char*)keyValue, sizeof(cursor->Key) - 1);
 
-		// Write the contents of the bucket block to the disk.
-		if (BF_WriteBlock(handle, bucketBlockIndex) < 0)
-		{
-			printf("Could not write secondary hash bucket block to disk! FileHandle: %d, BlockIndex: %d\n", handle, bucketBlockIndex);
-			BF_PrintError("");
+	// Find the primary hash data blocks of the data segments with the key, and pin the first batch of them.
+	if (FindPrimaryBlockIDs(file, primaryHandle, cursor->Key, &cursor->PrimaryBlockIDs, &cursor->PrimaryBlockCount) == -1 ||
+		PinCursorBatch(cursor, 0) == -1)
+	{
+		ReleaseOpenHashFile(file);
+		free(cursor->PrimaryBlockIDs);
+		free(cursor);
 
-			return -1;
-		}
+		return nullptr;
 	}
 
-	return 0;
+	return cursor;
 }
 
-int32_t SHT_SecondaryGetAllEntries(SHT_info handle, HT_info primaryHandle, void* keyValue)
+int32_t SHT_ScanNextBatch(SHT_Cursor* cursor, const Record** records, int32_t maxRecordCount)
 {
-	// Key value can be nullptr. If it's not get the actual value otherwise use a dummy.
-	char key[25];
-	memset(key, 0, 25 * sizeof(char));
-	bool printAll = true;
-
-	if (keyValue != nullptr)
-	{
-		memcpy(key, keyValue, (strlen((const char*)keyValue) + 1) * sizeof(char));
-		printAll = false;
-	}
-
-	// Retrieve a pointer to the hash file header block.
-	uint8_t* headerBlockPtr = nullptr;
-	if (BF_ReadBlock(handle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	if (maxRecordCount <= 0)
 	{
-		printf("Could not retrieve pointer to secondary hash header block! FileHandle: %d, BlockIndex: %d\n", handle, HEADER_BLOCK_INDEX);
-		BF_PrintError("");
-
+		printf("Invalid number of records to scan! RecordCount: %d\n", maxRecordCount);
 		return -1;
 	}
 
-	// Since this file exists, we know there's a FileHeader in the first bytes of the header block. So we treat the pointer as such.
-	HashFileHeader* fileHeader = (HashFileHeader*)headerBlockPtr;
-
-	// The number of blocks that we traversed. Set to one to account for the hash file header block.
-	uint32_t blocksTraversed = 1;
-
-	if (!printAll)
+	// Loop until a batch of blocks has records left, or the scan is over.
+	while (cursor->BatchSize > 0)
 	{
-		// If key is valid, search for the entry.
+		// Collect the next records with the key of the pinned blocks, if any are left.
+		uint32_t recordCount = 0;
+		for (; cursor->BatchIndex < cursor->BatchSize; cursor->BatchIndex++, cursor->SlotIndex = 0)
+		{
+			uint8_t* primaryHashDataBlockPtr = cursor->BatchBlockPtrs[cursor->BatchIndex];
+			HashDataBlockHeader* primaryHashDataBlockHeader = (HashDataBlockHeader*)primaryHashDataBlockPtr;
+			const Record* slots = (const Record*)(primaryHashDataBlockPtr + sizeof(HashDataBlockHeader));
 
-		// Hash the record ID and find the bucket index.
-		int32_t bucketIndex = HashFunction(key, fileHeader->BucketCount);
+			// Interate through the record slots of the block that are used, and were not read yet.
+			while (cursor->SlotIndex < primaryHashDataBlockHeader->SlotCount && recordCount < (uint32_t)maxRecordCount)
+			{
+				uint32_t slotIndex = cursor->SlotIndex++;
+				if (!IS_SLOT_DELETED(primaryHashDataBlockPtr, cursor->PrimaryBlockSize, slotIndex) && strcmp(slots[slotIndex].Surname, cursor->Key) == 0)
+					records[recordCount++] = &slots[slotIndex];
+			}
 
-		// First we need to find the bucket block where the bucket index is in.
+			if (recordCount == (uint32_t)maxRecordCount)
+				break;
+		}
 
-		// Calculate in which block the above bucket index is in. This is similar to calculating the total bucket block size.
-		int32_t bucketBlockNumber = ((bucketIndex + 1) / MAX_BUCKET_COUNT_PER_BLOCK);
-		bucketBlockNumber += (((bucketIndex + 1) % MAX_BUCKET_COUNT_PER_BLOCK) > 0) ? 1 : 0;
+		if (recordCount > 0)
+			return (int32_t)recordCount;
 
-		// Start from the first actuall bucket block.
-		int32_t currentBucketBlockIndex = fileHeader->NextBlockIndex;
+		// Move to the next batch, now that we are done with the blocks of this one.
+		uint32_t nextBatchStart = cursor->BatchStart + cursor->BatchSize;
+		if (UnpinCursorBatch(cursor) == -1 || PinCursorBatch(cursor, nextBatchStart) == -1)
+			return -1;
+	}
 
-		// Start with an invalid index since there's no previous bucket block.
-		int32_t previousBucketBlockIndex = INVALID_BLOCK_INDEX;
+	return 0;
+}
 
-		// Loop through all the blocks to find the index of the block the bucket index is in.
-		for (int32_t index = 0; index < bucketBlockNumber; index++)
-		{
-			// Retrieve a pointer to the new bucket block.
-			uint8_t* currentBucketBlockPtr = nullptr;
-			if (BF_ReadBlock(handle, currentBucketBlockIndex, (void**)&currentBucketBlockPtr) < 0)
-			{
-				printf("Could not retrieve pointer to secondary hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, currentBucketBlockIndex);
-				BF_PrintError("");
+int32_t SHT_ScanNext(SHT_Cursor* cursor, const Record** record)
+{
+	return SHT_ScanNextBatch(cursor, record, 1);
+}
 
-				return -1;
-			}
+int32_t SHT_ScanClose(SHT_Cursor* cursor)
+{
+	// Unpin the blocks of the cursor, and release the lock of the file.
+	int32_t result = UnpinCursorBatch(cursor);
+	ReleaseOpenHashFile(cursor->File);
+	free(cursor->PrimaryBlockIDs);
+	free(cursor);
 
-			// Increment the blocks traversed counter.
-			blocksTraversed++;
+	return result;
+}
 
-			// Since this file exists, we know there's a BucketBlockHeader in the first bytes of the header block. So we treat the pointer as such.
-			HashBucketBlockHeader* currentBucketBlockHeader = (HashBucketBlockHeader*)currentBucketBlockPtr;
+int32_t SHT_RemapBlockIDs(char* fileName, SHT_BlockIDRemap* remaps, uint32_t remapCount)
+{
+	// Sort the remaps so that every data segment can find it's own with a binary search.
+	qsort(remaps, remapCount, sizeof(SHT_BlockIDRemap), CompareBlockIDRemaps);
 
-			// Update the previous and current bucket block index to the next one until we exit out of the loop.
-			previousBucketBlockIndex = currentBucketBlockIndex;
-			currentBucketBlockIndex = currentBucketBlockHeader->NextBlockIndex;
-		}
+	// Open the block level file. If the secondary hash file is currently open, this shares it's blocks.
+	SHT_info fileHandle = BF_OpenFile(fileName);
+	if (fileHandle < 0)
+	{
+		printf("Could not open block level file for the secondary hash file! FileName: %s\n", fileName);
+		BF_PrintError("");
 
-		// This is the bucket block index where the bucket index is.
-		int32_t bucketBlockIndex = previousBucketBlockIndex;
+		return -1;
+	}
 
-		// Find the bucket index relative to the bucket block.
-		int32_t bucketIndexInBucketBlock = bucketIndex % MAX_BUCKET_COUNT_PER_BLOCK;
+	// Retrieve a pointer to the header block.
+	uint8_t* headerBlockPtr = nullptr;
+	if (BF_ReadBlock(fileHandle, HEADER_BLOCK_INDEX, (void**)&headerBlockPtr) < 0)
+	{
+		printf("Could not retrieve pointer to secondary hash header block! FileHandle: %d, BlockIndex: %d\n", fileHandle, HEADER_BLOCK_INDEX);
+		BF_PrintError("");
 
-		// Retrieve a pointer to the bucket block.
-		uint8_t* bucketBlockPtr = nullptr;
-		if (BF_ReadBlock(handle, bucketBlockIndex, (void**)&bucketBlockPtr) < 0)
-		{
-			printf("Could not retrieve pointer to secondary hash bucket block! FileHandle: %d, BlockIndex: %d\n", handle, bucketBlockIndex);
-			BF_PrintError("");
+		return -1;
+	}
 
-			return -1;
-		}
+	// Ensure that the file we remap is a indeed secondary hash file.
+	if (((CommonFileHeader*)headerBlockPtr)->Type != SecondaryHashFile)
+	{
+		printf("File specified is not a secondary hash file! FileName: %s\n", fileName);
+		BF_CloseFile(fileHandle);
+
+		return -1;
+	}
 
-		// Offset the bucket block pointer by the size of the header so it points at the beginning of it's section of the hash table.
-		bucketBlockPtr += sizeof(HashBucketBlockHeader);
+	// Load the bucket directory of the secondary hash file.
+	HashBucketDirectory directory;
+	if (LoadBucketDirectory(fileHandle, &directory) == -1)
+	{
+		printf("Could not load the bucket directory of the secondary hash file! FileName: %s\n", fileName);
+		BF_CloseFile(fileHandle);
 
-		// Offset the bucket block pointer by the index of the bucket index times the size of a bucket index, so in points at the beginning
-		// of the bucket index we want.
-		bucketBlockPtr += bucketIndexInBucketBlock * sizeof(int32_t);
+		return -1;
+	}
 
-		// Extract the index of the data block from the bucket.
-		int32_t dataBlockIndex = *(int32_t*)bucketBlockPtr;
+	int32_t result = 0;
 
-		// Start from the first actual block of data.
-		int32_t currentDataBlockIndex = dataBlockIndex;
+	// Loop though all the buckets of the secondary hash file.
+	for (uint32_t bucketIndex = 0; bucketIndex < directory.BucketCount && result == 0; bucketIndex++)
+	{
+		// Start from the first data block.
+		int32_t currentDataBlockIndex = directory.Buckets[bucketIndex];
 
-		// Loop until the end of the allocated blocks.
+		// Loop through all the data blocks in the bucket.
 		while (currentDataBlockIndex != INVALID_BLOCK_INDEX)
 		{
-			// Retrieve a pointer to the current hash data block.
+			// Retrieve a pointer to the data block.
 			uint8_t* currentDataBlockPtr = nullptr;
-			if (BF_ReadBlock(handle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
+			if (BF_ReadBlock(fileHandle, currentDataBlockIndex, (void**)&currentDataBlockPtr) < 0)
 			{
-				printf("Could not retrieve pointer to secondary hash data block! FileHandle: %d, BlockIndex: %d\n", handle, currentDataBlockIndex);
+				printf("Could not retrieve pointer to secondary hash data block! FileHandle: %d, BlockIndex: %d\n", fileHandle, currentDataBlockIndex);
 				BF_PrintError("");
+				result = -1;
 
-				return -1;
+				break;
 			}
 
-			// Increment the blocks traversed counter.
-			blocksTraversed++;
-
-			// Since this file exists, we know there's a BlockHeader in the first bytes of the block. So we treat the pointer as such.
+			// Since this block exists we know there is a DataBlockHeader is the first byte so treat is as such.
 			HashDataBlockHeader* currentDataBlockHeader = (HashDataBlockHeader*)currentDataBlockPtr;
+			DataSegment* dataSegments = (DataSegment*)(currentDataBlockPtr + sizeof(HashDataBlockHeader));
 
-			// Offset the block pointer by the size of the header so it points to the first byte of the first data segment slot.
-			currentDataBlockPtr += sizeof(HashDataBlockHeader);
-
-			// Interate through all the data segment slots that are occupied in the current block.
+			// Remap every data segment of the block.
 			for (uint32_t dataSegmentIndex = 0; dataSegmentIndex < currentDataBlockHeader->ElementCount; dataSegmentIndex++)
 			{
-				// Treat the current pointer as a data segment.
-				DataSegment* currentDataSegment = (DataSegment*)currentDataBlockPtr;
-
-				// If the current records ID is the same as the key, we want to print it and exit.
-				if (strcmp(currentDataSegment->Surname, key) == 0)
-				{
-					// Now we want to look for it in the primary hash file.
-
-					// Retrieve a pointer to the current hash data block.
-					uint8_t* primaryHashDataBlockPtr = nullptr;
-					if (BF_ReadBlock(primaryHandle, currentDataSegment->BlockID, (void**)&primaryHashDataBlockPtr) < 0)
-					{
-						printf("Could not retrieve pointer to hash data block! FileHandle: %d, BlockIndex: %d\n", primaryHandle, currentDataBlockIndex);
-						BF_PrintError("");
-
-						return -1;
-					}
-
-					// Increment the blocks traversed counter.
-					blocksTraversed++;
-
-					// Since this file exists, we know there's a BlockHeader in the first bytes of the block. So we treat the pointer as such.
-					HashDataBlockHeader* primaryHashDataBlockHeader = (HashDataBlockHeader*)primaryHashDataBlockPtr;
-
-					// Offset the block pointer by the size of the header so it points to the first byte of the first record slot.
-					primaryHashDataBlockPtr += sizeof(HashDataBlockHeader);
+				// Look for the remap of the data segment.
+				SHT_BlockIDRemap key = { };
+				key.OldBlockID = dataSegments[dataSegmentIndex].BlockID;
+				memcpy(key.Surname, dataSegments[dataSegmentIndex].Surname, sizeof(key.Surname));
+
+				SHT_BlockIDRemap* remap = (SHT_BlockIDRemap*)bsearch(&key, remaps, remapCount, sizeof(SHT_BlockIDRemap), CompareBlockIDRemaps);
+				if (remap != nullptr)
+					dataSegments[dataSegmentIndex].BlockID = remap->NewBlockID;
+			}
 
-					// Interate through all the record slots that are occupied in the current block.
-					for (uint32_t recordIndex = 0; recordIndex < primaryHashDataBlockHeader->ElementCount; recordIndex++)
-					{
-						// Treat the current pointer as a record.
-						Record* currentRecord = (Record*)primaryHashDataBlockPtr;
-
-						// If the current records ID is the same as the key, we want to print it and exit.
-						if (strcmp(currentRecord->Surname, key) == 0)
-						{
-							printf("ID: %d, Name: %s, Surname: %s, Address: %s\n", currentRecord->ID, currentRecord->Name, currentRecord->Surname, currentRecord->Address);
-							return blocksTraversed;
-						}
-
-						// Offset the block poiter by the size of a record so it pointer to the first byte of the next record slot.
-						primaryHashDataBlockPtr += sizeof(Record);
-					}
+			// Update the current data block to point to the next one, before writing since the write may evict the block.
+			int32_t nextDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
 
-					// Return an error since the record was not found in the primary index.
-					return -1;
-				}
+			// Write the remapped data block to the disk.
+			if (BF_WriteBlock(fileHandle, currentDataBlockIndex) < 0)
+			{
+				printf("Could not write secondary hash data block to disk! FileHandle: %d, BlockIndex: %d\n", fileHandle, currentDataBlockIndex);
+				BF_PrintError("");
+				result = -1;
 
-				// Offset the block poiter by the size of a data segment so it pointer to the first byte of the next data segment slot.
-				currentDataBlockPtr += sizeof(DataSegment);
+				break;
 			}
 
-			// Update the current block index.
-			currentDataBlockIndex = currentDataBlockHeader->NextBlockIndex;
+			currentDataBlockIndex = nextDataBlockIndex;
 		}
-
-		// If we are here, it means that the record with the specified key was not found in the hash file.
-		printf("Could not find record with key %s!\n", key);
-		return -1;
 	}
-	else
+
+	FreeBucketDirectory(&directory);
+
+	// Close the block level file.
+	if (BF_CloseFile(fileHandle) < 0)
 	{
-		printf("Invalid key!\n");
+		printf("Could not close block level file! FileHandle: %d\n", fileHandle);
+		BF_PrintError("");
+
 		return -1;
 	}
 
-	return -1;
+	return result;
 }
@@ -3,12 +3,31 @@
 // The handle of a secondary hash file.
 typedef int32_t SHT_info;
 
+// The new location of a record of the primary hash file, after the primary hash file has been rebuilt.
+typedef struct SHT_BlockIDRemap
+{
+	// The block ID the record used to be stored in.
+	int32_t OldBlockID;
+
+	// The block ID the record is now stored in.
+	int32_t NewBlockID;
+
+	// The surname of the record.
+	char Surname[25];
+} SHT_BlockIDRemap;
+
 // Creates a secondary hash file with bucketCount number of buckets, and is assosiated with the hash table
 // with file name primaryFileName. This function inserts any elements already in the main hash table into the
-// secondary one. This returns 0 on success and -1 on failure.
+// secondary one. The primary hash file can't be a linear or extendible hash file, since their splits move records without
+// updating the block IDs of the secondary hash file. This returns 0 on success and -1 on failure.
 int32_t SHT_CreateSecondaryIndex(char* fileName, char attributeType, char* attributeName, int32_t attributeLength,
 	int32_t bucketCount, char* primaryFileName);
 
+// Same as SHT_CreateSecondaryIndex, but the blocks of the secondary hash file are blockSize bytes.
+// This returns 0 on success and -1 on failure.
+int32_t SHT_CreateSecondaryIndexWithBlockSize(char* fileName, char attributeType, char* attributeName, int32_t attributeLength,
+	int32_t bucketCount, char* primaryFileName, int32_t blockSize);
+
 // Opens a secondary hash file and returns a pointer to it's handle. Returns the file handle on success and nullptr on failure.
 SHT_info* SHT_OpenSecondaryIndex(char* fileName);
 
@@ -21,3 +40,29 @@ int32_t SHT_SecondaryInsertEntry(SHT_info handle, SecondaryRecord record);
 // Prints the entry with key == keyValue if it exists.
 // Returns the number of blocks traversed on success and -1 on failure.
 int32_t SHT_SecondaryGetAllEntries(SHT_info handle, HT_info primaryHandle, void* keyValue);
+
+// The state of a scan of the records with a surname, through a secondary hash file.
+typedef struct SHT_Cursor SHT_Cursor;
+
+// Opens a cursor over the records of the primary hash file with surname == keyValue, found through the secondary hash file. The
+// records are returned as pointers into the data blocks of the primary hash file, pinned in memory a batch of blocks at a time while
+// the cursor reads them, so they are never copied. The cursor holds the lock of the secondary hash file shared until it's closed. It
+// must be used and closed by the thread that opened it, before that thread modifies either file. Returns the cursor on success and
+// nullptr on failure.
+SHT_Cursor* SHT_ScanOpen(SHT_info handle, HT_info primaryHandle, void* keyValue);
+
+// Stores a pointer to the next record of a cursor in record. The record is valid until the next call with the cursor.
+// Returns 1 if there was a record, 0 at the end of the scan and -1 on failure.
+int32_t SHT_ScanNext(SHT_Cursor* cursor, const Record** record);
+
+// Stores pointers to at most maxRecordCount of the next records of a cursor in records. The records are from the same batch of
+// blocks, and valid until the next call with the cursor. Returns the number of records stored, 0 at the end of the scan and -1 on
+// failure.
+int32_t SHT_ScanNextBatch(SHT_Cursor* cursor, const Record** records, int32_t maxRecordCount);
+
+// Closes a cursor, unpinning it's blocks and releasing the lock of the secondary hash file. Returns 0 on success and -1 on failure.
+int32_t SHT_ScanClose(SHT_Cursor* cursor);
+
+// Updates the primary block IDs stored in the secondary hash file with name fileName, after the primary hash file has been rebuilt.
+// Data segments without a remap entry are left unchanged. The remaps array is sorted in place. Returns 0 on success and -1 on failure.
+int32_t SHT_RemapBlockIDs(char* fileName, SHT_BlockIDRemap* remaps, uint32_t remapCount);